@@ -0,0 +1,136 @@
+#include "hkds_admission.h"
+#include "hkds_factory.h"
+#include "hkds_wire.h"
+#include "../QSC/atomics.h"
+#include "../QSC/memutils.h"
+
+void hkds_admission_initialize(hkds_admission_state* state, uint64_t budget, size_t workers, uint64_t unit)
+{
+	assert(state != NULL);
+	assert(budget != 0);
+
+	qsc_memutils_clear((uint8_t*)state, sizeof(hkds_admission_state));
+	state->budget = budget;
+	state->workers = (workers != 0) ? workers : 1;
+	state->unit = (unit != 0) ? unit : HKDS_ADMISSION_UNIT_DEFAULT;
+}
+
+uint32_t hkds_admission_cost(const uint8_t* packet, bool cached)
+{
+	assert(packet != NULL);
+
+	hkds_priority_class pcls;
+	uint32_t res;
+
+	pcls = hkds_priority_classify(packet);
+
+	if (pcls == hkds_priority_message)
+	{
+		res = HKDS_ADMISSION_COST_MESSAGE;
+		res += (cached == false) ? HKDS_ADMISSION_COST_DERIVE : 0;
+		res += (packet[HKDS_ADMISSION_PID_OFFSET] == HKDS_AUTHENTICATION_KMAC) ? HKDS_ADMISSION_COST_MAC : 0;
+	}
+	else if (pcls == hkds_priority_token)
+	{
+		res = HKDS_ADMISSION_COST_TOKEN;
+	}
+	else
+	{
+		res = 0;
+	}
+
+	/* SHAKE-512 absorbs a key at a lower rate, each derivation uses about twice the permutations */
+	if ((hkds_protocol_id)((const hkds_wire_header*)packet)->protocol == protocol_shake_512)
+	{
+		res *= 2;
+	}
+
+	return res;
+}
+
+bool hkds_admission_admit(hkds_admission_state* state, const uint8_t* packet, bool cached, uint32_t* cost)
+{
+	assert(state != NULL);
+	assert(packet != NULL);
+	assert(cost != NULL);
+
+	hkds_priority_class pcls;
+	uint64_t delay;
+	uint64_t limit;
+	bool res;
+
+	res = false;
+	*cost = 0;
+	pcls = hkds_priority_classify(packet);
+
+	if (pcls == hkds_priority_control)
+	{
+		res = true;
+	}
+	else if (pcls != hkds_priority_none)
+	{
+		*cost = hkds_admission_cost(packet, cached);
+		/* the expected wait behind the backlog, plus this requests own service time */
+		delay = hkds_admission_delay(state) + ((*cost * qsc_atomics_load64(&state->unit)) / 1000);
+		limit = (state->budget * ((pcls == hkds_priority_token) ? HKDS_ADMISSION_SHARE_TOKEN : HKDS_ADMISSION_SHARE_MESSAGE)) / 100;
+		res = (delay <= limit);
+	}
+
+	if (pcls != hkds_priority_none)
+	{
+		if (res == true)
+		{
+			qsc_atomics_fetch_add64(&state->backlog, *cost);
+			qsc_atomics_fetch_add64(&state->admitted[pcls], 1);
+		}
+		else
+		{
+			*cost = 0;
+			qsc_atomics_fetch_add64(&state->rejected[pcls], 1);
+		}
+	}
+
+	return res;
+}
+
+void hkds_admission_complete(hkds_admission_state* state, uint32_t cost, uint64_t elapsed)
+{
+	assert(state != NULL);
+
+	uint64_t sample;
+	uint64_t unit;
+
+	if (cost != 0)
+	{
+		qsc_atomics_fetch_add64(&state->backlog, (uint64_t)0 - (uint64_t)cost);
+
+		if (elapsed != 0)
+		{
+			/* a racing update loses one sample, the average is unaffected */
+			sample = (elapsed * 1000) / cost;
+			unit = qsc_atomics_load64(&state->unit);
+			qsc_atomics_store64(&state->unit, ((unit * 7) + sample) / 8);
+		}
+	}
+}
+
+uint64_t hkds_admission_delay(const hkds_admission_state* state)
+{
+	assert(state != NULL);
+
+	return (qsc_atomics_load64(&state->backlog) * qsc_atomics_load64(&state->unit)) / (state->workers * 1000);
+}
+
+hkds_error_message hkds_admission_create_busy(const uint8_t* packet)
+{
+	assert(packet != NULL);
+
+	uint8_t msg[HKDS_ERROR_SIZE] = { 0 };
+	bool client;
+
+	/* client requests carry the KSN after the header */
+	client = (hkds_priority_classify(packet) == hkds_priority_message || hkds_priority_classify(packet) == hkds_priority_token);
+	hkds_factory_create_error_echo(msg, hkds_factory_extract_packet_sequence(packet), (client == true) ? packet + HKDS_HEADER_SIZE : NULL);
+
+	return hkds_factory_create_error_message(msg, error_server_busy);
+}
@@ -0,0 +1,155 @@
+/* 2021 Digital Freedom Defense Incorporated
+ * All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Digital Freedom Defense Incorporated.
+ * The intellectual and technical concepts contained
+ * herein are proprietary to Digital Freedom Defense Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Digital Freedom Defense Incorporated.
+ *
+ * Contact: develop@dfdef.com
+ */
+
+#ifndef HKDS_ADMISSION_H
+#define HKDS_ADMISSION_H
+
+#include "common.h"
+#include "hkds_config.h"
+#include "hkds_priority.h"
+
+/* Cost model admission control.
+* Each server ingress packet is given an estimated cost in units of one transaction key derivation,
+* from its packet type, its protocol, whether it carries a KMAC tag, and whether the devices
+* epoch key cache is already held by the server.
+* The controller tracks the cost of admitted work not yet completed, and converts it to an expected
+* queueing delay with a moving average of the measured time per cost unit.
+* A packet is admitted only if the expected delay, plus its own cost, fits within the share of the
+* latency budget allowed for its priority class; token requests are shed first, then message requests,
+* control packets are always admitted.
+* A rejected request is answered at once with an error_server_busy message instead of being queued,
+* so under overload the server spends its time on requests that can still complete within the budget.
+* The admission functions are thread safe, one controller can be shared by the server threads. */
+
+/*!
+\def HKDS_ADMISSION_COST_MESSAGE
+* The cost of a message request when the devices key cache is held by the server
+*/
+#define HKDS_ADMISSION_COST_MESSAGE 1
+
+/*!
+\def HKDS_ADMISSION_COST_DERIVE
+* The additional cost of deriving the devices key cache; the EDK, token and cache derivations
+*/
+#define HKDS_ADMISSION_COST_DERIVE 4
+
+/*!
+\def HKDS_ADMISSION_COST_MAC
+* The additional cost of verifying a KMAC tag
+*/
+#define HKDS_ADMISSION_COST_MAC 1
+
+/*!
+\def HKDS_ADMISSION_COST_TOKEN
+* The cost of a token request; the EDK and token derivations, the token encryption and its KMAC
+*/
+#define HKDS_ADMISSION_COST_TOKEN 4
+
+/*!
+\def HKDS_ADMISSION_SHARE_MESSAGE
+* The percentage of the latency budget message requests may be queued behind
+*/
+#define HKDS_ADMISSION_SHARE_MESSAGE 100
+
+/*!
+\def HKDS_ADMISSION_SHARE_TOKEN
+* The percentage of the latency budget token requests may be queued behind
+*/
+#define HKDS_ADMISSION_SHARE_TOKEN 50
+
+/*!
+\def HKDS_ADMISSION_UNIT_DEFAULT
+* The initial estimate of the time to process one cost unit in nanoseconds
+*/
+#define HKDS_ADMISSION_UNIT_DEFAULT 2000ULL
+
+/*!
+\def HKDS_ADMISSION_PID_OFFSET
+* The offset of the KSN protocol id in a client request; HKDS_AUTHENTICATION_KMAC indicates an authenticated message
+*/
+#define HKDS_ADMISSION_PID_OFFSET (HKDS_HEADER_SIZE + HKDS_KID_SIZE)
+
+/*! \struct hkds_admission_state
+* Contains the admission controller state
+*/
+HKDS_EXPORT_API typedef struct
+{
+	uint64_t budget;									/*!< The latency budget in microseconds */
+	uint64_t workers;									/*!< The number of threads executing admitted work */
+	volatile uint64_t backlog;							/*!< The cost of admitted work not yet completed */
+	volatile uint64_t unit;								/*!< The moving average time per cost unit in nanoseconds */
+	volatile uint64_t admitted[HKDS_PRIORITY_CLASSES];	/*!< The number of packets admitted in each class */
+	volatile uint64_t rejected[HKDS_PRIORITY_CLASSES];	/*!< The number of packets rejected in each class */
+} hkds_admission_state;
+
+/**
+* \brief Initialize the admission controller
+*
+* \param state [struct] The controller state
+* \param budget [uint64] The latency budget in microseconds
+* \param workers [size] The number of threads executing admitted work
+* \param unit [uint64] The initial time per cost unit in nanoseconds, zero selects HKDS_ADMISSION_UNIT_DEFAULT
+*/
+HKDS_EXPORT_API void hkds_admission_initialize(hkds_admission_state* state, uint64_t budget, size_t workers, uint64_t unit);
+
+/**
+* \brief Estimate the cost of a packet
+*
+* \param packet [array][const] The serialized packet
+* \param cached [bool] The server holds the devices key cache for the current epoch
+* \return [uint32] The cost in units of one transaction key derivation, zero for control packets
+*/
+HKDS_EXPORT_API uint32_t hkds_admission_cost(const uint8_t* packet, bool cached);
+
+/**
+* \brief Decide whether to admit a packet, and add its cost to the backlog if it is admitted
+*
+* \param state [struct] The controller state
+* \param packet [array][const] The serialized packet
+* \param cached [bool] The server holds the devices key cache for the current epoch
+* \param cost [uint32] Receives the cost of the packet, passed to hkds_admission_complete
+* \return [bool] Returns true if the packet is admitted, false if it should be rejected
+*/
+HKDS_EXPORT_API bool hkds_admission_admit(hkds_admission_state* state, const uint8_t* packet, bool cached, uint32_t* cost);
+
+/**
+* \brief Remove completed work from the backlog, and update the time per cost unit
+*
+* \param state [struct] The controller state
+* \param cost [uint32] The cost returned when the work was admitted
+* \param elapsed [uint64] The processing time of the work in microseconds, zero to leave the estimate unchanged
+*/
+HKDS_EXPORT_API void hkds_admission_complete(hkds_admission_state* state, uint32_t cost, uint64_t elapsed);
+
+/**
+* \brief Get the expected queueing delay of the admitted work
+*
+* \param state [struct][const] The controller state
+* \return [uint64] The expected delay in microseconds
+*/
+HKDS_EXPORT_API uint64_t hkds_admission_delay(const hkds_admission_state* state);
+
+/**
+* \brief Build the error message returned for a rejected packet.
+* The error message carries the sequence of the rejected packet and the prefix of its KSN (see hkds_factory_create_error_echo),
+* so the client can match it to its request.
+*
+* \param packet [array][const] The rejected packet
+* \return [struct] An error message with the error_server_busy code
+*/
+HKDS_EXPORT_API hkds_error_message hkds_admission_create_busy(const uint8_t* packet);
+
+#endif
@@ -0,0 +1,640 @@
+#include "hkds_async.h"
+#include "../QSC/atomics.h"
+#include "../QSC/memutils.h"
+
+static void hkds_async_lock(hkds_async_ring* ring)
+{
+	uint64_t exp;
+
+	exp = 0;
+
+	while (qsc_atomics_compare_exchange64(&ring->lock, &exp, 1) == false)
+	{
+		exp = 0;
+		qsc_atomics_pause();
+	}
+}
+
+static void hkds_async_unlock(hkds_async_ring* ring)
+{
+	qsc_atomics_store64(&ring->lock, 0);
+}
+
+static bool hkds_async_ring_initialize(hkds_async_ring* ring, size_t capacity, size_t width)
+{
+	ring->items = (uint8_t*)qsc_memutils_aligned_alloc(64, capacity * width);
+	ring->mask = capacity - 1;
+	ring->width = width;
+	ring->head = 0;
+	ring->tail = 0;
+	ring->lock = 0;
+
+	if (ring->items != NULL)
+	{
+		qsc_memutils_clear(ring->items, capacity * width);
+	}
+
+	return (ring->items != NULL);
+}
+
+static void hkds_async_ring_dispose(hkds_async_ring* ring)
+{
+	if (ring->items != NULL)
+	{
+		qsc_memutils_clear(ring->items, (ring->mask + 1) * ring->width);
+		qsc_memutils_aligned_free(ring->items);
+		ring->items = NULL;
+	}
+
+	ring->mask = 0;
+	ring->width = 0;
+	ring->head = 0;
+	ring->tail = 0;
+}
+
+static void hkds_async_ring_push(hkds_async_ring* ring, const uint8_t* items, size_t count)
+{
+	/* the outstanding request limit guarantees the ring has space */
+	hkds_async_lock(ring);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		qsc_memutils_copy(ring->items + ((size_t)(ring->tail & ring->mask) * ring->width), items + (i * ring->width), ring->width);
+		++ring->tail;
+	}
+
+	hkds_async_unlock(ring);
+}
+
+static size_t hkds_async_ring_pop(hkds_async_ring* ring, uint8_t* items, size_t count)
+{
+	uint8_t* pitm;
+	size_t n;
+
+	hkds_async_lock(ring);
+	n = (size_t)(ring->tail - ring->head);
+	n = (n < count) ? n : count;
+
+	for (size_t i = 0; i < n; ++i)
+	{
+		pitm = ring->items + ((size_t)(ring->head & ring->mask) * ring->width);
+		qsc_memutils_copy(items + (i * ring->width), pitm, ring->width);
+		qsc_memutils_clear(pitm, ring->width);
+		++ring->head;
+	}
+
+	hkds_async_unlock(ring);
+
+	return n;
+}
+
+static void hkds_async_execute_single(hkds_master_key* mdk, const hkds_async_request* request, hkds_async_completion* completion)
+{
+	hkds_server_state ss;
+
+	hkds_server_initialize_state(&ss, mdk, request->ksn);
+
+	switch (request->operation)
+	{
+		case hkds_async_decrypt:
+		{
+			hkds_server_decrypt_message(&ss, request->message, completion->output);
+			completion->status = true;
+			break;
+		}
+		case hkds_async_decrypt_verify:
+		{
+			completion->status = hkds_server_decrypt_verify_message(&ss, request->message,
+				(request->datalen != 0) ? request->data : NULL, request->datalen, completion->output);
+			break;
+		}
+		case hkds_async_encrypt_token:
+		{
+			hkds_server_encrypt_token(&ss, completion->output);
+			completion->status = true;
+			break;
+		}
+		default:
+		{
+			completion->status = false;
+		}
+	}
+}
+
+static void hkds_async_execute_x8(hkds_master_key* mdk, const hkds_async_request* requests, const size_t* index, size_t count,
+	hkds_async_completion* completions)
+{
+	hkds_server_x8_state x8;
+	uint8_t ksn[HKDS_CACHX8_DEPTH][HKDS_KSN_SIZE];
+	size_t j;
+
+	/* unused lanes repeat the first request */
+	for (size_t i = 0; i < HKDS_CACHX8_DEPTH; ++i)
+	{
+		qsc_memutils_copy(ksn[i], requests[index[(i < count) ? i : 0]].ksn, HKDS_KSN_SIZE);
+	}
+
+	hkds_server_initialize_state_x8(&x8, mdk, ksn);
+
+	switch (requests[index[0]].operation)
+	{
+		case hkds_async_decrypt:
+		{
+			uint8_t ct[HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE];
+			uint8_t pt[HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE];
+
+			for (size_t i = 0; i < HKDS_CACHX8_DEPTH; ++i)
+			{
+				qsc_memutils_copy(ct[i], requests[index[(i < count) ? i : 0]].message, HKDS_MESSAGE_SIZE);
+			}
+
+			hkds_server_decrypt_message_x8(&x8, ct, pt);
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				j = index[i];
+				qsc_memutils_copy(completions[j].output, pt[i], HKDS_MESSAGE_SIZE);
+				completions[j].status = true;
+			}
+
+			qsc_memutils_clear((uint8_t*)pt, sizeof(pt));
+			break;
+		}
+		case hkds_async_decrypt_verify:
+		{
+			uint8_t ct[HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE + HKDS_TAG_SIZE];
+			uint8_t data[HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE];
+			uint8_t pt[HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE];
+			bool valid[HKDS_CACHX8_DEPTH];
+
+			for (size_t i = 0; i < HKDS_CACHX8_DEPTH; ++i)
+			{
+				j = index[(i < count) ? i : 0];
+				qsc_memutils_copy(ct[i], requests[j].message, HKDS_MESSAGE_SIZE + HKDS_TAG_SIZE);
+				qsc_memutils_copy(data[i], requests[j].data, HKDS_MESSAGE_SIZE);
+			}
+
+			/* a group shares the additional data length */
+			hkds_server_decrypt_verify_message_x8(&x8, ct, data, requests[index[0]].datalen, pt, valid);
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				j = index[i];
+				qsc_memutils_copy(completions[j].output, pt[i], HKDS_MESSAGE_SIZE);
+				completions[j].status = valid[i];
+			}
+
+			qsc_memutils_clear((uint8_t*)pt, sizeof(pt));
+			break;
+		}
+		case hkds_async_encrypt_token:
+		{
+			uint8_t etok[HKDS_CACHX8_DEPTH][HKDS_STK_SIZE + HKDS_TAG_SIZE];
+
+			hkds_server_encrypt_token_x8(&x8, etok);
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				j = index[i];
+				qsc_memutils_copy(completions[j].output, etok[i], HKDS_ETOK_SIZE);
+				completions[j].status = true;
+			}
+
+			break;
+		}
+		default:
+		{
+			break;
+		}
+	}
+}
+
+static void hkds_async_execute_x64(hkds_master_key* mdk, const hkds_async_request* requests, const size_t* index,
+	hkds_async_completion* completions)
+{
+	hkds_server_x8_state x64[HKDS_PARALLEL_DEPTH];
+	uint8_t ksn[HKDS_CACHX8_DEPTH][HKDS_KSN_SIZE];
+	size_t k;
+
+	for (size_t i = 0; i < HKDS_PARALLEL_DEPTH; ++i)
+	{
+		for (size_t j = 0; j < HKDS_CACHX8_DEPTH; ++j)
+		{
+			qsc_memutils_copy(ksn[j], requests[index[(i * HKDS_CACHX8_DEPTH) + j]].ksn, HKDS_KSN_SIZE);
+		}
+
+		hkds_server_initialize_state_x8(&x64[i], mdk, ksn);
+	}
+
+	switch (requests[index[0]].operation)
+	{
+		case hkds_async_decrypt:
+		{
+			uint8_t ct[HKDS_PARALLEL_DEPTH][HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE];
+			uint8_t pt[HKDS_PARALLEL_DEPTH][HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE];
+
+			for (size_t i = 0; i < HKDS_CACHX64_SIZE; ++i)
+			{
+				qsc_memutils_copy(ct[i / HKDS_CACHX8_DEPTH][i % HKDS_CACHX8_DEPTH], requests[index[i]].message, HKDS_MESSAGE_SIZE);
+			}
+
+			hkds_server_decrypt_message_x64(x64, ct, pt);
+
+			for (size_t i = 0; i < HKDS_CACHX64_SIZE; ++i)
+			{
+				k = index[i];
+				qsc_memutils_copy(completions[k].output, pt[i / HKDS_CACHX8_DEPTH][i % HKDS_CACHX8_DEPTH], HKDS_MESSAGE_SIZE);
+				completions[k].status = true;
+			}
+
+			qsc_memutils_clear((uint8_t*)pt, sizeof(pt));
+			break;
+		}
+		case hkds_async_decrypt_verify:
+		{
+			uint8_t ct[HKDS_PARALLEL_DEPTH][HKDS_CACHX8_DEPTH][HKDS_TAG_SIZE + HKDS_MESSAGE_SIZE];
+			uint8_t data[HKDS_PARALLEL_DEPTH][HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE];
+			uint8_t pt[HKDS_PARALLEL_DEPTH][HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE];
+			bool valid[HKDS_PARALLEL_DEPTH][HKDS_CACHX8_DEPTH];
+
+			for (size_t i = 0; i < HKDS_CACHX64_SIZE; ++i)
+			{
+				k = index[i];
+				qsc_memutils_copy(ct[i / HKDS_CACHX8_DEPTH][i % HKDS_CACHX8_DEPTH], requests[k].message, HKDS_MESSAGE_SIZE + HKDS_TAG_SIZE);
+				qsc_memutils_copy(data[i / HKDS_CACHX8_DEPTH][i % HKDS_CACHX8_DEPTH], requests[k].data, HKDS_MESSAGE_SIZE);
+			}
+
+			hkds_server_decrypt_verify_message_x64(x64, ct, data, requests[index[0]].datalen, pt, valid);
+
+			for (size_t i = 0; i < HKDS_CACHX64_SIZE; ++i)
+			{
+				k = index[i];
+				qsc_memutils_copy(completions[k].output, pt[i / HKDS_CACHX8_DEPTH][i % HKDS_CACHX8_DEPTH], HKDS_MESSAGE_SIZE);
+				completions[k].status = valid[i / HKDS_CACHX8_DEPTH][i % HKDS_CACHX8_DEPTH];
+			}
+
+			qsc_memutils_clear((uint8_t*)pt, sizeof(pt));
+			break;
+		}
+		case hkds_async_encrypt_token:
+		{
+			uint8_t etok[HKDS_PARALLEL_DEPTH][HKDS_CACHX8_DEPTH][HKDS_STK_SIZE + HKDS_TAG_SIZE];
+
+			hkds_server_encrypt_token_x64(x64, etok);
+
+			for (size_t i = 0; i < HKDS_CACHX64_SIZE; ++i)
+			{
+				k = index[i];
+				qsc_memutils_copy(completions[k].output, etok[i / HKDS_CACHX8_DEPTH][i % HKDS_CACHX8_DEPTH], HKDS_ETOK_SIZE);
+				completions[k].status = true;
+			}
+
+			break;
+		}
+		default:
+		{
+			break;
+		}
+	}
+}
+
+void hkds_async_execute_group(hkds_master_key* mdk, const hkds_async_request* requests, const size_t* index, size_t count,
+	hkds_async_completion* completions)
+{
+	assert(mdk != NULL);
+	assert(requests != NULL);
+	assert(index != NULL);
+	assert(completions != NULL);
+
+	size_t pos;
+
+	pos = 0;
+
+	if (count == HKDS_CACHX64_SIZE)
+	{
+		hkds_async_execute_x64(mdk, requests, index, completions);
+		pos = HKDS_CACHX64_SIZE;
+	}
+
+	while (count - pos >= HKDS_CACHX8_DEPTH)
+	{
+		hkds_async_execute_x8(mdk, requests, index + pos, HKDS_CACHX8_DEPTH, completions);
+		pos += HKDS_CACHX8_DEPTH;
+	}
+
+	if (count - pos >= HKDS_ASYNC_PAD_MINIMUM)
+	{
+		hkds_async_execute_x8(mdk, requests, index + pos, count - pos, completions);
+		pos = count;
+	}
+
+	while (pos < count)
+	{
+		hkds_async_execute_single(mdk, &requests[index[pos]], &completions[index[pos]]);
+		++pos;
+	}
+}
+
+static size_t hkds_async_execute(hkds_async_state* state)
+{
+	hkds_async_request reqs[HKDS_ASYNC_BATCH_SIZE];
+	hkds_async_completion cpls[HKDS_ASYNC_BATCH_SIZE];
+	size_t index[HKDS_ASYNC_BATCH_SIZE];
+	bool done[HKDS_ASYNC_BATCH_SIZE];
+	size_t count;
+	size_t len;
+
+	count = hkds_async_ring_pop(&state->sq, (uint8_t*)reqs, HKDS_ASYNC_BATCH_SIZE);
+
+	if (count != 0)
+	{
+		qsc_memutils_clear((uint8_t*)cpls, sizeof(cpls));
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			cpls[i].token = reqs[i].token;
+			cpls[i].operation = reqs[i].operation;
+			cpls[i].status = false;
+			/* invalid requests complete with a false status */
+			done[i] = (reqs[i].datalen > HKDS_MESSAGE_SIZE);
+		}
+
+		/* group the requests by operation, and verified messages by additional data length */
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (done[i] == false && reqs[i].operation != hkds_async_none)
+			{
+				len = 0;
+
+				for (size_t j = i; j < count; ++j)
+				{
+					if (done[j] == false && reqs[j].operation == reqs[i].operation &&
+						(reqs[i].operation != hkds_async_decrypt_verify || reqs[j].datalen == reqs[i].datalen))
+					{
+						index[len] = j;
+						done[j] = true;
+						++len;
+					}
+				}
+
+				hkds_async_execute_group(state->mdk, reqs, index, len, cpls);
+			}
+		}
+
+		if (state->callback != NULL)
+		{
+			state->callback(state->context, cpls, count);
+			qsc_atomics_fetch_add64(&state->outstanding, (uint64_t)0 - (uint64_t)count);
+		}
+		else
+		{
+			hkds_async_ring_push(&state->cq, (const uint8_t*)cpls, count);
+		}
+
+		qsc_atomics_fetch_add64(&state->completed, count);
+		qsc_memutils_clear((uint8_t*)reqs, sizeof(reqs));
+		qsc_memutils_clear((uint8_t*)cpls, sizeof(cpls));
+	}
+
+	return count;
+}
+
+static void hkds_async_worker(void* arg)
+{
+	hkds_async_state* state;
+	uint64_t sig;
+	size_t spin;
+
+	state = (hkds_async_state*)arg;
+	spin = 0;
+
+	while (qsc_atomics_load64(&state->running) != 0)
+	{
+		/* the signal is read before the ring, so a request submitted after the ring was found empty ends the wait */
+		sig = qsc_atomics_load64(&state->signal);
+
+		if (hkds_async_execute(state) != 0)
+		{
+			spin = 0;
+		}
+		else if (spin < HKDS_ASYNC_SPIN_COUNT)
+		{
+			qsc_atomics_pause();
+			++spin;
+		}
+		else
+		{
+			qsc_atomics_fetch_add64(&state->sleepers, 1);
+			qsc_atomics_wait64(&state->signal, sig, HKDS_ASYNC_WAIT_INTERVAL);
+			qsc_atomics_fetch_add64(&state->sleepers, (uint64_t)0 - 1);
+		}
+	}
+}
+
+static void hkds_async_signal(hkds_async_state* state)
+{
+	qsc_atomics_fetch_add64(&state->signal, 1);
+
+	/* the wake is a system call, and is made only when a worker is blocked */
+	if (qsc_atomics_load64(&state->sleepers) != 0)
+	{
+		qsc_atomics_wake64(&state->signal);
+	}
+}
+
+static size_t hkds_async_reserve(hkds_async_state* state, size_t count)
+{
+	uint64_t cur;
+	size_t n;
+
+	cur = qsc_atomics_load64(&state->outstanding);
+
+	do
+	{
+		n = (cur < state->capacity) ? state->capacity - (size_t)cur : 0;
+		n = (n < count) ? n : count;
+
+		if (n == 0)
+		{
+			break;
+		}
+	}
+	while (qsc_atomics_compare_exchange64(&state->outstanding, &cur, cur + n) == false);
+
+	return n;
+}
+
+bool hkds_async_initialize(hkds_async_state* state, hkds_master_key* mdk, size_t capacity, size_t threads,
+	hkds_async_callback callback, void* context)
+{
+	assert(state != NULL);
+	assert(mdk != NULL);
+	assert(capacity != 0);
+	assert(threads <= HKDS_ASYNC_THREADS_MAX);
+
+	qsc_thread thd;
+	size_t cap;
+	bool res;
+
+	res = false;
+
+	if (state != NULL && mdk != NULL && capacity != 0 && threads <= HKDS_ASYNC_THREADS_MAX)
+	{
+		cap = 1;
+
+		while (cap < capacity)
+		{
+			cap <<= 1;
+		}
+
+		state->mdk = mdk;
+		state->callback = callback;
+		state->context = context;
+		state->capacity = cap;
+		state->tcount = 0;
+		state->outstanding = 0;
+		state->completed = 0;
+		state->signal = 0;
+		state->sleepers = 0;
+		state->running = 1;
+
+		if (hkds_async_ring_initialize(&state->sq, cap, sizeof(hkds_async_request)) == true &&
+			hkds_async_ring_initialize(&state->cq, cap, sizeof(hkds_async_completion)) == true)
+		{
+			res = true;
+
+			for (size_t i = 0; i < threads && res == true; ++i)
+			{
+				thd = qsc_async_thread_create(&hkds_async_worker, state);
+
+				if (thd != 0)
+				{
+					state->threads[state->tcount] = thd;
+					++state->tcount;
+				}
+				else
+				{
+					res = false;
+				}
+			}
+
+			if (res == false)
+			{
+				/* stops the threads already started and releases the rings */
+				hkds_async_dispose(state);
+			}
+		}
+		else
+		{
+			hkds_async_ring_dispose(&state->sq);
+			hkds_async_ring_dispose(&state->cq);
+		}
+	}
+
+	return res;
+}
+
+void hkds_async_dispose(hkds_async_state* state)
+{
+	assert(state != NULL);
+
+	if (state != NULL)
+	{
+		qsc_atomics_store64(&state->running, 0);
+		hkds_async_signal(state);
+
+		if (state->tcount != 0)
+		{
+			qsc_async_thread_wait_all(state->threads, state->tcount);
+		}
+
+		hkds_async_ring_dispose(&state->sq);
+		hkds_async_ring_dispose(&state->cq);
+		state->mdk = NULL;
+		state->callback = NULL;
+		state->context = NULL;
+		state->capacity = 0;
+		state->tcount = 0;
+		state->outstanding = 0;
+	}
+}
+
+bool hkds_async_submit(hkds_async_state* state, const hkds_async_request* request)
+{
+	assert(state != NULL);
+	assert(request != NULL);
+
+	return (hkds_async_submit_batch(state, request, 1) == 1);
+}
+
+size_t hkds_async_submit_batch(hkds_async_state* state, const hkds_async_request* requests, size_t count)
+{
+	assert(state != NULL);
+	assert(requests != NULL);
+
+	size_t n;
+
+	n = 0;
+
+	if (state != NULL && requests != NULL && state->sq.items != NULL)
+	{
+		n = hkds_async_reserve(state, count);
+
+		if (n != 0)
+		{
+			hkds_async_ring_push(&state->sq, (const uint8_t*)requests, n);
+			hkds_async_signal(state);
+		}
+	}
+
+	return n;
+}
+
+size_t hkds_async_complete(hkds_async_state* state, hkds_async_completion* completions, size_t count)
+{
+	assert(state != NULL);
+	assert(completions != NULL);
+
+	size_t n;
+
+	n = 0;
+
+	if (state != NULL && completions != NULL && state->cq.items != NULL)
+	{
+		n = hkds_async_ring_pop(&state->cq, (uint8_t*)completions, count);
+
+		if (n != 0)
+		{
+			qsc_atomics_fetch_add64(&state->outstanding, (uint64_t)0 - (uint64_t)n);
+		}
+	}
+
+	return n;
+}
+
+size_t hkds_async_run(hkds_async_state* state, size_t maxbatches)
+{
+	assert(state != NULL);
+
+	size_t cnt;
+	size_t res;
+
+	res = 0;
+
+	if (state != NULL && state->sq.items != NULL)
+	{
+		for (size_t i = 0; i < maxbatches; ++i)
+		{
+			cnt = hkds_async_execute(state);
+
+			if (cnt == 0)
+			{
+				break;
+			}
+
+			res += cnt;
+		}
+	}
+
+	return res;
+}
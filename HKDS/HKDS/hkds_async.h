@@ -0,0 +1,222 @@
+/* 2021 Digital Freedom Defense Incorporated
+ * All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Digital Freedom Defense Incorporated.
+ * The intellectual and technical concepts contained
+ * herein are proprietary to Digital Freedom Defense Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Digital Freedom Defense Incorporated.
+ *
+ * Contact: develop@dfdef.com
+ */
+
+#ifndef HKDS_ASYNC_H
+#define HKDS_ASYNC_H
+
+#include "common.h"
+#include "hkds_config.h"
+#include "hkds_server.h"
+#include "../QSC/async.h"
+
+/* Asynchronous server engine.
+* Requests are added to a submission ring with a caller defined token, and the results are returned
+* on a completion ring, or passed to a completion callback, in batches.
+* The engine removes up to HKDS_ASYNC_BATCH_SIZE requests at a time, groups them by operation,
+* and executes each group across the SIMD lanes with the x64 and x8 server functions.
+* The engine is driven by its own worker threads, or by the caller with hkds_async_run when no threads are started.
+* A worker with no requests spins briefly, then blocks until a request is submitted, so idle workers do not hold a processor.
+* The number of outstanding requests, submitted but not yet reaped, is limited to the ring capacity,
+* so a completion always has space in the completion ring.
+* Submission and completion functions are thread safe. */
+
+/*!
+\def HKDS_ASYNC_BATCH_SIZE
+* The maximum number of requests executed by the engine in one batch
+*/
+#define HKDS_ASYNC_BATCH_SIZE HKDS_CACHX64_SIZE
+
+/*!
+\def HKDS_ASYNC_PAD_MINIMUM
+* The minimum number of requests in a group executed with a padded x8 call; smaller groups are executed one at a time
+*/
+#define HKDS_ASYNC_PAD_MINIMUM 4
+
+/*!
+\def HKDS_ASYNC_THREADS_MAX
+* The maximum number of engine worker threads
+*/
+#define HKDS_ASYNC_THREADS_MAX 64
+
+/*!
+\def HKDS_ASYNC_OUTPUT_SIZE
+* The size of a completion output; the largest of a message and an encrypted token
+*/
+#define HKDS_ASYNC_OUTPUT_SIZE HKDS_ETOK_SIZE
+
+/*!
+\def HKDS_ASYNC_SPIN_COUNT
+* The number of spin iterations of an idle worker, before it blocks until a request is submitted
+*/
+#define HKDS_ASYNC_SPIN_COUNT 256
+
+/*!
+\def HKDS_ASYNC_WAIT_INTERVAL
+* The maximum time in milliseconds a blocked worker waits before it checks the rings again
+*/
+#define HKDS_ASYNC_WAIT_INTERVAL 100
+
+/*! \enum hkds_async_operations
+* The asynchronous request operation
+*/
+HKDS_EXPORT_API typedef enum
+{
+	hkds_async_none = 0x00,				/*!< No operation */
+	hkds_async_decrypt = 0x01,			/*!< Decrypt a client message */
+	hkds_async_decrypt_verify = 0x02,	/*!< Verify and decrypt an authenticated client message */
+	hkds_async_encrypt_token = 0x03,	/*!< Encrypt a client token */
+} hkds_async_operations;
+
+/*! \struct hkds_async_request
+* An asynchronous server request
+*/
+HKDS_EXPORT_API typedef struct
+{
+	uint64_t token;										/*!< The caller defined request token, returned with the completion */
+	uint8_t ksn[HKDS_KSN_SIZE];							/*!< The clients key serial number */
+	uint8_t message[HKDS_MESSAGE_SIZE + HKDS_TAG_SIZE];	/*!< The encrypted message, and tag for verified messages; unused for tokens */
+	uint8_t data[HKDS_MESSAGE_SIZE];					/*!< The additional data of a verified message */
+	size_t datalen;										/*!< The length of the additional data, 0 to HKDS_MESSAGE_SIZE */
+	hkds_async_operations operation;					/*!< The requested operation */
+} hkds_async_request;
+
+/*! \struct hkds_async_completion
+* An asynchronous request completion
+*/
+HKDS_EXPORT_API typedef struct
+{
+	uint64_t token;								/*!< The request token */
+	uint8_t output[HKDS_ASYNC_OUTPUT_SIZE];		/*!< The decrypted message, or the encrypted token */
+	hkds_async_operations operation;			/*!< The completed operation */
+	bool status;								/*!< The operation succeeded; false if a message failed authentication */
+} hkds_async_completion;
+
+/*! \typedef hkds_async_callback
+* The completion callback; receives the callback context and a batch of completions
+*/
+typedef void (*hkds_async_callback)(void* context, const hkds_async_completion* completions, size_t count);
+
+/*! \struct hkds_async_ring
+* A bounded ring buffer protected by a spin lock
+*/
+HKDS_EXPORT_API typedef struct
+{
+	uint8_t* items;				/*!< The ring items */
+	size_t mask;				/*!< The ring capacity minus one, the capacity is a power of two */
+	size_t width;				/*!< The byte size of an item */
+	uint64_t head;				/*!< The position of the next item removed */
+	uint64_t tail;				/*!< The position of the next item added */
+	volatile uint64_t lock;		/*!< The ring spin lock */
+} hkds_async_ring;
+
+/*! \struct hkds_async_state
+* Contains the asynchronous engine state
+*/
+HKDS_EXPORT_API typedef struct
+{
+	hkds_async_ring sq;								/*!< The submission ring */
+	hkds_async_ring cq;								/*!< The completion ring */
+	qsc_thread threads[HKDS_ASYNC_THREADS_MAX];		/*!< The engine worker threads */
+	hkds_master_key* mdk;							/*!< A pointer to the master derivation key */
+	hkds_async_callback callback;					/*!< The optional completion callback */
+	void* context;									/*!< The completion callback context */
+	size_t capacity;								/*!< The maximum number of outstanding requests */
+	size_t tcount;									/*!< The number of worker threads */
+	volatile uint64_t outstanding;					/*!< The number of requests submitted and not yet reaped */
+	volatile uint64_t completed;					/*!< The total number of completed requests */
+	volatile uint64_t signal;						/*!< Advanced on each submission; idle workers wait for it to change */
+	volatile uint64_t sleepers;						/*!< The number of workers waiting for a submission */
+	volatile uint64_t running;						/*!< The worker threads are running */
+} hkds_async_state;
+
+/**
+* \brief Execute a group of requests that share an operation, and for verified messages an additional data length,
+* across the SIMD lanes; a full group of 64 with the x64 functions, groups of eight with the x8 functions,
+* and a remainder with a padded x8 call or one at a time.
+* The completion status and output are written to completions[index[i]].
+*
+* \param mdk [struct] The master key set of the requests
+* \param requests [array][const] The request array
+* \param index [array][const] The indices of the grouped requests
+* \param count [size] The number of grouped requests, at most HKDS_ASYNC_BATCH_SIZE
+* \param completions [array] The completion array
+*/
+HKDS_EXPORT_API void hkds_async_execute_group(hkds_master_key* mdk, const hkds_async_request* requests, const size_t* index, size_t count,
+	hkds_async_completion* completions);
+
+/**
+* \brief Initialize the asynchronous engine and start the worker threads
+*
+* \param state [struct] The engine state
+* \param mdk [struct] The master key set
+* \param capacity [size] The maximum number of outstanding requests, rounded up to a power of two
+* \param threads [size] The number of worker threads, zero if the engine is driven with hkds_async_run
+* \param callback [pointer] The optional completion callback; if NULL completions are added to the completion ring
+* \param context [pointer] The callback context
+* \return [bool] Returns true if the rings were allocated and the threads were started; if a thread cannot be created,
+* the threads already started are stopped and the rings are released
+*/
+HKDS_EXPORT_API bool hkds_async_initialize(hkds_async_state* state, hkds_master_key* mdk, size_t capacity, size_t threads,
+	hkds_async_callback callback, void* context);
+
+/**
+* \brief Stop the worker threads and release the engine.
+* Requests that were not executed are discarded.
+*
+* \param state [struct] The engine state
+*/
+HKDS_EXPORT_API void hkds_async_dispose(hkds_async_state* state);
+
+/**
+* \brief Submit a request to the engine
+*
+* \param state [struct] The engine state
+* \param request [struct][const] The request
+* \return [bool] Returns false if the engine has the maximum number of outstanding requests
+*/
+HKDS_EXPORT_API bool hkds_async_submit(hkds_async_state* state, const hkds_async_request* request);
+
+/**
+* \brief Submit a set of requests to the engine
+*
+* \param state [struct] The engine state
+* \param requests [array][const] The requests
+* \param count [size] The number of requests
+* \return [size] The number of requests submitted, in order
+*/
+HKDS_EXPORT_API size_t hkds_async_submit_batch(hkds_async_state* state, const hkds_async_request* requests, size_t count);
+
+/**
+* \brief Remove completions from the completion ring
+*
+* \param state [struct] The engine state
+* \param completions [array][output] The array receiving the completions
+* \param count [size] The maximum number of completions
+* \return [size] The number of completions removed
+*/
+HKDS_EXPORT_API size_t hkds_async_complete(hkds_async_state* state, hkds_async_completion* completions, size_t count);
+
+/**
+* \brief Execute pending requests on the calling thread.
+* Used to drive an engine without worker threads, or to assist the workers.
+*
+* \param state [struct] The engine state
+* \param maxbatches [size] The maximum number of batches to execute
+* \return [size] The number of requests executed
+*/
+HKDS_EXPORT_API size_t hkds_async_run(hkds_async_state* state, size_t maxbatches);
+
+#endif
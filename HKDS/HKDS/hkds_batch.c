@@ -0,0 +1,403 @@
+#include "hkds_batch.h"
+#include "../QSC/memutils.h"
+#include "../QSC/timerex.h"
+
+static bool hkds_batch_due(const hkds_batch_state* state, uint64_t now, uint64_t* wait, size_t* width)
+{
+	uint64_t arrival;
+	uint64_t elapsed;
+	uint64_t remaining;
+	size_t count;
+	bool res;
+
+	count = hkds_queue_count(&state->queue);
+	*wait = UINT64_MAX;
+	*width = 1;
+	res = false;
+
+	if (count >= HKDS_BATCH_DEPTH)
+	{
+		*wait = 0;
+		*width = HKDS_BATCH_DEPTH;
+		res = true;
+	}
+	else if (count != 0)
+	{
+		/* the queue tag of the oldest message is its arrival time */
+		qsc_queue_peek(&state->queue.state, NULL, &arrival, 1);
+		elapsed = (now > arrival) ? now - arrival : 0;
+
+		if (elapsed >= state->budget)
+		{
+			*wait = 0;
+			res = true;
+		}
+		else
+		{
+			remaining = state->budget - elapsed;
+
+			/* wait for the widest batch that is expected to fill before the oldest message is due */
+			if ((uint64_t)(HKDS_BATCH_DEPTH - count) * state->interval <= remaining)
+			{
+				*wait = remaining;
+				*width = HKDS_BATCH_DEPTH;
+			}
+			else if (count < HKDS_CACHX8_DEPTH && (uint64_t)(HKDS_CACHX8_DEPTH - count) * state->interval <= remaining)
+			{
+				*wait = remaining;
+				*width = HKDS_CACHX8_DEPTH;
+			}
+			else
+			{
+				/* waiting does not fill another lane group, flush now */
+				*wait = 0;
+				res = true;
+			}
+		}
+	}
+
+	return res;
+}
+
+static void hkds_batch_decrypt_x8(hkds_batch_state* state, uint8_t items[HKDS_BATCH_DEPTH][HKDS_BATCH_ITEM_SIZE], size_t offset, size_t count,
+	uint8_t plaintext[HKDS_BATCH_DEPTH][HKDS_MESSAGE_SIZE])
+{
+	hkds_server_x8_state x8;
+	uint8_t ct[HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE];
+	uint8_t ksn[HKDS_CACHX8_DEPTH][HKDS_KSN_SIZE];
+	uint8_t pt[HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE];
+
+	/* unused lanes repeat the first message */
+	for (size_t i = 0; i < HKDS_CACHX8_DEPTH; ++i)
+	{
+		const uint8_t* pitm = items[offset + ((i < count) ? i : 0)];
+
+		qsc_memutils_copy(ksn[i], pitm, HKDS_KSN_SIZE);
+		qsc_memutils_copy(ct[i], pitm + HKDS_KSN_SIZE, HKDS_MESSAGE_SIZE);
+	}
+
+	hkds_server_initialize_state_x8(&x8, state->mdk, ksn);
+	hkds_server_decrypt_message_x8(&x8, ct, pt);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		qsc_memutils_copy(plaintext[offset + i], pt[i], HKDS_MESSAGE_SIZE);
+	}
+
+	qsc_memutils_clear((uint8_t*)pt, sizeof(pt));
+	state->lanes += HKDS_CACHX8_DEPTH;
+	state->used += count;
+}
+
+static void hkds_batch_decrypt_x64(hkds_batch_state* state, uint8_t items[HKDS_BATCH_DEPTH][HKDS_BATCH_ITEM_SIZE],
+	uint8_t plaintext[HKDS_BATCH_DEPTH][HKDS_MESSAGE_SIZE])
+{
+	hkds_server_x8_state x64[HKDS_PARALLEL_DEPTH];
+	uint8_t ct[HKDS_PARALLEL_DEPTH][HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE];
+	uint8_t ksn[HKDS_PARALLEL_DEPTH][HKDS_CACHX8_DEPTH][HKDS_KSN_SIZE];
+	uint8_t pt[HKDS_PARALLEL_DEPTH][HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE];
+
+	for (size_t i = 0; i < HKDS_PARALLEL_DEPTH; ++i)
+	{
+		for (size_t j = 0; j < HKDS_CACHX8_DEPTH; ++j)
+		{
+			qsc_memutils_copy(ksn[i][j], items[(i * HKDS_CACHX8_DEPTH) + j], HKDS_KSN_SIZE);
+			qsc_memutils_copy(ct[i][j], items[(i * HKDS_CACHX8_DEPTH) + j] + HKDS_KSN_SIZE, HKDS_MESSAGE_SIZE);
+		}
+
+		hkds_server_initialize_state_x8(&x64[i], state->mdk, ksn[i]);
+	}
+
+	hkds_server_decrypt_message_x64(x64, ct, pt);
+	qsc_memutils_copy((uint8_t*)plaintext, (const uint8_t*)pt, sizeof(pt));
+	qsc_memutils_clear((uint8_t*)pt, sizeof(pt));
+	state->lanes += HKDS_BATCH_DEPTH;
+	state->used += HKDS_BATCH_DEPTH;
+}
+
+static void hkds_batch_record(hkds_batch_state* state, uint64_t latency)
+{
+	size_t idx;
+
+	idx = 0;
+
+	while (idx < HKDS_BATCH_HISTOGRAM_SIZE - 1 && latency >= (1ULL << idx))
+	{
+		++idx;
+	}
+
+	++state->histogram[idx];
+	++state->samples;
+}
+
+static void hkds_batch_adapt(hkds_batch_state* state)
+{
+	uint64_t p99;
+
+	if (state->samples >= HKDS_BATCH_ADAPT_SAMPLES)
+	{
+		p99 = hkds_batch_latency(state, 99);
+
+		if (p99 > state->slo)
+		{
+			/* the objective is missed, shorten the batching delay */
+			state->budget /= 2;
+		}
+		else if (p99 <= state->slo / 2 && state->budget < state->deadline)
+		{
+			state->budget = (state->budget == 0) ? 1 : state->budget * 2;
+
+			if (state->budget > state->deadline)
+			{
+				state->budget = state->deadline;
+			}
+		}
+
+		/* decay the histogram so it follows the current load */
+		for (size_t i = 0; i < HKDS_BATCH_HISTOGRAM_SIZE; ++i)
+		{
+			state->histogram[i] /= 2;
+		}
+
+		state->samples = 0;
+	}
+}
+
+void hkds_batch_initialize(hkds_batch_state* state, hkds_master_key* mdk, uint64_t deadline, uint64_t slo)
+{
+	assert(state != NULL);
+	assert(mdk != NULL);
+
+	hkds_queue_initialize(&state->queue, HKDS_BATCH_DEPTH, HKDS_BATCH_ITEM_SIZE, NULL);
+	qsc_memutils_clear((uint8_t*)state->histogram, sizeof(state->histogram));
+	state->mdk = mdk;
+	state->deadline = (deadline != 0) ? deadline : HKDS_BATCH_DEADLINE_DEFAULT;
+	state->budget = state->deadline;
+	state->slo = (slo != 0) ? slo : HKDS_BATCH_SLO_DEFAULT;
+	/* assume a slow arrival rate until it is measured */
+	state->interval = state->deadline;
+	state->last = 0;
+	state->samples = 0;
+	state->lanes = 0;
+	state->used = 0;
+	state->width = 1;
+}
+
+void hkds_batch_dispose(hkds_batch_state* state)
+{
+	assert(state != NULL);
+
+	if (state != NULL)
+	{
+		hkds_queue_destroy(&state->queue);
+		qsc_memutils_clear((uint8_t*)state->histogram, sizeof(state->histogram));
+		state->mdk = NULL;
+		state->deadline = 0;
+		state->budget = 0;
+		state->slo = 0;
+		state->interval = 0;
+		state->last = 0;
+		state->samples = 0;
+		state->lanes = 0;
+		state->used = 0;
+		state->width = 0;
+	}
+}
+
+bool hkds_batch_submit(hkds_batch_state* state, const uint8_t* ksn, const uint8_t* ciphertext)
+{
+	assert(state != NULL);
+	assert(ksn != NULL);
+	assert(ciphertext != NULL);
+
+	uint8_t item[HKDS_BATCH_ITEM_SIZE];
+	uint64_t now;
+	bool res;
+
+	res = false;
+
+	if (hkds_queue_isfull(&state->queue) == false)
+	{
+		now = qsc_timerex_monotonic_microseconds();
+
+		if (state->last != 0 && now >= state->last)
+		{
+			state->interval = ((state->interval * 7) + (now - state->last)) / 8;
+		}
+
+		state->last = now;
+		qsc_memutils_copy(item, ksn, HKDS_KSN_SIZE);
+		qsc_memutils_copy(item + HKDS_KSN_SIZE, ciphertext, HKDS_MESSAGE_SIZE);
+		qsc_queue_push(&state->queue.state, item, sizeof(item), now);
+		res = true;
+	}
+
+	return res;
+}
+
+size_t hkds_batch_process(hkds_batch_state* state, bool force,
+	uint8_t ksn[HKDS_BATCH_DEPTH][HKDS_KSN_SIZE],
+	uint8_t plaintext[HKDS_BATCH_DEPTH][HKDS_MESSAGE_SIZE])
+{
+	assert(state != NULL);
+	assert(ksn != NULL);
+	assert(plaintext != NULL);
+
+	uint8_t items[HKDS_BATCH_DEPTH][HKDS_BATCH_ITEM_SIZE];
+	uint64_t arrival[HKDS_BATCH_DEPTH];
+	hkds_server_state x1;
+	uint64_t now;
+	uint64_t wait;
+	size_t count;
+	size_t pos;
+	size_t width;
+
+	count = 0;
+	now = qsc_timerex_monotonic_microseconds();
+
+	if (hkds_batch_due(state, now, &wait, &width) == true || (force == true && hkds_queue_isempty(&state->queue) == false))
+	{
+		count = qsc_queue_pop_bulk(&state->queue.state, (uint8_t*)items, arrival, HKDS_BATCH_DEPTH);
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			qsc_memutils_copy(ksn[i], items[i], HKDS_KSN_SIZE);
+		}
+
+		pos = 0;
+
+		if (count == HKDS_BATCH_DEPTH)
+		{
+			hkds_batch_decrypt_x64(state, items, plaintext);
+			pos = HKDS_BATCH_DEPTH;
+		}
+
+		while (count - pos >= HKDS_CACHX8_DEPTH)
+		{
+			hkds_batch_decrypt_x8(state, items, pos, HKDS_CACHX8_DEPTH, plaintext);
+			pos += HKDS_CACHX8_DEPTH;
+		}
+
+		if (count - pos >= HKDS_BATCH_PAD_MINIMUM)
+		{
+			/* a partial lane group is cheaper as one padded x8 call */
+			hkds_batch_decrypt_x8(state, items, pos, count - pos, plaintext);
+			pos = count;
+		}
+
+		while (pos < count)
+		{
+			hkds_server_initialize_state(&x1, state->mdk, items[pos]);
+			hkds_server_decrypt_message(&x1, items[pos] + HKDS_KSN_SIZE, plaintext[pos]);
+			++state->lanes;
+			++state->used;
+			++pos;
+		}
+
+		qsc_memutils_clear((uint8_t*)items, sizeof(items));
+		now = qsc_timerex_monotonic_microseconds();
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			hkds_batch_record(state, (now > arrival[i]) ? now - arrival[i] : 0);
+		}
+
+		hkds_batch_adapt(state);
+	}
+
+	state->width = width;
+
+	return count;
+}
+
+uint64_t hkds_batch_wait_time(const hkds_batch_state* state)
+{
+	assert(state != NULL);
+
+	uint64_t wait;
+	size_t width;
+
+	hkds_batch_due(state, qsc_timerex_monotonic_microseconds(), &wait, &width);
+
+	return wait;
+}
+
+void hkds_batch_schedule(const hkds_batch_state* state, qsc_timerwheel_state* wheel, qsc_timerwheel_timer* timer)
+{
+	assert(state != NULL);
+	assert(wheel != NULL);
+	assert(timer != NULL);
+
+	uint64_t now;
+	uint64_t wait;
+	size_t width;
+
+	if (state != NULL && wheel != NULL && timer != NULL)
+	{
+		now = qsc_timerex_monotonic_microseconds();
+		hkds_batch_due(state, now, &wait, &width);
+
+		if (wait == UINT64_MAX)
+		{
+			qsc_timerwheel_cancel(wheel, timer);
+		}
+		else
+		{
+			qsc_timerwheel_start(wheel, timer, now + wait);
+		}
+	}
+}
+
+uint64_t hkds_batch_latency(const hkds_batch_state* state, uint32_t percentile)
+{
+	assert(state != NULL);
+	assert(percentile != 0 && percentile <= 100);
+
+	uint64_t sum;
+	uint64_t target;
+	uint64_t total;
+	uint64_t res;
+
+	total = 0;
+	res = 0;
+
+	for (size_t i = 0; i < HKDS_BATCH_HISTOGRAM_SIZE; ++i)
+	{
+		total += state->histogram[i];
+	}
+
+	if (total != 0)
+	{
+		target = ((total * percentile) + 99) / 100;
+		sum = 0;
+
+		for (size_t i = 0; i < HKDS_BATCH_HISTOGRAM_SIZE; ++i)
+		{
+			sum += state->histogram[i];
+
+			if (sum >= target)
+			{
+				res = 1ULL << i;
+				break;
+			}
+		}
+	}
+
+	return res;
+}
+
+uint32_t hkds_batch_utilization(const hkds_batch_state* state)
+{
+	assert(state != NULL);
+
+	uint32_t res;
+
+	res = 0;
+
+	if (state->lanes != 0)
+	{
+		res = (uint32_t)((state->used * 100) / state->lanes);
+	}
+
+	return res;
+}
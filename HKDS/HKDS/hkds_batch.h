@@ -0,0 +1,179 @@
+/* 2021 Digital Freedom Defense Incorporated
+ * All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Digital Freedom Defense Incorporated.
+ * The intellectual and technical concepts contained
+ * herein are proprietary to Digital Freedom Defense Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Digital Freedom Defense Incorporated.
+ *
+ * Contact: develop@dfdef.com
+ */
+
+#ifndef HKDS_BATCH_H
+#define HKDS_BATCH_H
+
+#include "common.h"
+#include "hkds_config.h"
+#include "hkds_queue.h"
+#include "hkds_server.h"
+#include "../QSC/timerwheel.h"
+
+/* Latency-bounded adaptive batching.
+* Client messages are queued with their arrival time, and decrypted in batches with the x64 and x8 server functions.
+* A batch is flushed when it fills, or when the oldest message has waited for the batch deadline.
+* The batch width adapts to the observed arrival rate: the batch waits for 64 or 8 messages only if
+* they are expected to arrive before the oldest message reaches its deadline, otherwise it is flushed immediately.
+* A flush decrypts groups of 64 with the x64 function, groups of 8 with the x8 function, and a remainder of
+* at least HKDS_BATCH_PAD_MINIMUM messages with a padded x8 call; smaller remainders are decrypted one at a time.
+* Completed requests are recorded in a latency histogram, and the deadline is reduced while the measured
+* 99th percentile latency exceeds the configured SLO, and restored when the latency recovers.
+* An event loop schedules the batch on its timer wheel, so a partial batch is flushed when its deadline
+* passes without the loop polling the batch between events.
+* The batch state is not thread safe; use one batch per server thread. */
+
+/*!
+\def HKDS_BATCH_DEPTH
+* The maximum number of messages held in a batch
+*/
+#define HKDS_BATCH_DEPTH HKDS_CACHX64_SIZE
+
+/*!
+\def HKDS_BATCH_ITEM_SIZE
+* The size of a queued batch item; the key serial number followed by the encrypted message
+*/
+#define HKDS_BATCH_ITEM_SIZE (HKDS_KSN_SIZE + HKDS_MESSAGE_SIZE)
+
+/*!
+\def HKDS_BATCH_PAD_MINIMUM
+* The minimum number of messages decrypted with a padded x8 call
+*/
+#define HKDS_BATCH_PAD_MINIMUM 4
+
+/*!
+\def HKDS_BATCH_HISTOGRAM_SIZE
+* The number of latency histogram buckets; bucket i counts latencies below 2^i microseconds
+*/
+#define HKDS_BATCH_HISTOGRAM_SIZE 32
+
+/*!
+\def HKDS_BATCH_ADAPT_SAMPLES
+* The number of completed requests between deadline adjustments
+*/
+#define HKDS_BATCH_ADAPT_SAMPLES 1024
+
+/*!
+\def HKDS_BATCH_DEADLINE_DEFAULT
+* The default batch deadline in microseconds
+*/
+#define HKDS_BATCH_DEADLINE_DEFAULT 1000ULL
+
+/*!
+\def HKDS_BATCH_SLO_DEFAULT
+* The default 99th percentile latency objective in microseconds
+*/
+#define HKDS_BATCH_SLO_DEFAULT 5000ULL
+
+/*! \struct hkds_batch_state
+* Contains the batching state
+*/
+HKDS_EXPORT_API typedef struct
+{
+	hkds_queue_message_queue queue;					/*!< The pending messages, tagged with their arrival time */
+	hkds_master_key* mdk;							/*!< A pointer to the master derivation key */
+	uint64_t histogram[HKDS_BATCH_HISTOGRAM_SIZE];	/*!< The completed request latency histogram */
+	uint64_t deadline;								/*!< The configured maximum batching delay in microseconds */
+	uint64_t budget;								/*!< The current batching delay, adjusted to meet the SLO */
+	uint64_t slo;									/*!< The 99th percentile latency objective in microseconds */
+	uint64_t interval;								/*!< The moving average message inter-arrival time in microseconds */
+	uint64_t last;									/*!< The arrival time of the last message */
+	uint64_t samples;								/*!< The number of latencies recorded since the last adjustment */
+	uint64_t lanes;									/*!< The number of SIMD lanes computed */
+	uint64_t used;									/*!< The number of SIMD lanes that carried a message */
+	size_t width;									/*!< The batch width the queue is currently filling towards */
+} hkds_batch_state;
+
+/**
+* \brief Initialize the batch state
+*
+* \param state [struct] The batch state
+* \param mdk [struct] The master key set
+* \param deadline [uint64] The maximum time in microseconds a message waits for a batch, zero selects HKDS_BATCH_DEADLINE_DEFAULT
+* \param slo [uint64] The 99th percentile latency objective in microseconds, zero selects HKDS_BATCH_SLO_DEFAULT
+*/
+HKDS_EXPORT_API void hkds_batch_initialize(hkds_batch_state* state, hkds_master_key* mdk, uint64_t deadline, uint64_t slo);
+
+/**
+* \brief Erase the batch state and release the queue
+*
+* \param state [struct] The batch state
+*/
+HKDS_EXPORT_API void hkds_batch_dispose(hkds_batch_state* state);
+
+/**
+* \brief Add a client message to the batch.
+* Returns false if the batch is full; call hkds_batch_process and resubmit.
+*
+* \param state [struct] The batch state
+* \param ksn [array][const] The clients key serial number
+* \param ciphertext [array][const] The encrypted message
+* \return [bool] Returns true if the message was queued
+*/
+HKDS_EXPORT_API bool hkds_batch_submit(hkds_batch_state* state, const uint8_t* ksn, const uint8_t* ciphertext);
+
+/**
+* \brief Decrypt the queued messages if the batch is due.
+* The batch is due when it is full, when waiting for the next batch width would exceed the oldest messages deadline,
+* or when force is set. Messages are returned in arrival order with their key serial numbers.
+*
+* \param state [struct] The batch state
+* \param force [bool] Decrypt all queued messages regardless of the batch deadline
+* \param ksn [array2d][output] The key serial numbers of the decrypted messages
+* \param plaintext [array2d][output] The decrypted messages
+* \return [size] The number of messages decrypted
+*/
+HKDS_EXPORT_API size_t hkds_batch_process(hkds_batch_state* state, bool force,
+	uint8_t ksn[HKDS_BATCH_DEPTH][HKDS_KSN_SIZE],
+	uint8_t plaintext[HKDS_BATCH_DEPTH][HKDS_MESSAGE_SIZE]);
+
+/**
+* \brief Get the time until the batch is due, for use as a poll or sleep timeout
+*
+* \param state [struct][const] The batch state
+* \return [uint64] The time in microseconds until hkds_batch_process will decrypt, or UINT64_MAX if the batch is empty
+*/
+HKDS_EXPORT_API uint64_t hkds_batch_wait_time(const hkds_batch_state* state);
+
+/**
+* \brief Move a timer to the time the batch is due, or cancel it if the batch is empty.
+* Call after submitting and processing messages, and process the batch from the timer callback.
+*
+* \param state [struct][const] The batch state
+* \param wheel [struct] The timer wheel of the event loop
+* \param timer [struct] The initialized batch timer
+*/
+HKDS_EXPORT_API void hkds_batch_schedule(const hkds_batch_state* state, qsc_timerwheel_state* wheel, qsc_timerwheel_timer* timer);
+
+/**
+* \brief Get a latency percentile from the histogram.
+* The result is the upper bound of the histogram bucket containing the percentile.
+*
+* \param state [struct][const] The batch state
+* \param percentile [uint32] The percentile, 1 to 100
+* \return [uint64] The latency in microseconds
+*/
+HKDS_EXPORT_API uint64_t hkds_batch_latency(const hkds_batch_state* state, uint32_t percentile);
+
+/**
+* \brief Get the SIMD lane utilization, the percentage of computed lanes that carried a message
+*
+* \param state [struct][const] The batch state
+* \return [uint32] The utilization percentage
+*/
+HKDS_EXPORT_API uint32_t hkds_batch_utilization(const hkds_batch_state* state);
+
+#endif
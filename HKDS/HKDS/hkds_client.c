@@ -36,17 +36,25 @@ static void hkds_client_generate_transactionkey(hkds_client_state* state, uint8_
 	if (idx == HKDS_CACHE_SIZE - 1)
 	{
 		state->cache_empty = true;
+
+		if (state->ntok_ready == true)
+		{
+			/* the server pushed the next epochs token, refill the cache */
+			hkds_client_generate_cache(state, state->ntok);
+			memset(state->ntok, 0x00, HKDS_STK_SIZE);
+			state->ntok_ready = false;
+		}
 	}
 }
 
-static void hkds_client_get_tms(const hkds_client_state* state, uint8_t* tms)
+static void hkds_client_get_tms(const uint8_t* ksn, uint8_t* tms)
 {
 	/* copy the ksn and mac name to the token mac string */
-	memcpy(tms, state->ksn, HKDS_KSN_SIZE);
+	memcpy(tms, ksn, HKDS_KSN_SIZE);
 	memcpy((tms + HKDS_KSN_SIZE), hkds_mac_name, HKDS_NAME_SIZE);
 }
 
-bool hkds_client_decrypt_token(hkds_client_state* state, const uint8_t* etok, uint8_t* token)
+static bool hkds_client_decrypt_token_ksn(const hkds_client_state* state, const uint8_t* ksn, const uint8_t* etok, uint8_t* token)
 {
 	uint8_t ctok[HKDS_CTOK_SIZE] = { 0 };
 	uint8_t mtk[HKDS_TAG_SIZE] = { 0 };
@@ -56,18 +64,18 @@ bool hkds_client_decrypt_token(hkds_client_state* state, const uint8_t* etok, ui
 	bool res;
 
 	/* add the cache counter to customization string (tkc = transaction-counter / key-store size) */
-	tkc = qsc_intutils_be8to32(((uint8_t*)state->ksn + HKDS_DID_SIZE)) / HKDS_CACHE_SIZE;
+	tkc = qsc_intutils_be8to32(((const uint8_t*)ksn + HKDS_DID_SIZE)) / HKDS_CACHE_SIZE;
 	qsc_intutils_be32to8(ctok, tkc);
 
 	/* add the mode algorithm name to customization string */
 	memcpy(((uint8_t*)ctok + HKDS_TKC_SIZE), hkds_formal_name, HKDS_NAME_SIZE);
 	/* add the device id to the customization string */
-	memcpy(((uint8_t*)ctok + HKDS_TKC_SIZE + HKDS_NAME_SIZE), state->ksn, HKDS_DID_SIZE);
+	memcpy(((uint8_t*)ctok + HKDS_TKC_SIZE + HKDS_NAME_SIZE), ksn, HKDS_DID_SIZE);
 
 	res = false;
 
 	/* get the token mac key string */
-	hkds_client_get_tms(state, tms);
+	hkds_client_get_tms(ksn, tms);
 
 	/* M(tok, etok, tms) = kmac(m, k, c) */
 #if defined(HKDS_SHAKE_128)
@@ -110,6 +118,68 @@ bool hkds_client_decrypt_token(hkds_client_state* state, const uint8_t* etok, ui
 	return res;
 }
 
+bool hkds_client_accept_next_token(hkds_client_state* state, const uint8_t* etok)
+{
+	uint8_t nksn[HKDS_KSN_SIZE] = { 0 };
+	uint8_t tok[HKDS_STK_SIZE] = { 0 };
+	uint32_t ctr;
+	uint32_t cur;
+	uint32_t tkc;
+	bool res;
+
+	/* the current epoch holds the last transaction key used, the token is for that epoch or the one following it */
+	ctr = qsc_intutils_be8to32(((uint8_t*)state->ksn + HKDS_DID_SIZE));
+	cur = (ctr == 0) ? 0 : (ctr - 1) / HKDS_CACHE_SIZE;
+	tkc = (ctr == 0) ? 0 : cur + 1;
+	res = false;
+
+	/* a token is bound to the ksn at the start of its epoch */
+	memcpy(nksn, state->ksn, HKDS_DID_SIZE);
+
+	if (ctr != 0)
+	{
+		/* a token for the current epoch arrived after the client began the epoch, it has been consumed and is ignored */
+		qsc_intutils_be32to8(((uint8_t*)nksn + HKDS_DID_SIZE), cur * HKDS_CACHE_SIZE);
+		res = hkds_client_decrypt_token_ksn(state, nksn, etok, tok);
+	}
+
+	if (res == false)
+	{
+		qsc_intutils_be32to8(((uint8_t*)nksn + HKDS_DID_SIZE), tkc * HKDS_CACHE_SIZE);
+		res = hkds_client_decrypt_token_ksn(state, nksn, etok, tok);
+	}
+	else
+	{
+		tkc = cur;
+	}
+
+	if (res == true && tkc != cur)
+	{
+		if (tkc * HKDS_CACHE_SIZE > ctr)
+		{
+			/* store the token until the current cache is exhausted */
+			memcpy(state->ntok, tok, HKDS_STK_SIZE);
+			state->ntok_ready = true;
+		}
+		else if (state->cache_empty == true)
+		{
+			/* the cache is already exhausted, generate the next cache now */
+			hkds_client_generate_cache(state, tok);
+		}
+
+		/* otherwise the cache was already refilled from an earlier push of this token */
+	}
+
+	memset(tok, 0x00, sizeof(tok));
+
+	return res;
+}
+
+bool hkds_client_decrypt_token(hkds_client_state* state, const uint8_t* etok, uint8_t* token)
+{
+	return hkds_client_decrypt_token_ksn(state, state->ksn, etok, token);
+}
+
 bool hkds_client_encrypt_message(hkds_client_state* state, const uint8_t* plaintext, uint8_t* ciphertext)
 {
 	bool res;
@@ -218,5 +288,7 @@ void hkds_client_initialize_state(hkds_client_state* state, const uint8_t* edk,
 		memset(state->tkc[i], 0x00, HKDS_MESSAGE_SIZE);
 	}
 
+	memset(state->ntok, 0x00, HKDS_STK_SIZE);
 	state->cache_empty = true;
+	state->ntok_ready = false;
 }
@@ -31,9 +31,25 @@ HKDS_EXPORT_API typedef struct
 	uint8_t edk[HKDS_EDK_SIZE];
 	uint8_t ksn[HKDS_KSN_SIZE];
 	uint8_t tkc[HKDS_CACHE_SIZE][HKDS_MESSAGE_SIZE];
+	uint8_t ntok[HKDS_STK_SIZE];
 	bool cache_empty;
+	bool ntok_ready;
 } hkds_client_state;
 
+/**
+* \brief Accept the next epochs encrypted token pushed by the server in a message token response.
+* The token is authenticated and decrypted immediately, and stored in the state.
+* When the current key cache is exhausted, the next cache is generated from the stored token,
+* without a token request. If the cache is already empty, the cache is generated immediately.
+* The server may push the same token more than once; a repeated token is authenticated and ignored,
+* including a token that arrives after the client has begun the epoch it is for.
+*
+* \param state [struct] The function state
+* \param etok [const][array] The encrypted token key for the next epoch
+* \return [bool] Returns true if the token was authenticated and accepted
+*/
+HKDS_EXPORT_API bool hkds_client_accept_next_token(hkds_client_state* state, const uint8_t* etok);
+
 /**
 * \brief Decrypt an encrypted token key sent by the server
 *
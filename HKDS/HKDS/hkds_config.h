@@ -35,6 +35,7 @@ typedef enum hkds_packet_type
 	packet_message_response = 0x04,				/*!< A server message response */
 	packet_administrative_message = 0x05,		/*!< An administrative message */
 	packet_error_message = 0x06,				/*!< An error message */
+	packet_message_token_response = 0x07,		/*!< A server message response carrying the next epochs encrypted token */
 } 
 hkds_packet_type;
 
@@ -61,6 +62,7 @@ typedef enum hkds_error_type
 	error_invalid_format = 0x24,				/*!< The request format was invalid */
 	error_retries_exceeded = 0x25,				/*!< The allowed number of retries was exceeded */
 	error_connection_failure = 0x26,			/*!< The connection had a general failure */
+	error_server_busy = 0x27,					/*!< The server is overloaded and rejected the request, the client should retry later */
 	error_unkown_failure = 0xFF,				/*!< The cause of failure is unknown */
 }
 hkds_error_type;
@@ -112,6 +114,15 @@ hkds_message_type;
 */
 #define HKDS_CACHE_MULTIPLIER 4
 
+/*!
+\def HKDS_PUSH_TOKEN_THRESHOLD
+* The number of transactions remaining in a clients key cache at which the server
+* begins attaching the next epochs encrypted token to its message responses.
+* The token is pushed for each of the final messages of the epoch, so a lost response does not stall the client.
+* Must be at least 2 (an authenticated message consumes two transaction keys), and less than the cache size.
+*/
+#define HKDS_PUSH_TOKEN_THRESHOLD 4
+
 /*** Static values (do not change) ***/
 
 /*!
@@ -207,6 +218,18 @@ hkds_message_type;
 */
 #define HKDS_NAME_SIZE 7
 
+/*!
+\def HKDS_SEQUENCE_DEFAULT
+* The sequence of a request sent by a client that keeps one request outstanding
+*/
+#define HKDS_SEQUENCE_DEFAULT 0x01
+
+/*!
+\def HKDS_SEQUENCE_NONE
+* The sequence returned with an error that does not answer a parsed request; never used as a request sequence
+*/
+#define HKDS_SEQUENCE_NONE 0x00
+
 /*!
 \def HKDS_TAG_SIZE
 * The size of the authentication code tag used with authenticated encryption
@@ -383,6 +406,12 @@ hkds_message_type;
 */
 #define HKDS_SERVER_TOKEN_RESPONSE_SIZE (HKDS_HEADER_SIZE + HKDS_ETOK_SIZE)
 
+/*!
+\def HKDS_SERVER_MESSAGE_TOKEN_RESPONSE_SIZE
+* The server message response with a pushed token packet size
+*/
+#define HKDS_SERVER_MESSAGE_TOKEN_RESPONSE_SIZE (HKDS_HEADER_SIZE + HKDS_MESSAGE_SIZE + HKDS_ETOK_SIZE)
+
 /*!
 \def HKDS_ADMIN_MESSAGE_SIZE
 * The administrative message packet size
@@ -404,7 +433,7 @@ typedef struct
 {
 	hkds_packet_type flag;					/*!< The type of packet */
 	hkds_protocol_id protocol;				/*!< The protocol id */
-	uint8_t sequence;						/*!< The packet sequence */
+	uint8_t sequence;						/*!< The request identifier, echoed by the response; the error code of an error message */
 	uint8_t length;							/*!< The packet size including header */
 }
 hkds_packet_header;
@@ -456,6 +485,19 @@ typedef struct
 }
 hkds_server_token_response;
 
+/*! \struct hkds_server_message_token_response
+* The server's message response extended with the encrypted token for the client's next epoch.
+* Sent in place of a message response when the client's key cache is within HKDS_PUSH_TOKEN_THRESHOLD
+* transactions of exhaustion, so the client can refill its cache without a token request.
+*/
+typedef struct
+{
+	hkds_packet_header header;				/*!< The HKDS packet header */
+	uint8_t message[HKDS_MESSAGE_SIZE];		/*!< The servers message response */
+	uint8_t etok[HKDS_ETOK_SIZE];			/*!< The encrypted token for the next epoch */
+}
+hkds_server_message_token_response;
+
 /*! \struct hkds_administrative_message
 * An administrative message is used to signal requests, status updates, 
 * or as a post-error condition reset of a communications session. 
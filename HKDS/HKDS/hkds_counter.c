@@ -0,0 +1,223 @@
+#include "hkds_counter.h"
+#include "../QSC/atomics.h"
+#include "../QSC/intutils.h"
+#include "../QSC/memutils.h"
+#include <stdlib.h>
+
+static int hkds_counter_compare(const void* a, const void* b)
+{
+	const hkds_counter_entry* ua = (const hkds_counter_entry*)a;
+	const hkds_counter_entry* ub = (const hkds_counter_entry*)b;
+	int res;
+
+	if (ua->index != ub->index)
+	{
+		res = (ua->index < ub->index) ? -1 : 1;
+	}
+	else if (ua->record != ub->record)
+	{
+		res = (ua->record < ub->record) ? -1 : 1;
+	}
+	else
+	{
+		res = 0;
+	}
+
+	return res;
+}
+
+uint64_t hkds_counter_pack(uint32_t epoch, uint32_t counter)
+{
+	return ((uint64_t)epoch << 32) | (uint64_t)counter;
+}
+
+uint64_t hkds_counter_from_ksn(const uint8_t* ksn)
+{
+	assert(ksn != NULL);
+
+	uint32_t ctr;
+
+	ctr = qsc_intutils_be8to32(ksn + HKDS_DID_SIZE);
+
+	return hkds_counter_pack(ctr / HKDS_CACHE_SIZE, ctr);
+}
+
+uint32_t hkds_counter_epoch(uint64_t record)
+{
+	return (uint32_t)(record >> 32);
+}
+
+uint32_t hkds_counter_value(uint64_t record)
+{
+	return (uint32_t)record;
+}
+
+bool hkds_counter_initialize(hkds_counter_table* table, size_t count)
+{
+	assert(table != NULL);
+	assert(count != 0);
+
+	size_t len;
+	bool res;
+
+	res = false;
+
+	if (table != NULL && count != 0)
+	{
+		/* round the allocation up to whole cache lines */
+		len = ((count + HKDS_COUNTER_RECORDS_PER_LINE - 1) / HKDS_COUNTER_RECORDS_PER_LINE) * HKDS_COUNTER_ALIGNMENT;
+		table->records = (volatile uint64_t*)qsc_memutils_aligned_alloc(HKDS_COUNTER_ALIGNMENT, len);
+
+		if (table->records != NULL)
+		{
+			qsc_memutils_clear((uint8_t*)table->records, len);
+			table->count = count;
+			res = true;
+		}
+		else
+		{
+			table->count = 0;
+		}
+	}
+
+	return res;
+}
+
+void hkds_counter_dispose(hkds_counter_table* table)
+{
+	assert(table != NULL);
+
+	if (table != NULL)
+	{
+		if (table->records != NULL)
+		{
+			qsc_memutils_clear((uint8_t*)table->records, table->count * sizeof(uint64_t));
+			qsc_memutils_aligned_free((void*)table->records);
+			table->records = NULL;
+		}
+
+		table->count = 0;
+	}
+}
+
+bool hkds_counter_read(const hkds_counter_table* table, size_t index, uint64_t* record)
+{
+	assert(table != NULL);
+	assert(record != NULL);
+	assert(index < table->count);
+
+	uint64_t val;
+	bool res;
+
+	res = false;
+
+	if (table != NULL && record != NULL && index < table->count)
+	{
+		val = qsc_atomics_load64(&table->records[index]);
+
+		if (val != 0)
+		{
+			*record = val - 1;
+			res = true;
+		}
+	}
+
+	return res;
+}
+
+bool hkds_counter_update(hkds_counter_table* table, size_t index, uint64_t record)
+{
+	assert(table != NULL);
+	assert(index < table->count);
+
+	uint64_t prev;
+	bool res;
+
+	res = false;
+
+	if (table != NULL && index < table->count && record != UINT64_MAX)
+	{
+		/* the stored value is biased by one, an empty slot (0) accepts record zero */
+		prev = qsc_atomics_fetch_max64(&table->records[index], record + 1);
+		res = (prev < record + 1);
+	}
+
+	return res;
+}
+
+size_t hkds_counter_update_batch(hkds_counter_table* table, const hkds_counter_entry* updates, size_t count, bool* accepted)
+{
+	assert(table != NULL);
+	assert(updates != NULL);
+
+	uint64_t prev;
+	size_t acc;
+	size_t idx;
+	size_t i;
+	size_t j;
+	bool res;
+
+	acc = 0;
+
+	if (table != NULL && updates != NULL)
+	{
+		i = 0;
+
+		while (i < count)
+		{
+			idx = updates[i].index;
+			j = i + 1;
+
+			/* find the run of updates that target this slot */
+			while (j < count && updates[j].index == idx)
+			{
+				assert(updates[j].record >= updates[j - 1].record);
+				++j;
+			}
+
+			/* warm the next slot while this one is updated */
+			if (j < count && updates[j].index < table->count)
+			{
+				qsc_memutils_prefetch_l1((uint8_t*)&table->records[updates[j].index], 0);
+			}
+
+			if (idx < table->count && updates[j - 1].record != UINT64_MAX)
+			{
+				/* one atomic maximum per slot; the run is sorted so its last record is the largest */
+				prev = qsc_atomics_fetch_max64(&table->records[idx], updates[j - 1].record + 1);
+
+				for (size_t k = i; k < j; ++k)
+				{
+					res = (updates[k].record + 1 > prev) && (k == i || updates[k].record != updates[k - 1].record);
+					acc += (res == true) ? 1 : 0;
+
+					if (accepted != NULL)
+					{
+						accepted[k] = res;
+					}
+				}
+			}
+			else if (accepted != NULL)
+			{
+				for (size_t k = i; k < j; ++k)
+				{
+					accepted[k] = false;
+				}
+			}
+
+			i = j;
+		}
+	}
+
+	return acc;
+}
+
+void hkds_counter_sort_batch(hkds_counter_entry* updates, size_t count)
+{
+	assert(updates != NULL);
+
+	if (updates != NULL && count > 1)
+	{
+		qsort(updates, count, sizeof(hkds_counter_entry), &hkds_counter_compare);
+	}
+}
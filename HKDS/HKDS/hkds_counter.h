@@ -0,0 +1,158 @@
+/* 2021 Digital Freedom Defense Incorporated
+ * All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Digital Freedom Defense Incorporated.
+ * The intellectual and technical concepts contained
+ * herein are proprietary to Digital Freedom Defense Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Digital Freedom Defense Incorporated.
+ *
+ * Contact: develop@dfdef.com
+ */
+
+#ifndef HKDS_COUNTER_H
+#define HKDS_COUNTER_H
+
+#include "common.h"
+#include "hkds_config.h"
+
+/* Device counter high-water table.
+* Each device slot holds a packed 64-bit (epoch, counter) record, the highest transaction counter
+* accepted from that device. Records are raised with an atomic compare-and-swap maximum,
+* so any number of server threads can share a table without a lock.
+* An update is accepted only if it is strictly greater than the stored record, which rejects replayed
+* and out-of-date messages. Device slot assignment (DID to index) is the responsibility of the caller. */
+
+/*!
+\def HKDS_COUNTER_ALIGNMENT
+* The counter table memory alignment; records start on a cache line boundary
+*/
+#define HKDS_COUNTER_ALIGNMENT 64
+
+/*!
+\def HKDS_COUNTER_RECORDS_PER_LINE
+* The number of device records that share one cache line
+*/
+#define HKDS_COUNTER_RECORDS_PER_LINE (HKDS_COUNTER_ALIGNMENT / sizeof(uint64_t))
+
+/*! \struct hkds_counter_table
+* Contains the device counter high-water table
+*/
+typedef struct
+{
+	volatile uint64_t* records;	/*!< The aligned array of packed records, biased by one so that zero means empty */
+	size_t count;				/*!< The number of device slots */
+}
+hkds_counter_table;
+
+/*! \struct hkds_counter_entry
+* A single high-water update used by the bulk update function
+*/
+typedef struct
+{
+	size_t index;				/*!< The device slot index */
+	uint64_t record;			/*!< The packed (epoch, counter) record */
+}
+hkds_counter_entry;
+
+/**
+* \brief Pack an epoch and transaction counter into a 64-bit record.
+* The epoch occupies the high 32 bits, so records order by epoch first, then counter.
+*
+* \param epoch [uint32] The token epoch (transaction counter / HKDS_CACHE_SIZE)
+* \param counter [uint32] The transaction counter
+* \return [uint64] The packed record
+*/
+HKDS_EXPORT_API uint64_t hkds_counter_pack(uint32_t epoch, uint32_t counter);
+
+/**
+* \brief Build a packed record from a clients key serial number
+*
+* \param ksn [array][const] The clients key serial number
+* \return [uint64] The packed record
+*/
+HKDS_EXPORT_API uint64_t hkds_counter_from_ksn(const uint8_t* ksn);
+
+/**
+* \brief Extract the epoch from a packed record
+*
+* \param record [uint64] The packed record
+* \return [uint32] The epoch
+*/
+HKDS_EXPORT_API uint32_t hkds_counter_epoch(uint64_t record);
+
+/**
+* \brief Extract the transaction counter from a packed record
+*
+* \param record [uint64] The packed record
+* \return [uint32] The transaction counter
+*/
+HKDS_EXPORT_API uint32_t hkds_counter_value(uint64_t record);
+
+/**
+* \brief Initialize a counter table; all device slots start empty
+*
+* \param table [struct] The counter table
+* \param count [size] The number of device slots
+* \return [bool] Returns true if the table memory was allocated
+*/
+HKDS_EXPORT_API bool hkds_counter_initialize(hkds_counter_table* table, size_t count);
+
+/**
+* \brief Clear and release the counter table
+*
+* \param table [struct] The counter table
+*/
+HKDS_EXPORT_API void hkds_counter_dispose(hkds_counter_table* table);
+
+/**
+* \brief Read the current high-water record of a device slot
+*
+* \param table [struct][const] The counter table
+* \param index [size] The device slot index
+* \param record [uint64][output] The stored record
+* \return [bool] Returns false if no record has been accepted for this slot
+*/
+HKDS_EXPORT_API bool hkds_counter_read(const hkds_counter_table* table, size_t index, uint64_t* record);
+
+/**
+* \brief Atomically raise the high-water record of a device slot.
+* Safe to call concurrently from any number of threads.
+*
+* \param table [struct] The counter table
+* \param index [size] The device slot index
+* \param record [uint64] The packed (epoch, counter) record
+* \return [bool] Returns true if the record was greater than the stored value and was accepted,
+* false if it is a replay or out of date
+*/
+HKDS_EXPORT_API bool hkds_counter_update(hkds_counter_table* table, size_t index, uint64_t record);
+
+/**
+* \brief Apply a sorted batch of high-water updates.
+* The batch must be sorted by slot index, then record, in ascending order (see hkds_counter_sort_batch).
+* Each device slot in the batch is touched by a single atomic operation, in ascending address order,
+* so concurrent batches contend for each cache line at most once.
+* An update is accepted if it is greater than the slot record before the batch, and is not a
+* duplicate of another update in the same batch.
+*
+* \param table [struct] The counter table
+* \param updates [array][const] The sorted array of updates
+* \param count [size] The number of updates
+* \param accepted [array][output] An array of count booleans receiving the result of each update, can be NULL
+* \return [size] The number of accepted updates
+*/
+HKDS_EXPORT_API size_t hkds_counter_update_batch(hkds_counter_table* table, const hkds_counter_entry* updates, size_t count, bool* accepted);
+
+/**
+* \brief Sort a batch of updates by slot index, then record, in ascending order
+*
+* \param updates [array] The array of updates
+* \param count [size] The number of updates
+*/
+HKDS_EXPORT_API void hkds_counter_sort_batch(hkds_counter_entry* updates, size_t count);
+
+#endif
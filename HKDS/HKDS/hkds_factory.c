@@ -1,59 +1,119 @@
 #include "hkds_factory.h"
+#include "hkds_wire.h"
 #include "../QSC/memutils.h"
 
+/* the packet structures hold enumerated header fields, the wire views give the byte layout */
+
+static void hkds_factory_write_header(hkds_wire_header* output, const hkds_packet_header* header)
+{
+	output->flag = (uint8_t)header->flag;
+	output->protocol = (uint8_t)header->protocol;
+	output->sequence = header->sequence;
+	output->length = header->length;
+}
+
+static hkds_packet_header hkds_factory_read_header(const hkds_wire_header* input)
+{
+	hkds_packet_header hdr = { 0 };
+
+	hdr.flag = (hkds_packet_type)input->flag;
+	hdr.protocol = (hkds_protocol_id)input->protocol;
+	hdr.sequence = input->sequence;
+	hdr.length = input->length;
+
+	return hdr;
+}
+
 /* header to raw packet */
 
 void hkds_factory_serialize_packet_header(uint8_t* output, const hkds_packet_header* header)
 {
-	qsc_memutils_copy(output, (const uint8_t*)header, HKDS_HEADER_SIZE);
+	hkds_factory_write_header((hkds_wire_header*)output, header);
 }
 
 void hkds_factory_serialize_client_message(uint8_t* output, const hkds_client_message_request* header)
 {
-	qsc_memutils_copy(output, (const uint8_t*)header, HKDS_CLIENT_MESSAGE_REQUEST_SIZE);
+	hkds_wire_client_message* pkt;
+
+	pkt = (hkds_wire_client_message*)output;
+	hkds_factory_write_header(&pkt->header, &header->header);
+	qsc_memutils_copy(pkt->ksn, header->ksn, sizeof(pkt->ksn));
+	qsc_memutils_copy(pkt->message, header->message, sizeof(pkt->message));
+	qsc_memutils_copy(pkt->tag, header->tag, sizeof(pkt->tag));
 }
 
 void hkds_factory_serialize_client_token(uint8_t* output, const hkds_client_token_request* header)
 {
-	qsc_memutils_copy(output, (const uint8_t*)header, HKDS_CLIENT_TOKEN_REQUEST_SIZE);
+	hkds_wire_client_token* pkt;
+
+	pkt = (hkds_wire_client_token*)output;
+	hkds_factory_write_header(&pkt->header, &header->header);
+	qsc_memutils_copy(pkt->ksn, header->ksn, sizeof(pkt->ksn));
 }
 
 void hkds_factory_serialize_server_message(uint8_t* output, const hkds_server_message_response* header)
 {
-	qsc_memutils_copy(output, (const uint8_t*)header, HKDS_SERVER_MESSAGE_RESPONSE_SIZE);
+	hkds_wire_server_message* pkt;
+
+	pkt = (hkds_wire_server_message*)output;
+	hkds_factory_write_header(&pkt->header, &header->header);
+	qsc_memutils_copy(pkt->message, header->message, sizeof(pkt->message));
 }
 
 void hkds_factory_serialize_server_token(uint8_t* output, const hkds_server_token_response* header)
 {
-	qsc_memutils_copy(output, (const uint8_t*)header, HKDS_SERVER_TOKEN_RESPONSE_SIZE);
+	hkds_wire_server_token* pkt;
+
+	pkt = (hkds_wire_server_token*)output;
+	hkds_factory_write_header(&pkt->header, &header->header);
+	qsc_memutils_copy(pkt->etok, header->etok, sizeof(pkt->etok));
+}
+
+void hkds_factory_serialize_server_message_token(uint8_t* output, const hkds_server_message_token_response* header)
+{
+	hkds_wire_server_message_token* pkt;
+
+	pkt = (hkds_wire_server_message_token*)output;
+	hkds_factory_write_header(&pkt->header, &header->header);
+	qsc_memutils_copy(pkt->message, header->message, sizeof(pkt->message));
+	qsc_memutils_copy(pkt->etok, header->etok, sizeof(pkt->etok));
 }
 
 void hkds_factory_serialize_administrative_message(uint8_t* output, const hkds_administrative_message* header)
 {
-	qsc_memutils_copy(output, (const uint8_t*)header, HKDS_ADMIN_MESSAGE_SIZE);
+	hkds_wire_administrative_message* pkt;
+
+	pkt = (hkds_wire_administrative_message*)output;
+	hkds_factory_write_header(&pkt->header, &header->header);
+	qsc_memutils_copy(pkt->message, header->message, sizeof(pkt->message));
 }
 
 void hkds_factory_serialize_error_message(uint8_t* output, const hkds_error_message* header)
 {
-	qsc_memutils_copy(output, (const uint8_t*)header, HKDS_ERROR_MESSAGE_SIZE);
+	hkds_wire_error_message* pkt;
+
+	pkt = (hkds_wire_error_message*)output;
+	hkds_factory_write_header(&pkt->header, &header->header);
+	qsc_memutils_copy(pkt->message, header->message, sizeof(pkt->message));
 }
 
 /* raw packet to header */
 
 hkds_packet_header hkds_factory_extract_packet_header(const uint8_t* input)
 {
-	hkds_packet_header hdr = { 0 };
-
-	qsc_memutils_copy((uint8_t*)&hdr, input, HKDS_HEADER_SIZE);
-
-	return hdr;
+	return hkds_factory_read_header((const hkds_wire_header*)input);
 }
 
 hkds_client_message_request hkds_factory_extract_client_message(const uint8_t* input)
 {
 	hkds_client_message_request hdr = { 0 };
+	const hkds_wire_client_message* pkt;
 
-	qsc_memutils_copy((uint8_t*)&hdr, input, HKDS_CLIENT_MESSAGE_REQUEST_SIZE);
+	pkt = (const hkds_wire_client_message*)input;
+	hdr.header = hkds_factory_read_header(&pkt->header);
+	qsc_memutils_copy(hdr.ksn, pkt->ksn, sizeof(hdr.ksn));
+	qsc_memutils_copy(hdr.message, pkt->message, sizeof(hdr.message));
+	qsc_memutils_copy(hdr.tag, pkt->tag, sizeof(hdr.tag));
 
 	return hdr;
 }
@@ -61,8 +121,11 @@ hkds_client_message_request hkds_factory_extract_client_message(const uint8_t* i
 hkds_client_token_request hkds_factory_extract_client_token(const uint8_t* input)
 {
 	hkds_client_token_request hdr = { 0 };
+	const hkds_wire_client_token* pkt;
 
-	qsc_memutils_copy((uint8_t*)&hdr, input, HKDS_CLIENT_TOKEN_REQUEST_SIZE);
+	pkt = (const hkds_wire_client_token*)input;
+	hdr.header = hkds_factory_read_header(&pkt->header);
+	qsc_memutils_copy(hdr.ksn, pkt->ksn, sizeof(hdr.ksn));
 
 	return hdr;
 }
@@ -70,8 +133,11 @@ hkds_client_token_request hkds_factory_extract_client_token(const uint8_t* input
 hkds_server_message_response hkds_factory_extract_server_message(const uint8_t* input)
 {
 	hkds_server_message_response hdr = { 0 };
+	const hkds_wire_server_message* pkt;
 
-	qsc_memutils_copy((uint8_t*)&hdr, input, HKDS_SERVER_MESSAGE_RESPONSE_SIZE);
+	pkt = (const hkds_wire_server_message*)input;
+	hdr.header = hkds_factory_read_header(&pkt->header);
+	qsc_memutils_copy(hdr.message, pkt->message, sizeof(hdr.message));
 
 	return hdr;
 }
@@ -79,8 +145,24 @@ hkds_server_message_response hkds_factory_extract_server_message(const uint8_t*
 hkds_server_token_response hkds_factory_extract_server_token(const uint8_t* input)
 {
 	hkds_server_token_response hdr = { 0 };
+	const hkds_wire_server_token* pkt;
+
+	pkt = (const hkds_wire_server_token*)input;
+	hdr.header = hkds_factory_read_header(&pkt->header);
+	qsc_memutils_copy(hdr.etok, pkt->etok, sizeof(hdr.etok));
+
+	return hdr;
+}
+
+hkds_server_message_token_response hkds_factory_extract_server_message_token(const uint8_t* input)
+{
+	hkds_server_message_token_response hdr = { 0 };
+	const hkds_wire_server_message_token* pkt;
 
-	qsc_memutils_copy((uint8_t*)&hdr, input, HKDS_SERVER_TOKEN_RESPONSE_SIZE);
+	pkt = (const hkds_wire_server_message_token*)input;
+	hdr.header = hkds_factory_read_header(&pkt->header);
+	qsc_memutils_copy(hdr.message, pkt->message, sizeof(hdr.message));
+	qsc_memutils_copy(hdr.etok, pkt->etok, sizeof(hdr.etok));
 
 	return hdr;
 }
@@ -88,8 +170,11 @@ hkds_server_token_response hkds_factory_extract_server_token(const uint8_t* inpu
 hkds_administrative_message hkds_factory_extract_administrative_message(const uint8_t* input)
 {
 	hkds_administrative_message hdr = { 0 };
+	const hkds_wire_administrative_message* pkt;
 
-	qsc_memutils_copy((uint8_t*)&hdr, input, HKDS_ADMIN_MESSAGE_SIZE);
+	pkt = (const hkds_wire_administrative_message*)input;
+	hdr.header = hkds_factory_read_header(&pkt->header);
+	qsc_memutils_copy(hdr.message, pkt->message, sizeof(hdr.message));
 
 	return hdr;
 }
@@ -97,21 +182,24 @@ hkds_administrative_message hkds_factory_extract_administrative_message(const ui
 hkds_error_message hkds_factory_extract_error_message(const uint8_t* input)
 {
 	hkds_error_message hdr = { 0 };
+	const hkds_wire_error_message* pkt;
 
-	qsc_memutils_copy((uint8_t*)&hdr, input, HKDS_ERROR_MESSAGE_SIZE);
+	pkt = (const hkds_wire_error_message*)input;
+	hdr.header = hkds_factory_read_header(&pkt->header);
+	qsc_memutils_copy(hdr.message, pkt->message, sizeof(hdr.message));
 
 	return hdr;
 }
 
 /* packet construction */
 
-hkds_client_message_request hkds_factory_create_client_message_request(const uint8_t* message, const uint8_t* ksn, const uint8_t* tag)
+hkds_client_message_request hkds_factory_create_client_message_request(const uint8_t* message, const uint8_t* ksn, const uint8_t* tag, uint8_t sequence)
 {
 	hkds_client_message_request hdr = { 0 };
 
 	hkds_packet_header hdp =
 	{
-		.sequence = 0x01,
+		.sequence = sequence,
 		.flag = packet_message_request,
 		.length = HKDS_CLIENT_MESSAGE_REQUEST_SIZE,
 		.protocol = HKDS_PROTOCOL_TYPE
@@ -129,13 +217,13 @@ hkds_client_message_request hkds_factory_create_client_message_request(const uin
 	return hdr;
 }
 
-hkds_client_token_request hkds_factory_create_client_token_request(const uint8_t* ksn)
+hkds_client_token_request hkds_factory_create_client_token_request(const uint8_t* ksn, uint8_t sequence)
 {
 	hkds_client_token_request hdr = { 0 };
 
 	hkds_packet_header hdp =
 	{
-		.sequence = 0x01,
+		.sequence = sequence,
 		.flag = packet_token_request,
 		.length = HKDS_CLIENT_TOKEN_REQUEST_SIZE,
 		.protocol = HKDS_PROTOCOL_TYPE
@@ -147,13 +235,13 @@ hkds_client_token_request hkds_factory_create_client_token_request(const uint8_t
 	return hdr;
 }
 
-hkds_server_message_response hkds_factory_create_server_message_response(const uint8_t* message)
+hkds_server_message_response hkds_factory_create_server_message_response(const uint8_t* message, uint8_t sequence)
 {
 	hkds_server_message_response hdr = { 0 };
 
 	hkds_packet_header hdp =
 	{
-		.sequence = 0x02,
+		.sequence = sequence,
 		.flag = packet_message_response,
 		.length = HKDS_SERVER_MESSAGE_RESPONSE_SIZE,
 		.protocol = HKDS_PROTOCOL_TYPE
@@ -165,13 +253,13 @@ hkds_server_message_response hkds_factory_create_server_message_response(const u
 	return hdr;
 }
 
-hkds_server_token_response hkds_factory_create_server_token_reponse(const uint8_t* etok)
+hkds_server_token_response hkds_factory_create_server_token_reponse(const uint8_t* etok, uint8_t sequence)
 {
 	hkds_server_token_response hdr = { 0 };
 
 	hkds_packet_header hdp =
 	{
-		.sequence = 0x02,
+		.sequence = sequence,
 		.flag = packet_token_response,
 		.length = HKDS_SERVER_TOKEN_RESPONSE_SIZE,
 		.protocol = HKDS_PROTOCOL_TYPE
@@ -183,6 +271,25 @@ hkds_server_token_response hkds_factory_create_server_token_reponse(const uint8_
 	return hdr;
 }
 
+hkds_server_message_token_response hkds_factory_create_server_message_token_response(const uint8_t* message, const uint8_t* etok, uint8_t sequence)
+{
+	hkds_server_message_token_response hdr = { 0 };
+
+	hkds_packet_header hdp =
+	{
+		.sequence = sequence,
+		.flag = packet_message_token_response,
+		.length = HKDS_SERVER_MESSAGE_TOKEN_RESPONSE_SIZE,
+		.protocol = HKDS_PROTOCOL_TYPE
+	};
+
+	hdr.header = hdp;
+	qsc_memutils_copy(hdr.message, message, sizeof(hdr.message));
+	qsc_memutils_copy(hdr.etok, etok, sizeof(hdr.etok));
+
+	return hdr;
+}
+
 hkds_administrative_message hkds_factory_create_administrative_message(const uint8_t* message)
 {
 	hkds_administrative_message hdr = { 0 };
@@ -219,6 +326,19 @@ hkds_error_message hkds_factory_create_error_message(const uint8_t* message, hkd
 	return hdr;
 }
 
+void hkds_factory_create_error_echo(uint8_t* message, uint8_t sequence, const uint8_t* ksn)
+{
+	assert(message != NULL);
+
+	qsc_memutils_clear(message, HKDS_ERROR_SIZE);
+	message[0] = sequence;
+
+	if (ksn != NULL)
+	{
+		qsc_memutils_copy(message + 1, ksn, HKDS_ERROR_SIZE - 1);
+	}
+}
+
 /* raw packet value extraction  */
 
 hkds_packet_type hkds_factory_extract_packet_type(const uint8_t* input)
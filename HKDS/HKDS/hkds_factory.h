@@ -65,6 +65,14 @@ HKDS_EXPORT_API void hkds_factory_serialize_server_message(uint8_t* output, cons
 */
 HKDS_EXPORT_API void hkds_factory_serialize_server_token(uint8_t* output, const hkds_server_token_response* header);
 
+/**
+* \brief Serialize a server message response with a pushed token to a byte array
+*
+* \param output [array] The serialized server message token response
+* \param header [struct][const] The server message token response structure
+*/
+HKDS_EXPORT_API void hkds_factory_serialize_server_message_token(uint8_t* output, const hkds_server_message_token_response* header);
+
 /**
 * \brief Serialize an administrative message to a byte array
 *
@@ -123,6 +131,14 @@ HKDS_EXPORT_API hkds_server_message_response hkds_factory_extract_server_message
 */
 HKDS_EXPORT_API hkds_server_token_response hkds_factory_extract_server_token(const uint8_t* input);
 
+/**
+* \brief Extract a server message response with a pushed token from a byte array
+*
+* \param input [array][const] The serialized server message token response input array
+* \return [struct] A server message token response structure
+*/
+HKDS_EXPORT_API hkds_server_message_token_response hkds_factory_extract_server_message_token(const uint8_t* input);
+
 /**
 * \brief Extract an administrative message from a byte array
 *
@@ -147,33 +163,47 @@ HKDS_EXPORT_API hkds_error_message hkds_factory_extract_error_message(const uint
 * \param message [array][const] The encrypted client message array
 * \param ksn [array][const] The clients KSN array
 * \param tag [array][const] The [optional] authentication tag
+* \param sequence [uint8] The request identifier, unique among the requests outstanding on the connection
 * \return [struct] A client message request structure
 */
-HKDS_EXPORT_API hkds_client_message_request hkds_factory_create_client_message_request(const uint8_t* message, const uint8_t* ksn, const uint8_t* tag);
+HKDS_EXPORT_API hkds_client_message_request hkds_factory_create_client_message_request(const uint8_t* message, const uint8_t* ksn, const uint8_t* tag, uint8_t sequence);
 
 /**
 * \brief Build a client token request from components
 *
 * \param ksn [array][const] The clients KSN array
+* \param sequence [uint8] The request identifier, unique among the requests outstanding on the connection
 * \return [struct] A client token request structure
 */
-HKDS_EXPORT_API hkds_client_token_request hkds_factory_create_client_token_request(const uint8_t* ksn);
+HKDS_EXPORT_API hkds_client_token_request hkds_factory_create_client_token_request(const uint8_t* ksn, uint8_t sequence);
 
 /**
 * \brief Build a server message response from components
 *
 * \param message [array][const] The server message response array
+* \param sequence [uint8] The sequence of the request being answered
 * \return [struct] A server message response structure
 */
-HKDS_EXPORT_API hkds_server_message_response hkds_factory_create_server_message_response(const uint8_t* message);
+HKDS_EXPORT_API hkds_server_message_response hkds_factory_create_server_message_response(const uint8_t* message, uint8_t sequence);
 
 /**
 * \brief Build a server token response from components
 *
 * \param etok [array][const] The servers encrypted token response array
+* \param sequence [uint8] The sequence of the request being answered
 * \return [struct] A server token response structure
 */
-HKDS_EXPORT_API hkds_server_token_response hkds_factory_create_server_token_reponse(const uint8_t* etok);
+HKDS_EXPORT_API hkds_server_token_response hkds_factory_create_server_token_reponse(const uint8_t* etok, uint8_t sequence);
+
+/**
+* \brief Build a server message response with a pushed token from components
+*
+* \param message [array][const] The server message response array
+* \param etok [array][const] The encrypted token for the clients next epoch
+* \param sequence [uint8] The sequence of the request being answered
+* \return [struct] A server message token response structure
+*/
+HKDS_EXPORT_API hkds_server_message_token_response hkds_factory_create_server_message_token_response(const uint8_t* message, const uint8_t* etok, uint8_t sequence);
 
 /**
 * \brief Build an administrative message from components
@@ -191,6 +221,18 @@ HKDS_EXPORT_API hkds_administrative_message hkds_factory_create_administrative_m
 */
 HKDS_EXPORT_API hkds_error_message hkds_factory_create_error_message(const uint8_t* message, hkds_error_type err);
 
+/**
+* \brief Build the error message array that answers a request.
+* The array is the sequence of the request followed by the first HKDS_ERROR_SIZE - 1 bytes of its KSN;
+* the array has no room for the low byte of the counter, so the echo holds the device id and the high bytes
+* of the counter, and the client matches the error to its request by the sequence.
+*
+* \param message [array][output] The error message array, HKDS_ERROR_SIZE bytes
+* \param sequence [uint8] The sequence of the request being answered
+* \param ksn [array][const] The key serial number of the request, or NULL if the request does not carry one
+*/
+HKDS_EXPORT_API void hkds_factory_create_error_echo(uint8_t* message, uint8_t sequence, const uint8_t* ksn);
+
 /* raw packet value extraction  */
 
 /**
@@ -0,0 +1,617 @@
+#include "hkds_ipc.h"
+#include "../QSC/atomics.h"
+#include "../QSC/memutils.h"
+#include "../QSC/stringutils.h"
+
+#if defined(QSC_SYSTEM_OS_LINUX)
+#	include <fcntl.h>
+#	include <limits.h>
+#	include <linux/futex.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <sys/syscall.h>
+#	include <time.h>
+#	include <unistd.h>
+#endif
+
+#define HKDS_IPC_MAGIC 0x484B445349504331ULL
+
+#if defined(QSC_SYSTEM_OS_LINUX)
+
+static uint32_t* hkds_ipc_futex_word(volatile uint64_t* word)
+{
+	/* the futex is the low order half of the 64-bit counter */
+	return (uint32_t*)word + ((QSC_SYSTEM_IS_LITTLE_ENDIAN) ? 0 : 1);
+}
+
+static void hkds_ipc_futex_wait(volatile uint64_t* word, uint64_t value, uint32_t milliseconds)
+{
+	struct timespec ts;
+
+	ts.tv_sec = (time_t)(milliseconds / 1000);
+	ts.tv_nsec = (long)(milliseconds % 1000) * 1000000L;
+	/* the shared futex operations are used, the word is mapped by more than one process */
+	syscall(SYS_futex, hkds_ipc_futex_word(word), FUTEX_WAIT, (uint32_t)value, &ts, NULL, 0);
+}
+
+static void hkds_ipc_futex_wake(volatile uint64_t* word, volatile uint64_t* waiters)
+{
+	qsc_atomics_fetch_add64(word, 1);
+
+	if (qsc_atomics_load64(waiters) != 0)
+	{
+		syscall(SYS_futex, hkds_ipc_futex_word(word), FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+	}
+}
+
+static size_t hkds_ipc_mapping_size(size_t count)
+{
+	return sizeof(hkds_ipc_header) + (count * 2 * sizeof(hkds_ipc_slot));
+}
+
+static void hkds_ipc_map_slots(hkds_ipc_channel* channel)
+{
+	uint8_t* base;
+
+	base = (uint8_t*)channel->header + sizeof(hkds_ipc_header);
+	channel->slots[hkds_ipc_requests] = (hkds_ipc_slot*)base;
+	channel->slots[hkds_ipc_responses] = (hkds_ipc_slot*)(base + ((size_t)channel->header->count * sizeof(hkds_ipc_slot)));
+}
+
+static bool hkds_ipc_readable(const hkds_ipc_channel* channel, hkds_ipc_rings ring)
+{
+	const hkds_ipc_slot* slot;
+	uint64_t pos;
+
+	pos = qsc_atomics_load64(&channel->header->rings[ring].tail);
+	slot = &channel->slots[ring][pos & (channel->header->count - 1)];
+
+	return (qsc_atomics_load64(&slot->sequence) == pos + 1);
+}
+
+static bool hkds_ipc_writable(const hkds_ipc_channel* channel, hkds_ipc_rings ring)
+{
+	const hkds_ipc_slot* slot;
+	uint64_t pos;
+
+	pos = qsc_atomics_load64(&channel->header->rings[ring].head);
+	slot = &channel->slots[ring][pos & (channel->header->count - 1)];
+
+	return (qsc_atomics_load64(&slot->sequence) == pos);
+}
+
+bool hkds_ipc_create(hkds_ipc_channel* channel, const char* name, size_t slots)
+{
+	assert(channel != NULL);
+	assert(name != NULL);
+
+	void* map;
+	size_t count;
+	size_t i;
+	size_t len;
+	int fd;
+	bool res;
+
+	res = false;
+
+	if (channel != NULL && name != NULL && slots != 0 && slots <= HKDS_IPC_SLOTS_MAX &&
+		qsc_stringutils_string_size(name) < HKDS_IPC_NAME_MAX)
+	{
+		qsc_memutils_clear(channel, sizeof(hkds_ipc_channel));
+		count = 2;
+
+		while (count < slots)
+		{
+			count <<= 1;
+		}
+
+		len = hkds_ipc_mapping_size(count);
+		fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+
+		if (fd != -1)
+		{
+			map = MAP_FAILED;
+
+			if (ftruncate(fd, (off_t)len) == 0)
+			{
+				map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			}
+
+			close(fd);
+
+			if (map != MAP_FAILED)
+			{
+				/* the object is zero filled by ftruncate; the slot sequences start at their ring position */
+				channel->header = (hkds_ipc_header*)map;
+				channel->header->count = count;
+				channel->header->size = sizeof(hkds_ipc_slot);
+				hkds_ipc_map_slots(channel);
+
+				for (i = 0; i < count; ++i)
+				{
+					channel->slots[hkds_ipc_requests][i].sequence = i;
+					channel->slots[hkds_ipc_responses][i].sequence = i;
+				}
+
+				qsc_atomics_fence();
+				qsc_atomics_store64(&channel->header->magic, HKDS_IPC_MAGIC);
+				qsc_stringutils_copy_string(channel->name, sizeof(channel->name), name);
+				channel->length = len;
+				channel->owner = true;
+				res = true;
+			}
+			else
+			{
+				shm_unlink(name);
+			}
+		}
+	}
+
+	return res;
+}
+
+bool hkds_ipc_open(hkds_ipc_channel* channel, const char* name)
+{
+	assert(channel != NULL);
+	assert(name != NULL);
+
+	hkds_ipc_header* hdr;
+	void* map;
+	struct stat sb;
+	size_t len;
+	int fd;
+	bool res;
+
+	res = false;
+
+	if (channel != NULL && name != NULL && qsc_stringutils_string_size(name) < HKDS_IPC_NAME_MAX)
+	{
+		qsc_memutils_clear(channel, sizeof(hkds_ipc_channel));
+		fd = shm_open(name, O_RDWR, 0);
+
+		if (fd != -1)
+		{
+			map = MAP_FAILED;
+			len = 0;
+
+			if (fstat(fd, &sb) == 0 && (size_t)sb.st_size >= sizeof(hkds_ipc_header))
+			{
+				len = (size_t)sb.st_size;
+				map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			}
+
+			close(fd);
+
+			if (map != MAP_FAILED)
+			{
+				hdr = (hkds_ipc_header*)map;
+
+				/* the creator and the opener must agree on the layout */
+				if (qsc_atomics_load64(&hdr->magic) == HKDS_IPC_MAGIC && hdr->size == sizeof(hkds_ipc_slot) &&
+					hdr->count >= 2 && hdr->count <= HKDS_IPC_SLOTS_MAX && (hdr->count & (hdr->count - 1)) == 0 &&
+					hkds_ipc_mapping_size((size_t)hdr->count) == len)
+				{
+					channel->header = hdr;
+					hkds_ipc_map_slots(channel);
+					qsc_stringutils_copy_string(channel->name, sizeof(channel->name), name);
+					channel->length = len;
+					channel->owner = false;
+					res = true;
+				}
+				else
+				{
+					munmap(map, len);
+				}
+			}
+		}
+	}
+
+	return res;
+}
+
+void hkds_ipc_close(hkds_ipc_channel* channel)
+{
+	assert(channel != NULL);
+
+	if (channel != NULL && channel->header != NULL)
+	{
+		munmap(channel->header, channel->length);
+
+		if (channel->owner == true)
+		{
+			shm_unlink(channel->name);
+		}
+
+		qsc_memutils_clear(channel, sizeof(hkds_ipc_channel));
+	}
+}
+
+void hkds_ipc_shutdown(hkds_ipc_channel* channel)
+{
+	assert(channel != NULL);
+
+	hkds_ipc_ring* rng;
+	size_t i;
+
+	if (channel != NULL && channel->header != NULL)
+	{
+		qsc_atomics_store64(&channel->header->closed, 1);
+
+		for (i = 0; i < 2; ++i)
+		{
+			rng = &channel->header->rings[i];
+			hkds_ipc_futex_wake(&rng->published, &rng->readers);
+			hkds_ipc_futex_wake(&rng->released, &rng->writers);
+		}
+	}
+}
+
+hkds_ipc_slot* hkds_ipc_reserve(hkds_ipc_channel* channel, hkds_ipc_rings ring)
+{
+	assert(channel != NULL);
+
+	hkds_ipc_ring* rng;
+	hkds_ipc_slot* slot;
+	hkds_ipc_slot* res;
+	uint64_t pos;
+	uint64_t seq;
+	bool done;
+
+	res = NULL;
+
+	if (channel != NULL && channel->header != NULL)
+	{
+		rng = &channel->header->rings[ring];
+		pos = qsc_atomics_load64(&rng->head);
+		done = false;
+
+		/* the slot at the head is free when its sequence equals the position; a smaller sequence is a full ring,
+		and a larger one means another producer claimed the position first */
+		while (done == false)
+		{
+			slot = &channel->slots[ring][pos & (channel->header->count - 1)];
+			seq = qsc_atomics_load64(&slot->sequence);
+
+			if (seq == pos)
+			{
+				if (qsc_atomics_compare_exchange64(&rng->head, &pos, pos + 1) == true)
+				{
+					res = slot;
+					done = true;
+				}
+			}
+			else if ((int64_t)(seq - pos) < 0)
+			{
+				done = true;
+			}
+			else
+			{
+				pos = qsc_atomics_load64(&rng->head);
+			}
+		}
+	}
+
+	return res;
+}
+
+void hkds_ipc_publish(hkds_ipc_channel* channel, hkds_ipc_rings ring, hkds_ipc_slot* slot, size_t length, uint64_t tag)
+{
+	assert(channel != NULL);
+	assert(slot != NULL);
+	assert(length <= HKDS_IPC_SLOT_SIZE);
+
+	hkds_ipc_ring* rng;
+
+	if (channel != NULL && channel->header != NULL && slot != NULL)
+	{
+		rng = &channel->header->rings[ring];
+		slot->length = (uint32_t)((length <= HKDS_IPC_SLOT_SIZE) ? length : HKDS_IPC_SLOT_SIZE);
+		slot->tag = tag;
+		/* the sequence still holds the reserved position; one past it hands the slot to the consumers */
+		qsc_atomics_store64(&slot->sequence, slot->sequence + 1);
+		hkds_ipc_futex_wake(&rng->published, &rng->readers);
+	}
+}
+
+hkds_ipc_slot* hkds_ipc_acquire(hkds_ipc_channel* channel, hkds_ipc_rings ring)
+{
+	assert(channel != NULL);
+
+	hkds_ipc_ring* rng;
+	hkds_ipc_slot* slot;
+	hkds_ipc_slot* res;
+	uint64_t pos;
+	uint64_t seq;
+	bool done;
+
+	res = NULL;
+
+	if (channel != NULL && channel->header != NULL)
+	{
+		rng = &channel->header->rings[ring];
+		pos = qsc_atomics_load64(&rng->tail);
+		done = false;
+
+		while (done == false)
+		{
+			slot = &channel->slots[ring][pos & (channel->header->count - 1)];
+			seq = qsc_atomics_load64(&slot->sequence);
+
+			if (seq == pos + 1)
+			{
+				if (qsc_atomics_compare_exchange64(&rng->tail, &pos, pos + 1) == true)
+				{
+					res = slot;
+					done = true;
+				}
+			}
+			else if ((int64_t)(seq - (pos + 1)) < 0)
+			{
+				done = true;
+			}
+			else
+			{
+				pos = qsc_atomics_load64(&rng->tail);
+			}
+		}
+	}
+
+	return res;
+}
+
+void hkds_ipc_release(hkds_ipc_channel* channel, hkds_ipc_rings ring, hkds_ipc_slot* slot)
+{
+	assert(channel != NULL);
+	assert(slot != NULL);
+
+	hkds_ipc_ring* rng;
+
+	if (channel != NULL && channel->header != NULL && slot != NULL)
+	{
+		rng = &channel->header->rings[ring];
+		/* the sequence holds the read position plus one; the slot is next written one lap later */
+		qsc_atomics_store64(&slot->sequence, slot->sequence + channel->header->count - 1);
+		hkds_ipc_futex_wake(&rng->released, &rng->writers);
+	}
+}
+
+bool hkds_ipc_wait_readable(hkds_ipc_channel* channel, hkds_ipc_rings ring, uint32_t milliseconds)
+{
+	assert(channel != NULL);
+
+	hkds_ipc_ring* rng;
+	uint64_t val;
+	bool res;
+
+	res = false;
+
+	if (channel != NULL && channel->header != NULL)
+	{
+		rng = &channel->header->rings[ring];
+		/* the counter is read before the ring is checked, so a record published after the check changes
+		the futex word and the wait returns at once */
+		val = qsc_atomics_load64(&rng->published);
+		qsc_atomics_fetch_add64(&rng->readers, 1);
+		res = hkds_ipc_readable(channel, ring);
+
+		if (res == false && qsc_atomics_load64(&channel->header->closed) == 0)
+		{
+			hkds_ipc_futex_wait(&rng->published, val, milliseconds);
+			res = hkds_ipc_readable(channel, ring);
+		}
+
+		qsc_atomics_fetch_add64(&rng->readers, (uint64_t)-1);
+	}
+
+	return res;
+}
+
+bool hkds_ipc_wait_writable(hkds_ipc_channel* channel, hkds_ipc_rings ring, uint32_t milliseconds)
+{
+	assert(channel != NULL);
+
+	hkds_ipc_ring* rng;
+	uint64_t val;
+	bool res;
+
+	res = false;
+
+	if (channel != NULL && channel->header != NULL)
+	{
+		rng = &channel->header->rings[ring];
+		val = qsc_atomics_load64(&rng->released);
+		qsc_atomics_fetch_add64(&rng->writers, 1);
+		res = hkds_ipc_writable(channel, ring);
+
+		if (res == false && qsc_atomics_load64(&channel->header->closed) == 0)
+		{
+			hkds_ipc_futex_wait(&rng->released, val, milliseconds);
+			res = hkds_ipc_writable(channel, ring);
+		}
+
+		qsc_atomics_fetch_add64(&rng->writers, (uint64_t)-1);
+	}
+
+	return res;
+}
+
+static hkds_ipc_slot* hkds_ipc_serve_reserve(hkds_ipc_channel* channel)
+{
+	hkds_ipc_slot* res;
+
+	res = hkds_ipc_reserve(channel, hkds_ipc_responses);
+
+	while (res == NULL && qsc_atomics_load64(&channel->header->closed) == 0)
+	{
+		hkds_ipc_wait_writable(channel, hkds_ipc_responses, HKDS_IPC_POLL_INTERVAL);
+		res = hkds_ipc_reserve(channel, hkds_ipc_responses);
+	}
+
+	return res;
+}
+
+size_t hkds_ipc_serve(hkds_ipc_channel* channel, hkds_network_state* server, uint32_t milliseconds)
+{
+	assert(channel != NULL);
+	assert(server != NULL);
+
+	uint8_t emsg[HKDS_ERROR_SIZE] = { 0 };
+	hkds_response_batch rsp;
+	hkds_ipc_slot* rslot;
+	hkds_ipc_slot* wslot;
+	uint64_t tag;
+	size_t len;
+	size_t pos;
+	size_t res;
+	size_t used;
+	bool done;
+
+	res = 0;
+
+	if (channel != NULL && channel->header != NULL && server != NULL && server->mdk != NULL)
+	{
+		hkds_ipc_wait_readable(channel, hkds_ipc_requests, milliseconds);
+		rslot = hkds_ipc_acquire(channel, hkds_ipc_requests);
+
+		while (rslot != NULL)
+		{
+			/* the front end can still write the shared mapping, so the record is copied to private memory before it is parsed */
+			len = rslot->length;
+			len = (len <= HKDS_IPC_SLOT_SIZE) ? len : HKDS_IPC_SLOT_SIZE;
+			tag = rslot->tag;
+			qsc_memutils_copy(channel->request, rslot->data, len);
+			hkds_ipc_release(channel, hkds_ipc_requests, rslot);
+			pos = 0;
+			done = false;
+
+			/* a record holding more than one wire batch of packets is answered with a response record for each batch */
+			while (done == false)
+			{
+				wslot = hkds_ipc_serve_reserve(channel);
+
+				if (wslot != NULL)
+				{
+					hkds_response_initialize(&rsp, wslot->data, HKDS_IPC_SLOT_SIZE, hkds_response_contiguous);
+					used = hkds_network_process(server, channel->request + pos, len - pos, &rsp);
+					pos += used;
+
+					if (used == 0 && pos < len)
+					{
+						/* a record holds whole packets, so a remainder that is not a complete packet is malformed */
+						emsg[0] = HKDS_SEQUENCE_NONE;
+						hkds_response_add_error(&rsp, emsg, error_invalid_format);
+						qsc_atomics_fetch_add64(&server->rejected, 1);
+						pos = len;
+					}
+
+					hkds_ipc_publish(channel, hkds_ipc_responses, wslot, rsp.length, tag);
+				}
+
+				done = (wslot == NULL || pos >= len);
+			}
+
+			++res;
+			rslot = (wslot != NULL) ? hkds_ipc_acquire(channel, hkds_ipc_requests) : NULL;
+		}
+	}
+
+	return res;
+}
+
+#else
+
+bool hkds_ipc_create(hkds_ipc_channel* channel, const char* name, size_t slots)
+{
+	(void)name;
+	(void)slots;
+
+	if (channel != NULL)
+	{
+		qsc_memutils_clear(channel, sizeof(hkds_ipc_channel));
+	}
+
+	return false;
+}
+
+bool hkds_ipc_open(hkds_ipc_channel* channel, const char* name)
+{
+	(void)name;
+
+	if (channel != NULL)
+	{
+		qsc_memutils_clear(channel, sizeof(hkds_ipc_channel));
+	}
+
+	return false;
+}
+
+void hkds_ipc_close(hkds_ipc_channel* channel)
+{
+	(void)channel;
+}
+
+void hkds_ipc_shutdown(hkds_ipc_channel* channel)
+{
+	(void)channel;
+}
+
+hkds_ipc_slot* hkds_ipc_reserve(hkds_ipc_channel* channel, hkds_ipc_rings ring)
+{
+	(void)channel;
+	(void)ring;
+
+	return NULL;
+}
+
+void hkds_ipc_publish(hkds_ipc_channel* channel, hkds_ipc_rings ring, hkds_ipc_slot* slot, size_t length, uint64_t tag)
+{
+	(void)channel;
+	(void)ring;
+	(void)slot;
+	(void)length;
+	(void)tag;
+}
+
+hkds_ipc_slot* hkds_ipc_acquire(hkds_ipc_channel* channel, hkds_ipc_rings ring)
+{
+	(void)channel;
+	(void)ring;
+
+	return NULL;
+}
+
+void hkds_ipc_release(hkds_ipc_channel* channel, hkds_ipc_rings ring, hkds_ipc_slot* slot)
+{
+	(void)channel;
+	(void)ring;
+	(void)slot;
+}
+
+bool hkds_ipc_wait_readable(hkds_ipc_channel* channel, hkds_ipc_rings ring, uint32_t milliseconds)
+{
+	(void)channel;
+	(void)ring;
+	(void)milliseconds;
+
+	return false;
+}
+
+bool hkds_ipc_wait_writable(hkds_ipc_channel* channel, hkds_ipc_rings ring, uint32_t milliseconds)
+{
+	(void)channel;
+	(void)ring;
+	(void)milliseconds;
+
+	return false;
+}
+
+size_t hkds_ipc_serve(hkds_ipc_channel* channel, hkds_network_state* server, uint32_t milliseconds)
+{
+	(void)channel;
+	(void)server;
+	(void)milliseconds;
+
+	return 0;
+}
+
+#endif
@@ -0,0 +1,246 @@
+/* 2021 Digital Freedom Defense Incorporated
+ * All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Digital Freedom Defense Incorporated.
+ * The intellectual and technical concepts contained
+ * herein are proprietary to Digital Freedom Defense Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Digital Freedom Defense Incorporated.
+ *
+ * Contact: develop@dfdef.com
+ */
+
+
+#ifndef HKDS_IPC_H
+#define HKDS_IPC_H
+
+#include "common.h"
+#include "hkds_config.h"
+#include "hkds_network.h"
+#include "hkds_response.h"
+#include "hkds_wire.h"
+
+/* Shared memory channel between a network front end and a crypto engine process.
+* The front end holds the terminal connections and no keys, and the engine holds the master key set and no sockets,
+* so a compromise of the network facing process does not expose the keys. The two processes share a mapped channel
+* holding a request ring and a response ring; each ring is an array of fixed size slots with a sequence number in
+* each slot, so any number of producers and consumers can use a ring without locks, and a single producer and consumer pair
+* pays only the sequence exchange. A record is written and read in place: the producer reserves a slot, writes
+* the packets into it and publishes it, and the consumer reads the packets from the slot and then releases it.
+* The engine copies each request record into its own memory before it parses it, since the front end can still write
+* the shared mapping, then decrypts the requests in SIMD groups and writes the responses directly into a response slot.
+* A request record holds one or more whole packets and carries a tag chosen by the front end,
+* a connection identifier for example, that is returned with the response record; a record holding more packets than
+* one wire batch is answered with a response record for each batch.
+* A process waiting for a ring sleeps on a futex in the shared mapping, and is woken only when a record is published or released
+* while it is waiting. The channel is supported on Linux. */
+
+/*!
+\def HKDS_IPC_NAME_MAX
+* The maximum length of a channel name, including the terminating null
+*/
+#define HKDS_IPC_NAME_MAX 64
+
+/*!
+\def HKDS_IPC_SLOTS_MAX
+* The maximum number of slots in each ring
+*/
+#define HKDS_IPC_SLOTS_MAX 4096
+
+/*!
+\def HKDS_IPC_REQUEST_SIZE
+* The size of a request record holding a full wire batch of the largest request
+*/
+#define HKDS_IPC_REQUEST_SIZE (HKDS_WIRE_BATCH_MAX * HKDS_CLIENT_MESSAGE_REQUEST_SIZE)
+
+/*!
+\def HKDS_IPC_SLOT_SIZE
+* The size of the data in a slot; holds a request or a response record, rounded to the cache line size
+*/
+#define HKDS_IPC_SLOT_SIZE ((((HKDS_IPC_REQUEST_SIZE > HKDS_RESPONSE_BUFFER_SIZE) ? HKDS_IPC_REQUEST_SIZE : HKDS_RESPONSE_BUFFER_SIZE) + 63) & ~(size_t)63)
+
+/*!
+\def HKDS_IPC_POLL_INTERVAL
+* The time in milliseconds the engine waits for a free response slot before it checks whether the channel is closed
+*/
+#define HKDS_IPC_POLL_INTERVAL 50
+
+/*! \enum hkds_ipc_rings
+* The rings of a channel
+*/
+HKDS_EXPORT_API typedef enum
+{
+	hkds_ipc_requests = 0x00,			/*!< The request ring, written by the front end and read by the engine */
+	hkds_ipc_responses = 0x01,			/*!< The response ring, written by the engine and read by the front end */
+} hkds_ipc_rings;
+
+/*! \struct hkds_ipc_slot
+* A ring slot in the shared mapping
+*/
+HKDS_EXPORT_API typedef struct
+{
+	volatile uint64_t sequence;			/*!< The slot sequence, the ring position the slot is next written or read at */
+	uint64_t tag;						/*!< The record tag */
+	uint32_t length;					/*!< The record length */
+	uint8_t padding[44];				/*!< Aligns the data to the cache line */
+	uint8_t data[HKDS_IPC_SLOT_SIZE];	/*!< The record data */
+} hkds_ipc_slot;
+
+/*! \struct hkds_ipc_ring
+* The ring positions and wakeup words in the shared mapping; each group has its own cache line
+*/
+HKDS_EXPORT_API typedef struct
+{
+	volatile uint64_t head;				/*!< The next position written */
+	uint8_t hpad[56];					/*!< Head padding */
+	volatile uint64_t tail;				/*!< The next position read */
+	uint8_t tpad[56];					/*!< Tail padding */
+	volatile uint64_t published;		/*!< The futex word advanced when a record is published */
+	volatile uint64_t readers;			/*!< The number of processes waiting for a record */
+	volatile uint64_t released;			/*!< The futex word advanced when a slot is released */
+	volatile uint64_t writers;			/*!< The number of processes waiting for a free slot */
+	uint8_t wpad[32];					/*!< Wakeup padding */
+} hkds_ipc_ring;
+
+/*! \struct hkds_ipc_header
+* The channel header at the start of the shared mapping
+*/
+HKDS_EXPORT_API typedef struct
+{
+	uint64_t magic;						/*!< The channel identifier, written last by the creator */
+	uint64_t count;						/*!< The number of slots in each ring */
+	uint64_t size;						/*!< The size of a slot */
+	volatile uint64_t closed;			/*!< The channel has been closed */
+	uint8_t padding[32];				/*!< Header padding */
+	hkds_ipc_ring rings[2];				/*!< The request and response rings */
+} hkds_ipc_header;
+
+/*! \struct hkds_ipc_channel
+* Contains a processes view of a channel
+*/
+HKDS_EXPORT_API typedef struct
+{
+	char name[HKDS_IPC_NAME_MAX];		/*!< The shared memory object name */
+	hkds_ipc_header* header;			/*!< The mapped channel header */
+	hkds_ipc_slot* slots[2];			/*!< The mapped request and response slots */
+	uint8_t request[HKDS_IPC_SLOT_SIZE];	/*!< The engines private copy of the request record being served */
+	size_t length;						/*!< The length of the mapping */
+	bool owner;							/*!< The channel was created by this process */
+} hkds_ipc_channel;
+
+/**
+* \brief Create a channel, and map it into the calling process.
+* The name is a shared memory object name beginning with a slash; creation fails if the object exists.
+*
+* \param channel [struct] The channel
+* \param name [string][const] The shared memory object name
+* \param slots [size] The number of slots in each ring, rounded up to a power of two, at most HKDS_IPC_SLOTS_MAX
+* \return [bool] Returns true if the channel was created
+*/
+HKDS_EXPORT_API bool hkds_ipc_create(hkds_ipc_channel* channel, const char* name, size_t slots);
+
+/**
+* \brief Map an existing channel into the calling process
+*
+* \param channel [struct] The channel
+* \param name [string][const] The shared memory object name
+* \return [bool] Returns true if the channel was opened and its header is valid
+*/
+HKDS_EXPORT_API bool hkds_ipc_open(hkds_ipc_channel* channel, const char* name);
+
+/**
+* \brief Unmap the channel; the creating process also removes the shared memory object.
+* The processes still mapping the channel keep their mapping until they close it.
+*
+* \param channel [struct] The channel
+*/
+HKDS_EXPORT_API void hkds_ipc_close(hkds_ipc_channel* channel);
+
+/**
+* \brief Mark the channel as closed, and wake every waiting process.
+* A closed channel no longer blocks in the wait functions; the records already published can still be read.
+*
+* \param channel [struct] The channel
+*/
+HKDS_EXPORT_API void hkds_ipc_shutdown(hkds_ipc_channel* channel);
+
+/**
+* \brief Reserve the next free slot of a ring for writing
+*
+* \param channel [struct] The channel
+* \param ring [enum] The ring written
+* \return [struct] Returns the slot, or NULL if the ring is full
+*/
+HKDS_EXPORT_API hkds_ipc_slot* hkds_ipc_reserve(hkds_ipc_channel* channel, hkds_ipc_rings ring);
+
+/**
+* \brief Publish a reserved slot, making its record visible to the consumers
+*
+* \param channel [struct] The channel
+* \param ring [enum] The ring written
+* \param slot [struct] The reserved slot, holding the record in its data array
+* \param length [size] The record length, at most HKDS_IPC_SLOT_SIZE
+* \param tag [uint64] The record tag
+*/
+HKDS_EXPORT_API void hkds_ipc_publish(hkds_ipc_channel* channel, hkds_ipc_rings ring, hkds_ipc_slot* slot, size_t length, uint64_t tag);
+
+/**
+* \brief Acquire the next published record of a ring for reading in place
+*
+* \param channel [struct] The channel
+* \param ring [enum] The ring read
+* \return [struct] Returns the slot, or NULL if the ring is empty
+*/
+HKDS_EXPORT_API hkds_ipc_slot* hkds_ipc_acquire(hkds_ipc_channel* channel, hkds_ipc_rings ring);
+
+/**
+* \brief Release an acquired slot, returning it to the producers
+*
+* \param channel [struct] The channel
+* \param ring [enum] The ring read
+* \param slot [struct] The acquired slot
+*/
+HKDS_EXPORT_API void hkds_ipc_release(hkds_ipc_channel* channel, hkds_ipc_rings ring, hkds_ipc_slot* slot);
+
+/**
+* \brief Wait for a record to be published to a ring.
+* Returns immediately if the ring holds a record or the channel is closed; may return early if the wait is interrupted.
+*
+* \param channel [struct] The channel
+* \param ring [enum] The ring read
+* \param milliseconds [uint32] The maximum wait time in milliseconds
+* \return [bool] Returns true if the ring holds a record
+*/
+HKDS_EXPORT_API bool hkds_ipc_wait_readable(hkds_ipc_channel* channel, hkds_ipc_rings ring, uint32_t milliseconds);
+
+/**
+* \brief Wait for a slot of a ring to be released.
+* Returns immediately if the ring has a free slot or the channel is closed; may return early if the wait is interrupted.
+*
+* \param channel [struct] The channel
+* \param ring [enum] The ring written
+* \param milliseconds [uint32] The maximum wait time in milliseconds
+* \return [bool] Returns true if the ring has a free slot
+*/
+HKDS_EXPORT_API bool hkds_ipc_wait_writable(hkds_ipc_channel* channel, hkds_ipc_rings ring, uint32_t milliseconds);
+
+/**
+* \brief Serve the request ring from the engine process.
+* Waits for a request record, then processes the records in the ring until it is empty: each record is copied from its slot,
+* its packets are parsed and decrypted one wire batch at a time, and the responses of each batch are written into a response slot
+* and published with the tag of the request. A trailing incomplete packet is answered with an error_invalid_format message.
+* The engine waits for a free response slot while the front end is collecting responses, and discards a request
+* if the channel is closed while it waits.
+*
+* \param channel [struct] The channel
+* \param server [struct] The server state; only the master key set and the request counters are used, the server is not started
+* \param milliseconds [uint32] The maximum wait time for the first request record in milliseconds
+* \return [size] The number of request records served
+*/
+HKDS_EXPORT_API size_t hkds_ipc_serve(hkds_ipc_channel* channel, hkds_network_state* server, uint32_t milliseconds);
+
+#endif
@@ -0,0 +1,263 @@
+#include "hkds_jobs.h"
+#include "../QSC/intutils.h"
+#include "../QSC/memutils.h"
+#include "../QSC/timerex.h"
+
+/* the key serial number begins with the key identity, followed by the protocol id */
+#define HKDS_JOBS_PID_OFFSET HKDS_KID_SIZE
+
+static hkds_master_key* hkds_jobs_key(const hkds_jobs_state* state, const uint8_t* ksn)
+{
+	hkds_master_key* res;
+
+	res = NULL;
+
+	for (size_t i = 0; i < state->kcount; ++i)
+	{
+		if (qsc_intutils_are_equal8(state->keys[i]->kid, ksn, HKDS_KID_SIZE) == true)
+		{
+			res = state->keys[i];
+			break;
+		}
+	}
+
+	return res;
+}
+
+static void hkds_jobs_execute(hkds_jobs_state* state, hkds_jobs_class* cls)
+{
+	hkds_async_completion cpls[HKDS_CACHX8_DEPTH];
+	size_t index[HKDS_CACHX8_DEPTH];
+	size_t count;
+
+	count = cls->count;
+	qsc_memutils_clear((uint8_t*)cpls, sizeof(cpls));
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		index[i] = i;
+		cpls[i].token = cls->jobs[i].token;
+		cpls[i].operation = cls->jobs[i].operation;
+	}
+
+	hkds_async_execute_group(cls->mdk, cls->jobs, index, count, cpls);
+
+	/* a padded x8 call computes every lane, smaller groups are executed one at a time */
+	state->lanes += (count >= HKDS_ASYNC_PAD_MINIMUM) ? HKDS_CACHX8_DEPTH : count;
+	state->used += count;
+	cls->count = 0;
+	qsc_memutils_clear((uint8_t*)cls->jobs, count * sizeof(hkds_async_request));
+	state->callback(state->context, cpls, count);
+	qsc_memutils_clear((uint8_t*)cpls, sizeof(cpls));
+}
+
+static hkds_jobs_class* hkds_jobs_class_select(hkds_jobs_state* state, hkds_master_key* mdk, const hkds_async_request* request)
+{
+	hkds_jobs_class* cls;
+	hkds_jobs_class* res;
+
+	res = NULL;
+	cls = NULL;
+
+	for (size_t i = 0; i < HKDS_JOBS_CLASSES_MAX; ++i)
+	{
+		if (state->classes[i].count == 0)
+		{
+			if (cls == NULL)
+			{
+				cls = &state->classes[i];
+			}
+		}
+		else if (state->classes[i].mdk == mdk && state->classes[i].operation == request->operation &&
+			state->classes[i].pid == request->ksn[HKDS_JOBS_PID_OFFSET] &&
+			(request->operation != hkds_async_decrypt_verify || state->classes[i].datalen == request->datalen))
+		{
+			res = &state->classes[i];
+			break;
+		}
+	}
+
+	if (res == NULL)
+	{
+		if (cls == NULL)
+		{
+			/* every slot is in use, flush the class with the oldest job */
+			cls = &state->classes[0];
+
+			for (size_t i = 1; i < HKDS_JOBS_CLASSES_MAX; ++i)
+			{
+				if (state->classes[i].arrival < cls->arrival)
+				{
+					cls = &state->classes[i];
+				}
+			}
+
+			hkds_jobs_execute(state, cls);
+		}
+
+		cls->mdk = mdk;
+		cls->operation = request->operation;
+		cls->pid = request->ksn[HKDS_JOBS_PID_OFFSET];
+		cls->datalen = (request->operation == hkds_async_decrypt_verify) ? request->datalen : 0;
+		res = cls;
+	}
+
+	return res;
+}
+
+void hkds_jobs_initialize(hkds_jobs_state* state, hkds_master_key* keys[], size_t kcount, uint64_t timeout,
+	hkds_async_callback callback, void* context)
+{
+	assert(state != NULL);
+	assert(keys != NULL);
+	assert(kcount != 0);
+	assert(callback != NULL);
+
+	qsc_memutils_clear((uint8_t*)state, sizeof(hkds_jobs_state));
+	state->kcount = (kcount <= HKDS_JOBS_KEYS_MAX) ? kcount : HKDS_JOBS_KEYS_MAX;
+
+	for (size_t i = 0; i < state->kcount; ++i)
+	{
+		state->keys[i] = keys[i];
+	}
+
+	state->callback = callback;
+	state->context = context;
+	state->timeout = (timeout != 0) ? timeout : HKDS_JOBS_TIMEOUT_DEFAULT;
+}
+
+void hkds_jobs_dispose(hkds_jobs_state* state)
+{
+	assert(state != NULL);
+
+	if (state != NULL)
+	{
+		qsc_memutils_clear((uint8_t*)state, sizeof(hkds_jobs_state));
+	}
+}
+
+bool hkds_jobs_submit(hkds_jobs_state* state, const hkds_async_request* request)
+{
+	assert(state != NULL);
+	assert(request != NULL);
+
+	hkds_jobs_class* cls;
+	hkds_master_key* mdk;
+	bool res;
+
+	res = false;
+
+	if (state != NULL && request != NULL && request->operation != hkds_async_none && request->datalen <= HKDS_MESSAGE_SIZE)
+	{
+		mdk = hkds_jobs_key(state, request->ksn);
+
+		if (mdk != NULL)
+		{
+			cls = hkds_jobs_class_select(state, mdk, request);
+
+			if (cls->count == 0)
+			{
+				cls->arrival = qsc_timerex_monotonic_microseconds();
+			}
+
+			qsc_memutils_copy((uint8_t*)&cls->jobs[cls->count], (const uint8_t*)request, sizeof(hkds_async_request));
+			++cls->count;
+
+			if (cls->count == HKDS_CACHX8_DEPTH)
+			{
+				hkds_jobs_execute(state, cls);
+			}
+
+			res = true;
+		}
+	}
+
+	return res;
+}
+
+size_t hkds_jobs_flush(hkds_jobs_state* state, bool force)
+{
+	assert(state != NULL);
+
+	uint64_t now;
+	size_t res;
+
+	res = 0;
+	now = qsc_timerex_monotonic_microseconds();
+
+	for (size_t i = 0; i < HKDS_JOBS_CLASSES_MAX; ++i)
+	{
+		if (state->classes[i].count != 0 && (force == true || now - state->classes[i].arrival >= state->timeout))
+		{
+			res += state->classes[i].count;
+			hkds_jobs_execute(state, &state->classes[i]);
+		}
+	}
+
+	return res;
+}
+
+size_t hkds_jobs_pending(const hkds_jobs_state* state)
+{
+	assert(state != NULL);
+
+	size_t res;
+
+	res = 0;
+
+	for (size_t i = 0; i < HKDS_JOBS_CLASSES_MAX; ++i)
+	{
+		res += state->classes[i].count;
+	}
+
+	return res;
+}
+
+uint64_t hkds_jobs_wait_time(const hkds_jobs_state* state)
+{
+	assert(state != NULL);
+
+	uint64_t elapsed;
+	uint64_t now;
+	uint64_t res;
+
+	res = UINT64_MAX;
+	now = qsc_timerex_monotonic_microseconds();
+
+	for (size_t i = 0; i < HKDS_JOBS_CLASSES_MAX; ++i)
+	{
+		if (state->classes[i].count != 0)
+		{
+			elapsed = now - state->classes[i].arrival;
+
+			if (elapsed >= state->timeout)
+			{
+				res = 0;
+				break;
+			}
+
+			if (state->timeout - elapsed < res)
+			{
+				res = state->timeout - elapsed;
+			}
+		}
+	}
+
+	return res;
+}
+
+uint32_t hkds_jobs_utilization(const hkds_jobs_state* state)
+{
+	assert(state != NULL);
+
+	uint32_t res;
+
+	res = 0;
+
+	if (state->lanes != 0)
+	{
+		res = (uint32_t)((state->used * 100) / state->lanes);
+	}
+
+	return res;
+}
@@ -0,0 +1,146 @@
+/* 2021 Digital Freedom Defense Incorporated
+ * All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Digital Freedom Defense Incorporated.
+ * The intellectual and technical concepts contained
+ * herein are proprietary to Digital Freedom Defense Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Digital Freedom Defense Incorporated.
+ *
+ * Contact: develop@dfdef.com
+ */
+
+#ifndef HKDS_JOBS_H
+#define HKDS_JOBS_H
+
+#include "common.h"
+#include "hkds_async.h"
+#include "hkds_config.h"
+#include "hkds_server.h"
+
+/* Lane packing job manager.
+* The x8 server functions require every lane to use the same master key and operation,
+* and verified messages to share an additional data length.
+* The job manager keeps a sub-queue for each class of request, keyed by the key identity and protocol id
+* of the key serial number, the operation, and the additional data length.
+* A class is executed with an x8 call as soon as it holds eight jobs, so mixed traffic fills every lane.
+* Classes that do not fill are flushed when their oldest job has waited for the timeout; a straggler
+* group of at least HKDS_ASYNC_PAD_MINIMUM jobs is executed with a padded x8 call, smaller groups one at a time.
+* When every class slot is in use, the class with the oldest job is flushed to make room for a new class.
+* Completions are passed to the callback on the thread that submits or flushes the jobs.
+* The job manager is not thread safe; use one manager per server thread. */
+
+/*!
+\def HKDS_JOBS_CLASSES_MAX
+* The maximum number of request classes with pending jobs
+*/
+#define HKDS_JOBS_CLASSES_MAX 32
+
+/*!
+\def HKDS_JOBS_KEYS_MAX
+* The maximum number of master keys served by a job manager
+*/
+#define HKDS_JOBS_KEYS_MAX 16
+
+/*!
+\def HKDS_JOBS_TIMEOUT_DEFAULT
+* The default straggler timeout in microseconds
+*/
+#define HKDS_JOBS_TIMEOUT_DEFAULT 500ULL
+
+/*! \struct hkds_jobs_class
+* A request class and its pending jobs
+*/
+HKDS_EXPORT_API typedef struct
+{
+	hkds_async_request jobs[HKDS_CACHX8_DEPTH];		/*!< The pending jobs */
+	hkds_master_key* mdk;							/*!< The master key of the class */
+	uint64_t arrival;								/*!< The arrival time of the oldest job in microseconds */
+	size_t count;									/*!< The number of pending jobs */
+	size_t datalen;									/*!< The additional data length of verified messages */
+	hkds_async_operations operation;				/*!< The class operation */
+	uint8_t pid;									/*!< The class protocol id */
+} hkds_jobs_class;
+
+/*! \struct hkds_jobs_state
+* Contains the job manager state
+*/
+HKDS_EXPORT_API typedef struct
+{
+	hkds_jobs_class classes[HKDS_JOBS_CLASSES_MAX];	/*!< The request classes */
+	hkds_master_key* keys[HKDS_JOBS_KEYS_MAX];		/*!< The master keys, selected by the key identity of a request */
+	hkds_async_callback callback;					/*!< The completion callback */
+	void* context;									/*!< The completion callback context */
+	uint64_t timeout;								/*!< The straggler timeout in microseconds */
+	uint64_t lanes;									/*!< The number of SIMD lanes computed */
+	uint64_t used;									/*!< The number of SIMD lanes that carried a job */
+	size_t kcount;									/*!< The number of master keys */
+} hkds_jobs_state;
+
+/**
+* \brief Initialize the job manager
+*
+* \param state [struct] The job manager state
+* \param keys [array] The master keys, up to HKDS_JOBS_KEYS_MAX
+* \param kcount [size] The number of master keys
+* \param timeout [uint64] The straggler timeout in microseconds, zero selects HKDS_JOBS_TIMEOUT_DEFAULT
+* \param callback [pointer] The completion callback
+* \param context [pointer] The callback context
+*/
+HKDS_EXPORT_API void hkds_jobs_initialize(hkds_jobs_state* state, hkds_master_key* keys[], size_t kcount, uint64_t timeout,
+	hkds_async_callback callback, void* context);
+
+/**
+* \brief Erase the job manager state; pending jobs are discarded
+*
+* \param state [struct] The job manager state
+*/
+HKDS_EXPORT_API void hkds_jobs_dispose(hkds_jobs_state* state);
+
+/**
+* \brief Add a job to its class, and execute the class if it has filled the SIMD lanes
+*
+* \param state [struct] The job manager state
+* \param request [struct][const] The request
+* \return [bool] Returns false if the request is invalid, or no master key matches its key identity
+*/
+HKDS_EXPORT_API bool hkds_jobs_submit(hkds_jobs_state* state, const hkds_async_request* request);
+
+/**
+* \brief Execute the classes whose oldest job has waited for the timeout
+*
+* \param state [struct] The job manager state
+* \param force [bool] Execute every pending job regardless of the timeout
+* \return [size] The number of jobs executed
+*/
+HKDS_EXPORT_API size_t hkds_jobs_flush(hkds_jobs_state* state, bool force);
+
+/**
+* \brief Get the number of pending jobs
+*
+* \param state [struct][const] The job manager state
+* \return [size] The number of jobs waiting in all classes
+*/
+HKDS_EXPORT_API size_t hkds_jobs_pending(const hkds_jobs_state* state);
+
+/**
+* \brief Get the time until the next class is due to be flushed
+*
+* \param state [struct][const] The job manager state
+* \return [uint64] The wait time in microseconds, zero if a class is due, UINT64_MAX if no jobs are pending
+*/
+HKDS_EXPORT_API uint64_t hkds_jobs_wait_time(const hkds_jobs_state* state);
+
+/**
+* \brief Get the percentage of computed SIMD lanes that carried a job
+*
+* \param state [struct][const] The job manager state
+* \return [uint32] The lane utilization percentage
+*/
+HKDS_EXPORT_API uint32_t hkds_jobs_utilization(const hkds_jobs_state* state);
+
+#endif
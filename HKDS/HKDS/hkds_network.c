@@ -0,0 +1,283 @@
+#include "hkds_network.h"
+#include "hkds_wire.h"
+#include "../QSC/async.h"
+#include "../QSC/atomics.h"
+#include "../QSC/memutils.h"
+#include "../QSC/socketserver.h"
+
+static size_t hkds_network_receive(void* context, qsc_reactor_connection* connection, const uint8_t* input, size_t inlen)
+{
+	uint8_t obuf[HKDS_RESPONSE_BUFFER_SIZE];
+	hkds_network_state* state;
+	hkds_response_batch rsp;
+	size_t pos;
+	size_t used;
+
+	state = (hkds_network_state*)context;
+	pos = 0;
+	used = 1;
+
+	/* a receive may hold more packets than one batch */
+	while (used != 0 && connection->closing == false)
+	{
+		hkds_response_initialize(&rsp, obuf, sizeof(obuf), hkds_response_contiguous);
+		used = hkds_network_process(state, input + pos, inlen - pos, &rsp);
+		pos += used;
+
+		if (rsp.count != 0)
+		{
+			qsc_reactor_send(connection, obuf, rsp.length);
+		}
+	}
+
+	return pos;
+}
+
+void hkds_network_request(const hkds_wire_batch* batch, size_t index, hkds_async_request* request)
+{
+	assert(batch != NULL);
+	assert(request != NULL);
+
+	if (batch != NULL && request != NULL && index < batch->count)
+	{
+		request->token = index;
+		request->datalen = 0;
+		qsc_memutils_copy(request->ksn, batch->ksn[index], HKDS_KSN_SIZE);
+
+		if (batch->type[index] == packet_token_request)
+		{
+			request->operation = hkds_async_encrypt_token;
+		}
+		else
+		{
+			qsc_memutils_copy(request->message, batch->message[index], HKDS_MESSAGE_SIZE);
+
+			if (batch->tag[index] != NULL)
+			{
+				qsc_memutils_copy(request->message + HKDS_MESSAGE_SIZE, batch->tag[index], HKDS_TAG_SIZE);
+				request->operation = hkds_async_decrypt_verify;
+			}
+			else
+			{
+				request->operation = hkds_async_decrypt;
+			}
+		}
+	}
+}
+
+void hkds_network_execute(hkds_master_key* mdk, const hkds_async_request* requests, size_t count, hkds_async_completion* completions, size_t* order)
+{
+	assert(mdk != NULL);
+	assert(requests != NULL);
+	assert(completions != NULL);
+
+	size_t index[3][HKDS_WIRE_BATCH_MAX];
+	size_t counts[3] = { 0 };
+	size_t i;
+	size_t op;
+	size_t pos;
+
+	pos = 0;
+
+	if (mdk != NULL && requests != NULL && completions != NULL)
+	{
+		count = (count > HKDS_WIRE_BATCH_MAX) ? HKDS_WIRE_BATCH_MAX : count;
+
+		/* group the requests by operation; the group index is the operation minus one */
+		for (i = 0; i < count; ++i)
+		{
+			if (requests[i].operation != hkds_async_none)
+			{
+				op = (size_t)requests[i].operation - 1;
+				index[op][counts[op]] = i;
+				++counts[op];
+				completions[i].token = requests[i].token;
+				completions[i].operation = requests[i].operation;
+			}
+		}
+
+		for (op = 0; op < 3; ++op)
+		{
+			if (counts[op] != 0)
+			{
+				hkds_async_execute_group(mdk, requests, index[op], counts[op], completions);
+
+				/* the group is complete; its requests are ordered before the groups that follow it */
+				if (order != NULL)
+				{
+					qsc_memutils_copy(order + pos, index[op], counts[op] * sizeof(size_t));
+					pos += counts[op];
+				}
+			}
+		}
+	}
+}
+
+size_t hkds_network_process(hkds_network_state* state, const uint8_t* input, size_t inlen, hkds_response_batch* responses)
+{
+	assert(state != NULL);
+	assert(input != NULL);
+	assert(responses != NULL);
+
+	uint8_t emsg[HKDS_ERROR_SIZE] = { 0 };
+	hkds_async_request reqs[HKDS_WIRE_BATCH_MAX];
+	hkds_async_completion cmps[HKDS_WIRE_BATCH_MAX];
+	size_t order[HKDS_WIRE_BATCH_MAX];
+	hkds_wire_batch batch;
+	size_t i;
+	size_t k;
+	size_t used;
+
+	used = hkds_wire_parse_batch(&batch, input, inlen);
+
+	for (i = 0; i < batch.count; ++i)
+	{
+		hkds_network_request(&batch, i, &reqs[i]);
+	}
+
+	hkds_network_execute(state->mdk, reqs, batch.count, cmps, order);
+
+	/* the responses are added in the order the groups were executed, each echoes the sequence of its request */
+	for (i = 0; i < batch.count; ++i)
+	{
+		k = order[i];
+		hkds_response_add_completion(responses, &cmps[k], reqs[k].ksn, hkds_wire_batch_sequence(&batch, k));
+	}
+
+	emsg[0] = HKDS_SEQUENCE_NONE;
+
+	for (i = 0; i < batch.rejected; ++i)
+	{
+		hkds_response_add_error(responses, emsg, error_invalid_format);
+	}
+
+	qsc_atomics_fetch_add64(&state->requests, batch.count);
+	qsc_atomics_fetch_add64(&state->rejected, batch.rejected);
+
+	return used;
+}
+
+bool hkds_network_start(hkds_network_state* state, hkds_master_key* mdk, const char* address, uint16_t port,
+	qsc_socket_address_families family, size_t listeners, size_t threads, size_t maximum, qsc_reactor_backends backend)
+{
+	assert(state != NULL);
+	assert(mdk != NULL);
+	assert(address != NULL);
+
+	size_t lmax;
+	bool shared;
+	bool res;
+
+	res = false;
+
+	if (state != NULL && mdk != NULL && address != NULL)
+	{
+		listeners = (listeners == 0) ? qsc_async_processor_count() : listeners;
+		listeners = (listeners == 0) ? 1 : listeners;
+		listeners = (listeners > HKDS_NETWORK_LISTENERS_MAX) ? HKDS_NETWORK_LISTENERS_MAX : listeners;
+		shared = (listeners > 1);
+		/* the connection limit is divided between the reactors */
+		lmax = (maximum + listeners - 1) / listeners;
+
+		state->mdk = mdk;
+		state->requests = 0;
+		state->rejected = 0;
+		state->count = 0;
+		state->listeners = (qsc_socket*)qsc_memutils_malloc(listeners * sizeof(qsc_socket));
+		state->reactors = (qsc_reactor_state*)qsc_memutils_malloc(listeners * sizeof(qsc_reactor_state));
+
+		if (state->listeners != NULL && state->reactors != NULL)
+		{
+			res = true;
+
+			/* each listener is served by its own reactor, so the accepts are spread across the event loops */
+			while (res == true && state->count < listeners)
+			{
+				res = false;
+				qsc_socket_server_initialize(&state->listeners[state->count]);
+
+				if (qsc_socket_server_open(&state->listeners[state->count], address, port, family, shared) == qsc_socket_exception_success)
+				{
+					res = qsc_reactor_initialize(&state->reactors[state->count], &state->listeners[state->count], threads, lmax,
+						NULL, &hkds_network_receive, NULL, state, backend);
+
+					if (res == true)
+					{
+						++state->count;
+					}
+					else
+					{
+						qsc_socket_close_socket(&state->listeners[state->count]);
+					}
+				}
+			}
+		}
+
+		if (res == false)
+		{
+			hkds_network_stop(state);
+		}
+	}
+
+	return res;
+}
+
+void hkds_network_stop(hkds_network_state* state)
+{
+	assert(state != NULL);
+
+	if (state != NULL)
+	{
+		for (size_t i = 0; i < state->count; ++i)
+		{
+			qsc_reactor_dispose(&state->reactors[i]);
+			qsc_socket_close_socket(&state->listeners[i]);
+		}
+
+		if (state->reactors != NULL)
+		{
+			qsc_memutils_alloc_free(state->reactors);
+			state->reactors = NULL;
+		}
+
+		if (state->listeners != NULL)
+		{
+			qsc_memutils_alloc_free(state->listeners);
+			state->listeners = NULL;
+		}
+
+		state->count = 0;
+	}
+}
+
+size_t hkds_network_connections(const hkds_network_state* state)
+{
+	assert(state != NULL);
+
+	size_t res;
+
+	res = 0;
+
+	if (state != NULL)
+	{
+		for (size_t i = 0; i < state->count; ++i)
+		{
+			res += qsc_reactor_connections(&state->reactors[i]);
+		}
+	}
+
+	return res;
+}
+
+void hkds_network_idle_timeout(hkds_network_state* state, uint32_t milliseconds)
+{
+	assert(state != NULL);
+
+	if (state != NULL)
+	{
+		for (size_t i = 0; i < state->count; ++i)
+		{
+			qsc_reactor_idle_timeout(&state->reactors[i], milliseconds);
+		}
+	}
+}
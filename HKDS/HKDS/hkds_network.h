@@ -0,0 +1,143 @@
+/* 2021 Digital Freedom Defense Incorporated
+ * All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Digital Freedom Defense Incorporated.
+ * The intellectual and technical concepts contained
+ * herein are proprietary to Digital Freedom Defense Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Digital Freedom Defense Incorporated.
+ *
+ * Contact: develop@dfdef.com
+ */
+
+#ifndef HKDS_NETWORK_H
+#define HKDS_NETWORK_H
+
+#include "common.h"
+#include "hkds_async.h"
+#include "hkds_config.h"
+#include "hkds_response.h"
+#include "hkds_server.h"
+#include "hkds_wire.h"
+#include "../QSC/socketreactor.h"
+
+/* Reactor driven HKDS server.
+* Terminal connections are served by the socket reactor, a small set of event loop threads that each
+* hold thousands of persistent, non-blocking connections. The requests in each received buffer are parsed in place,
+* grouped by operation and executed across the SIMD lanes on the event loop thread, and the responses of the buffer
+* are written back with one send once every group has executed; they are ordered by group, not by request.
+* A connection may send many requests without waiting for the responses, each identified by the sequence
+* in its packet header and answered with the same sequence; an incomplete request is kept
+* by the reactor until the rest of it arrives. A packet that fails validation is answered with an
+* error_invalid_format message.
+* The server can open several listening sockets on the same port with the reuse port option, each served by its own reactor;
+* the kernel then distributes the incoming connections between the listeners, so that a burst of reconnections,
+* after a network interruption for example, is accepted on every core instead of queuing behind a single accept path. */
+
+/*!
+* \def HKDS_NETWORK_LISTENERS_MAX
+* \brief The maximum number of listening sockets
+*/
+#define HKDS_NETWORK_LISTENERS_MAX 64
+
+/*! \struct hkds_network_state
+* Contains the network server state
+*/
+HKDS_EXPORT_API typedef struct
+{
+	qsc_reactor_state* reactors;			/*!< The socket reactors, one for each listener */
+	qsc_socket* listeners;					/*!< The listening sockets */
+	size_t count;							/*!< The number of listeners */
+	hkds_master_key* mdk;					/*!< A pointer to the master derivation key */
+	volatile uint64_t requests;				/*!< The number of requests served */
+	volatile uint64_t rejected;				/*!< The number of packets rejected */
+} hkds_network_state;
+
+/**
+* \brief Open the listening sockets and start the event loops.
+* A single listener is shared by all of the event loops of one reactor; with more than one listener,
+* each listener binds the port with the reuse port option and is served by its own reactor.
+*
+* \param state [struct] The network server state
+* \param mdk [struct] The master key set
+* \param address [string][const] The servers address
+* \param port [uint16] The servers port number
+* \param family [enum] The socket address family
+* \param listeners [size] The number of listening sockets, zero selects the processor count
+* \param threads [size] The number of event loop threads serving each listener, zero selects the processor count
+* \param maximum [size] The maximum number of terminal connections, divided between the listeners
+* \param backend [enum] The event loop backend, qsc_reactor_backend_auto selects io_uring when it is supported
+* \return [bool] Returns true if the server was started
+*/
+HKDS_EXPORT_API bool hkds_network_start(hkds_network_state* state, hkds_master_key* mdk, const char* address, uint16_t port,
+	qsc_socket_address_families family, size_t listeners, size_t threads, size_t maximum, qsc_reactor_backends backend);
+
+/**
+* \brief Stop the event loops, and close the connections and the listening sockets
+*
+* \param state [struct] The network server state
+*/
+HKDS_EXPORT_API void hkds_network_stop(hkds_network_state* state);
+
+/**
+* \brief Get the number of open terminal connections
+*
+* \param state [struct][const] The network server state
+* \return [size] The number of connections
+*/
+HKDS_EXPORT_API size_t hkds_network_connections(const hkds_network_state* state);
+
+/**
+* \brief Set the idle timeout; a terminal connection that sends nothing for the timeout period is closed.
+* The timeout applies to the connections accepted after it is set.
+*
+* \param state [struct] The network server state
+* \param milliseconds [uint32] The idle timeout in milliseconds, zero disables the timeout
+*/
+HKDS_EXPORT_API void hkds_network_idle_timeout(hkds_network_state* state, uint32_t milliseconds);
+
+/**
+* \brief Copy a parsed client request into an asynchronous request.
+* The request token is set to the index of the request in the batch.
+*
+* \param batch [struct][const] The parsed request batch
+* \param index [size] The index of the request in the batch
+* \param request [struct][output] The asynchronous request
+*/
+HKDS_EXPORT_API void hkds_network_request(const hkds_wire_batch* batch, size_t index, hkds_async_request* request);
+
+/**
+* \brief Execute a set of requests, grouped by operation across the SIMD lanes.
+* Completion i receives the result of request i; a request with the operation hkds_async_none is skipped,
+* and its completion is left unchanged. The groups are executed one after another in operation order, and the optional order array
+* receives the index of each executed request, grouped in the order the groups were executed.
+*
+* \param mdk [struct] The master key set
+* \param requests [array][const] The requests
+* \param count [size] The number of requests, at most HKDS_WIRE_BATCH_MAX
+* \param completions [array][output] The completion array
+* \param order [array][output] The optional execution order array, with space for count indices; can be NULL
+*/
+HKDS_EXPORT_API void hkds_network_execute(hkds_master_key* mdk, const hkds_async_request* requests, size_t count, hkds_async_completion* completions, size_t* order);
+
+/**
+* \brief Process the client requests in a receive buffer, and add the responses to a batch.
+* The responses are added grouped by operation, in the order the SIMD groups were executed, not in request order; each response
+* carries the sequence of its request, so a client matches responses to the requests it has outstanding.
+* Processes up to HKDS_WIRE_BATCH_MAX packets, counting the rejected packets that are answered with an error, so a batch
+* sized with HKDS_RESPONSE_BUFFER_SIZE holds a response to every packet consumed; the caller resumes from the returned position.
+* Used by the reactor, and by transports that receive packets in other ways.
+*
+* \param state [struct] The network server state
+* \param input [array][const] The received packets
+* \param inlen [size] The number of bytes received
+* \param responses [struct] The response batch receiving the responses
+* \return [size] The number of bytes processed; the remainder is an incomplete packet, or more packets than one batch
+*/
+HKDS_EXPORT_API size_t hkds_network_process(hkds_network_state* state, const uint8_t* input, size_t inlen, hkds_response_batch* responses);
+
+#endif
@@ -0,0 +1,112 @@
+#include "hkds_pipeline.h"
+#include "hkds_wire.h"
+#include "../QSC/memutils.h"
+
+void hkds_pipeline_initialize(hkds_pipeline_state* state)
+{
+	assert(state != NULL);
+
+	if (state != NULL)
+	{
+		qsc_memutils_clear(state, sizeof(hkds_pipeline_state));
+		state->next = HKDS_SEQUENCE_NONE + 1;
+	}
+}
+
+bool hkds_pipeline_issue(hkds_pipeline_state* state, const uint8_t* ksn, hkds_packet_type type, uint64_t tag, uint8_t* sequence)
+{
+	assert(state != NULL);
+	assert(ksn != NULL);
+	assert(sequence != NULL);
+
+	hkds_pipeline_entry* ent;
+	bool res;
+
+	res = false;
+
+	if (state != NULL && ksn != NULL && sequence != NULL && state->outstanding < HKDS_PIPELINE_DEPTH &&
+		(type == packet_message_request || type == packet_token_request))
+	{
+		/* a free sequence exists, continue from the last one assigned so a late response is not matched to a new request */
+		while (state->next == HKDS_SEQUENCE_NONE || state->entries[state->next].pending == true)
+		{
+			++state->next;
+		}
+
+		ent = &state->entries[state->next];
+		qsc_memutils_copy(ent->ksn, ksn, HKDS_KSN_SIZE);
+		ent->tag = tag;
+		ent->type = type;
+		ent->sequence = state->next;
+		ent->pending = true;
+		*sequence = state->next;
+		++state->next;
+		++state->outstanding;
+		res = true;
+	}
+
+	return res;
+}
+
+bool hkds_pipeline_complete(hkds_pipeline_state* state, const uint8_t* input, size_t inlen, hkds_pipeline_entry* entry)
+{
+	assert(state != NULL);
+	assert(input != NULL);
+	assert(entry != NULL);
+
+	hkds_pipeline_entry* ent;
+	uint8_t flag;
+	uint8_t seq;
+	bool res;
+
+	res = false;
+
+	if (state != NULL && input != NULL && entry != NULL)
+	{
+		seq = hkds_wire_response_sequence(input, inlen);
+		ent = &state->entries[seq];
+
+		if (seq != HKDS_SEQUENCE_NONE && ent->pending == true)
+		{
+			flag = input[0];
+
+			if (flag == (uint8_t)packet_error_message)
+			{
+				res = true;
+			}
+			else if (ent->type == packet_message_request)
+			{
+				res = (flag == (uint8_t)packet_message_response || flag == (uint8_t)packet_message_token_response);
+			}
+			else
+			{
+				res = (flag == (uint8_t)packet_token_response);
+			}
+
+			if (res == true)
+			{
+				qsc_memutils_copy(entry, ent, sizeof(hkds_pipeline_entry));
+				ent->pending = false;
+				--state->outstanding;
+			}
+		}
+	}
+
+	return res;
+}
+
+size_t hkds_pipeline_outstanding(const hkds_pipeline_state* state)
+{
+	assert(state != NULL);
+
+	size_t res;
+
+	res = 0;
+
+	if (state != NULL)
+	{
+		res = state->outstanding;
+	}
+
+	return res;
+}
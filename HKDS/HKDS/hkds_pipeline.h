@@ -0,0 +1,100 @@
+/* 2021 Digital Freedom Defense Incorporated
+ * All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Digital Freedom Defense Incorporated.
+ * The intellectual and technical concepts contained
+ * herein are proprietary to Digital Freedom Defense Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Digital Freedom Defense Incorporated.
+ *
+ * Contact: develop@dfdef.com
+ */
+
+#ifndef HKDS_PIPELINE_H
+#define HKDS_PIPELINE_H
+
+#include "common.h"
+#include "hkds_config.h"
+
+/* Client request pipelining.
+* The sequence field of a request header identifies the request, and the server returns it with the response,
+* so a connection can carry many requests at once and the server can answer them in any order.
+* The pipeline assigns each request a sequence that is not in use on the connection, and records the request
+* until a response with that sequence arrives. A gateway that carries the requests of many terminals over one link
+* tags each request with the terminal it came from, and uses the tag to return the response.
+* Sequence HKDS_SEQUENCE_NONE is never assigned, so up to HKDS_PIPELINE_DEPTH requests can be outstanding.
+* A pipeline is not thread safe, each connection uses its own. */
+
+/*!
+\def HKDS_PIPELINE_DEPTH
+* The maximum number of outstanding requests on a connection
+*/
+#define HKDS_PIPELINE_DEPTH 255
+
+/*! \struct hkds_pipeline_entry
+* An outstanding request
+*/
+HKDS_EXPORT_API typedef struct
+{
+	uint8_t ksn[HKDS_KSN_SIZE];				/*!< The key serial number of the request */
+	uint64_t tag;							/*!< The caller defined request tag */
+	hkds_packet_type type;					/*!< The request packet type */
+	uint8_t sequence;						/*!< The request sequence */
+	bool pending;							/*!< The request is waiting for its response */
+} hkds_pipeline_entry;
+
+/*! \struct hkds_pipeline_state
+* Contains the outstanding requests of a connection, indexed by sequence
+*/
+HKDS_EXPORT_API typedef struct
+{
+	hkds_pipeline_entry entries[HKDS_PIPELINE_DEPTH + 1];	/*!< The request entries */
+	size_t outstanding;										/*!< The number of outstanding requests */
+	uint8_t next;											/*!< The next sequence tried by an issue */
+} hkds_pipeline_state;
+
+/**
+* \brief Initialize a pipeline with no outstanding requests
+*
+* \param state [struct] The pipeline state
+*/
+HKDS_EXPORT_API void hkds_pipeline_initialize(hkds_pipeline_state* state);
+
+/**
+* \brief Record a new request and assign its sequence
+*
+* \param state [struct] The pipeline state
+* \param ksn [array][const] The key serial number of the request
+* \param type [enum] The request packet type, packet_message_request or packet_token_request
+* \param tag [uint64] The caller defined request tag
+* \param sequence [uint8][output] The sequence to write in the request header
+* \return [bool] Returns false if HKDS_PIPELINE_DEPTH requests are outstanding, or the type is not a request
+*/
+HKDS_EXPORT_API bool hkds_pipeline_issue(hkds_pipeline_state* state, const uint8_t* ksn, hkds_packet_type type, uint64_t tag, uint8_t* sequence);
+
+/**
+* \brief Match a server packet to its outstanding request, and release the request.
+* A message request is answered with a message response, a message and token response, or an error message;
+* a token request with a token response or an error message.
+*
+* \param state [struct] The pipeline state
+* \param input [array][const] The serialized server packet
+* \param inlen [size] The number of bytes available in the buffer
+* \param entry [struct][output] Receives the matched request
+* \return [bool] Returns false if the packet does not answer an outstanding request
+*/
+HKDS_EXPORT_API bool hkds_pipeline_complete(hkds_pipeline_state* state, const uint8_t* input, size_t inlen, hkds_pipeline_entry* entry);
+
+/**
+* \brief Get the number of outstanding requests
+*
+* \param state [struct][const] The pipeline state
+* \return [size] The number of requests waiting for a response
+*/
+HKDS_EXPORT_API size_t hkds_pipeline_outstanding(const hkds_pipeline_state* state);
+
+#endif
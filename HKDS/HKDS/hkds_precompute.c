@@ -0,0 +1,520 @@
+#include "hkds_precompute.h"
+#include "../QSC/atomics.h"
+#include "../QSC/intutils.h"
+#include "../QSC/memutils.h"
+#include "../QSC/secmem.h"
+#include "../QSC/sha3.h"
+#include "../QSC/timerex.h"
+
+static void hkds_precompute_lock(volatile uint64_t* lock)
+{
+	uint64_t exp;
+
+	exp = 0;
+
+	while (qsc_atomics_compare_exchange64(lock, &exp, 1) == false)
+	{
+		exp = 0;
+		qsc_atomics_pause();
+	}
+}
+
+static void hkds_precompute_unlock(volatile uint64_t* lock)
+{
+	qsc_atomics_store64(lock, 0);
+}
+
+static size_t hkds_precompute_get_index(const hkds_precompute_state* state, const uint8_t* did)
+{
+	uint64_t h;
+
+	/* fnv-1a over the device id */
+	h = 0xCBF29CE484222325ULL;
+
+	for (size_t i = 0; i < HKDS_DID_SIZE; ++i)
+	{
+		h ^= did[i];
+		h *= 0x100000001B3ULL;
+	}
+
+	return (size_t)(h & (state->sets - 1));
+}
+
+static hkds_precompute_entry* hkds_precompute_get_set(const hkds_precompute_state* state, const uint8_t* did)
+{
+	return state->entries + (hkds_precompute_get_index(state, did) * HKDS_PRECOMPUTE_WAYS);
+}
+
+static volatile uint64_t* hkds_precompute_entry_lock(const hkds_precompute_state* state, const hkds_precompute_entry* entry)
+{
+	return &state->locks[(size_t)(entry - state->entries) / HKDS_PRECOMPUTE_WAYS];
+}
+
+static hkds_precompute_entry* hkds_precompute_find(const hkds_precompute_state* state, const uint8_t* did)
+{
+	hkds_precompute_entry* set;
+	hkds_precompute_entry* res;
+
+	set = hkds_precompute_get_set(state, did);
+	res = NULL;
+
+	for (size_t i = 0; i < HKDS_PRECOMPUTE_WAYS; ++i)
+	{
+		if (set[i].used == true && qsc_intutils_are_equal8(set[i].did, did, HKDS_DID_SIZE) == true)
+		{
+			res = &set[i];
+			break;
+		}
+	}
+
+	return res;
+}
+
+static uint8_t* hkds_precompute_get_material(const hkds_precompute_state* state, const hkds_precompute_entry* entry, size_t slot)
+{
+	size_t idx;
+
+	idx = (size_t)(entry - state->entries);
+
+	return state->material + ((idx * 2 + slot) * HKDS_PRECOMPUTE_KEY_SIZE);
+}
+
+static void hkds_precompute_clear_entry(hkds_precompute_state* state, hkds_precompute_entry* entry)
+{
+	qsc_secmem_erase(hkds_precompute_get_material(state, entry, 0), 2 * HKDS_PRECOMPUTE_KEY_SIZE);
+	qsc_memutils_clear((uint8_t*)entry, sizeof(hkds_precompute_entry));
+}
+
+static bool hkds_precompute_get_keys(hkds_precompute_state* state, const hkds_server_state* server, uint8_t* tkey, size_t tkeylen)
+{
+	const hkds_precompute_entry* entry;
+	volatile uint64_t* lock;
+	uint32_t ctr;
+	uint32_t epoch;
+	size_t index;
+	size_t slot;
+	bool res;
+
+	res = false;
+	ctr = qsc_intutils_be8to32(server->ksn + HKDS_DID_SIZE);
+	epoch = ctr / HKDS_CACHE_SIZE;
+	index = (size_t)(ctr % HKDS_CACHE_SIZE);
+	slot = (size_t)(epoch & 1);
+
+	/* material is only valid for the master key it was derived with */
+	if (server->mdk == state->mdk && index * HKDS_MESSAGE_SIZE + tkeylen <= HKDS_PRECOMPUTE_KEY_SIZE)
+	{
+		lock = &state->locks[hkds_precompute_get_index(state, server->ksn)];
+		hkds_precompute_lock(lock);
+		entry = hkds_precompute_find(state, server->ksn);
+
+		if (entry != NULL && entry->ready[slot] == true && entry->epoch[slot] == epoch)
+		{
+			qsc_memutils_copy(tkey, hkds_precompute_get_material(state, entry, slot) + (index * HKDS_MESSAGE_SIZE), tkeylen);
+			res = true;
+		}
+
+		hkds_precompute_unlock(lock);
+	}
+
+	qsc_atomics_fetch_add64((res == true) ? &state->hits : &state->misses, 1);
+
+	return res;
+}
+
+bool hkds_precompute_initialize(hkds_precompute_state* state, hkds_master_key* mdk, size_t capacity, uint32_t threshold)
+{
+	assert(state != NULL);
+	assert(mdk != NULL);
+	assert(capacity != 0);
+
+	size_t sets;
+	bool res;
+
+	res = false;
+
+	if (state != NULL && mdk != NULL && capacity != 0)
+	{
+		sets = 1;
+
+		while (sets * HKDS_PRECOMPUTE_WAYS < capacity)
+		{
+			sets <<= 1;
+		}
+
+		state->capacity = sets * HKDS_PRECOMPUTE_WAYS;
+		state->entries = (hkds_precompute_entry*)qsc_memutils_malloc(state->capacity * sizeof(hkds_precompute_entry));
+		state->locks = (volatile uint64_t*)qsc_memutils_malloc(sets * sizeof(uint64_t));
+		state->material = qsc_secmem_alloc(state->capacity * 2 * HKDS_PRECOMPUTE_KEY_SIZE);
+
+		if (state->entries != NULL && state->locks != NULL && state->material != NULL)
+		{
+			qsc_memutils_clear((uint8_t*)state->entries, state->capacity * sizeof(hkds_precompute_entry));
+			qsc_memutils_clear((uint8_t*)state->locks, sets * sizeof(uint64_t));
+			qsc_secmem_erase(state->material, state->capacity * 2 * HKDS_PRECOMPUTE_KEY_SIZE);
+			state->mdk = mdk;
+			state->sets = sets;
+			state->threshold = threshold;
+			state->hits = 0;
+			state->misses = 0;
+			res = true;
+		}
+		else
+		{
+			hkds_precompute_dispose(state);
+		}
+	}
+
+	return res;
+}
+
+void hkds_precompute_dispose(hkds_precompute_state* state)
+{
+	assert(state != NULL);
+
+	if (state != NULL)
+	{
+		if (state->material != NULL)
+		{
+			qsc_secmem_free(state->material, state->capacity * 2 * HKDS_PRECOMPUTE_KEY_SIZE);
+			state->material = NULL;
+		}
+
+		if (state->entries != NULL)
+		{
+			qsc_memutils_clear((uint8_t*)state->entries, state->capacity * sizeof(hkds_precompute_entry));
+			qsc_memutils_alloc_free(state->entries);
+			state->entries = NULL;
+		}
+
+		if (state->locks != NULL)
+		{
+			qsc_memutils_alloc_free((void*)state->locks);
+			state->locks = NULL;
+		}
+
+		state->mdk = NULL;
+		state->capacity = 0;
+		state->sets = 0;
+	}
+}
+
+void hkds_precompute_age(hkds_precompute_state* state)
+{
+	assert(state != NULL);
+
+	if (state != NULL && state->entries != NULL)
+	{
+		for (size_t i = 0; i < state->sets; ++i)
+		{
+			hkds_precompute_lock(&state->locks[i]);
+
+			for (size_t j = 0; j < HKDS_PRECOMPUTE_WAYS; ++j)
+			{
+				state->entries[(i * HKDS_PRECOMPUTE_WAYS) + j].activity >>= 1;
+			}
+
+			hkds_precompute_unlock(&state->locks[i]);
+		}
+	}
+}
+
+void hkds_precompute_record(hkds_precompute_state* state, const uint8_t* ksn)
+{
+	assert(state != NULL);
+	assert(ksn != NULL);
+
+	hkds_precompute_entry* entry;
+	hkds_precompute_entry* set;
+	volatile uint64_t* lock;
+	uint32_t ctr;
+	uint32_t mact;
+
+	if (state != NULL && ksn != NULL && state->entries != NULL)
+	{
+		ctr = qsc_intutils_be8to32(ksn + HKDS_DID_SIZE);
+		lock = &state->locks[hkds_precompute_get_index(state, ksn)];
+		hkds_precompute_lock(lock);
+		entry = hkds_precompute_find(state, ksn);
+
+		if (entry == NULL)
+		{
+			/* space-saving replacement: the new device inherits the count of the least active device in the set */
+			set = hkds_precompute_get_set(state, ksn);
+			mact = UINT32_MAX;
+
+			for (size_t i = 0; i < HKDS_PRECOMPUTE_WAYS; ++i)
+			{
+				if (set[i].used == false)
+				{
+					entry = &set[i];
+					mact = 0;
+					break;
+				}
+
+				if (set[i].activity < mact)
+				{
+					entry = &set[i];
+					mact = set[i].activity;
+				}
+			}
+
+			hkds_precompute_clear_entry(state, entry);
+			qsc_memutils_copy(entry->did, ksn, HKDS_DID_SIZE);
+			entry->activity = mact;
+			entry->counter = ctr;
+			entry->used = true;
+		}
+
+		if (entry->activity != UINT32_MAX)
+		{
+			++entry->activity;
+		}
+
+		if (ctr > entry->counter)
+		{
+			entry->counter = ctr;
+		}
+
+		hkds_precompute_unlock(lock);
+	}
+}
+
+size_t hkds_precompute_run(hkds_precompute_state* state, size_t maxdevices, uint64_t maxtime)
+{
+	assert(state != NULL);
+
+	uint8_t etok[HKDS_CACHX8_DEPTH][HKDS_ETOK_SIZE] = { 0 };
+	uint8_t skey[HKDS_CACHX8_DEPTH][HKDS_PRECOMPUTE_KEY_SIZE] = { 0 };
+	uint32_t epoch[HKDS_CACHX8_DEPTH] = { 0 };
+	uint32_t rank[HKDS_CACHX8_DEPTH] = { 0 };
+	hkds_precompute_entry* lane[HKDS_CACHX8_DEPTH] = { 0 };
+	hkds_precompute_entry* cand;
+	hkds_precompute_entry* entry;
+	volatile uint64_t* lock;
+	hkds_server_x8_state xs;
+	uint64_t start;
+	uint32_t act;
+	uint32_t next;
+	size_t count;
+	size_t done;
+	size_t limit;
+	size_t pos;
+	size_t sel;
+	size_t slot;
+	bool more;
+
+	done = 0;
+
+	if (state != NULL && state->entries != NULL)
+	{
+		start = qsc_timerex_monotonic_microseconds();
+		xs.mdk = state->mdk;
+		more = true;
+
+		while (more == true && done < maxdevices && (maxtime == 0 || qsc_timerex_monotonic_microseconds() - start < maxtime))
+		{
+			count = 0;
+			limit = (maxdevices - done < HKDS_CACHX8_DEPTH) ? maxdevices - done : HKDS_CACHX8_DEPTH;
+
+			/* one unlocked pass ranks the most active devices whose next epoch material is missing;
+			   the fields read here are only a hint, each candidate is checked again under its set lock */
+			for (size_t i = 0; i < state->capacity; ++i)
+			{
+				cand = &state->entries[i];
+				act = cand->activity;
+
+				if (cand->used == true && act >= state->threshold && (count < limit || act > rank[count - 1]))
+				{
+					next = (cand->counter / HKDS_CACHE_SIZE) + 1;
+					slot = (size_t)(next & 1);
+
+					if (cand->ready[slot] == false || cand->epoch[slot] != next)
+					{
+						/* insert in order of activity, a full list drops its least active candidate */
+						pos = (count < limit) ? count : limit - 1;
+
+						while (pos > 0 && rank[pos - 1] < act)
+						{
+							lane[pos] = lane[pos - 1];
+							rank[pos] = rank[pos - 1];
+							--pos;
+						}
+
+						lane[pos] = cand;
+						rank[pos] = act;
+						count += (count < limit) ? 1 : 0;
+					}
+				}
+			}
+
+			sel = 0;
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				entry = lane[i];
+				lock = hkds_precompute_entry_lock(state, entry);
+				hkds_precompute_lock(lock);
+				next = (entry->counter / HKDS_CACHE_SIZE) + 1;
+				slot = (size_t)(next & 1);
+
+				if (entry->used == true && (entry->ready[slot] == false || entry->epoch[slot] != next))
+				{
+					lane[sel] = entry;
+					epoch[sel] = next;
+					qsc_memutils_copy(xs.ksn[sel], entry->did, HKDS_DID_SIZE);
+					qsc_intutils_be32to8(((uint8_t*)xs.ksn[sel] + HKDS_DID_SIZE), next * HKDS_CACHE_SIZE);
+					++sel;
+				}
+
+				hkds_precompute_unlock(lock);
+			}
+
+			count = sel;
+			more = (count != 0);
+
+			if (more == true)
+			{
+				/* pad the unused lanes with the first device */
+				for (size_t i = count; i < HKDS_CACHX8_DEPTH; ++i)
+				{
+					qsc_memutils_copy(xs.ksn[i], xs.ksn[0], HKDS_KSN_SIZE);
+				}
+
+				/* derive the material outside the locks */
+				hkds_server_encrypt_token_x8(&xs, etok);
+				hkds_server_generate_cache_x8(&xs, skey);
+
+				for (size_t i = 0; i < count; ++i)
+				{
+					entry = lane[i];
+					lock = hkds_precompute_entry_lock(state, entry);
+					hkds_precompute_lock(lock);
+
+					/* the entry may have been replaced while the material was derived */
+					if (entry->used == true && qsc_intutils_are_equal8(entry->did, xs.ksn[i], HKDS_DID_SIZE) == true)
+					{
+						slot = (size_t)(epoch[i] & 1);
+						qsc_memutils_copy(hkds_precompute_get_material(state, entry, slot), skey[i], HKDS_PRECOMPUTE_KEY_SIZE);
+						qsc_memutils_copy(entry->etok[slot], etok[i], HKDS_ETOK_SIZE);
+						entry->epoch[slot] = epoch[i];
+						entry->ready[slot] = true;
+					}
+
+					hkds_precompute_unlock(lock);
+				}
+
+				qsc_memutils_clear((uint8_t*)skey, sizeof(skey));
+				done += count;
+			}
+		}
+	}
+
+	return done;
+}
+
+void hkds_precompute_decrypt_message(hkds_precompute_state* state, hkds_server_state* server, const uint8_t* ciphertext, uint8_t* plaintext)
+{
+	assert(state != NULL);
+	assert(server != NULL);
+	assert(ciphertext != NULL);
+	assert(plaintext != NULL);
+
+	if (hkds_precompute_get_keys(state, server, plaintext, HKDS_MESSAGE_SIZE) == true)
+	{
+		/* XOR the key-stream and cipher-text */
+		qsc_memutils_xor(plaintext, ciphertext, HKDS_MESSAGE_SIZE);
+	}
+	else
+	{
+		hkds_server_decrypt_message(server, ciphertext, plaintext);
+	}
+}
+
+bool hkds_precompute_decrypt_verify_message(hkds_precompute_state* state, hkds_server_state* server, const uint8_t* ciphertext,
+	const uint8_t* data, size_t datalen, uint8_t* plaintext)
+{
+	assert(state != NULL);
+	assert(server != NULL);
+	assert(ciphertext != NULL);
+	assert(plaintext != NULL);
+
+	uint8_t code[HKDS_TAG_SIZE] = { 0 };
+	uint8_t dkey[2 * HKDS_MESSAGE_SIZE] = { 0 };
+	bool res;
+
+	res = false;
+
+	if (hkds_precompute_get_keys(state, server, dkey, sizeof(dkey)) == true)
+	{
+		/* generate the MAC code for the cipher-text received */
+#if defined(HKDS_SHAKE_128)
+		qsc_kmac128_compute(code, sizeof(code), ciphertext, HKDS_MESSAGE_SIZE, dkey + HKDS_MESSAGE_SIZE, HKDS_MESSAGE_SIZE, data, datalen);
+#elif defined(HKDS_SHAKE_256)
+		qsc_kmac256_compute(code, sizeof(code), ciphertext, HKDS_MESSAGE_SIZE, dkey + HKDS_MESSAGE_SIZE, HKDS_MESSAGE_SIZE, data, datalen);
+#else
+		qsc_kmac512_compute(code, sizeof(code), ciphertext, HKDS_MESSAGE_SIZE, dkey + HKDS_MESSAGE_SIZE, HKDS_MESSAGE_SIZE, data, datalen);
+#endif
+
+		/* compare the MAC generated with the one appended to the message */
+		if (qsc_intutils_verify(code, (ciphertext + HKDS_MESSAGE_SIZE), HKDS_TAG_SIZE) == 0)
+		{
+			for (size_t i = 0; i < HKDS_MESSAGE_SIZE; ++i)
+			{
+				plaintext[i] = (uint8_t)(ciphertext[i] ^ dkey[i]);
+			}
+
+			res = true;
+		}
+
+		qsc_memutils_clear(dkey, sizeof(dkey));
+	}
+	else
+	{
+		res = hkds_server_decrypt_verify_message(server, ciphertext, data, datalen, plaintext);
+	}
+
+	return res;
+}
+
+void hkds_precompute_encrypt_token(hkds_precompute_state* state, hkds_server_state* server, uint8_t* etok)
+{
+	assert(state != NULL);
+	assert(server != NULL);
+	assert(etok != NULL);
+
+	const hkds_precompute_entry* entry;
+	volatile uint64_t* lock;
+	uint32_t ctr;
+	uint32_t epoch;
+	size_t slot;
+	bool res;
+
+	res = false;
+	ctr = qsc_intutils_be8to32(server->ksn + HKDS_DID_SIZE);
+	epoch = ctr / HKDS_CACHE_SIZE;
+	slot = (size_t)(epoch & 1);
+
+	/* the stored token is bound to the first counter of its epoch */
+	if (server->mdk == state->mdk && ctr == epoch * HKDS_CACHE_SIZE)
+	{
+		lock = &state->locks[hkds_precompute_get_index(state, server->ksn)];
+		hkds_precompute_lock(lock);
+		entry = hkds_precompute_find(state, server->ksn);
+
+		if (entry != NULL && entry->ready[slot] == true && entry->epoch[slot] == epoch)
+		{
+			qsc_memutils_copy(etok, entry->etok[slot], HKDS_ETOK_SIZE);
+			res = true;
+		}
+
+		hkds_precompute_unlock(lock);
+	}
+
+	qsc_atomics_fetch_add64((res == true) ? &state->hits : &state->misses, 1);
+
+	if (res == false)
+	{
+		hkds_server_encrypt_token(server, etok);
+	}
+}
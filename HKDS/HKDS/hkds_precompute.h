@@ -0,0 +1,156 @@
+/* 2021 Digital Freedom Defense Incorporated
+ * All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Digital Freedom Defense Incorporated.
+ * The intellectual and technical concepts contained
+ * herein are proprietary to Digital Freedom Defense Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Digital Freedom Defense Incorporated.
+ *
+ * Contact: develop@dfdef.com
+ */
+
+#ifndef HKDS_PRECOMPUTE_H
+#define HKDS_PRECOMPUTE_H
+
+#include "common.h"
+#include "hkds_config.h"
+#include "hkds_server.h"
+
+/* Speculative next-epoch precomputation.
+* The server records the activity of each device, keeping an approximate set of the most active devices.
+* During idle time, hkds_precompute_run derives the next epochs encrypted token and transaction key cache
+* for the hottest devices, eight at a time with the SIMD x8 functions, and stores them in locked memory.
+* When a device crosses into the next epoch, its token request and messages are served from the stored
+* material, so the first message after a rollover costs less than a mid-epoch message.
+* Requests for devices without stored material fall back to the server functions.
+* All functions are thread safe; each set of the table has its own spin lock, held only while an entry of that set is read
+* or updated, so requests for devices in different sets do not contend. The run function ranks its candidates with an
+* unlocked scan of the table, checks each one again under its set lock, and holds no lock during derivation. */
+
+/*!
+\def HKDS_PRECOMPUTE_WAYS
+* The number of devices in each activity table set
+*/
+#define HKDS_PRECOMPUTE_WAYS 8
+
+/*!
+\def HKDS_PRECOMPUTE_KEY_SIZE
+* The size of a devices stored transaction key cache
+*/
+#define HKDS_PRECOMPUTE_KEY_SIZE (HKDS_CACHE_SIZE * HKDS_MESSAGE_SIZE)
+
+/*! \struct hkds_precompute_entry
+* A tracked device; two material slots hold the current and next epoch, indexed by epoch parity
+*/
+HKDS_EXPORT_API typedef struct
+{
+	uint8_t did[HKDS_DID_SIZE];					/*!< The device identity */
+	uint8_t etok[2][HKDS_ETOK_SIZE];			/*!< The encrypted token of each material slot */
+	uint32_t counter;							/*!< The highest transaction counter observed */
+	uint32_t activity;							/*!< The approximate number of requests observed */
+	uint32_t epoch[2];							/*!< The epoch of each material slot */
+	bool ready[2];								/*!< The material slot contains valid material */
+	bool used;									/*!< The entry is tracking a device */
+} hkds_precompute_entry;
+
+/*! \struct hkds_precompute_state
+* Contains the precompute state
+*/
+HKDS_EXPORT_API typedef struct
+{
+	hkds_precompute_entry* entries;				/*!< The activity table, sets of HKDS_PRECOMPUTE_WAYS */
+	uint8_t* material;							/*!< The locked transaction key cache memory, two slots per entry */
+	hkds_master_key* mdk;						/*!< A pointer to the master derivation key */
+	size_t capacity;							/*!< The number of tracked devices */
+	size_t sets;								/*!< The number of sets, a power of two */
+	uint32_t threshold;							/*!< The minimum activity of a device before material is precomputed */
+	volatile uint64_t* locks;					/*!< The spin lock of each set */
+	volatile uint64_t hits;						/*!< The number of requests served from precomputed material */
+	volatile uint64_t misses;					/*!< The number of requests passed to the server functions */
+} hkds_precompute_state;
+
+/**
+* \brief Initialize the precompute state
+*
+* \param state [struct] The precompute state
+* \param mdk [struct] The master key set
+* \param capacity [size] The number of devices tracked, rounded up to a multiple of HKDS_PRECOMPUTE_WAYS and a power of two sets
+* \param threshold [uint32] The minimum number of requests observed before a devices material is precomputed
+* \return [bool] Returns true if the table and locked memory were allocated
+*/
+HKDS_EXPORT_API bool hkds_precompute_initialize(hkds_precompute_state* state, hkds_master_key* mdk, size_t capacity, uint32_t threshold);
+
+/**
+* \brief Erase and release the precompute state
+*
+* \param state [struct] The precompute state
+*/
+HKDS_EXPORT_API void hkds_precompute_dispose(hkds_precompute_state* state);
+
+/**
+* \brief Halve the activity count of every tracked device, so the table follows changes in traffic.
+* Call periodically, for example once per run interval.
+*
+* \param state [struct] The precompute state
+*/
+HKDS_EXPORT_API void hkds_precompute_age(hkds_precompute_state* state);
+
+/**
+* \brief Record a request from a client.
+* Devices that are not tracked replace the least active device of their set.
+*
+* \param state [struct] The precompute state
+* \param ksn [array][const] The clients key serial number
+*/
+HKDS_EXPORT_API void hkds_precompute_record(hkds_precompute_state* state, const uint8_t* ksn);
+
+/**
+* \brief Precompute the next epochs token and key cache for the most active devices.
+* Intended to be called from an idle loop or a background thread; material is derived in groups of eight.
+*
+* \param state [struct] The precompute state
+* \param maxdevices [size] The maximum number of devices to precompute in this call
+* \param maxtime [uint64] The time budget in microseconds, checked between groups; zero for no time limit
+* \return [size] The number of devices precomputed
+*/
+HKDS_EXPORT_API size_t hkds_precompute_run(hkds_precompute_state* state, size_t maxdevices, uint64_t maxtime);
+
+/**
+* \brief Decrypt a message sent by the client, using the precomputed key cache if available
+*
+* \param state [struct] The precompute state
+* \param server [struct] The server state initialized with the clients KSN
+* \param ciphertext [array][const] The encrypted message
+* \param plaintext [array][output] The decrypted message output
+*/
+HKDS_EXPORT_API void hkds_precompute_decrypt_message(hkds_precompute_state* state, hkds_server_state* server, const uint8_t* ciphertext, uint8_t* plaintext);
+
+/**
+* \brief Verify and decrypt a message sent by the client, using the precomputed key cache if available
+*
+* \param state [struct] The precompute state
+* \param server [struct] The server state initialized with the clients KSN
+* \param ciphertext [array][const] The encrypted message and authentication tag
+* \param data [array][const] The additional data array
+* \param datalen [size] The length of the additional data array
+* \param plaintext [array][output] The decrypted message output
+* \return [bool] Returns true if the message was authenticated and decrypted
+*/
+HKDS_EXPORT_API bool hkds_precompute_decrypt_verify_message(hkds_precompute_state* state, hkds_server_state* server, const uint8_t* ciphertext,
+	const uint8_t* data, size_t datalen, uint8_t* plaintext);
+
+/**
+* \brief Encrypt the clients token, using the precomputed token if available
+*
+* \param state [struct] The precompute state
+* \param server [struct] The server state initialized with the clients KSN
+* \param etok [array][output] The encrypted token output array
+*/
+HKDS_EXPORT_API void hkds_precompute_encrypt_token(hkds_precompute_state* state, hkds_server_state* server, uint8_t* etok);
+
+#endif
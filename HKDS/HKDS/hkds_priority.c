@@ -0,0 +1,252 @@
+#include "hkds_priority.h"
+#include "hkds_wire.h"
+#include "../QSC/memutils.h"
+#include "../QSC/timerex.h"
+
+static void hkds_priority_record(hkds_priority_queue* cls, uint64_t latency)
+{
+	size_t idx;
+
+	idx = 0;
+
+	while (idx < HKDS_PRIORITY_HISTOGRAM_SIZE - 1 && latency >= (1ULL << idx))
+	{
+		++idx;
+	}
+
+	++cls->histogram[idx];
+}
+
+void hkds_priority_initialize(hkds_priority_state* state, size_t depth, const uint32_t* weights)
+{
+	assert(state != NULL);
+	assert(depth != 0);
+
+	const uint64_t COSTS[HKDS_PRIORITY_CLASSES] = { HKDS_PRIORITY_COST_CONTROL, HKDS_PRIORITY_COST_MESSAGE, HKDS_PRIORITY_COST_TOKEN };
+	const uint64_t WEIGHTS[HKDS_PRIORITY_CLASSES] = { HKDS_PRIORITY_WEIGHT_CONTROL, HKDS_PRIORITY_WEIGHT_MESSAGE, HKDS_PRIORITY_WEIGHT_TOKEN };
+
+	qsc_memutils_clear((uint8_t*)state, sizeof(hkds_priority_state));
+
+	for (size_t i = 0; i < HKDS_PRIORITY_CLASSES; ++i)
+	{
+		qsc_queue_initialize(&state->classes[i].queue, depth, HKDS_PRIORITY_ITEM_SIZE);
+		state->classes[i].cost = COSTS[i];
+		state->classes[i].weight = (weights != NULL) ? weights[i] : WEIGHTS[i];
+
+		/* a zero weight would never be served */
+		if (state->classes[i].weight == 0)
+		{
+			state->classes[i].weight = 1;
+		}
+	}
+
+	state->current = 0;
+	state->credited = false;
+}
+
+void hkds_priority_dispose(hkds_priority_state* state)
+{
+	assert(state != NULL);
+
+	if (state != NULL)
+	{
+		for (size_t i = 0; i < HKDS_PRIORITY_CLASSES; ++i)
+		{
+			qsc_queue_destroy(&state->classes[i].queue);
+		}
+
+		qsc_memutils_clear((uint8_t*)state, sizeof(hkds_priority_state));
+	}
+}
+
+hkds_priority_class hkds_priority_classify(const uint8_t* packet)
+{
+	assert(packet != NULL);
+
+	hkds_priority_class res;
+
+	switch ((hkds_packet_type)((const hkds_wire_header*)packet)->flag)
+	{
+		case packet_administrative_message:
+		case packet_error_message:
+		{
+			res = hkds_priority_control;
+			break;
+		}
+		case packet_message_request:
+		{
+			res = hkds_priority_message;
+			break;
+		}
+		case packet_token_request:
+		{
+			res = hkds_priority_token;
+			break;
+		}
+		default:
+		{
+			res = hkds_priority_none;
+		}
+	}
+
+	return res;
+}
+
+bool hkds_priority_submit(hkds_priority_state* state, const uint8_t* packet, size_t pktlen)
+{
+	assert(state != NULL);
+	assert(packet != NULL);
+
+	hkds_priority_queue* cls;
+	hkds_priority_class pcls;
+	bool res;
+
+	res = false;
+
+	if (state != NULL && packet != NULL && pktlen >= HKDS_HEADER_SIZE && pktlen <= HKDS_PRIORITY_ITEM_SIZE)
+	{
+		pcls = hkds_priority_classify(packet);
+
+		if (pcls != hkds_priority_none)
+		{
+			cls = &state->classes[pcls];
+
+			if (qsc_queue_isfull(&cls->queue) == false)
+			{
+				qsc_queue_push(&cls->queue, packet, pktlen, qsc_timerex_monotonic_microseconds());
+				++cls->enqueued;
+				res = true;
+			}
+			else
+			{
+				++cls->dropped;
+			}
+		}
+	}
+
+	return res;
+}
+
+bool hkds_priority_next(hkds_priority_state* state, uint8_t* output, hkds_priority_class* pclass)
+{
+	assert(state != NULL);
+	assert(output != NULL);
+	assert(pclass != NULL);
+
+	hkds_priority_queue* cls;
+	uint64_t arrival;
+	uint64_t now;
+	size_t count;
+	bool res;
+
+	res = false;
+	count = 0;
+	*pclass = hkds_priority_none;
+
+	for (size_t i = 0; i < HKDS_PRIORITY_CLASSES; ++i)
+	{
+		count += qsc_queue_items(&state->classes[i].queue);
+	}
+
+	/* the deficit of a non-empty class grows on each visit, so the loop ends within a few rounds */
+	while (count != 0 && res == false)
+	{
+		cls = &state->classes[state->current];
+
+		if (qsc_queue_isempty(&cls->queue) == true)
+		{
+			/* an idle class does not accumulate credit */
+			cls->deficit = 0;
+			state->current = (state->current + 1) % HKDS_PRIORITY_CLASSES;
+			state->credited = false;
+		}
+		else
+		{
+			if (state->credited == false)
+			{
+				cls->deficit += cls->weight;
+				state->credited = true;
+			}
+
+			if (cls->deficit >= cls->cost)
+			{
+				cls->deficit -= cls->cost;
+				arrival = qsc_queue_pop(&cls->queue, output, HKDS_PRIORITY_ITEM_SIZE);
+				now = qsc_timerex_monotonic_microseconds();
+				hkds_priority_record(cls, (now > arrival) ? now - arrival : 0);
+				++cls->dequeued;
+				*pclass = (hkds_priority_class)state->current;
+				res = true;
+			}
+			else
+			{
+				state->current = (state->current + 1) % HKDS_PRIORITY_CLASSES;
+				state->credited = false;
+			}
+		}
+	}
+
+	return res;
+}
+
+size_t hkds_priority_pending(const hkds_priority_state* state, hkds_priority_class pclass)
+{
+	assert(state != NULL);
+	assert(pclass < hkds_priority_none);
+
+	size_t res;
+
+	res = 0;
+
+	if (pclass < hkds_priority_none)
+	{
+		res = qsc_queue_items(&state->classes[pclass].queue);
+	}
+
+	return res;
+}
+
+uint64_t hkds_priority_latency(const hkds_priority_state* state, hkds_priority_class pclass, uint32_t percentile)
+{
+	assert(state != NULL);
+	assert(pclass < hkds_priority_none);
+	assert(percentile != 0 && percentile <= 100);
+
+	const hkds_priority_queue* cls;
+	uint64_t sum;
+	uint64_t target;
+	uint64_t total;
+	uint64_t res;
+
+	total = 0;
+	res = 0;
+
+	if (pclass < hkds_priority_none)
+	{
+		cls = &state->classes[pclass];
+
+		for (size_t i = 0; i < HKDS_PRIORITY_HISTOGRAM_SIZE; ++i)
+		{
+			total += cls->histogram[i];
+		}
+
+		if (total != 0)
+		{
+			target = ((total * percentile) + 99) / 100;
+			sum = 0;
+
+			for (size_t i = 0; i < HKDS_PRIORITY_HISTOGRAM_SIZE; ++i)
+			{
+				sum += cls->histogram[i];
+
+				if (sum >= target)
+				{
+					res = 1ULL << i;
+					break;
+				}
+			}
+		}
+	}
+
+	return res;
+}
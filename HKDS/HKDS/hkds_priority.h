@@ -0,0 +1,187 @@
+/* 2021 Digital Freedom Defense Incorporated
+ * All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Digital Freedom Defense Incorporated.
+ * The intellectual and technical concepts contained
+ * herein are proprietary to Digital Freedom Defense Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Digital Freedom Defense Incorporated.
+ *
+ * Contact: develop@dfdef.com
+ */
+
+#ifndef HKDS_PRIORITY_H
+#define HKDS_PRIORITY_H
+
+#include "common.h"
+#include "hkds_config.h"
+#include "../QSC/queue.h"
+
+/* Priority classes with weighted fair scheduling.
+* Server ingress packets are classified by their packet type into three queues: control traffic
+* (administrative and error messages), message requests, and token requests.
+* The queues are served with deficit round robin; each visit adds the class weight to its deficit,
+* and a packet is dequeued when the deficit covers the cost of the packet type.
+* A token request costs several message decryptions, so a burst of token requests at an epoch rollover
+* takes a bounded share of the server, and message requests and control packets are not delayed behind it.
+* The time each packet waits in its queue is recorded in a per-class latency histogram.
+* The scheduler state is not thread safe; use one scheduler per server thread. */
+
+/*!
+\def HKDS_PRIORITY_CLASSES
+* The number of priority classes
+*/
+#define HKDS_PRIORITY_CLASSES 3
+
+/*!
+\def HKDS_PRIORITY_ITEM_SIZE
+* The size of a queued packet; the largest server ingress packet, a client message request
+*/
+#define HKDS_PRIORITY_ITEM_SIZE HKDS_CLIENT_MESSAGE_REQUEST_SIZE
+
+/*!
+\def HKDS_PRIORITY_HISTOGRAM_SIZE
+* The number of latency histogram buckets; bucket i counts latencies below 2^i microseconds
+*/
+#define HKDS_PRIORITY_HISTOGRAM_SIZE 32
+
+/*!
+\def HKDS_PRIORITY_COST_CONTROL
+* The scheduling cost of an administrative or error packet
+*/
+#define HKDS_PRIORITY_COST_CONTROL 1
+
+/*!
+\def HKDS_PRIORITY_COST_MESSAGE
+* The scheduling cost of a message request, one transaction key derivation
+*/
+#define HKDS_PRIORITY_COST_MESSAGE 1
+
+/*!
+\def HKDS_PRIORITY_COST_TOKEN
+* The scheduling cost of a token request; three SHAKE permutation sets and a KMAC
+*/
+#define HKDS_PRIORITY_COST_TOKEN 4
+
+/*!
+\def HKDS_PRIORITY_WEIGHT_CONTROL
+* The default weight of the control class, the cost units it is served in each round
+*/
+#define HKDS_PRIORITY_WEIGHT_CONTROL 4
+
+/*!
+\def HKDS_PRIORITY_WEIGHT_MESSAGE
+* The default weight of the message class
+*/
+#define HKDS_PRIORITY_WEIGHT_MESSAGE 8
+
+/*!
+\def HKDS_PRIORITY_WEIGHT_TOKEN
+* The default weight of the token class
+*/
+#define HKDS_PRIORITY_WEIGHT_TOKEN 2
+
+/*! \enum hkds_priority_class
+* The packet priority classes
+*/
+HKDS_EXPORT_API typedef enum
+{
+	hkds_priority_control = 0x00,		/*!< Administrative and error messages */
+	hkds_priority_message = 0x01,		/*!< Client message requests */
+	hkds_priority_token = 0x02,			/*!< Client token requests */
+	hkds_priority_none = 0x03,			/*!< The packet is not a server ingress packet */
+} hkds_priority_class;
+
+/*! \struct hkds_priority_queue
+* A priority class queue and its metrics
+*/
+HKDS_EXPORT_API typedef struct
+{
+	qsc_queue_state queue;									/*!< The pending packets, tagged with their arrival time */
+	uint64_t histogram[HKDS_PRIORITY_HISTOGRAM_SIZE];		/*!< The queueing latency histogram */
+	uint64_t cost;											/*!< The cost of a packet */
+	uint64_t deficit;										/*!< The deficit round robin credit */
+	uint64_t weight;										/*!< The credit added in each round */
+	uint64_t enqueued;										/*!< The number of packets queued */
+	uint64_t dequeued;										/*!< The number of packets scheduled */
+	uint64_t dropped;										/*!< The number of packets rejected by a full queue */
+} hkds_priority_queue;
+
+/*! \struct hkds_priority_state
+* Contains the priority scheduler state
+*/
+HKDS_EXPORT_API typedef struct
+{
+	hkds_priority_queue classes[HKDS_PRIORITY_CLASSES];		/*!< The class queues */
+	size_t current;											/*!< The class visited by the round robin */
+	bool credited;											/*!< The current class has received its weight in this visit */
+} hkds_priority_state;
+
+/**
+* \brief Initialize the priority scheduler
+*
+* \param state [struct] The scheduler state
+* \param depth [size] The maximum number of packets held by each class queue
+* \param weights [array][const] The class weights indexed by hkds_priority_class, or NULL for the default weights
+*/
+HKDS_EXPORT_API void hkds_priority_initialize(hkds_priority_state* state, size_t depth, const uint32_t* weights);
+
+/**
+* \brief Release the class queues and erase the scheduler state
+*
+* \param state [struct] The scheduler state
+*/
+HKDS_EXPORT_API void hkds_priority_dispose(hkds_priority_state* state);
+
+/**
+* \brief Get the priority class of a packet
+*
+* \param packet [array][const] The serialized packet
+* \return [enum] The packet class, or hkds_priority_none if the packet is not server ingress traffic
+*/
+HKDS_EXPORT_API hkds_priority_class hkds_priority_classify(const uint8_t* packet);
+
+/**
+* \brief Add a packet to the queue of its class
+*
+* \param state [struct] The scheduler state
+* \param packet [array][const] The serialized packet
+* \param pktlen [size] The packet length, at most HKDS_PRIORITY_ITEM_SIZE
+* \return [bool] Returns false if the packet is not server ingress traffic, or its class queue is full
+*/
+HKDS_EXPORT_API bool hkds_priority_submit(hkds_priority_state* state, const uint8_t* packet, size_t pktlen);
+
+/**
+* \brief Remove the next packet selected by the weighted scheduler
+*
+* \param state [struct] The scheduler state
+* \param output [array] The array receiving the packet, HKDS_PRIORITY_ITEM_SIZE bytes
+* \param pclass [enum] Receives the class of the packet
+* \return [bool] Returns false if every queue is empty
+*/
+HKDS_EXPORT_API bool hkds_priority_next(hkds_priority_state* state, uint8_t* output, hkds_priority_class* pclass);
+
+/**
+* \brief Get the number of packets waiting in a class queue
+*
+* \param state [struct][const] The scheduler state
+* \param pclass [enum] The priority class
+* \return [size] The number of queued packets
+*/
+HKDS_EXPORT_API size_t hkds_priority_pending(const hkds_priority_state* state, hkds_priority_class pclass);
+
+/**
+* \brief Get a percentile of the queueing latency of a class, from the latency histogram
+*
+* \param state [struct][const] The scheduler state
+* \param pclass [enum] The priority class
+* \param percentile [uint32] The percentile, 1 to 100
+* \return [uint64] The upper bound of the histogram bucket containing the percentile in microseconds, zero if no packets were scheduled
+*/
+HKDS_EXPORT_API uint64_t hkds_priority_latency(const hkds_priority_state* state, hkds_priority_class pclass, uint32_t percentile);
+
+#endif
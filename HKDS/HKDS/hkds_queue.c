@@ -1,4 +1,6 @@
 #include "hkds_queue.h"
+#include "../QSC/atomics.h"
+#include "../QSC/memutils.h"
 
 void hkds_queue_destroy(hkds_queue_message_queue* ctx)
 {
@@ -18,7 +20,7 @@ void hkds_queue_initialize(hkds_queue_message_queue* ctx, size_t depth, size_t w
 
 void hkds_queue_pop(hkds_queue_message_queue* ctx, uint8_t* output, size_t outlen)
 {
-	if (ctx->state.position != 0)
+	if (ctx->state.count != 0)
 	{
 		qsc_queue_pop(&ctx->state, output, outlen);
 	}
@@ -26,7 +28,7 @@ void hkds_queue_pop(hkds_queue_message_queue* ctx, uint8_t* output, size_t outle
 
 void hkds_queue_push(hkds_queue_message_queue* ctx, const uint8_t* output, size_t outlen)
 {
-	if (ctx->state.position != ctx->state.depth)
+	if (ctx->state.count != ctx->state.depth)
 	{
 		qsc_queue_push(&ctx->state, output, outlen, 0);
 	}
@@ -55,12 +57,9 @@ size_t hkds_queue_extract_block_x8(hkds_queue_message_queue* ctx, uint8_t output
 
 	i = 0;
 
-	if (ctx->state.position >= HKDS_CACHX8_DEPTH)
+	if (ctx->state.count >= HKDS_CACHX8_DEPTH)
 	{
-		for (i = 0; i < HKDS_CACHX8_DEPTH; ++i)
-		{
-			qsc_queue_pop(&ctx->state, output[i], ctx->state.width);
-		}
+		i = qsc_queue_pop_bulk(&ctx->state, (uint8_t*)output, NULL, HKDS_CACHX8_DEPTH);
 	}
 
 	return i;
@@ -69,23 +68,16 @@ size_t hkds_queue_extract_block_x8(hkds_queue_message_queue* ctx, uint8_t output
 size_t hkds_queue_extract_block_x64(hkds_queue_message_queue* ctx, uint8_t output[HKDS_PARALLEL_DEPTH][HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE])
 {
 	size_t i;
-	size_t j;
 
 	i = 0;
-	j = 0;
 
-	if (ctx->state.position >= HKDS_CACHX64_SIZE)
+	if (ctx->state.count >= HKDS_CACHX64_SIZE)
 	{
-		for (i = 0; i < HKDS_PARALLEL_DEPTH; ++i)
-		{
-			for (j = 0; j < HKDS_CACHX8_DEPTH; ++j)
-			{
-				qsc_queue_pop(&ctx->state, output[i][j], ctx->state.width);
-			}
-		}
+		/* the 8x8 block is contiguous, so the batch is removed with one bulk copy */
+		i = qsc_queue_pop_bulk(&ctx->state, (uint8_t*)output, NULL, HKDS_CACHX64_SIZE);
 	}
 
-	return (i * j);
+	return i;
 }
 
 /* stream queue serialization */
@@ -96,13 +88,274 @@ size_t hkds_queue_extract_stream(hkds_queue_message_queue* ctx, uint8_t* stream,
 
 	i = 0;
 
-	if (ctx->state.position >= items)
+	if (ctx->state.count >= items)
+	{
+		i = qsc_queue_pop_bulk(&ctx->state, stream, NULL, items);
+	}
+
+	return i;
+}
+
+/* lock-free multi-producer multi-consumer queue */
+
+static size_t hkds_queue_mpmc_claim(hkds_queue_mpmc* ctx, volatile uint64_t* position, uint64_t offset, size_t count, bool exact, uint64_t* start)
+{
+	uint64_t pos;
+	uint64_t cur;
+	size_t res;
+
+	pos = qsc_atomics_load64(position);
+
+	while (true)
 	{
-		for (i = 0; i < items; ++i)
+		/* count the slots ready for this side; free slots hold their position, filled slots hold the position plus one */
+		res = 0;
+
+		while (res < count && qsc_atomics_load64(&ctx->sequence[(pos + res) & ctx->mask]) == pos + res + offset)
 		{
-			qsc_queue_pop(&ctx->state, (stream + (i * ctx->state.width)), ctx->state.width);
+			++res;
+		}
+
+		if (res == 0 || (exact == true && res != count))
+		{
+			cur = qsc_atomics_load64(position);
+
+			if (cur == pos)
+			{
+				/* the queue is full or empty for this request */
+				res = 0;
+				break;
+			}
+
+			pos = cur;
+		}
+		else if (qsc_atomics_compare_exchange64(position, &pos, pos + res) == true)
+		{
+			*start = pos;
+			break;
 		}
 	}
 
-	return i;
+	return res;
+}
+
+static size_t hkds_queue_mpmc_write(hkds_queue_mpmc* ctx, const uint8_t* input, size_t inlen, size_t count)
+{
+	uint64_t pos;
+	size_t slot;
+	size_t res;
+
+	res = hkds_queue_mpmc_claim(ctx, &ctx->enqueue, 0, count, false, &pos);
+
+	for (size_t i = 0; i < res; ++i)
+	{
+		slot = (size_t)((pos + i) & ctx->mask);
+		qsc_memutils_copy(ctx->slots + (slot * ctx->width), input + (i * ctx->width), inlen);
+		/* publish the slot to the consumers */
+		qsc_atomics_store64(&ctx->sequence[slot], pos + i + 1);
+	}
+
+	return res;
+}
+
+static size_t hkds_queue_mpmc_read(hkds_queue_mpmc* ctx, uint8_t* output, size_t outlen, size_t count, bool exact)
+{
+	uint64_t pos;
+	size_t slot;
+	size_t res;
+
+	res = hkds_queue_mpmc_claim(ctx, &ctx->dequeue, 1, count, exact, &pos);
+
+	for (size_t i = 0; i < res; ++i)
+	{
+		slot = (size_t)((pos + i) & ctx->mask);
+		qsc_memutils_copy(output + (i * outlen), ctx->slots + (slot * ctx->width), outlen);
+		qsc_memutils_clear(ctx->slots + (slot * ctx->width), ctx->width);
+		/* return the slot to the producers for the next lap of the ring */
+		qsc_atomics_store64(&ctx->sequence[slot], pos + i + ctx->mask + 1);
+	}
+
+	return res;
+}
+
+void hkds_queue_mpmc_destroy(hkds_queue_mpmc* ctx)
+{
+	assert(ctx != NULL);
+
+	if (ctx != NULL)
+	{
+		if (ctx->slots != NULL)
+		{
+			qsc_memutils_clear(ctx->slots, (ctx->mask + 1) * ctx->width);
+			qsc_memutils_aligned_free(ctx->slots);
+			ctx->slots = NULL;
+		}
+
+		if (ctx->sequence != NULL)
+		{
+			qsc_memutils_aligned_free((void*)ctx->sequence);
+			ctx->sequence = NULL;
+		}
+
+		ctx->mask = 0;
+		ctx->width = 0;
+		ctx->enqueue = 0;
+		ctx->dequeue = 0;
+	}
+}
+
+bool hkds_queue_mpmc_initialize(hkds_queue_mpmc* ctx, size_t depth, size_t width)
+{
+	assert(ctx != NULL);
+	assert(depth != 0 && width != 0);
+
+	size_t slots;
+	bool res;
+
+	res = false;
+
+	if (ctx != NULL && depth != 0 && width != 0)
+	{
+		slots = 2;
+
+		while (slots < depth)
+		{
+			slots <<= 1;
+		}
+
+		qsc_memutils_clear((uint8_t*)ctx, sizeof(hkds_queue_mpmc));
+		ctx->sequence = (volatile uint64_t*)qsc_memutils_aligned_alloc(QSC_QUEUE_ALIGNMENT, slots * sizeof(uint64_t));
+		ctx->slots = (uint8_t*)qsc_memutils_aligned_alloc(QSC_QUEUE_ALIGNMENT, slots * width);
+		ctx->mask = slots - 1;
+		ctx->width = width;
+
+		if (ctx->sequence != NULL && ctx->slots != NULL)
+		{
+			qsc_memutils_clear(ctx->slots, slots * width);
+
+			for (size_t i = 0; i < slots; ++i)
+			{
+				ctx->sequence[i] = i;
+			}
+
+			res = true;
+		}
+		else
+		{
+			hkds_queue_mpmc_destroy(ctx);
+		}
+	}
+
+	return res;
+}
+
+bool hkds_queue_mpmc_push(hkds_queue_mpmc* ctx, const uint8_t* input, size_t inlen)
+{
+	assert(ctx != NULL);
+	assert(input != NULL);
+	assert(inlen != 0);
+
+	bool res;
+
+	res = false;
+
+	if (ctx != NULL && input != NULL && inlen != 0 && inlen <= ctx->width)
+	{
+		res = (hkds_queue_mpmc_write(ctx, input, inlen, 1) == 1);
+	}
+
+	return res;
+}
+
+bool hkds_queue_mpmc_pop(hkds_queue_mpmc* ctx, uint8_t* output, size_t outlen)
+{
+	assert(ctx != NULL);
+	assert(output != NULL);
+	assert(outlen != 0);
+
+	bool res;
+
+	res = false;
+
+	if (ctx != NULL && output != NULL && outlen != 0 && outlen <= ctx->width)
+	{
+		res = (hkds_queue_mpmc_read(ctx, output, outlen, 1, true) == 1);
+	}
+
+	return res;
+}
+
+size_t hkds_queue_mpmc_push_batch(hkds_queue_mpmc* ctx, const uint8_t* input, size_t count)
+{
+	assert(ctx != NULL);
+	assert(input != NULL);
+
+	size_t cnt;
+	size_t res;
+
+	res = 0;
+
+	if (ctx != NULL && input != NULL)
+	{
+		while (res < count)
+		{
+			/* a batch larger than the free run is added over several claims */
+			cnt = hkds_queue_mpmc_write(ctx, input + (res * ctx->width), ctx->width, count - res);
+
+			if (cnt == 0)
+			{
+				break;
+			}
+
+			res += cnt;
+		}
+	}
+
+	return res;
+}
+
+size_t hkds_queue_mpmc_pop_batch(hkds_queue_mpmc* ctx, uint8_t* output, size_t count)
+{
+	assert(ctx != NULL);
+	assert(output != NULL);
+
+	size_t res;
+
+	res = 0;
+
+	if (ctx != NULL && output != NULL && count != 0)
+	{
+		res = hkds_queue_mpmc_read(ctx, output, ctx->width, count, false);
+	}
+
+	return res;
+}
+
+size_t hkds_queue_mpmc_count(const hkds_queue_mpmc* ctx)
+{
+	assert(ctx != NULL);
+
+	uint64_t deq;
+	uint64_t enq;
+
+	deq = qsc_atomics_load64(&ctx->dequeue);
+	enq = qsc_atomics_load64(&ctx->enqueue);
+
+	return (enq > deq) ? (size_t)(enq - deq) : 0;
+}
+
+size_t hkds_queue_mpmc_extract_block_x8(hkds_queue_mpmc* ctx, uint8_t output[HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE])
+{
+	assert(ctx != NULL);
+	assert(ctx->width == HKDS_MESSAGE_SIZE);
+
+	return hkds_queue_mpmc_read(ctx, (uint8_t*)output, HKDS_MESSAGE_SIZE, HKDS_CACHX8_DEPTH, true);
+}
+
+size_t hkds_queue_mpmc_extract_block_x64(hkds_queue_mpmc* ctx, uint8_t output[HKDS_PARALLEL_DEPTH][HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE])
+{
+	assert(ctx != NULL);
+	assert(ctx->width == HKDS_MESSAGE_SIZE);
+
+	return hkds_queue_mpmc_read(ctx, (uint8_t*)output, HKDS_MESSAGE_SIZE, HKDS_CACHX64_SIZE, true);
 }
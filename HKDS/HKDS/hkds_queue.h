@@ -43,6 +43,25 @@ typedef struct hkds_queue_message_queue
 }
 hkds_queue_message_queue;
 
+/*! \struct hkds_queue_mpmc
+* Contains the lock-free multi-producer multi-consumer queue state.
+* Each slot carries a sequence number that tells a producer the slot is free, and a consumer the slot is filled,
+* so producers and consumers only contend on their own position counter.
+*/
+typedef struct hkds_queue_mpmc
+{
+	volatile uint64_t* sequence;	/*!< The slot sequence numbers */
+	uint8_t* slots;					/*!< The slot slab, width bytes per slot */
+	size_t mask;					/*!< The number of slots minus one */
+	size_t width;					/*!< The byte size of a slot */
+	uint8_t pad1[32];				/*!< Keeps the positions off the read-only line */
+	volatile uint64_t enqueue;		/*!< The next position written by a producer */
+	uint8_t pad2[56];				/*!< Keeps the positions on separate cache lines */
+	volatile uint64_t dequeue;		/*!< The next position read by a consumer */
+	uint8_t pad3[56];				/*!< Cache line padding */
+}
+hkds_queue_mpmc;
+
 /**
 * \brief Resets the queue context state
 *
@@ -131,4 +150,92 @@ HKDS_EXPORT_API size_t hkds_queue_extract_block_x64(hkds_queue_message_queue* ct
 */
 HKDS_EXPORT_API size_t hkds_queue_extract_stream(hkds_queue_message_queue* ctx, uint8_t* stream, size_t items);
 
+/* lock-free multi-producer multi-consumer queue */
+
+/**
+* \brief Release the lock-free queue.
+* Must not be called while other threads are using the queue.
+*
+* \param ctx [struct] The lock-free queue state
+*/
+HKDS_EXPORT_API void hkds_queue_mpmc_destroy(hkds_queue_mpmc* ctx);
+
+/**
+* \brief Initialize the lock-free queue
+*
+* \param ctx [struct] The lock-free queue state
+* \param depth [size] The number of slots, rounded up to a power of two
+* \param width [size] The byte size of a queued packet
+* \return [bool] Returns true if the queue was allocated
+*/
+HKDS_EXPORT_API bool hkds_queue_mpmc_initialize(hkds_queue_mpmc* ctx, size_t depth, size_t width);
+
+/**
+* \brief Add a packet to the lock-free queue, can be called by any thread
+*
+* \param ctx [struct] The lock-free queue state
+* \param input [array][const] The packet
+* \param inlen [size] The packet length, at most the queue width; a shorter packet is zero padded
+* \return [bool] Returns false if the queue is full
+*/
+HKDS_EXPORT_API bool hkds_queue_mpmc_push(hkds_queue_mpmc* ctx, const uint8_t* input, size_t inlen);
+
+/**
+* \brief Remove a packet from the lock-free queue, can be called by any thread
+*
+* \param ctx [struct] The lock-free queue state
+* \param output [array] The array receiving the packet
+* \param outlen [size] The number of bytes to copy, at most the queue width
+* \return [bool] Returns false if the queue is empty
+*/
+HKDS_EXPORT_API bool hkds_queue_mpmc_pop(hkds_queue_mpmc* ctx, uint8_t* output, size_t outlen);
+
+/**
+* \brief Add a set of packets to the lock-free queue, claiming their slots with one atomic operation
+*
+* \param ctx [struct] The lock-free queue state
+* \param input [array][const] The packets, at a stride of the queue width
+* \param count [size] The number of packets
+* \return [size] The number of packets added, in order
+*/
+HKDS_EXPORT_API size_t hkds_queue_mpmc_push_batch(hkds_queue_mpmc* ctx, const uint8_t* input, size_t count);
+
+/**
+* \brief Remove up to count packets from the lock-free queue, claiming their slots with one atomic operation
+*
+* \param ctx [struct] The lock-free queue state
+* \param output [array] The array receiving the packets, at a stride of the queue width
+* \param count [size] The maximum number of packets
+* \return [size] The number of packets removed
+*/
+HKDS_EXPORT_API size_t hkds_queue_mpmc_pop_batch(hkds_queue_mpmc* ctx, uint8_t* output, size_t count);
+
+/**
+* \brief Returns the number of packets in the lock-free queue; a snapshot while other threads are active
+*
+* \param ctx [struct] The lock-free queue state
+* \return [size] The number of packets
+*/
+HKDS_EXPORT_API size_t hkds_queue_mpmc_count(const hkds_queue_mpmc* ctx);
+
+/**
+* \brief Remove a block of 8 messages from the lock-free queue, or nothing if fewer are queued.
+* Consumers can call this concurrently; each block is taken by one consumer.
+*
+* \param ctx [struct] The lock-free queue state
+* \param output [array2d] The 2d array receiving the messages; containing HKDS_CACHX8_DEPTH of items of array HKDS_MESSAGE_SIZE length
+* \return [size] The number of items exported
+*/
+HKDS_EXPORT_API size_t hkds_queue_mpmc_extract_block_x8(hkds_queue_mpmc* ctx, uint8_t output[HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE]);
+
+/**
+* \brief Remove 8 slots 8 blocks of messages (8x8) from the lock-free queue, or nothing if fewer are queued.
+* Consumers can call this concurrently; each block is taken by one consumer.
+*
+* \param ctx [struct] The lock-free queue state
+* \param output [array3d] The 3d array receiving the messages; HKDS_PARALLEL_DEPTH slots, containing HKDS_CACHX64_DEPTH of items of array HKDS_MESSAGE_SIZE length
+* \return [size] The number of items exported
+*/
+HKDS_EXPORT_API size_t hkds_queue_mpmc_extract_block_x64(hkds_queue_mpmc* ctx, uint8_t output[HKDS_PARALLEL_DEPTH][HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE]);
+
 #endif
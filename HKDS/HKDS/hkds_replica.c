@@ -0,0 +1,561 @@
+#include "hkds_replica.h"
+#include "../QSC/atomics.h"
+#include "../QSC/fileutils.h"
+#include "../QSC/intutils.h"
+#include "../QSC/memutils.h"
+#include "../QSC/stringutils.h"
+
+#define HKDS_REPLICA_MAGIC 0x31474C5253444B48ULL
+#define HKDS_REPLICA_END 0xFFFFFFFFFFFFFFFFULL
+#define HKDS_REPLICA_TEMP_EXTENSION ".tmp"
+
+static bool hkds_replica_log_write(hkds_replica_log_state* state, FILE* fp, size_t count)
+{
+	size_t len;
+
+	len = count * HKDS_REPLICA_RECORD_SIZE;
+
+	return (fwrite(state->buffer, 1, len, fp) == len);
+}
+
+static bool hkds_replica_log_header(const hkds_replica_log_state* state, FILE* fp)
+{
+	uint8_t hdr[HKDS_REPLICA_HEADER_SIZE] = { 0 };
+
+	qsc_intutils_le64to8(hdr, HKDS_REPLICA_MAGIC);
+	qsc_intutils_le64to8(hdr + sizeof(uint64_t), (uint64_t)state->table->count);
+
+	return (fwrite(hdr, 1, sizeof(hdr), fp) == sizeof(hdr));
+}
+
+static bool hkds_replica_log_snapshot(hkds_replica_log_state* state, FILE* fp, size_t* count)
+{
+	uint64_t rec;
+	size_t cnt;
+	bool res;
+
+	cnt = 0;
+	*count = 0;
+	res = true;
+
+	/* every occupied slot is written; the standby keeps the larger of a snapshot record and its own */
+	for (size_t i = 0; i < state->table->count && res == true; ++i)
+	{
+		if (hkds_counter_read(state->table, i, &rec) == true)
+		{
+			qsc_intutils_le64to8(state->buffer + (cnt * HKDS_REPLICA_RECORD_SIZE), (uint64_t)i);
+			qsc_intutils_le64to8(state->buffer + (cnt * HKDS_REPLICA_RECORD_SIZE) + sizeof(uint64_t), rec);
+			++cnt;
+
+			if (cnt == HKDS_REPLICA_BATCH)
+			{
+				res = hkds_replica_log_write(state, fp, cnt);
+				*count += cnt;
+				cnt = 0;
+			}
+		}
+	}
+
+	if (res == true && cnt != 0)
+	{
+		res = hkds_replica_log_write(state, fp, cnt);
+		*count += cnt;
+	}
+
+	if (res == true)
+	{
+		qsc_atomics_fetch_add64(&state->snapshots, 1);
+	}
+
+	return res;
+}
+
+static bool hkds_replica_log_compact(hkds_replica_log_state* state)
+{
+	char tmp[QSC_SYSTEM_MAX_PATH] = { 0 };
+	uint8_t end[HKDS_REPLICA_RECORD_SIZE] = { 0 };
+	FILE* fp;
+	errno_t err;
+	size_t cnt;
+	bool res;
+
+	cnt = 0;
+	res = false;
+	qsc_stringutils_concat_and_copy(tmp, sizeof(tmp), state->path, HKDS_REPLICA_TEMP_EXTENSION);
+	fp = qsc_filetools_open_file(tmp, "wb", &err);
+
+	if (fp != NULL)
+	{
+		/* the new log begins with a snapshot of the table, which holds every update in the current log */
+		res = (hkds_replica_log_header(state, fp) == true && hkds_replica_log_snapshot(state, fp, &cnt) == true);
+		res = (fclose(fp) == 0 && res == true);
+
+		if (res == true && rename(tmp, state->path) != 0)
+		{
+			/* a platform that does not replace an existing file on rename; this fails while a standby holds the log open */
+			res = (remove(state->path) == 0 && rename(tmp, state->path) == 0);
+		}
+
+		if (res == true)
+		{
+			fp = qsc_filetools_open_file(state->path, "r+b", &err);
+			res = (fp != NULL && fseek(fp, 0, SEEK_END) == 0);
+
+			if (res == true)
+			{
+				/* the end record is written after the new log is in place, and moves the standby to it */
+				qsc_intutils_le64to8(end, HKDS_REPLICA_END);
+				fwrite(end, 1, sizeof(end), state->fp);
+				fclose(state->fp);
+				state->fp = fp;
+				state->offset = HKDS_REPLICA_HEADER_SIZE + (cnt * HKDS_REPLICA_RECORD_SIZE);
+				state->logged = cnt;
+				qsc_atomics_fetch_add64(&state->records, cnt);
+				qsc_atomics_fetch_add64(&state->compactions, 1);
+			}
+			else if (fp != NULL)
+			{
+				fclose(fp);
+			}
+		}
+		else
+		{
+			remove(tmp);
+		}
+	}
+
+	/* a log that could not be compacted is tried again after it has grown by the same amount */
+	state->limit = state->logged + (HKDS_REPLICA_COMPACT_RATIO * state->table->count);
+
+	return res;
+}
+
+static size_t hkds_replica_log_flush(hkds_replica_log_state* state)
+{
+	hkds_replica_slot* slot;
+	size_t cnt;
+	size_t res;
+	bool more;
+	bool ok;
+
+	res = 0;
+	more = true;
+	ok = true;
+
+	/* the writer is the only consumer of the ring, the tail is not shared */
+	while (more == true)
+	{
+		cnt = 0;
+		slot = &state->slots[state->tail & (state->capacity - 1)];
+
+		while (cnt < HKDS_REPLICA_BATCH && qsc_atomics_load64(&slot->sequence) == state->tail + 1)
+		{
+			qsc_intutils_le64to8(state->buffer + (cnt * HKDS_REPLICA_RECORD_SIZE), slot->index);
+			qsc_intutils_le64to8(state->buffer + (cnt * HKDS_REPLICA_RECORD_SIZE) + sizeof(uint64_t), slot->record);
+			/* the slot is next written one lap later */
+			qsc_atomics_store64(&slot->sequence, state->tail + state->capacity);
+			++state->tail;
+			++cnt;
+			slot = &state->slots[state->tail & (state->capacity - 1)];
+		}
+
+		if (cnt != 0)
+		{
+			ok = hkds_replica_log_write(state, state->fp, cnt);
+			res += cnt;
+		}
+
+		more = (ok == true && cnt == HKDS_REPLICA_BATCH);
+	}
+
+	/* the dropped updates are already in the table, so a snapshot taken after the flag is cleared holds them */
+	if (ok == true && qsc_atomics_exchange64(&state->overflow, 0) != 0)
+	{
+		ok = hkds_replica_log_snapshot(state, state->fp, &cnt);
+		res += cnt;
+	}
+
+	if (res != 0)
+	{
+		/* the records are written when the stream is flushed */
+		ok = (ok == true && fflush(state->fp) == 0);
+
+		if (ok == true)
+		{
+			state->offset += res * HKDS_REPLICA_RECORD_SIZE;
+			state->logged += res;
+			qsc_atomics_fetch_add64(&state->records, res);
+		}
+		else
+		{
+			/* the failed records are not counted, and the next write replaces them; the updates they carried are in the table,
+				so the snapshot that follows the next successful write restores them */
+			clearerr(state->fp);
+			fseek(state->fp, (long)state->offset, SEEK_SET);
+			qsc_atomics_store64(&state->overflow, 1);
+			qsc_atomics_fetch_add64(&state->failures, 1);
+			res = 0;
+		}
+	}
+
+	if (ok == true && state->logged > state->limit)
+	{
+		hkds_replica_log_compact(state);
+	}
+
+	return res;
+}
+
+static void hkds_replica_log_run(void* context)
+{
+	hkds_replica_log_state* state;
+
+	state = (hkds_replica_log_state*)context;
+
+	while (qsc_atomics_load64(&state->running) != 0)
+	{
+		if (hkds_replica_log_flush(state) == 0)
+		{
+			qsc_async_thread_sleep(HKDS_REPLICA_POLL_INTERVAL);
+		}
+	}
+}
+
+bool hkds_replica_log_open(hkds_replica_log_state* state, hkds_counter_table* table, const char* path, size_t capacity)
+{
+	assert(state != NULL);
+	assert(table != NULL);
+	assert(path != NULL);
+
+	errno_t err;
+	size_t cap;
+	size_t cnt;
+	bool res;
+
+	res = false;
+
+	if (state != NULL && table != NULL && table->records != NULL && path != NULL && capacity != 0 &&
+		qsc_stringutils_string_size(path) + sizeof(HKDS_REPLICA_TEMP_EXTENSION) <= sizeof(state->path))
+	{
+		qsc_memutils_clear(state, sizeof(hkds_replica_log_state));
+		qsc_stringutils_copy_string(state->path, sizeof(state->path), path);
+		cap = 2;
+
+		while (cap < capacity)
+		{
+			cap <<= 1;
+		}
+
+		state->table = table;
+		state->capacity = cap;
+		state->slots = (hkds_replica_slot*)qsc_memutils_malloc(cap * sizeof(hkds_replica_slot));
+		state->fp = qsc_filetools_open_file(path, "wb", &err);
+
+		if (state->slots != NULL && state->fp != NULL)
+		{
+			for (size_t i = 0; i < cap; ++i)
+			{
+				state->slots[i].sequence = i;
+			}
+
+			/* the standby starts from the state of the table when the log is opened */
+			if (hkds_replica_log_header(state, state->fp) == true && hkds_replica_log_snapshot(state, state->fp, &cnt) == true &&
+				fflush(state->fp) == 0)
+			{
+				state->offset = HKDS_REPLICA_HEADER_SIZE + (cnt * HKDS_REPLICA_RECORD_SIZE);
+				state->logged = cnt;
+				state->limit = cnt + (HKDS_REPLICA_COMPACT_RATIO * table->count);
+				qsc_atomics_store64(&state->records, cnt);
+				state->running = 1;
+				state->thread = qsc_async_thread_create(&hkds_replica_log_run, state);
+				res = (state->thread != 0);
+			}
+		}
+
+		if (res == false)
+		{
+			if (state->fp != NULL)
+			{
+				fclose(state->fp);
+				state->fp = NULL;
+			}
+
+			if (state->slots != NULL)
+			{
+				qsc_memutils_alloc_free(state->slots);
+				state->slots = NULL;
+			}
+		}
+	}
+
+	return res;
+}
+
+void hkds_replica_log_close(hkds_replica_log_state* state)
+{
+	assert(state != NULL);
+
+	if (state != NULL && state->fp != NULL)
+	{
+		qsc_atomics_store64(&state->running, 0);
+		qsc_async_thread_wait(state->thread);
+		/* the updates added while the thread stopped are written before the file is closed */
+		hkds_replica_log_flush(state);
+		fclose(state->fp);
+		state->fp = NULL;
+		qsc_memutils_alloc_free(state->slots);
+		state->slots = NULL;
+	}
+}
+
+bool hkds_replica_log_append(hkds_replica_log_state* state, size_t index, uint64_t record)
+{
+	assert(state != NULL);
+
+	hkds_replica_slot* slot;
+	uint64_t pos;
+	uint64_t seq;
+	bool done;
+	bool res;
+
+	res = false;
+
+	if (state != NULL && state->slots != NULL)
+	{
+		pos = qsc_atomics_load64(&state->head);
+		done = false;
+
+		/* the slot at the head is free when its sequence equals the position */
+		while (done == false)
+		{
+			slot = &state->slots[pos & (state->capacity - 1)];
+			seq = qsc_atomics_load64(&slot->sequence);
+
+			if (seq == pos)
+			{
+				if (qsc_atomics_compare_exchange64(&state->head, &pos, pos + 1) == true)
+				{
+					slot->index = (uint64_t)index;
+					slot->record = record;
+					qsc_atomics_store64(&slot->sequence, pos + 1);
+					res = true;
+					done = true;
+				}
+			}
+			else if ((int64_t)(seq - pos) < 0)
+			{
+				/* the ring is full; the writer appends a snapshot instead */
+				qsc_atomics_store64(&state->overflow, 1);
+				done = true;
+			}
+			else
+			{
+				pos = qsc_atomics_load64(&state->head);
+			}
+		}
+	}
+
+	return res;
+}
+
+bool hkds_replica_update(hkds_replica_log_state* state, size_t index, uint64_t record)
+{
+	assert(state != NULL);
+
+	bool res;
+
+	res = false;
+
+	if (state != NULL && state->table != NULL)
+	{
+		/* the table is raised first, so a snapshot that follows a dropped update includes it */
+		res = hkds_counter_update(state->table, index, record);
+
+		if (res == true)
+		{
+			hkds_replica_log_append(state, index, record);
+		}
+	}
+
+	return res;
+}
+
+static bool hkds_replica_standby_attach(hkds_replica_standby_state* state)
+{
+	uint8_t hdr[HKDS_REPLICA_HEADER_SIZE] = { 0 };
+	errno_t err;
+	bool res;
+
+	res = false;
+	state->pending = 0;
+	state->fp = qsc_filetools_open_file(state->path, "rb", &err);
+
+	if (state->fp != NULL)
+	{
+		/* the standby table must hold the same device slots as the primary */
+		res = (fread(hdr, 1, sizeof(hdr), state->fp) == sizeof(hdr) && qsc_intutils_le8to64(hdr) == HKDS_REPLICA_MAGIC &&
+			qsc_intutils_le8to64(hdr + sizeof(uint64_t)) == (uint64_t)state->table->count);
+
+		if (res == false)
+		{
+			fclose(state->fp);
+			state->fp = NULL;
+		}
+	}
+
+	return res;
+}
+
+size_t hkds_replica_standby_poll(hkds_replica_standby_state* state)
+{
+	assert(state != NULL);
+
+	uint64_t idx;
+	size_t cnt;
+	size_t len;
+	size_t rcnt;
+	size_t res;
+	bool end;
+	bool more;
+
+	res = 0;
+
+	if (state != NULL && state->fp != NULL)
+	{
+		more = true;
+
+		while (more == true)
+		{
+			len = fread(state->buffer + state->pending, 1, sizeof(state->buffer) - state->pending, state->fp);
+
+			if (len == 0)
+			{
+				/* the end of the log; clear it so that the next read sees the records appended since */
+				clearerr(state->fp);
+			}
+
+			len += state->pending;
+			rcnt = len / HKDS_REPLICA_RECORD_SIZE;
+			cnt = 0;
+			end = false;
+
+			while (cnt < rcnt && end == false)
+			{
+				idx = qsc_intutils_le8to64(state->buffer + (cnt * HKDS_REPLICA_RECORD_SIZE));
+
+				if (idx == HKDS_REPLICA_END)
+				{
+					end = true;
+				}
+				else
+				{
+					state->entries[cnt].index = (size_t)idx;
+					state->entries[cnt].record = qsc_intutils_le8to64(state->buffer + (cnt * HKDS_REPLICA_RECORD_SIZE) + sizeof(uint64_t));
+					++cnt;
+				}
+			}
+
+			if (cnt != 0)
+			{
+				hkds_counter_sort_batch(state->entries, cnt);
+				qsc_atomics_fetch_add64(&state->applied, hkds_counter_update_batch(state->table, state->entries, cnt, NULL));
+				qsc_atomics_fetch_add64(&state->received, cnt);
+				res += cnt;
+			}
+
+			if (end == true)
+			{
+				/* the primary compacted the log; the new log at the path begins with a snapshot of its table */
+				fclose(state->fp);
+
+				if (hkds_replica_standby_attach(state) == true)
+				{
+					qsc_atomics_fetch_add64(&state->compactions, 1);
+				}
+
+				more = (state->fp != NULL);
+			}
+			else
+			{
+				/* an incomplete record at the end of the log is kept until the writer completes it */
+				state->pending = len - (rcnt * HKDS_REPLICA_RECORD_SIZE);
+
+				if (state->pending != 0)
+				{
+					qsc_memutils_copy(state->buffer, state->buffer + (rcnt * HKDS_REPLICA_RECORD_SIZE), state->pending);
+				}
+
+				more = (rcnt == HKDS_REPLICA_BATCH);
+			}
+		}
+	}
+
+	return res;
+}
+
+static void hkds_replica_standby_run(void* context)
+{
+	hkds_replica_standby_state* state;
+
+	state = (hkds_replica_standby_state*)context;
+
+	while (qsc_atomics_load64(&state->running) != 0)
+	{
+		if (hkds_replica_standby_poll(state) == 0)
+		{
+			qsc_async_thread_sleep(HKDS_REPLICA_POLL_INTERVAL);
+		}
+	}
+}
+
+bool hkds_replica_standby_open(hkds_replica_standby_state* state, hkds_counter_table* table, const char* path)
+{
+	assert(state != NULL);
+	assert(table != NULL);
+	assert(path != NULL);
+
+	bool res;
+
+	res = false;
+
+	if (state != NULL && table != NULL && table->records != NULL && path != NULL &&
+		qsc_stringutils_string_size(path) < sizeof(state->path))
+	{
+		qsc_memutils_clear(state, sizeof(hkds_replica_standby_state));
+		qsc_stringutils_copy_string(state->path, sizeof(state->path), path);
+		state->table = table;
+
+		if (hkds_replica_standby_attach(state) == true)
+		{
+			state->running = 1;
+			state->thread = qsc_async_thread_create(&hkds_replica_standby_run, state);
+			res = (state->thread != 0);
+
+			if (res == false)
+			{
+				state->running = 0;
+				fclose(state->fp);
+				state->fp = NULL;
+			}
+		}
+	}
+
+	return res;
+}
+
+void hkds_replica_standby_close(hkds_replica_standby_state* state)
+{
+	assert(state != NULL);
+
+	if (state != NULL && qsc_atomics_exchange64(&state->running, 0) != 0)
+	{
+		qsc_async_thread_wait(state->thread);
+		hkds_replica_standby_poll(state);
+
+		if (state->fp != NULL)
+		{
+			fclose(state->fp);
+			state->fp = NULL;
+		}
+	}
+}
@@ -0,0 +1,199 @@
+/* 2021 Digital Freedom Defense Incorporated
+ * All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Digital Freedom Defense Incorporated.
+ * The intellectual and technical concepts contained
+ * herein are proprietary to Digital Freedom Defense Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Digital Freedom Defense Incorporated.
+ *
+ * Contact: develop@dfdef.com
+ */
+
+
+#ifndef HKDS_REPLICA_H
+#define HKDS_REPLICA_H
+
+#include "common.h"
+#include "hkds_config.h"
+#include "hkds_counter.h"
+#include "../QSC/async.h"
+#include <stdio.h>
+
+/* Counter table replication by log shipping.
+* The primary server appends each accepted high-water update to a replication log file, and a standby process on the same host
+* tails the file and applies the updates to its own counter table in sorted batches, so that a standby taking over
+* holds the replay state of every device and rejects a message the primary has already accepted, without a cold rebuild.
+* The shard workers feed the log: a shard given the table and the log with hkds_shard_attach_table logs each raised device mark,
+* and the server that takes over attaches the standby table to its own shard, whose workers start each device from its slot.
+* A log record is the device slot index and the packed (epoch, counter) record, as 64-bit little endian integers; the device to
+* slot assignment is shared by the primary and the standby, as it is for the table. The log begins with a header holding
+* the table size, followed by a snapshot of every occupied slot.
+* The decrypt path does not write the file: an accepted update is added to a lock-free ring, and a writer thread moves the ring to the log
+* in batches. A full ring never blocks a server thread; the update is dropped from the ring, and the writer appends a new snapshot
+* of the table after it has drained the ring, which holds the dropped record because the table was updated before the ring.
+* Applying a record is an atomic maximum, so records applied twice or out of order leave the standby table unchanged.
+* A write that fails is not counted as replicated; the writer returns to the end of the last complete write, and appends a snapshot once
+* the file accepts writes again.
+* The log is compacted when the records written since its opening snapshot exceed HKDS_REPLICA_COMPACT_RATIO times the table size:
+* the writer writes a new log holding the header and a snapshot of the table, renames it over the path, and ends the old log with an end record,
+* which moves the standby to the new log. Where an open file cannot be replaced, compaction waits until no standby holds the log open. */
+
+/*!
+\def HKDS_REPLICA_BATCH
+* The maximum number of records written or applied in one batch
+*/
+#define HKDS_REPLICA_BATCH 256
+
+/*!
+\def HKDS_REPLICA_RECORD_SIZE
+* The size of a log record; the slot index and the packed record
+*/
+#define HKDS_REPLICA_RECORD_SIZE 16
+
+/*!
+\def HKDS_REPLICA_HEADER_SIZE
+* The size of the log header; the log identifier and the table size
+*/
+#define HKDS_REPLICA_HEADER_SIZE 16
+
+/*!
+\def HKDS_REPLICA_COMPACT_RATIO
+* The log is compacted when the records written since its snapshot exceed this multiple of the number of device slots
+*/
+#define HKDS_REPLICA_COMPACT_RATIO 4
+
+/*!
+\def HKDS_REPLICA_POLL_INTERVAL
+* The time in milliseconds the writer and the tailing threads wait when they have no records
+*/
+#define HKDS_REPLICA_POLL_INTERVAL 1
+
+/*! \struct hkds_replica_slot
+* A ring slot holding a pending update
+*/
+HKDS_EXPORT_API typedef struct
+{
+	volatile uint64_t sequence;							/*!< The slot sequence, the ring position the slot is next written or read at */
+	uint64_t index;										/*!< The device slot index */
+	uint64_t record;									/*!< The packed (epoch, counter) record */
+} hkds_replica_slot;
+
+/*! \struct hkds_replica_log_state
+* Contains the primary servers replication log state
+*/
+HKDS_EXPORT_API typedef struct
+{
+	uint8_t buffer[HKDS_REPLICA_BATCH * HKDS_REPLICA_RECORD_SIZE];	/*!< The writer threads output buffer */
+	hkds_counter_table* table;							/*!< The replicated counter table */
+	hkds_replica_slot* slots;							/*!< The pending update ring */
+	char path[QSC_SYSTEM_MAX_PATH];						/*!< The log file path */
+	FILE* fp;											/*!< The log file */
+	qsc_thread thread;									/*!< The writer thread */
+	size_t capacity;									/*!< The number of ring slots, a power of two */
+	size_t offset;										/*!< The end of the last complete write to the log file */
+	size_t logged;										/*!< The number of records in the current log file */
+	size_t limit;										/*!< The number of records at which the log is next compacted */
+	volatile uint64_t head;								/*!< The next ring position written by the servers */
+	uint64_t tail;										/*!< The next ring position read by the writer */
+	volatile uint64_t overflow;							/*!< An update was dropped from a full ring or a failed write, and a snapshot is due */
+	volatile uint64_t records;							/*!< The number of records written to the log */
+	volatile uint64_t snapshots;						/*!< The number of table snapshots written to the log */
+	volatile uint64_t compactions;						/*!< The number of times the log was compacted */
+	volatile uint64_t failures;							/*!< The number of writes that failed */
+	volatile uint64_t running;							/*!< The writer thread is running */
+} hkds_replica_log_state;
+
+/*! \struct hkds_replica_standby_state
+* Contains the standby servers log tailing state
+*/
+HKDS_EXPORT_API typedef struct
+{
+	uint8_t buffer[HKDS_REPLICA_BATCH * HKDS_REPLICA_RECORD_SIZE];	/*!< The input buffer */
+	hkds_counter_entry entries[HKDS_REPLICA_BATCH];		/*!< The batch being applied */
+	hkds_counter_table* table;							/*!< The standby counter table */
+	char path[QSC_SYSTEM_MAX_PATH];						/*!< The log file path */
+	FILE* fp;											/*!< The log file */
+	qsc_thread thread;									/*!< The tailing thread */
+	size_t pending;										/*!< The bytes of an incomplete record held in the buffer */
+	volatile uint64_t received;							/*!< The number of records read from the log */
+	volatile uint64_t applied;							/*!< The number of records that raised a standby record */
+	volatile uint64_t compactions;						/*!< The number of compacted logs the standby moved to */
+	volatile uint64_t running;							/*!< The tailing thread is running */
+} hkds_replica_standby_state;
+
+/**
+* \brief Create the replication log, write the header and a snapshot of the table, and start the writer thread.
+* An existing file at the path is replaced.
+*
+* \param state [struct] The replication log state
+* \param table [struct] The primary counter table
+* \param path [string][const] The log file path
+* \param capacity [size] The number of pending updates the ring holds, rounded up to a power of two
+* \return [bool] Returns true if the log was created and the opening snapshot was written
+*/
+HKDS_EXPORT_API bool hkds_replica_log_open(hkds_replica_log_state* state, hkds_counter_table* table, const char* path, size_t capacity);
+
+/**
+* \brief Stop the writer thread after it has written the pending updates, and close the log file
+*
+* \param state [struct] The replication log state
+*/
+HKDS_EXPORT_API void hkds_replica_log_close(hkds_replica_log_state* state);
+
+/**
+* \brief Add an accepted update to the log ring.
+* Lock-free and safe to call from any number of server threads; never waits for the file.
+*
+* \param state [struct] The replication log state
+* \param index [size] The device slot index
+* \param record [uint64] The packed (epoch, counter) record accepted by the table
+* \return [bool] Returns false if the ring was full; the update is then written with the next table snapshot
+*/
+HKDS_EXPORT_API bool hkds_replica_log_append(hkds_replica_log_state* state, size_t index, uint64_t record);
+
+/**
+* \brief Raise the high-water record of a device slot, and log the update if it was accepted.
+* Called by the shard workers when a verified message raises a device mark (see hkds_shard_attach_table).
+*
+* \param state [struct] The replication log state
+* \param index [size] The device slot index
+* \param record [uint64] The packed (epoch, counter) record
+* \return [bool] Returns true if the record was accepted, false if it is a replay or out of date
+*/
+HKDS_EXPORT_API bool hkds_replica_update(hkds_replica_log_state* state, size_t index, uint64_t record);
+
+/**
+* \brief Open a replication log for tailing, and start the thread that applies its records to the standby table.
+* The standby table must have the size recorded in the log header.
+*
+* \param state [struct] The standby state
+* \param table [struct] The standby counter table
+* \param path [string][const] The log file path
+* \return [bool] Returns true if the log header is valid and the tailing thread was started
+*/
+HKDS_EXPORT_API bool hkds_replica_standby_open(hkds_replica_standby_state* state, hkds_counter_table* table, const char* path);
+
+/**
+* \brief Stop the tailing thread, apply the records remaining in the log, and close the log file.
+* A standby taking over calls this after the primary has stopped; its table then holds every update the primary logged.
+*
+* \param state [struct] The standby state
+*/
+HKDS_EXPORT_API void hkds_replica_standby_close(hkds_replica_standby_state* state);
+
+/**
+* \brief Read the records added to the log since the last call, and apply them to the standby table in sorted batches.
+* An end record closes the log, and the standby continues with the compacted log at the same path.
+* Used by the tailing thread, and by the close function to apply the remainder of the log; it must not be called while the tailing thread is running.
+*
+* \param state [struct] The standby state
+* \return [size] The number of records read
+*/
+HKDS_EXPORT_API size_t hkds_replica_standby_poll(hkds_replica_standby_state* state);
+
+#endif
@@ -0,0 +1,209 @@
+#include "hkds_response.h"
+#include "hkds_factory.h"
+#include "../QSC/memutils.h"
+
+static void hkds_response_write_header(uint8_t* output, hkds_packet_type flag, uint8_t sequence, size_t length)
+{
+	hkds_wire_header* hdr;
+
+	hdr = (hkds_wire_header*)output;
+	hdr->flag = (uint8_t)flag;
+	hdr->protocol = (uint8_t)HKDS_PROTOCOL_TYPE;
+	hdr->sequence = sequence;
+	hdr->length = (uint8_t)length;
+}
+
+static void hkds_response_add_vector(hkds_response_batch* batch, const uint8_t* data, size_t length)
+{
+	qsc_socket_vector* prev;
+
+	prev = (batch->vcount != 0) ? &batch->vectors[batch->vcount - 1] : NULL;
+
+	/* data that follows the previous buffer in memory extends it, consecutive copied packets use one buffer */
+	if (prev != NULL && prev->data + prev->length == data)
+	{
+		prev->length += length;
+	}
+	else
+	{
+		batch->vectors[batch->vcount].data = data;
+		batch->vectors[batch->vcount].length = length;
+		++batch->vcount;
+	}
+}
+
+static bool hkds_response_add_packet(hkds_response_batch* batch, hkds_packet_type flag, uint8_t sequence, const uint8_t* payload, size_t paylen, bool copy)
+{
+	size_t plen;
+	bool res;
+
+	res = false;
+	plen = HKDS_HEADER_SIZE + paylen;
+
+	if (batch->count < HKDS_RESPONSE_BATCH_MAX)
+	{
+		if (batch->framing == hkds_response_contiguous || copy == true)
+		{
+			if (batch->length + plen <= batch->capacity)
+			{
+				hkds_response_write_header(batch->buffer + batch->length, flag, sequence, plen);
+				qsc_memutils_copy(batch->buffer + batch->length + HKDS_HEADER_SIZE, payload, paylen);
+
+				if (batch->framing == hkds_response_vectored)
+				{
+					hkds_response_add_vector(batch, batch->buffer + batch->length, plen);
+				}
+
+				batch->length += plen;
+				res = true;
+			}
+		}
+		else
+		{
+			if (batch->length + HKDS_HEADER_SIZE <= batch->capacity && batch->vcount + 2 <= HKDS_RESPONSE_VECTORS_MAX)
+			{
+				hkds_response_write_header(batch->buffer + batch->length, flag, sequence, plen);
+				hkds_response_add_vector(batch, batch->buffer + batch->length, HKDS_HEADER_SIZE);
+				hkds_response_add_vector(batch, payload, paylen);
+				batch->length += HKDS_HEADER_SIZE;
+				res = true;
+			}
+		}
+
+		if (res == true)
+		{
+			batch->size += plen;
+			++batch->count;
+		}
+	}
+
+	return res;
+}
+
+void hkds_response_initialize(hkds_response_batch* batch, uint8_t* buffer, size_t capacity, hkds_response_framing framing)
+{
+	assert(batch != NULL);
+	assert(buffer != NULL);
+
+	batch->buffer = buffer;
+	batch->capacity = capacity;
+	batch->framing = framing;
+	hkds_response_reset(batch);
+}
+
+void hkds_response_reset(hkds_response_batch* batch)
+{
+	assert(batch != NULL);
+
+	batch->count = 0;
+	batch->length = 0;
+	batch->size = 0;
+	batch->vcount = 0;
+}
+
+bool hkds_response_add_message(hkds_response_batch* batch, const uint8_t* message, uint8_t sequence)
+{
+	assert(batch != NULL);
+	assert(message != NULL);
+
+	return hkds_response_add_packet(batch, packet_message_response, sequence, message, HKDS_MESSAGE_SIZE, false);
+}
+
+bool hkds_response_add_token(hkds_response_batch* batch, const uint8_t* etok, uint8_t sequence)
+{
+	assert(batch != NULL);
+	assert(etok != NULL);
+
+	return hkds_response_add_packet(batch, packet_token_response, sequence, etok, HKDS_ETOK_SIZE, false);
+}
+
+bool hkds_response_add_error(hkds_response_batch* batch, const uint8_t* message, hkds_error_type err)
+{
+	assert(batch != NULL);
+	assert(message != NULL);
+
+	return hkds_response_add_packet(batch, packet_error_message, (uint8_t)err, message, HKDS_ERROR_SIZE, true);
+}
+
+bool hkds_response_add_completion(hkds_response_batch* batch, const hkds_async_completion* completion, const uint8_t* ksn, uint8_t sequence)
+{
+	assert(batch != NULL);
+	assert(completion != NULL);
+
+	uint8_t msg[HKDS_ERROR_SIZE] = { 0 };
+	bool res;
+
+	res = false;
+
+	if (completion->status == false)
+	{
+		hkds_factory_create_error_echo(msg, sequence, ksn);
+		res = hkds_response_add_error(batch, msg, error_general_failure);
+	}
+	else if (completion->operation == hkds_async_encrypt_token)
+	{
+		res = hkds_response_add_token(batch, completion->output, sequence);
+	}
+	else if (completion->operation == hkds_async_decrypt || completion->operation == hkds_async_decrypt_verify)
+	{
+		res = hkds_response_add_message(batch, completion->output, sequence);
+	}
+
+	return res;
+}
+
+size_t hkds_response_serialize(const hkds_response_batch* batch, uint8_t* output, size_t outlen)
+{
+	assert(batch != NULL);
+	assert(output != NULL);
+
+	size_t i;
+	size_t pos;
+
+	pos = 0;
+
+	if (batch->size <= outlen)
+	{
+		if (batch->framing == hkds_response_contiguous)
+		{
+			qsc_memutils_copy(output, batch->buffer, batch->length);
+			pos = batch->length;
+		}
+		else
+		{
+			for (i = 0; i < batch->vcount; ++i)
+			{
+				qsc_memutils_copy(output + pos, batch->vectors[i].data, batch->vectors[i].length);
+				pos += batch->vectors[i].length;
+			}
+		}
+	}
+
+	return pos;
+}
+
+size_t hkds_response_send(hkds_response_batch* batch, const qsc_socket* sock)
+{
+	assert(batch != NULL);
+	assert(sock != NULL);
+
+	size_t res;
+
+	res = 0;
+
+	if (batch->count != 0)
+	{
+		if (batch->framing == hkds_response_contiguous)
+		{
+			res = qsc_socket_send_all(sock, batch->buffer, batch->length, qsc_socket_send_flag_none);
+		}
+		else
+		{
+			res = qsc_socket_send_vector(sock, batch->vectors, batch->vcount, qsc_socket_send_flag_none);
+		}
+
+		hkds_response_reset(batch);
+	}
+
+	return res;
+}
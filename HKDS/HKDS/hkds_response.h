@@ -0,0 +1,162 @@
+/* 2021 Digital Freedom Defense Incorporated
+ * All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Digital Freedom Defense Incorporated.
+ * The intellectual and technical concepts contained
+ * herein are proprietary to Digital Freedom Defense Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Digital Freedom Defense Incorporated.
+ *
+ * Contact: develop@dfdef.com
+ */
+
+#ifndef HKDS_RESPONSE_H
+#define HKDS_RESPONSE_H
+
+#include "common.h"
+#include "hkds_async.h"
+#include "hkds_config.h"
+#include "hkds_wire.h"
+#include "../QSC/socketbase.h"
+
+/* Batched server responses.
+* The response builder serializes the responses to a set of client requests into one send buffer,
+* so a connection carries many HKDS packets in each TCP segment, and the whole batch is written with one system call.
+* The packet header holds the packet length, so the packets need no additional framing; the receiver splits the
+* stream with hkds_wire_parse_batch, or reads one header at a time.
+* With contiguous framing every response is copied into the send buffer, and the buffer is sent with one send.
+* With vectored framing only the packet headers are written to the send buffer, the message and token of each response
+* are referenced where they are, in the completion array for example, and the batch is sent as a buffer vector with sendmsg.
+* The referenced memory must not change until the batch is sent. Error messages are always copied into the buffer.
+* A builder is not thread safe, each connection or sending thread uses its own. */
+
+/*!
+\def HKDS_RESPONSE_BATCH_MAX
+* The maximum number of responses in one batch
+*/
+#define HKDS_RESPONSE_BATCH_MAX HKDS_WIRE_BATCH_MAX
+
+/*!
+\def HKDS_RESPONSE_VECTORS_MAX
+* The maximum number of buffers in a vectored batch, a header and a payload for each response
+*/
+#define HKDS_RESPONSE_VECTORS_MAX (HKDS_RESPONSE_BATCH_MAX * 2)
+
+/*!
+\def HKDS_RESPONSE_BUFFER_SIZE
+* The send buffer size that holds a full batch of the largest response
+*/
+#define HKDS_RESPONSE_BUFFER_SIZE (HKDS_RESPONSE_BATCH_MAX * HKDS_SERVER_TOKEN_RESPONSE_SIZE)
+
+/*! \enum hkds_response_framing
+* The batch framing mode
+*/
+HKDS_EXPORT_API typedef enum
+{
+	hkds_response_contiguous = 0x01,	/*!< Responses are copied into the send buffer and sent with one send */
+	hkds_response_vectored = 0x02,		/*!< Headers are written to the send buffer, payloads are referenced in place and sent with sendmsg */
+} hkds_response_framing;
+
+/*! \struct hkds_response_batch
+* Contains the response builder state
+*/
+HKDS_EXPORT_API typedef struct
+{
+	qsc_socket_vector vectors[HKDS_RESPONSE_VECTORS_MAX];	/*!< The send vector of a vectored batch */
+	uint8_t* buffer;										/*!< The caller provided send buffer */
+	size_t capacity;										/*!< The size of the send buffer */
+	size_t count;											/*!< The number of responses in the batch */
+	size_t length;											/*!< The number of bytes used in the send buffer */
+	size_t size;											/*!< The total serialized size of the batch */
+	size_t vcount;											/*!< The number of buffers in the send vector */
+	hkds_response_framing framing;							/*!< The framing mode */
+} hkds_response_batch;
+
+/**
+* \brief Initialize a response builder
+*
+* \param batch [struct] The response builder
+* \param buffer [array] The send buffer, HKDS_RESPONSE_BUFFER_SIZE holds a full batch in either mode
+* \param capacity [size] The size of the send buffer
+* \param framing [enum] The framing mode
+*/
+HKDS_EXPORT_API void hkds_response_initialize(hkds_response_batch* batch, uint8_t* buffer, size_t capacity, hkds_response_framing framing);
+
+/**
+* \brief Empty the batch without sending it
+*
+* \param batch [struct] The response builder
+*/
+HKDS_EXPORT_API void hkds_response_reset(hkds_response_batch* batch);
+
+/**
+* \brief Add a server message response to the batch
+*
+* \param batch [struct] The response builder
+* \param message [array][const] The servers message, referenced in place by a vectored batch
+* \param sequence [uint8] The sequence of the request being answered
+* \return [bool] Returns false if the batch or the send buffer is full
+*/
+HKDS_EXPORT_API bool hkds_response_add_message(hkds_response_batch* batch, const uint8_t* message, uint8_t sequence);
+
+/**
+* \brief Add a server token response to the batch
+*
+* \param batch [struct] The response builder
+* \param etok [array][const] The encrypted token, referenced in place by a vectored batch
+* \param sequence [uint8] The sequence of the request being answered
+* \return [bool] Returns false if the batch or the send buffer is full
+*/
+HKDS_EXPORT_API bool hkds_response_add_token(hkds_response_batch* batch, const uint8_t* etok, uint8_t sequence);
+
+/**
+* \brief Add an error message to the batch; the message is always copied
+*
+* \param batch [struct] The response builder
+* \param message [array][const] The error message, HKDS_ERROR_SIZE bytes
+* \param err [enum] The error type
+* \return [bool] Returns false if the batch or the send buffer is full
+*/
+HKDS_EXPORT_API bool hkds_response_add_error(hkds_response_batch* batch, const uint8_t* message, hkds_error_type err);
+
+/**
+* \brief Add the response to an asynchronous completion.
+* A decrypted message is added as a message response, an encrypted token as a token response,
+* and a message that failed authentication as an error message. The header of an error message holds the error code,
+* so the error message carries the request sequence in its first byte, followed by the leading bytes of the clients KSN (see hkds_factory_create_error_echo).
+*
+* \param batch [struct] The response builder
+* \param completion [struct][const] The completion, referenced in place by a vectored batch
+* \param ksn [array][const] The clients key serial number, used only by an error message; can be NULL
+* \param sequence [uint8] The sequence of the request being answered
+* \return [bool] Returns false if the batch or the send buffer is full
+*/
+HKDS_EXPORT_API bool hkds_response_add_completion(hkds_response_batch* batch, const hkds_async_completion* completion, const uint8_t* ksn, uint8_t sequence);
+
+/**
+* \brief Copy the serialized batch to an output array.
+* Used to send the batch through a transport other than a socket.
+*
+* \param batch [struct][const] The response builder
+* \param output [array] The output array
+* \param outlen [size] The length of the output array
+* \return [size] The number of bytes written, zero if the output is too small
+*/
+HKDS_EXPORT_API size_t hkds_response_serialize(const hkds_response_batch* batch, uint8_t* output, size_t outlen);
+
+/**
+* \brief Send the batch on a connected socket, and empty it.
+* A contiguous batch is sent with qsc_socket_send_all, a vectored batch with qsc_socket_send_vector.
+* If the send fails part of the batch may have been written, and the connection should be closed.
+*
+* \param batch [struct] The response builder
+* \param sock [struct][const] The connected socket
+* \return [size] The number of bytes sent, zero if the send failed
+*/
+HKDS_EXPORT_API size_t hkds_response_send(hkds_response_batch* batch, const qsc_socket* sock);
+
+#endif
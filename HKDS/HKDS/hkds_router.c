@@ -0,0 +1,786 @@
+#include "hkds_router.h"
+#include "hkds_factory.h"
+#include "../QSC/async.h"
+#include "../QSC/atomics.h"
+#include "../QSC/intutils.h"
+#include "../QSC/memutils.h"
+#include "../QSC/socketserver.h"
+#include "../QSC/stringutils.h"
+#include "../QSC/timerex.h"
+#include <stdio.h>
+
+static uint64_t hkds_router_hash(const uint8_t* input, size_t length, uint64_t point)
+{
+	uint64_t h;
+
+	/* fnv-1a over the input and the point number, with a final mix so that the points spread over the whole ring */
+	h = 0xCBF29CE484222325ULL;
+
+	for (size_t i = 0; i < length; ++i)
+	{
+		h ^= input[i];
+		h *= 0x100000001B3ULL;
+	}
+
+	h ^= point;
+	h *= 0x100000001B3ULL;
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 33;
+
+	return h;
+}
+
+static bool hkds_router_path_equal(const char* a, const char* b)
+{
+	size_t alen;
+
+	alen = qsc_stringutils_string_size(a);
+
+	return (alen == qsc_stringutils_string_size(b) && qsc_intutils_are_equal8((const uint8_t*)a, (const uint8_t*)b, alen) == true);
+}
+
+static size_t hkds_router_owner(const hkds_router_ring* ring, uint64_t hash)
+{
+	size_t hi;
+	size_t lo;
+	size_t mid;
+	size_t res;
+
+	res = HKDS_ROUTER_BACKENDS_MAX;
+
+	if (ring->count != 0 && ring->count <= HKDS_ROUTER_BACKENDS_MAX * HKDS_ROUTER_POINTS)
+	{
+		lo = 0;
+		hi = ring->count;
+
+		/* the first point at or after the hash, wrapping to the first point of the ring */
+		while (lo < hi)
+		{
+			mid = (lo + hi) / 2;
+
+			if (ring->points[mid] < hash)
+			{
+				lo = mid + 1;
+			}
+			else
+			{
+				hi = mid;
+			}
+		}
+
+		res = ring->owners[(lo == ring->count) ? 0 : lo];
+	}
+
+	return res;
+}
+
+static void hkds_router_rebuild(hkds_router_state* state)
+{
+	hkds_router_ring* ring;
+	uint64_t h;
+	size_t j;
+	uint8_t o;
+
+	/* the ring that is not in use is rebuilt, then published by advancing the version */
+	ring = &state->rings[(state->version + 1) & 1];
+	ring->count = 0;
+
+	for (size_t i = 0; i < HKDS_ROUTER_BACKENDS_MAX; ++i)
+	{
+		if (state->targets[i].generation != 0)
+		{
+			for (size_t p = 0; p < HKDS_ROUTER_POINTS; ++p)
+			{
+				h = hkds_router_hash((const uint8_t*)state->targets[i].path, qsc_stringutils_string_size(state->targets[i].path), p);
+				o = (uint8_t)i;
+				j = ring->count;
+
+				/* insertion keeps the points in order; on equal points the lower slot comes first */
+				while (j > 0 && ring->points[j - 1] > h)
+				{
+					ring->points[j] = ring->points[j - 1];
+					ring->owners[j] = ring->owners[j - 1];
+					--j;
+				}
+
+				ring->points[j] = h;
+				ring->owners[j] = o;
+				++ring->count;
+			}
+		}
+	}
+
+	qsc_atomics_fetch_add64(&state->version, 1);
+}
+
+static hkds_router_loop* hkds_router_loop_of(hkds_router_state* state, const qsc_reactor_connection* connection)
+{
+	return &state->loops[(size_t)((qsc_reactor_loop*)connection->loop - state->reactor.loops)];
+}
+
+static void hkds_router_error_record(const uint8_t* packet, size_t plen, uint8_t* emsg)
+{
+	hkds_factory_create_error_echo(emsg, hkds_factory_extract_packet_sequence(packet),
+		(plen >= HKDS_HEADER_SIZE + HKDS_KSN_SIZE) ? packet + HKDS_HEADER_SIZE : NULL);
+}
+
+static void hkds_router_error(qsc_reactor_connection* connection, const uint8_t* emsg, hkds_error_type err)
+{
+	uint8_t obuf[HKDS_ERROR_MESSAGE_SIZE];
+	hkds_response_batch rsp;
+
+	hkds_response_initialize(&rsp, obuf, sizeof(obuf), hkds_response_contiguous);
+	hkds_response_add_error(&rsp, emsg, err);
+	qsc_reactor_send(connection, obuf, rsp.length);
+}
+
+static void hkds_router_reject(hkds_router_state* state, qsc_reactor_connection* connection, const uint8_t* packet, size_t plen, hkds_error_type err)
+{
+	uint8_t emsg[HKDS_ERROR_SIZE];
+
+	hkds_router_error_record(packet, plen, emsg);
+	hkds_router_error(connection, emsg, err);
+	qsc_atomics_fetch_add64(&state->failed, 1);
+}
+
+static void hkds_router_fail_frame(hkds_router_state* state, const hkds_router_frame* frame, size_t count)
+{
+	if (frame->terminal != NULL)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			hkds_router_error(frame->terminal, frame->errors[i], error_connection_failure);
+		}
+	}
+
+	qsc_atomics_fetch_add64(&state->failed, count);
+}
+
+static void hkds_router_drop(hkds_router_state* state, hkds_router_link* link)
+{
+	/* the frames the backend has not answered, and a frame still being built, are answered with errors */
+	while (link->pcount != 0)
+	{
+		hkds_router_fail_frame(state, &link->pending[link->head], link->pending[link->head].count);
+		link->head = (link->head + 1) % HKDS_ROUTER_PENDING_MAX;
+		--link->pcount;
+	}
+
+	if (link->count != 0)
+	{
+		hkds_router_fail_frame(state, &link->pending[link->head], link->count);
+		link->count = 0;
+		link->length = 0;
+	}
+
+	link->remaining = 0;
+}
+
+static void hkds_router_timeout(void* context, qsc_reactor_connection* connection, qsc_reactor_timer* timer)
+{
+	(void)context;
+	(void)timer;
+
+	/* the oldest frame was not answered in time; a late response would be read as the answer to the next frame, so the link is closed */
+	qsc_reactor_close(connection);
+}
+
+static void hkds_router_closed(void* context, qsc_reactor_connection* connection)
+{
+	hkds_router_state* state;
+	hkds_router_link* link;
+	hkds_router_loop* rlp;
+
+	state = (hkds_router_state*)context;
+	rlp = hkds_router_loop_of(state, connection);
+
+	if (connection->tag != NULL)
+	{
+		link = (hkds_router_link*)connection->tag;
+		qsc_reactor_timer_cancel(connection, &link->timer);
+		hkds_router_drop(state, link);
+
+		if (rlp->links[link->slot] == link)
+		{
+			/* the backend failed or closed the link, and is not connected again by this loop until the retry time */
+			rlp->links[link->slot] = NULL;
+			rlp->failures[link->slot] = link->generation;
+			rlp->retries[link->slot] = qsc_timerex_monotonic_microseconds() + ((uint64_t)HKDS_ROUTER_RETRY_INTERVAL * 1000ULL);
+		}
+
+		qsc_memutils_alloc_free(link);
+	}
+	else
+	{
+		/* the responses still due to a closed terminal are discarded when they arrive */
+		for (size_t i = 0; i < HKDS_ROUTER_BACKENDS_MAX; ++i)
+		{
+			link = rlp->links[i];
+
+			if (link != NULL)
+			{
+				for (size_t j = 0; j < link->pcount; ++j)
+				{
+					if (link->pending[(link->head + j) % HKDS_ROUTER_PENDING_MAX].terminal == connection)
+					{
+						link->pending[(link->head + j) % HKDS_ROUTER_PENDING_MAX].terminal = NULL;
+					}
+				}
+			}
+		}
+	}
+}
+
+static hkds_router_link* hkds_router_connect(hkds_router_state* state, hkds_router_loop* rlp, size_t index, qsc_reactor_connection* terminal)
+{
+	hkds_router_link* link;
+	qsc_socket sock;
+	uint64_t gen;
+
+	gen = qsc_atomics_load64(&state->targets[index].generation);
+	link = rlp->links[index];
+
+	if (link != NULL && link->generation != gen)
+	{
+		/* the slot was reassigned; the link to the earlier backend is closed, and its unanswered frames are answered with errors */
+		rlp->links[index] = NULL;
+		hkds_router_drop(state, link);
+		qsc_reactor_close(link->connection);
+		link = NULL;
+	}
+
+	if (link == NULL)
+	{
+		/* a backend that failed is not tried again until its retry time, a backend newly assigned to the slot is tried at once */
+		if (gen != 0 && (rlp->failures[index] != gen || qsc_timerex_monotonic_microseconds() >= rlp->retries[index]))
+		{
+			link = (hkds_router_link*)qsc_memutils_malloc(sizeof(hkds_router_link));
+
+			if (link != NULL)
+			{
+				qsc_memutils_clear(link, sizeof(hkds_router_link));
+				link->generation = gen;
+				link->slot = index;
+				qsc_reactor_timer_initialize(&link->timer, &hkds_router_timeout);
+				qsc_memutils_clear((uint8_t*)&sock, sizeof(qsc_socket));
+
+				if (qsc_socket_create(&sock, qsc_socket_address_family_unix, qsc_socket_transport_stream, qsc_socket_protocol_none) == qsc_socket_exception_success)
+				{
+					/* a backend with a full backlog fails the connect instead of blocking the loop */
+					if (qsc_socket_set_nonblocking(&sock, true) == qsc_socket_exception_success &&
+						qsc_socket_connect(&sock, state->targets[index].path, 0) == qsc_socket_exception_success)
+					{
+						link->connection = qsc_reactor_attach(terminal, &sock, link);
+					}
+					else
+					{
+						qsc_socket_close_socket(&sock);
+					}
+				}
+
+				if (link->connection != NULL)
+				{
+					rlp->links[index] = link;
+				}
+				else
+				{
+					qsc_memutils_alloc_free(link);
+					link = NULL;
+				}
+			}
+
+			if (link == NULL)
+			{
+				rlp->failures[index] = gen;
+				rlp->retries[index] = qsc_timerex_monotonic_microseconds() + ((uint64_t)HKDS_ROUTER_RETRY_INTERVAL * 1000ULL);
+			}
+		}
+	}
+	else if (link->connection->closing == true)
+	{
+		/* the link failed during this receive, and is released with its frames when the receive returns */
+		link = NULL;
+	}
+
+	return link;
+}
+
+static void hkds_router_send(hkds_router_link* link)
+{
+	size_t flen;
+
+	qsc_intutils_le32to8(link->frame, (uint32_t)link->length);
+	qsc_intutils_le32to8(link->frame + sizeof(uint32_t), (uint32_t)link->count);
+	flen = HKDS_ROUTER_FRAME_HEADER_SIZE + link->length;
+	link->pending[(link->head + link->pcount) % HKDS_ROUTER_PENDING_MAX].count = link->count;
+	++link->pcount;
+	link->count = 0;
+	link->length = 0;
+
+	if (link->pcount == 1)
+	{
+		qsc_reactor_timer_start(link->connection, &link->timer, HKDS_ROUTER_TIMEOUT);
+	}
+
+	/* the frame is queued on the non-blocking link; a link that can not take it is closed, and the frame is answered with errors */
+	qsc_reactor_send(link->connection, link->frame, flen);
+}
+
+static void hkds_router_complete(hkds_router_state* state, hkds_router_link* link)
+{
+	qsc_atomics_fetch_add64(&state->forwarded, link->pending[link->head].count);
+	link->pending[link->head].terminal = NULL;
+	link->head = (link->head + 1) % HKDS_ROUTER_PENDING_MAX;
+	--link->pcount;
+
+	/* the timeout follows the oldest frame still waiting */
+	if (link->pcount != 0)
+	{
+		qsc_reactor_timer_start(link->connection, &link->timer, HKDS_ROUTER_TIMEOUT);
+	}
+	else
+	{
+		qsc_reactor_timer_cancel(link->connection, &link->timer);
+	}
+}
+
+static size_t hkds_router_forward(hkds_router_state* state, hkds_router_link* link, const uint8_t* input, size_t inlen)
+{
+	hkds_router_frame* frm;
+	size_t plen;
+	size_t pos;
+	bool done;
+
+	done = false;
+	pos = 0;
+
+	/* the response packets are forwarded one at a time to the terminal that sent the oldest pending frame */
+	while (done == false && link->connection->closing == false)
+	{
+		if (link->remaining == 0)
+		{
+			if (inlen - pos < HKDS_ROUTER_FRAME_HEADER_SIZE)
+			{
+				done = true;
+			}
+			else
+			{
+				plen = (size_t)qsc_intutils_le8to32(input + pos);
+
+				if (link->pcount == 0 || plen > HKDS_ROUTER_RESPONSE_SIZE - HKDS_ROUTER_FRAME_HEADER_SIZE)
+				{
+					/* a response to no frame, or larger than any batch response */
+					qsc_reactor_close(link->connection);
+				}
+				else
+				{
+					pos += HKDS_ROUTER_FRAME_HEADER_SIZE;
+					link->remaining = plen;
+
+					if (plen == 0)
+					{
+						hkds_router_complete(state, link);
+					}
+				}
+			}
+		}
+		else if (inlen - pos < HKDS_HEADER_SIZE)
+		{
+			done = true;
+		}
+		else
+		{
+			plen = hkds_factory_extract_packet_size(input + pos);
+
+			if (plen < HKDS_HEADER_SIZE || plen > link->remaining)
+			{
+				qsc_reactor_close(link->connection);
+			}
+			else if (inlen - pos < plen)
+			{
+				done = true;
+			}
+			else
+			{
+				frm = &link->pending[link->head];
+
+				if (frm->terminal != NULL)
+				{
+					qsc_reactor_send(frm->terminal, input + pos, plen);
+				}
+
+				pos += plen;
+				link->remaining -= plen;
+
+				if (link->remaining == 0)
+				{
+					hkds_router_complete(state, link);
+				}
+			}
+		}
+	}
+
+	return pos;
+}
+
+static size_t hkds_router_receive(void* context, qsc_reactor_connection* connection, const uint8_t* input, size_t inlen)
+{
+	uint8_t emsg[HKDS_ERROR_SIZE];
+	hkds_router_frame* frm;
+	hkds_router_link* link;
+	hkds_router_loop* rlp;
+	hkds_router_state* state;
+	size_t idx;
+	size_t plen;
+	size_t pos;
+	bool done;
+
+	state = (hkds_router_state*)context;
+	pos = 0;
+
+	if (connection->tag != NULL)
+	{
+		/* a response from a backend link */
+		pos = hkds_router_forward(state, (hkds_router_link*)connection->tag, input, inlen);
+	}
+	else
+	{
+		rlp = hkds_router_loop_of(state, connection);
+		done = false;
+
+		while (done == false && inlen - pos >= HKDS_HEADER_SIZE)
+		{
+			plen = hkds_factory_extract_packet_size(input + pos);
+
+			if (plen < HKDS_HEADER_SIZE + HKDS_DID_SIZE || plen > HKDS_CLIENT_MESSAGE_REQUEST_SIZE)
+			{
+				/* the length field cannot be trusted to reach the next packet; the connection is closed */
+				hkds_router_error_record(input + pos, HKDS_HEADER_SIZE, emsg);
+				hkds_router_error(connection, emsg, error_invalid_format);
+				qsc_reactor_close(connection);
+				pos = inlen;
+				done = true;
+			}
+			else if (inlen - pos < plen)
+			{
+				done = true;
+			}
+			else
+			{
+				idx = hkds_router_route(state, input + pos + HKDS_HEADER_SIZE);
+				link = (idx < HKDS_ROUTER_BACKENDS_MAX) ? hkds_router_connect(state, rlp, idx, connection) : NULL;
+
+				if (link != NULL && (HKDS_ROUTER_FRAME_HEADER_SIZE + link->length + plen > HKDS_ROUTER_FRAME_SIZE || link->count == HKDS_WIRE_BATCH_MAX))
+				{
+					hkds_router_send(link);
+					link = (link->connection->closing == false) ? link : NULL;
+				}
+
+				if (link == NULL)
+				{
+					hkds_router_reject(state, connection, input + pos, plen, error_connection_failure);
+				}
+				else if (link->count == 0 && link->pcount == HKDS_ROUTER_PENDING_MAX)
+				{
+					/* the backend has not answered the frames already sent on this link */
+					hkds_router_reject(state, connection, input + pos, plen, error_server_busy);
+				}
+				else
+				{
+					frm = &link->pending[(link->head + link->pcount) % HKDS_ROUTER_PENDING_MAX];
+					frm->terminal = connection;
+					hkds_router_error_record(input + pos, plen, frm->errors[link->count]);
+					qsc_memutils_copy(link->frame + HKDS_ROUTER_FRAME_HEADER_SIZE + link->length, input + pos, plen);
+					link->length += plen;
+					++link->count;
+				}
+
+				pos += plen;
+			}
+		}
+
+		/* the frames of the receive are sent to every backend at once, and answered as each backend responds */
+		for (size_t i = 0; i < HKDS_ROUTER_BACKENDS_MAX; ++i)
+		{
+			if (rlp->links[i] != NULL && rlp->links[i]->count != 0)
+			{
+				hkds_router_send(rlp->links[i]);
+			}
+		}
+	}
+
+	return pos;
+}
+
+static size_t hkds_router_backend_receive(void* context, qsc_reactor_connection* connection, const uint8_t* input, size_t inlen)
+{
+	uint8_t obuf[HKDS_ROUTER_RESPONSE_SIZE];
+	hkds_router_backend_state* state;
+	hkds_response_batch rsp;
+	size_t flen;
+	size_t pos;
+	bool done;
+
+	state = (hkds_router_backend_state*)context;
+	done = false;
+	pos = 0;
+
+	while (done == false && connection->closing == false && inlen - pos >= HKDS_ROUTER_FRAME_HEADER_SIZE)
+	{
+		flen = (size_t)qsc_intutils_le8to32(input + pos);
+
+		if (flen > HKDS_ROUTER_FRAME_SIZE - HKDS_ROUTER_FRAME_HEADER_SIZE)
+		{
+			/* a frame larger than the read buffer can never complete */
+			qsc_reactor_close(connection);
+			pos = inlen;
+			done = true;
+		}
+		else if (inlen - pos < HKDS_ROUTER_FRAME_HEADER_SIZE + flen)
+		{
+			done = true;
+		}
+		else
+		{
+			/* the frame holds fewer packets than one wire batch, and is answered with one response frame */
+			hkds_response_initialize(&rsp, obuf + HKDS_ROUTER_FRAME_HEADER_SIZE, sizeof(obuf) - HKDS_ROUTER_FRAME_HEADER_SIZE, hkds_response_contiguous);
+			hkds_network_process(&state->server, input + pos + HKDS_ROUTER_FRAME_HEADER_SIZE, flen, &rsp);
+			qsc_intutils_le32to8(obuf, (uint32_t)rsp.length);
+			qsc_intutils_le32to8(obuf + sizeof(uint32_t), (uint32_t)rsp.count);
+			qsc_reactor_send(connection, obuf, HKDS_ROUTER_FRAME_HEADER_SIZE + rsp.length);
+			pos += HKDS_ROUTER_FRAME_HEADER_SIZE + flen;
+		}
+	}
+
+	return pos;
+}
+
+void hkds_router_initialize(hkds_router_state* state)
+{
+	assert(state != NULL);
+
+	if (state != NULL)
+	{
+		qsc_memutils_clear(state, sizeof(hkds_router_state));
+	}
+}
+
+bool hkds_router_add(hkds_router_state* state, const char* path)
+{
+	assert(state != NULL);
+	assert(path != NULL);
+
+	size_t i;
+	size_t slot;
+	size_t plen;
+	bool res;
+
+	res = false;
+
+	if (state != NULL && path != NULL)
+	{
+		plen = qsc_stringutils_string_size(path);
+		slot = HKDS_ROUTER_BACKENDS_MAX;
+
+		for (i = 0; i < HKDS_ROUTER_BACKENDS_MAX; ++i)
+		{
+			if (state->targets[i].generation != 0 && hkds_router_path_equal(state->targets[i].path, path) == true)
+			{
+				plen = 0;
+			}
+			else if (state->targets[i].generation == 0 && slot == HKDS_ROUTER_BACKENDS_MAX)
+			{
+				slot = i;
+			}
+		}
+
+		if (plen != 0 && plen < HKDS_ROUTER_PATH_MAX && slot != HKDS_ROUTER_BACKENDS_MAX)
+		{
+			qsc_memutils_clear(state->targets[slot].path, sizeof(state->targets[slot].path));
+			qsc_memutils_copy(state->targets[slot].path, path, plen);
+			/* a new generation makes the event loops replace a link to an earlier backend of the slot */
+			++state->assigned;
+			qsc_atomics_store64(&state->targets[slot].generation, state->assigned);
+			hkds_router_rebuild(state);
+			res = true;
+		}
+	}
+
+	return res;
+}
+
+bool hkds_router_remove(hkds_router_state* state, const char* path)
+{
+	assert(state != NULL);
+	assert(path != NULL);
+
+	bool res;
+
+	res = false;
+
+	if (state != NULL && path != NULL)
+	{
+		for (size_t i = 0; i < HKDS_ROUTER_BACKENDS_MAX; ++i)
+		{
+			if (res == false && state->targets[i].generation != 0 && hkds_router_path_equal(state->targets[i].path, path) == true)
+			{
+				qsc_atomics_store64(&state->targets[i].generation, 0);
+				hkds_router_rebuild(state);
+				res = true;
+			}
+		}
+	}
+
+	return res;
+}
+
+size_t hkds_router_route(const hkds_router_state* state, const uint8_t* ksn)
+{
+	assert(state != NULL);
+	assert(ksn != NULL);
+
+	uint64_t h;
+	uint64_t ver;
+	size_t res;
+
+	res = HKDS_ROUTER_BACKENDS_MAX;
+
+	if (state != NULL && ksn != NULL)
+	{
+		h = hkds_router_hash(ksn, HKDS_DID_SIZE, 0);
+		ver = qsc_atomics_load64(&state->version);
+		res = hkds_router_owner(&state->rings[ver & 1], h);
+
+		/* a ring rebuilt during the lookup is read again */
+		while (qsc_atomics_load64(&state->version) != ver)
+		{
+			ver = qsc_atomics_load64(&state->version);
+			res = hkds_router_owner(&state->rings[ver & 1], h);
+		}
+	}
+
+	return res;
+}
+
+bool hkds_router_start(hkds_router_state* state, const char* address, uint16_t port,
+	qsc_socket_address_families family, size_t threads, size_t maximum, qsc_reactor_backends backend)
+{
+	assert(state != NULL);
+	assert(address != NULL);
+
+	bool res;
+
+	res = false;
+
+	if (state != NULL && address != NULL && state->running == false)
+	{
+		/* the loop count matches the reactor, each loop has its own backend links */
+		threads = (threads == 0) ? qsc_async_processor_count() : threads;
+		threads = (threads == 0) ? 1 : threads;
+		state->lcount = (threads > QSC_REACTOR_THREADS_MAX) ? QSC_REACTOR_THREADS_MAX : threads;
+		state->forwarded = 0;
+		state->failed = 0;
+		state->loops = (hkds_router_loop*)qsc_memutils_malloc(state->lcount * sizeof(hkds_router_loop));
+
+		if (state->loops != NULL)
+		{
+			qsc_memutils_clear(state->loops, state->lcount * sizeof(hkds_router_loop));
+			qsc_socket_server_initialize(&state->listener);
+
+			if (qsc_socket_server_open(&state->listener, address, port, family, false) == qsc_socket_exception_success)
+			{
+				res = qsc_reactor_initialize(&state->reactor, &state->listener, state->lcount, maximum, NULL, &hkds_router_receive, &hkds_router_closed, state, backend);
+
+				if (res == false)
+				{
+					qsc_socket_close_socket(&state->listener);
+				}
+			}
+
+			if (res == false)
+			{
+				qsc_memutils_alloc_free(state->loops);
+				state->loops = NULL;
+			}
+		}
+
+		state->running = res;
+	}
+
+	return res;
+}
+
+void hkds_router_stop(hkds_router_state* state)
+{
+	assert(state != NULL);
+
+	if (state != NULL && state->running == true)
+	{
+		/* the backend links are connections of the reactor, and are released with the terminals */
+		qsc_reactor_dispose(&state->reactor);
+		qsc_socket_close_socket(&state->listener);
+		qsc_memutils_alloc_free(state->loops);
+		state->loops = NULL;
+		state->lcount = 0;
+		state->running = false;
+	}
+}
+
+bool hkds_router_backend_start(hkds_router_backend_state* state, hkds_master_key* mdk, const char* path,
+	size_t threads, qsc_reactor_backends backend)
+{
+	assert(state != NULL);
+	assert(mdk != NULL);
+	assert(path != NULL);
+
+	size_t plen;
+	bool res;
+
+	res = false;
+
+	if (state != NULL && mdk != NULL && path != NULL)
+	{
+		plen = qsc_stringutils_string_size(path);
+
+		if (plen != 0 && plen < HKDS_ROUTER_PATH_MAX)
+		{
+			qsc_memutils_clear(state, sizeof(hkds_router_backend_state));
+			qsc_memutils_copy(state->path, path, plen);
+			state->server.mdk = mdk;
+			/* a socket file left by a stopped backend would make the bind fail */
+			remove(state->path);
+			qsc_socket_server_initialize(&state->listener);
+
+			if (qsc_socket_server_open(&state->listener, state->path, 0, qsc_socket_address_family_unix, false) == qsc_socket_exception_success)
+			{
+				/* one link from each router event loop */
+				res = qsc_reactor_initialize(&state->reactor, &state->listener, threads, QSC_REACTOR_THREADS_MAX,
+					NULL, &hkds_router_backend_receive, NULL, state, backend);
+
+				if (res == false)
+				{
+					qsc_socket_close_socket(&state->listener);
+					remove(state->path);
+				}
+			}
+		}
+	}
+
+	return res;
+}
+
+void hkds_router_backend_stop(hkds_router_backend_state* state)
+{
+	assert(state != NULL);
+
+	if (state != NULL && state->server.mdk != NULL)
+	{
+		qsc_reactor_dispose(&state->reactor);
+		qsc_socket_close_socket(&state->listener);
+		remove(state->path);
+		state->server.mdk = NULL;
+	}
+}
@@ -0,0 +1,273 @@
+/* 2021 Digital Freedom Defense Incorporated
+ * All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Digital Freedom Defense Incorporated.
+ * The intellectual and technical concepts contained
+ * herein are proprietary to Digital Freedom Defense Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Digital Freedom Defense Incorporated.
+ *
+ * Contact: develop@dfdef.com
+ */
+
+
+#ifndef HKDS_ROUTER_H
+#define HKDS_ROUTER_H
+
+#include "common.h"
+#include "hkds_config.h"
+#include "hkds_network.h"
+#include "hkds_response.h"
+#include "hkds_server.h"
+#include "hkds_wire.h"
+#include "../QSC/socketreactor.h"
+
+/* Device sharding router.
+* The router accepts the terminal connections and forwards each request to one of several backend server processes
+* on the same host, connected with Unix domain sockets. The device id at the start of the requests KSN is hashed onto
+* a consistent hash ring, on which each backend holds HKDS_ROUTER_POINTS points derived from its socket path;
+* the device is served by the backend holding the first point at or after its hash. Every request of a device is served
+* by the same backend, so the device state is partitioned between the backend processes, and the memory bandwidth of
+* a host is shared by several servers.
+* Adding or removing a backend moves only the devices on the ring intervals that backend gains or loses, and the new ring
+* is published to the event loops without stopping them. A backend that is removed and added again with the same path
+* receives the same devices.
+* The requests of a receive buffer are grouped by backend into frames of up to HKDS_ROUTER_FRAME_SIZE bytes; each frame carries an
+* eight byte header, the payload length and packet count as little endian 32-bit integers, followed by the packets.
+* Each event loop has its own connection to each backend, attached to the loop as a non-blocking reactor connection,
+* so the backend links are not shared between threads and a loop never waits on a backend. The frames of a receive are
+* queued on their backend links at once, so the backends serve a receive in parallel, and each link keeps the frames it
+* has sent in order until they are answered. The responses are forwarded to the terminal that sent the frame from the
+* backend links receive callback, one response packet at a time, so responses from different backends are not interleaved
+* within a packet. A link holds up to HKDS_ROUTER_PENDING_MAX unanswered frames; further requests for the backend are
+* answered with an error_server_busy message.
+* The router does not hold keys; a request that cannot be delivered to its backend is answered with an error_connection_failure message.
+* A frame that is not answered within HKDS_ROUTER_TIMEOUT closes the link, and the frames it holds are answered with errors;
+* the event loop does not connect to that backend again for HKDS_ROUTER_RETRY_INTERVAL, so the requests for a stalled backend
+* are then answered with errors without waiting, and the other backends are served throughout.
+* The ring can be changed from one control thread while the router is running; the add and remove functions
+* must not be called concurrently with each other. */
+
+/*!
+\def HKDS_ROUTER_BACKENDS_MAX
+* The maximum number of backend servers
+*/
+#define HKDS_ROUTER_BACKENDS_MAX 32
+
+/*!
+\def HKDS_ROUTER_POINTS
+* The number of points each backend holds on the hash ring
+*/
+#define HKDS_ROUTER_POINTS 64
+
+/*!
+\def HKDS_ROUTER_PATH_MAX
+* The maximum length of a backend socket path, including the terminating null
+*/
+#define HKDS_ROUTER_PATH_MAX 104
+
+/*!
+\def HKDS_ROUTER_FRAME_HEADER_SIZE
+* The size of a frame header; the payload length and the packet count
+*/
+#define HKDS_ROUTER_FRAME_HEADER_SIZE 8
+
+/*!
+\def HKDS_ROUTER_FRAME_SIZE
+* The maximum size of a request frame; a frame is received whole into one reactor read buffer of the backend
+*/
+#define HKDS_ROUTER_FRAME_SIZE QSC_REACTOR_BUFFER_SIZE
+
+/*!
+\def HKDS_ROUTER_RESPONSE_SIZE
+* The maximum size of a response frame; a header and one batch of the largest response
+*/
+#define HKDS_ROUTER_RESPONSE_SIZE (HKDS_ROUTER_FRAME_HEADER_SIZE + HKDS_RESPONSE_BUFFER_SIZE)
+
+/*!
+\def HKDS_ROUTER_PENDING_MAX
+* The maximum number of frames a backend link holds that have been sent and not yet answered
+*/
+#define HKDS_ROUTER_PENDING_MAX 4
+
+/*!
+\def HKDS_ROUTER_TIMEOUT
+* The time in milliseconds a backend link waits for the response to its oldest frame before the backend is treated as failed
+*/
+#define HKDS_ROUTER_TIMEOUT 200
+
+/*!
+\def HKDS_ROUTER_RETRY_INTERVAL
+* The time in milliseconds an event loop waits before it connects again to a backend whose link failed
+*/
+#define HKDS_ROUTER_RETRY_INTERVAL 1000
+
+/*! \struct hkds_router_target
+* A backend server slot
+*/
+HKDS_EXPORT_API typedef struct
+{
+	char path[HKDS_ROUTER_PATH_MAX];				/*!< The backends socket path */
+	volatile uint64_t generation;					/*!< Changes each time the slot is assigned, zero if the slot is free */
+} hkds_router_target;
+
+/*! \struct hkds_router_ring
+* The consistent hash ring
+*/
+HKDS_EXPORT_API typedef struct
+{
+	uint64_t points[HKDS_ROUTER_BACKENDS_MAX * HKDS_ROUTER_POINTS];	/*!< The ring points in ascending order */
+	uint8_t owners[HKDS_ROUTER_BACKENDS_MAX * HKDS_ROUTER_POINTS];	/*!< The backend slot holding each point */
+	size_t count;													/*!< The number of points on the ring */
+} hkds_router_ring;
+
+/*! \struct hkds_router_frame
+* A request frame sent on a backend link
+*/
+HKDS_EXPORT_API typedef struct
+{
+	qsc_reactor_connection* terminal;						/*!< The terminal the responses are forwarded to, NULL if it has closed */
+	uint8_t errors[HKDS_WIRE_BATCH_MAX][HKDS_ERROR_SIZE];	/*!< The error message of each request, sent if the frame is not answered */
+	size_t count;											/*!< The number of requests in the frame */
+} hkds_router_frame;
+
+/*! \struct hkds_router_link
+* The connection of one event loop to one backend, with the frames it has sent and not yet been answered
+*/
+HKDS_EXPORT_API typedef struct
+{
+	qsc_reactor_connection* connection;						/*!< The backend connection, attached to the event loop */
+	qsc_reactor_timer timer;								/*!< The response timeout of the oldest pending frame */
+	hkds_router_frame pending[HKDS_ROUTER_PENDING_MAX];		/*!< The frames awaiting a response, from the oldest */
+	uint8_t frame[HKDS_ROUTER_FRAME_SIZE];					/*!< The request frame being built */
+	uint64_t generation;									/*!< The backend generation the link is connected to */
+	size_t slot;											/*!< The backend slot index */
+	size_t head;											/*!< The index of the oldest pending frame */
+	size_t pcount;											/*!< The number of pending frames */
+	size_t remaining;										/*!< The payload bytes of the current response frame not yet forwarded, zero between frames */
+	size_t length;											/*!< The payload length of the frame being built */
+	size_t count;											/*!< The number of packets in the frame being built */
+} hkds_router_link;
+
+/*! \struct hkds_router_loop
+* The backend links of one event loop
+*/
+HKDS_EXPORT_API typedef struct
+{
+	hkds_router_link* links[HKDS_ROUTER_BACKENDS_MAX];		/*!< The link to each backend, NULL if not connected */
+	uint64_t failures[HKDS_ROUTER_BACKENDS_MAX];			/*!< The backend generation of the last failed link */
+	uint64_t retries[HKDS_ROUTER_BACKENDS_MAX];				/*!< The monotonic time in microseconds after which a failed backend is connected again */
+} hkds_router_loop;
+
+/*! \struct hkds_router_state
+* Contains the router state
+*/
+HKDS_EXPORT_API typedef struct
+{
+	qsc_reactor_state reactor;								/*!< The socket reactor serving the terminals */
+	qsc_socket listener;									/*!< The terminal listening socket */
+	hkds_router_target targets[HKDS_ROUTER_BACKENDS_MAX];	/*!< The backend slots */
+	hkds_router_ring rings[2];								/*!< The current ring and the ring being rebuilt */
+	hkds_router_loop* loops;								/*!< The backend links of each event loop */
+	size_t lcount;											/*!< The number of event loops */
+	uint64_t assigned;										/*!< The last backend generation assigned */
+	volatile uint64_t version;								/*!< The ring version; the current ring is rings[version & 1] */
+	volatile uint64_t forwarded;							/*!< The number of requests forwarded to a backend */
+	volatile uint64_t failed;								/*!< The number of requests that could not be delivered */
+	bool running;											/*!< The router has been started */
+} hkds_router_state;
+
+/*! \struct hkds_router_backend_state
+* Contains a backend server state
+*/
+HKDS_EXPORT_API typedef struct
+{
+	qsc_reactor_state reactor;								/*!< The socket reactor serving the router links */
+	qsc_socket listener;									/*!< The Unix domain listening socket */
+	hkds_network_state server;								/*!< The server state; holds the key set and the request counters */
+	char path[HKDS_ROUTER_PATH_MAX];						/*!< The listening sockets path */
+} hkds_router_backend_state;
+
+/**
+* \brief Initialize the router with an empty ring
+*
+* \param state [struct] The router state
+*/
+HKDS_EXPORT_API void hkds_router_initialize(hkds_router_state* state);
+
+/**
+* \brief Add a backend to the ring; the devices on the intervals it gains are routed to it from the next receive.
+* Backends can be added before or after the router is started.
+*
+* \param state [struct] The router state
+* \param path [string][const] The backends socket path
+* \return [bool] Returns true if the backend was added; false if the path is in use, invalid, or the ring is full
+*/
+HKDS_EXPORT_API bool hkds_router_add(hkds_router_state* state, const char* path);
+
+/**
+* \brief Remove a backend from the ring; its devices are moved to the backends holding the next points on the ring
+*
+* \param state [struct] The router state
+* \param path [string][const] The backends socket path
+* \return [bool] Returns true if the backend was removed
+*/
+HKDS_EXPORT_API bool hkds_router_remove(hkds_router_state* state, const char* path);
+
+/**
+* \brief Get the backend slot that serves a device
+*
+* \param state [struct][const] The router state
+* \param ksn [array][const] The clients key serial number, beginning with the device id
+* \return [size] The backend slot index, or HKDS_ROUTER_BACKENDS_MAX if the ring is empty
+*/
+HKDS_EXPORT_API size_t hkds_router_route(const hkds_router_state* state, const uint8_t* ksn);
+
+/**
+* \brief Open the terminal listening socket and start the event loops
+*
+* \param state [struct] The router state
+* \param address [string][const] The routers address
+* \param port [uint16] The routers port number
+* \param family [enum] The socket address family
+* \param threads [size] The number of event loop threads, zero selects the processor count
+* \param maximum [size] The maximum number of terminal connections
+* \param backend [enum] The event loop backend, qsc_reactor_backend_auto selects io_uring when it is supported
+* \return [bool] Returns true if the router was started
+*/
+HKDS_EXPORT_API bool hkds_router_start(hkds_router_state* state, const char* address, uint16_t port,
+	qsc_socket_address_families family, size_t threads, size_t maximum, qsc_reactor_backends backend);
+
+/**
+* \brief Stop the event loops, and close the terminal connections and the backend links
+*
+* \param state [struct] The router state
+*/
+HKDS_EXPORT_API void hkds_router_stop(hkds_router_state* state);
+
+/**
+* \brief Start a backend server listening on a Unix domain socket; a stale socket file at the path is removed.
+* Each received frame is processed as one wire batch, and answered with one response frame.
+*
+* \param state [struct] The backend server state
+* \param mdk [struct] The master key set
+* \param path [string][const] The socket path
+* \param threads [size] The number of event loop threads, zero selects the processor count
+* \param backend [enum] The event loop backend
+* \return [bool] Returns true if the backend server was started
+*/
+HKDS_EXPORT_API bool hkds_router_backend_start(hkds_router_backend_state* state, hkds_master_key* mdk, const char* path,
+	size_t threads, qsc_reactor_backends backend);
+
+/**
+* \brief Stop a backend server, and remove its socket file
+*
+* \param state [struct] The backend server state
+*/
+HKDS_EXPORT_API void hkds_router_backend_stop(hkds_router_backend_state* state);
+
+#endif
@@ -41,7 +41,7 @@ static void hkds_server_generate_token(const uint8_t* stk, const uint8_t* ctok,
 #endif
 }
 
-static void hkds_server_get_ctok(hkds_server_state* state, uint8_t* ctok)
+static void hkds_server_get_ctok(const hkds_server_state* state, uint8_t* ctok)
 {
 	uint32_t tkc;
 
@@ -161,6 +161,38 @@ bool hkds_server_decrypt_verify_message(hkds_server_state* state, const uint8_t*
 	return res;
 }
 
+void hkds_server_generate_cache(const hkds_server_state* state, uint8_t* skey)
+{
+	uint8_t ctok[HKDS_CTOK_SIZE] = { 0 };
+	uint8_t edk[HKDS_EDK_SIZE] = { 0 };
+	uint8_t tok[HKDS_STK_SIZE] = { 0 };
+	uint8_t tmpk[HKDS_STK_SIZE + HKDS_EDK_SIZE] = { 0 };
+
+	/* generate the device key */
+	hkds_server_generate_edk(state->mdk->bdk, state->ksn, edk);
+
+	/* generate the device token from the base token and customization string */
+	hkds_server_get_ctok(state, ctok);
+	hkds_server_generate_token(state->mdk->stk, ctok, tok);
+
+	/* copy token and edk to PRF key */
+	qsc_memutils_copy(tmpk, tok, HKDS_STK_SIZE);
+	qsc_memutils_copy(((uint8_t*)tmpk + HKDS_STK_SIZE), edk, HKDS_EDK_SIZE);
+
+	/* generate the full key cache */
+#if defined(HKDS_SHAKE_128)
+	qsc_shake128_compute(skey, HKDS_CACHE_SIZE * HKDS_MESSAGE_SIZE, tmpk, sizeof(tmpk));
+#elif defined(HKDS_SHAKE_256)
+	qsc_shake256_compute(skey, HKDS_CACHE_SIZE * HKDS_MESSAGE_SIZE, tmpk, sizeof(tmpk));
+#else
+	qsc_shake512_compute(skey, HKDS_CACHE_SIZE * HKDS_MESSAGE_SIZE, tmpk, sizeof(tmpk));
+#endif
+
+	qsc_memutils_clear(edk, sizeof(edk));
+	qsc_memutils_clear(tok, sizeof(tok));
+	qsc_memutils_clear(tmpk, sizeof(tmpk));
+}
+
 void hkds_server_generate_edk(const uint8_t* bdk, const uint8_t* did, uint8_t* edk)
 {
 	uint8_t dkey[HKDS_BDK_SIZE + HKDS_DID_SIZE] = { 0 };
@@ -179,6 +211,22 @@ void hkds_server_generate_edk(const uint8_t* bdk, const uint8_t* did, uint8_t* e
 #endif
 }
 
+void hkds_server_encrypt_next_token(const hkds_server_state* state, uint8_t* etok)
+{
+	hkds_server_state nss;
+	uint32_t tkc;
+
+	/* the client begins the next epoch at the first counter of the next token period */
+	tkc = qsc_intutils_be8to32(((const uint8_t*)state->ksn + HKDS_DID_SIZE)) / HKDS_CACHE_SIZE;
+	qsc_memutils_copy(nss.ksn, state->ksn, HKDS_DID_SIZE);
+	qsc_intutils_be32to8(((uint8_t*)nss.ksn + HKDS_DID_SIZE), (tkc + 1) * HKDS_CACHE_SIZE);
+	nss.mdk = state->mdk;
+	nss.count = (size_t)(tkc + 1) * HKDS_CACHE_SIZE;
+	nss.rate = state->rate;
+
+	hkds_server_encrypt_token(&nss, etok);
+}
+
 void hkds_server_encrypt_token(hkds_server_state* state, uint8_t* etok)
 {
 	uint8_t ctok[HKDS_CTOK_SIZE] = { 0 };
@@ -247,6 +295,15 @@ void hkds_server_initialize_state(hkds_server_state* state, hkds_master_key* mdk
 	state->rate = HKDS_PRF_RATE;
 }
 
+bool hkds_server_push_token_required(const hkds_server_state* state)
+{
+	uint32_t index;
+
+	index = qsc_intutils_be8to32(((const uint8_t*)state->ksn + HKDS_DID_SIZE)) % HKDS_CACHE_SIZE;
+
+	return (HKDS_CACHE_SIZE - index <= HKDS_PUSH_TOKEN_THRESHOLD);
+}
+
 /* parallel x8 */
 
 static void hkds_server_generate_token_x8(const hkds_server_x8_state* state, 
@@ -293,109 +350,39 @@ static void hkds_server_get_ctok_x8(hkds_server_x8_state* state,
 static void hkds_server_generate_transaction_key_x8(hkds_server_x8_state* state, 
 	uint8_t tkey[HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE])
 {
-	uint8_t ctok[HKDS_CACHX8_DEPTH][HKDS_CTOK_SIZE] = { 0 };
-	uint8_t did[HKDS_CACHX8_DEPTH][HKDS_DID_SIZE] = { 0 };
-	uint8_t edk[HKDS_CACHX8_DEPTH][HKDS_EDK_SIZE] = { 0 };
 	uint8_t skey[HKDS_CACHX8_DEPTH][HKDS_CACHE_SIZE * HKDS_MESSAGE_SIZE] = { 0 };
-	uint8_t tok[HKDS_CACHX8_DEPTH][HKDS_STK_SIZE] = { 0 };
-	uint8_t tmpk[HKDS_CACHX8_DEPTH][HKDS_STK_SIZE + HKDS_EDK_SIZE] = { 0 };
-	uint32_t index[HKDS_CACHX8_DEPTH] = { 0 };
-	size_t i;
-
-	for (i = 0; i < HKDS_CACHX8_DEPTH; ++i)
-	{
-		/* get the key counter mod the cache size from the ksn */
-		index[i] = qsc_intutils_be8to32(((uint8_t*)state->ksn[i] + HKDS_DID_SIZE)) % HKDS_CACHE_SIZE;
-		/* copy the device id from the ksn */
-		qsc_memutils_copy(did[i], state->ksn[i], HKDS_DID_SIZE);
-	}
-
-	/* generate the device key */
-	hkds_server_generate_edk_x8(state, did, edk);
-
-	/* generate the custom token string */
-	hkds_server_get_ctok_x8(state, ctok);
+	uint32_t index;
 
-	/* generate the device token from the base token and customization string */
-	hkds_server_generate_token_x8(state, ctok, tok);
+	/* generate the key cache of each lane */
+	hkds_server_generate_cache_x8(state, skey);
 
-	for (i = 0; i < HKDS_CACHX8_DEPTH; ++i)
+	for (size_t i = 0; i < HKDS_CACHX8_DEPTH; ++i)
 	{
-		/* copy token and edk to PRF key */
-		qsc_memutils_copy(tmpk[i], tok[i], HKDS_STK_SIZE);
-		qsc_memutils_copy(((uint8_t*)tmpk[i] + HKDS_STK_SIZE), edk[i], HKDS_EDK_SIZE);
+		/* get the key counter mod the cache size from the ksn */
+		index = qsc_intutils_be8to32(((uint8_t*)state->ksn[i] + HKDS_DID_SIZE)) % HKDS_CACHE_SIZE;
+		qsc_memutils_copy((uint8_t*)tkey[i], ((uint8_t*)skey[i] + ((size_t)index * HKDS_MESSAGE_SIZE)), HKDS_MESSAGE_SIZE);
 	}
 
-	/* generate the minimum number of blocks, and return the transaction key */
-#if defined(HKDS_SHAKE_128)
-	shake128x8(skey[0], skey[1], skey[2], skey[3], skey[4], skey[5], skey[6], skey[7], sizeof(skey[0]),
-		tmpk[0], tmpk[1], tmpk[2], tmpk[3], tmpk[4], tmpk[5], tmpk[6], tmpk[7], HKDS_STK_SIZE + HKDS_EDK_SIZE);
-#elif defined(HKDS_SHAKE_256)
-	shake256x8(skey[0], skey[1], skey[2], skey[3], skey[4], skey[5], skey[6], skey[7], sizeof(skey[0]),
-		tmpk[0], tmpk[1], tmpk[2], tmpk[3], tmpk[4], tmpk[5], tmpk[6], tmpk[7], HKDS_STK_SIZE + HKDS_EDK_SIZE);
-#else
-	shake512x8(skey[0], skey[1], skey[2], skey[3], skey[4], skey[5], skey[6], skey[7], sizeof(skey[0]),
-		tmpk[0], tmpk[1], tmpk[2], tmpk[3], tmpk[4], tmpk[5], tmpk[6], tmpk[7], HKDS_STK_SIZE + HKDS_EDK_SIZE);
-#endif
-
-	for (i = 0; i < HKDS_CACHX8_DEPTH; ++i)
-	{
-		qsc_memutils_copy((uint8_t*)tkey[i], ((uint8_t*)skey[i] + ((size_t)index[i] * HKDS_MESSAGE_SIZE)), HKDS_MESSAGE_SIZE);
-	}
+	qsc_memutils_clear((uint8_t*)skey, sizeof(skey));
 }
 
 static void hkds_server_generate_transaction_authkey_x8(hkds_server_x8_state* state, 
 	uint8_t tkey[HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE + HKDS_TAG_SIZE])
 {
-	uint8_t ctok[HKDS_CACHX8_DEPTH][HKDS_CTOK_SIZE] = { 0 };
-	uint8_t did[HKDS_CACHX8_DEPTH][HKDS_DID_SIZE] = { 0 };
-	uint8_t edk[HKDS_CACHX8_DEPTH][HKDS_EDK_SIZE] = { 0 };
 	uint8_t skey[HKDS_CACHX8_DEPTH][HKDS_CACHE_SIZE * HKDS_MESSAGE_SIZE] = { 0 };
-	uint8_t tok[HKDS_CACHX8_DEPTH][HKDS_STK_SIZE] = { 0 };
-	uint8_t tmpk[HKDS_CACHX8_DEPTH][HKDS_STK_SIZE + HKDS_EDK_SIZE] = { 0 };
-	uint32_t index[HKDS_CACHX8_DEPTH] = { 0 };
-	size_t i;
-
-	for (i = 0; i < HKDS_CACHX8_DEPTH; ++i)
-	{
-		/* get the key counter mod the cache size from the ksn */
-		index[i] = qsc_intutils_be8to32(((uint8_t*)state->ksn [i]+ HKDS_DID_SIZE)) % HKDS_CACHE_SIZE;
-		/* copy the device id from the ksn */
-		qsc_memutils_copy(did[i], state->ksn[i], HKDS_DID_SIZE);
-	}
-
-	/* generate the device key */
-	hkds_server_generate_edk_x8(state, did, edk);
-
-	/* generate the custom token string */
-	hkds_server_get_ctok_x8(state, ctok);
+	uint32_t index;
 
-	/* generate the device token from the base token and customization string */
-	hkds_server_generate_token_x8(state, ctok, tok);
+	/* generate the key cache of each lane */
+	hkds_server_generate_cache_x8(state, skey);
 
-	for (i = 0; i < HKDS_CACHX8_DEPTH; ++i)
+	for (size_t i = 0; i < HKDS_CACHX8_DEPTH; ++i)
 	{
-		/* copy token and edk to PRF key */
-		qsc_memutils_copy(tmpk[i], tok[i], HKDS_STK_SIZE);
-		qsc_memutils_copy(((uint8_t*)tmpk[i] + HKDS_STK_SIZE), edk[i], HKDS_EDK_SIZE);
+		/* get the key counter mod the cache size from the ksn */
+		index = qsc_intutils_be8to32(((uint8_t*)state->ksn[i] + HKDS_DID_SIZE)) % HKDS_CACHE_SIZE;
+		qsc_memutils_copy((uint8_t*)tkey[i], ((uint8_t*)skey[i] + ((size_t)index * HKDS_MESSAGE_SIZE)), 2 * HKDS_MESSAGE_SIZE);
 	}
 
-	/* generate the minimum number of blocks, and return the transaction key */
-#if defined(HKDS_SHAKE_128)
-	shake128x8(skey[0], skey[1], skey[2], skey[3], skey[4], skey[5], skey[6], skey[7], sizeof(skey[0]),
-		tmpk[0], tmpk[1], tmpk[2], tmpk[3], tmpk[4], tmpk[5], tmpk[6], tmpk[7], HKDS_STK_SIZE + HKDS_EDK_SIZE);
-#elif defined(HKDS_SHAKE_256)
-	shake256x8(skey[0], skey[1], skey[2], skey[3], skey[4], skey[5], skey[6], skey[7], sizeof(skey[0]),
-		tmpk[0], tmpk[1], tmpk[2], tmpk[3], tmpk[4], tmpk[5], tmpk[6], tmpk[7], HKDS_STK_SIZE + HKDS_EDK_SIZE);
-#else
-	shake512x8(skey[0], skey[1], skey[2], skey[3], skey[4], skey[5], skey[6], skey[7], sizeof(skey[0]),
-		tmpk[0], tmpk[1], tmpk[2], tmpk[3], tmpk[4], tmpk[5], tmpk[6], tmpk[7], HKDS_STK_SIZE + HKDS_EDK_SIZE);
-#endif
-
-	for (i = 0; i < HKDS_CACHX8_DEPTH; ++i)
-	{
-		qsc_memutils_copy((uint8_t*)tkey[i], ((uint8_t*)skey[i] + ((size_t)index[i] * HKDS_MESSAGE_SIZE)), 2 * HKDS_MESSAGE_SIZE);
-	}
+	qsc_memutils_clear((uint8_t*)skey, sizeof(skey));
 }
 
 void hkds_server_decrypt_message_x8(hkds_server_x8_state* state, 
@@ -530,6 +517,54 @@ void hkds_server_decrypt_verify_message_x8(hkds_server_x8_state* state,
 	}
 }
 
+void hkds_server_generate_cache_x8(hkds_server_x8_state* state, 
+	uint8_t skey[HKDS_CACHX8_DEPTH][HKDS_CACHE_SIZE * HKDS_MESSAGE_SIZE])
+{
+	uint8_t ctok[HKDS_CACHX8_DEPTH][HKDS_CTOK_SIZE] = { 0 };
+	uint8_t did[HKDS_CACHX8_DEPTH][HKDS_DID_SIZE] = { 0 };
+	uint8_t edk[HKDS_CACHX8_DEPTH][HKDS_EDK_SIZE] = { 0 };
+	uint8_t tok[HKDS_CACHX8_DEPTH][HKDS_STK_SIZE] = { 0 };
+	uint8_t tmpk[HKDS_CACHX8_DEPTH][HKDS_STK_SIZE + HKDS_EDK_SIZE] = { 0 };
+	size_t i;
+
+	for (i = 0; i < HKDS_CACHX8_DEPTH; ++i)
+	{
+		/* copy the device id from the ksn */
+		qsc_memutils_copy(did[i], state->ksn[i], HKDS_DID_SIZE);
+	}
+
+	/* generate the device key */
+	hkds_server_generate_edk_x8(state, did, edk);
+
+	/* generate the custom token string */
+	hkds_server_get_ctok_x8(state, ctok);
+
+	/* generate the device token from the base token and customization string */
+	hkds_server_generate_token_x8(state, ctok, tok);
+
+	for (i = 0; i < HKDS_CACHX8_DEPTH; ++i)
+	{
+		/* copy token and edk to PRF key */
+		qsc_memutils_copy(tmpk[i], tok[i], HKDS_STK_SIZE);
+		qsc_memutils_copy(((uint8_t*)tmpk[i] + HKDS_STK_SIZE), edk[i], HKDS_EDK_SIZE);
+	}
+
+	/* generate the full key cache of each lane */
+#if defined(HKDS_SHAKE_128)
+	shake128x8(skey[0], skey[1], skey[2], skey[3], skey[4], skey[5], skey[6], skey[7], HKDS_CACHE_SIZE * HKDS_MESSAGE_SIZE,
+		tmpk[0], tmpk[1], tmpk[2], tmpk[3], tmpk[4], tmpk[5], tmpk[6], tmpk[7], HKDS_STK_SIZE + HKDS_EDK_SIZE);
+#elif defined(HKDS_SHAKE_256)
+	shake256x8(skey[0], skey[1], skey[2], skey[3], skey[4], skey[5], skey[6], skey[7], HKDS_CACHE_SIZE * HKDS_MESSAGE_SIZE,
+		tmpk[0], tmpk[1], tmpk[2], tmpk[3], tmpk[4], tmpk[5], tmpk[6], tmpk[7], HKDS_STK_SIZE + HKDS_EDK_SIZE);
+#else
+	shake512x8(skey[0], skey[1], skey[2], skey[3], skey[4], skey[5], skey[6], skey[7], HKDS_CACHE_SIZE * HKDS_MESSAGE_SIZE,
+		tmpk[0], tmpk[1], tmpk[2], tmpk[3], tmpk[4], tmpk[5], tmpk[6], tmpk[7], HKDS_STK_SIZE + HKDS_EDK_SIZE);
+#endif
+
+	qsc_memutils_clear((uint8_t*)tok, sizeof(tok));
+	qsc_memutils_clear((uint8_t*)tmpk, sizeof(tmpk));
+}
+
 void hkds_server_generate_edk_x8(hkds_server_x8_state* state,
 	const uint8_t did[HKDS_CACHX8_DEPTH][HKDS_DID_SIZE],
 	uint8_t edk[HKDS_CACHX8_DEPTH][HKDS_EDK_SIZE])
@@ -633,3 +668,78 @@ void hkds_server_initialize_state_x64(hkds_server_x8_state state[HKDS_PARALLEL_D
 		hkds_server_initialize_state_x8(&state[i], &mdk[i], ksn[i]);
 	}
 }
+
+/* scheduled SIMD vectorized api */
+
+typedef struct
+{
+	hkds_server_x8_state* state;
+	const uint8_t (*ciphertext)[HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE];
+	const uint8_t (*ciphertextv)[HKDS_CACHX8_DEPTH][HKDS_TAG_SIZE + HKDS_MESSAGE_SIZE];
+	const uint8_t (*data)[HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE];
+	uint8_t (*plaintext)[HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE];
+	uint8_t (*etok)[HKDS_CACHX8_DEPTH][HKDS_STK_SIZE + HKDS_TAG_SIZE];
+	bool (*valid)[HKDS_CACHX8_DEPTH];
+	size_t datalen;
+} hkds_server_xn_task;
+
+static void hkds_server_decrypt_message_task(void* arg, size_t index)
+{
+	hkds_server_xn_task* task = (hkds_server_xn_task*)arg;
+
+	hkds_server_decrypt_message_x8(&task->state[index], task->ciphertext[index], task->plaintext[index]);
+}
+
+static void hkds_server_decrypt_verify_message_task(void* arg, size_t index)
+{
+	hkds_server_xn_task* task = (hkds_server_xn_task*)arg;
+
+	hkds_server_decrypt_verify_message_x8(&task->state[index], task->ciphertextv[index], task->data[index], task->datalen,
+		task->plaintext[index], task->valid[index]);
+}
+
+static void hkds_server_encrypt_token_task(void* arg, size_t index)
+{
+	hkds_server_xn_task* task = (hkds_server_xn_task*)arg;
+
+	hkds_server_encrypt_token_x8(&task->state[index], task->etok[index]);
+}
+
+void hkds_server_decrypt_message_xn(qsc_threadpool_scheduler* pool, hkds_server_x8_state* state, size_t sets,
+	const uint8_t ciphertext[][HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE],
+	uint8_t plaintext[][HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE])
+{
+	hkds_server_xn_task task = { 0 };
+
+	task.state = state;
+	task.ciphertext = ciphertext;
+	task.plaintext = plaintext;
+	qsc_threadpool_parallel_for(pool, sets, &hkds_server_decrypt_message_task, &task);
+}
+
+void hkds_server_decrypt_verify_message_xn(qsc_threadpool_scheduler* pool, hkds_server_x8_state* state, size_t sets,
+	const uint8_t ciphertext[][HKDS_CACHX8_DEPTH][HKDS_TAG_SIZE + HKDS_MESSAGE_SIZE],
+	const uint8_t data[][HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE], size_t datalen,
+	uint8_t plaintext[][HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE],
+	bool valid[][HKDS_CACHX8_DEPTH])
+{
+	hkds_server_xn_task task = { 0 };
+
+	task.state = state;
+	task.ciphertextv = ciphertext;
+	task.data = data;
+	task.datalen = datalen;
+	task.plaintext = plaintext;
+	task.valid = valid;
+	qsc_threadpool_parallel_for(pool, sets, &hkds_server_decrypt_verify_message_task, &task);
+}
+
+void hkds_server_encrypt_token_xn(qsc_threadpool_scheduler* pool, hkds_server_x8_state* state, size_t sets,
+	uint8_t etok[][HKDS_CACHX8_DEPTH][HKDS_STK_SIZE + HKDS_TAG_SIZE])
+{
+	hkds_server_xn_task task = { 0 };
+
+	task.state = state;
+	task.etok = etok;
+	qsc_threadpool_parallel_for(pool, sets, &hkds_server_encrypt_token_task, &task);
+}
@@ -21,6 +21,7 @@
 #define HKDS_SERVER_H
 
 #include "hkds_config.h"
+#include "../QSC/threadpool.h"
 
  /*! \struct hkds_master_key
  * Contains the HKDS master key set
@@ -69,6 +70,16 @@ HKDS_EXPORT_API void hkds_server_decrypt_message(hkds_server_state* state, const
 HKDS_EXPORT_API bool hkds_server_decrypt_verify_message(hkds_server_state* state, const uint8_t* ciphertext, const uint8_t* data,
 	size_t datalen, uint8_t* plaintext);
 
+/**
+* \brief Encrypt the secret token key of the clients next epoch.
+* The token is bound to the KSN at which the client will begin the next epoch,
+* and is sent to the client in a message token response (see hkds_server_push_token_required).
+*
+* \param state [struct] The function state
+* \param etok [array][output] The encrypted token output key array
+*/
+HKDS_EXPORT_API void hkds_server_encrypt_next_token(const hkds_server_state* state, uint8_t* etok);
+
 /**
 * \brief Encrypt a secret token key to send to the client
 *
@@ -77,6 +88,15 @@ HKDS_EXPORT_API bool hkds_server_decrypt_verify_message(hkds_server_state* state
 */
 HKDS_EXPORT_API void hkds_server_encrypt_token(hkds_server_state* state, uint8_t* etok);
 
+/**
+* \brief Generate the full transaction key cache of the clients current epoch.
+* The transaction key of counter n is at offset (n % HKDS_CACHE_SIZE) * HKDS_MESSAGE_SIZE.
+*
+* \param state [struct] The function state
+* \param skey [array][output] The transaction key cache output array, HKDS_CACHE_SIZE * HKDS_MESSAGE_SIZE bytes
+*/
+HKDS_EXPORT_API void hkds_server_generate_cache(const hkds_server_state* state, uint8_t* skey);
+
 /**
 * \brief Generate the embedded device key of a client.
 *
@@ -104,6 +124,15 @@ HKDS_EXPORT_API void hkds_server_generate_mdk(bool (*rng_generate)(uint8_t*, siz
 */
 HKDS_EXPORT_API void hkds_server_initialize_state(hkds_server_state* state, hkds_master_key* mdk, const uint8_t* ksn);
 
+/**
+* \brief Test if the clients key cache is within HKDS_PUSH_TOKEN_THRESHOLD transactions of exhaustion,
+* and the next epochs token should be attached to the message response
+*
+* \param state [struct][const] The function state
+* \return [bool] Returns true if the next token should be pushed to the client
+*/
+HKDS_EXPORT_API bool hkds_server_push_token_required(const hkds_server_state* state);
+
 /* SIMD vectorized x8 api */
 
 /*! \struct hkds_server_x8_state
@@ -156,6 +185,17 @@ HKDS_EXPORT_API void hkds_server_decrypt_verify_message_x8(hkds_server_x8_state*
 HKDS_EXPORT_API void hkds_server_encrypt_token_x8(hkds_server_x8_state* state, 
 	uint8_t etok[HKDS_CACHX8_DEPTH][HKDS_STK_SIZE + HKDS_TAG_SIZE]);
 
+/**
+* \brief Generate the full transaction key cache of the current epoch for a 2-dimensional x8 set of clients.
+* Each lanes cache is the key-stream the client derives from its token (see hkds_client_generate_cache),
+* the transaction key of counter n is at offset (n % HKDS_CACHE_SIZE) * HKDS_MESSAGE_SIZE.
+*
+* \param state [array][struct] A set of function states
+* \param skey [array2d][output] A set of transaction key cache output arrays
+*/
+HKDS_EXPORT_API void hkds_server_generate_cache_x8(hkds_server_x8_state* state, 
+	uint8_t skey[HKDS_CACHX8_DEPTH][HKDS_CACHE_SIZE * HKDS_MESSAGE_SIZE]);
+
 /**
 * \brief Generate a 2-dimensional x8 set of client embedded device keys
 *
@@ -242,4 +282,49 @@ HKDS_EXPORT_API void hkds_server_initialize_state_x64(hkds_server_x8_state state
 	hkds_master_key mdk[HKDS_PARALLEL_DEPTH],
 	const uint8_t ksn[HKDS_PARALLEL_DEPTH][HKDS_CACHX8_DEPTH][HKDS_KSN_SIZE]);
 
+/* Scheduled SIMD vectorized api */
+
+/**
+* \brief Decrypt any number of x8 sets of client messages on a work-stealing scheduler.
+* Each set is a task, so the work is spread over all of the scheduler threads, and the calling thread.
+*
+* \param pool [struct] The scheduler state
+* \param state [array][struct] A set of function states, one per x8 set
+* \param sets [size] The number of x8 sets
+* \param ciphertext [array3d][const] A set of encrypted messages
+* \param plaintext [array3d][output] A set of decrypted messages
+*/
+HKDS_EXPORT_API void hkds_server_decrypt_message_xn(qsc_threadpool_scheduler* pool, hkds_server_x8_state* state, size_t sets,
+	const uint8_t ciphertext[][HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE],
+	uint8_t plaintext[][HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE]);
+
+/**
+* \brief Verify and decrypt any number of x8 sets of client messages on a work-stealing scheduler.
+*
+* \param pool [struct] The scheduler state
+* \param state [array][struct] A set of function states, one per x8 set
+* \param sets [size] The number of x8 sets
+* \param ciphertext [array3d][const] A set of encrypted messages
+* \param data [array3d][const] A set of additional data arrays
+* \param datalen [size] The length of the additional data arrays
+* \param plaintext [array3d][output] A set of decrypted messages
+* \param valid [array2d][output] A set of booleans, indicating the verification of each messsage
+*/
+HKDS_EXPORT_API void hkds_server_decrypt_verify_message_xn(qsc_threadpool_scheduler* pool, hkds_server_x8_state* state, size_t sets,
+	const uint8_t ciphertext[][HKDS_CACHX8_DEPTH][HKDS_TAG_SIZE + HKDS_MESSAGE_SIZE],
+	const uint8_t data[][HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE], size_t datalen,
+	uint8_t plaintext[][HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE],
+	bool valid[][HKDS_CACHX8_DEPTH]);
+
+/**
+* \brief Encrypt any number of x8 sets of secret token keys on a work-stealing scheduler.
+*
+* \param pool [struct] The scheduler state
+* \param state [array][struct] A set of function states, one per x8 set
+* \param sets [size] The number of x8 sets
+* \param etok [array3d][output] A set of encrypted token output key arrays
+*/
+HKDS_EXPORT_API void hkds_server_encrypt_token_xn(qsc_threadpool_scheduler* pool, hkds_server_x8_state* state, size_t sets,
+	uint8_t etok[][HKDS_CACHX8_DEPTH][HKDS_STK_SIZE + HKDS_TAG_SIZE]);
+
 #endif
@@ -0,0 +1,669 @@
+#include "hkds_shard.h"
+#include "../QSC/atomics.h"
+#include "../QSC/intutils.h"
+#include "../QSC/memutils.h"
+#include "../QSC/sha3.h"
+#include "../QSC/timerex.h"
+
+#define HKDS_SHARD_READY 0x01
+#define HKDS_SHARD_FAILED 0x02
+
+static uint64_t hkds_shard_hash(const uint8_t* did)
+{
+	uint64_t h;
+
+	/* fnv-1a over the device id */
+	h = 0xCBF29CE484222325ULL;
+
+	for (size_t i = 0; i < HKDS_DID_SIZE; ++i)
+	{
+		h ^= did[i];
+		h *= 0x100000001B3ULL;
+	}
+
+	return h;
+}
+
+static hkds_shard_mark* hkds_shard_mark_find(hkds_shard_mark* marks, size_t slots, const uint8_t* did)
+{
+	size_t pos;
+
+	/* linear probing; the table always has an empty slot, so the probe ends at the device or at a free slot */
+	pos = (size_t)hkds_shard_hash(did) & (slots - 1);
+
+	while (marks[pos].used == true && qsc_intutils_are_equal8(marks[pos].did, did, HKDS_DID_SIZE) == false)
+	{
+		pos = (pos + 1) & (slots - 1);
+	}
+
+	return &marks[pos];
+}
+
+static bool hkds_shard_mark_grow(hkds_shard_worker* worker)
+{
+	hkds_shard_mark* marks;
+	hkds_shard_mark* slot;
+	size_t len;
+	bool res;
+
+	res = false;
+	len = worker->mslots * 2 * sizeof(hkds_shard_mark);
+	marks = (hkds_shard_mark*)qsc_memutils_aligned_alloc(64, len);
+
+	if (marks != NULL)
+	{
+		qsc_memutils_clear((uint8_t*)marks, len);
+
+		for (size_t i = 0; i < worker->mslots; ++i)
+		{
+			if (worker->marks[i].used == true)
+			{
+				slot = hkds_shard_mark_find(marks, worker->mslots * 2, worker->marks[i].did);
+				qsc_memutils_copy((uint8_t*)slot, (const uint8_t*)&worker->marks[i], sizeof(hkds_shard_mark));
+			}
+		}
+
+		qsc_memutils_clear((uint8_t*)worker->marks, worker->mslots * sizeof(hkds_shard_mark));
+		qsc_memutils_aligned_free(worker->marks);
+		worker->marks = marks;
+		worker->mslots *= 2;
+		res = true;
+	}
+
+	return res;
+}
+
+static bool hkds_shard_mark_store(hkds_shard_worker* worker, const hkds_shard_device* device)
+{
+	hkds_shard_mark* slot;
+	bool res;
+
+	res = true;
+	slot = hkds_shard_mark_find(worker->marks, worker->mslots, device->did);
+
+	if (slot->used == false)
+	{
+		/* the table is kept at most half full; if it cannot grow, it may fill until one free slot remains */
+		if ((worker->mcount + 1) * 2 > worker->mslots && hkds_shard_mark_grow(worker) == true)
+		{
+			slot = hkds_shard_mark_find(worker->marks, worker->mslots, device->did);
+		}
+
+		if (worker->mcount + 1 < worker->mslots)
+		{
+			qsc_memutils_copy(slot->did, device->did, HKDS_DID_SIZE);
+			slot->highest = device->highest;
+			slot->used = true;
+			++worker->mcount;
+		}
+		else
+		{
+			res = false;
+		}
+	}
+	else if (device->highest > slot->highest)
+	{
+		slot->highest = device->highest;
+	}
+
+	return res;
+}
+
+static hkds_shard_device* hkds_shard_get_device(hkds_shard_worker* worker, const uint8_t* did)
+{
+	hkds_shard_state* state;
+	hkds_shard_device* set;
+	hkds_shard_device* res;
+	const hkds_shard_mark* mark;
+	uint64_t rec;
+
+	state = (hkds_shard_state*)worker->owner;
+	set = worker->devices + ((size_t)((hkds_shard_hash(did) >> 32) & (worker->sets - 1)) * HKDS_SHARD_WAYS);
+	res = NULL;
+
+	for (size_t i = 0; i < HKDS_SHARD_WAYS; ++i)
+	{
+		if (set[i].used == true && qsc_intutils_are_equal8(set[i].did, did, HKDS_DID_SIZE) == true)
+		{
+			res = &set[i];
+			break;
+		}
+	}
+
+	if (res == NULL)
+	{
+		/* replace an unused entry, or the least recently used device of the set */
+		res = &set[0];
+
+		for (size_t i = 0; i < HKDS_SHARD_WAYS; ++i)
+		{
+			if (set[i].used == false)
+			{
+				res = &set[i];
+				break;
+			}
+
+			if (set[i].stamp < res->stamp)
+			{
+				res = &set[i];
+			}
+		}
+
+		/* the replaced device keeps its counter mark; if it cannot be kept, the device is not replaced */
+		if (res->used == true && res->window != 0 && hkds_shard_mark_store(worker, res) == false)
+		{
+			res = NULL;
+		}
+		else
+		{
+			qsc_memutils_clear((uint8_t*)res, sizeof(hkds_shard_device));
+			qsc_memutils_copy(res->did, did, HKDS_DID_SIZE);
+			res->used = true;
+			mark = hkds_shard_mark_find(worker->marks, worker->mslots, did);
+
+			if (mark->used == true)
+			{
+				/* the counters of a returning device below its mark are unknown, so the whole window is marked as used */
+				res->highest = mark->highest;
+				res->window = ~0ULL;
+			}
+
+			if (state->table != NULL && hkds_counter_read(state->table, state->slot(state->scontext, did), &rec) == true &&
+				(res->window == 0 || hkds_counter_value(rec) > res->highest))
+			{
+				/* a device accepted by another server, or before a failover, starts from the mark in its table slot */
+				res->highest = hkds_counter_value(rec);
+				res->window = ~0ULL;
+			}
+		}
+	}
+
+	if (res != NULL)
+	{
+		++worker->clock;
+		res->stamp = worker->clock;
+	}
+
+	return res;
+}
+
+static bool hkds_shard_replay_check(const hkds_shard_device* device, uint32_t ctr)
+{
+	uint32_t diff;
+	bool res;
+
+	/* an empty window accepts any counter */
+	res = true;
+
+	if (device->window != 0 && ctr <= device->highest)
+	{
+		diff = device->highest - ctr;
+		res = (diff < HKDS_SHARD_REPLAY_WINDOW && (device->window & (1ULL << diff)) == 0);
+	}
+
+	return res;
+}
+
+static bool hkds_shard_replay_update(hkds_shard_device* device, uint32_t ctr)
+{
+	uint32_t shift;
+	bool res;
+
+	res = false;
+
+	if (device->window == 0 || ctr > device->highest)
+	{
+		shift = (device->window == 0) ? HKDS_SHARD_REPLAY_WINDOW : ctr - device->highest;
+		device->window = (shift >= HKDS_SHARD_REPLAY_WINDOW) ? 1ULL : ((device->window << shift) | 1ULL);
+		device->highest = ctr;
+		res = true;
+	}
+	else
+	{
+		device->window |= (1ULL << (device->highest - ctr));
+	}
+
+	return res;
+}
+
+static void hkds_shard_execute(hkds_shard_worker* worker, const hkds_async_request* request, hkds_async_completion* completion)
+{
+	hkds_shard_state* state;
+	hkds_shard_device* dev;
+	hkds_server_state ss;
+	uint8_t code[HKDS_TAG_SIZE];
+	const uint8_t* pkey;
+	uint32_t ctr;
+	uint32_t epoch;
+	size_t index;
+
+	state = (hkds_shard_state*)worker->owner;
+	hkds_server_initialize_state(&ss, state->mdk, request->ksn);
+	completion->token = request->token;
+	completion->operation = request->operation;
+	completion->status = false;
+	qsc_memutils_clear(completion->output, HKDS_ASYNC_OUTPUT_SIZE);
+
+	if (request->operation == hkds_async_encrypt_token)
+	{
+		hkds_server_encrypt_token(&ss, completion->output);
+		completion->status = true;
+	}
+	else if ((request->operation == hkds_async_decrypt || request->operation == hkds_async_decrypt_verify) && request->datalen <= HKDS_MESSAGE_SIZE)
+	{
+		dev = hkds_shard_get_device(worker, request->ksn);
+		ctr = qsc_intutils_be8to32(request->ksn + HKDS_DID_SIZE);
+		epoch = ctr / HKDS_CACHE_SIZE;
+		index = (size_t)(ctr % HKDS_CACHE_SIZE);
+
+		if (dev == NULL)
+		{
+			/* the device table set is full and the mark table could not grow */
+		}
+		else if (hkds_shard_replay_check(dev, ctr) == false)
+		{
+			++worker->replays;
+		}
+		else
+		{
+			if (dev->keyed == false || dev->epoch != epoch)
+			{
+				/* derive the epochs key cache once, later messages of the epoch are a lookup */
+				hkds_server_generate_cache(&ss, dev->skey);
+				dev->epoch = epoch;
+				dev->keyed = true;
+				++worker->misses;
+			}
+			else
+			{
+				++worker->hits;
+			}
+
+			pkey = dev->skey + (index * HKDS_MESSAGE_SIZE);
+
+			if (request->operation == hkds_async_decrypt)
+			{
+				qsc_memutils_copy(completion->output, request->message, HKDS_MESSAGE_SIZE);
+				qsc_memutils_xor(completion->output, pkey, HKDS_MESSAGE_SIZE);
+				completion->status = true;
+			}
+			else if (index + 1 < HKDS_CACHE_SIZE)
+			{
+				/* the mac key is the next key in the cache */
+#if defined(HKDS_SHAKE_128)
+				qsc_kmac128_compute(code, sizeof(code), request->message, HKDS_MESSAGE_SIZE, pkey + HKDS_MESSAGE_SIZE, HKDS_MESSAGE_SIZE, request->data, request->datalen);
+#elif defined(HKDS_SHAKE_256)
+				qsc_kmac256_compute(code, sizeof(code), request->message, HKDS_MESSAGE_SIZE, pkey + HKDS_MESSAGE_SIZE, HKDS_MESSAGE_SIZE, request->data, request->datalen);
+#else
+				qsc_kmac512_compute(code, sizeof(code), request->message, HKDS_MESSAGE_SIZE, pkey + HKDS_MESSAGE_SIZE, HKDS_MESSAGE_SIZE, request->data, request->datalen);
+#endif
+
+				if (qsc_intutils_verify(code, request->message + HKDS_MESSAGE_SIZE, HKDS_TAG_SIZE) == 0)
+				{
+					qsc_memutils_copy(completion->output, request->message, HKDS_MESSAGE_SIZE);
+					qsc_memutils_xor(completion->output, pkey, HKDS_MESSAGE_SIZE);
+					completion->status = true;
+				}
+			}
+			else
+			{
+				/* the mac key of the last counter is past the end of the cache */
+				completion->status = hkds_server_decrypt_verify_message(&ss, request->message,
+					(request->datalen != 0) ? request->data : NULL, request->datalen, completion->output);
+			}
+
+			/* an unauthenticated message cannot be told from a forgery, so only a verified message moves the window;
+				a forged counter would otherwise raise the mark and lock the device out */
+			if (completion->status == true && request->operation == hkds_async_decrypt_verify &&
+				hkds_shard_replay_update(dev, ctr) == true && state->table != NULL)
+			{
+				/* the raised mark is shared, and logged for the standby when the table is replicated */
+				if (state->replica != NULL)
+				{
+					hkds_replica_update(state->replica, state->slot(state->scontext, request->ksn), hkds_counter_from_ksn(request->ksn));
+				}
+				else
+				{
+					hkds_counter_update(state->table, state->slot(state->scontext, request->ksn), hkds_counter_from_ksn(request->ksn));
+				}
+			}
+		}
+	}
+}
+
+static size_t hkds_shard_poll(hkds_shard_worker* worker)
+{
+	hkds_async_completion cpls[HKDS_ASYNC_BATCH_SIZE];
+	hkds_shard_state* state;
+	hkds_shard_ring* ring;
+	uint64_t head;
+	size_t cnt;
+	size_t res;
+
+	state = (hkds_shard_state*)worker->owner;
+	res = 0;
+
+	for (size_t i = 0; i < state->producers; ++i)
+	{
+		ring = &worker->rings[i];
+		head = ring->head;
+		cnt = (size_t)(qsc_atomics_load64(&ring->tail) - head);
+		cnt = (cnt < HKDS_ASYNC_BATCH_SIZE) ? cnt : HKDS_ASYNC_BATCH_SIZE;
+
+		if (cnt != 0)
+		{
+			for (size_t j = 0; j < cnt; ++j)
+			{
+				hkds_shard_execute(worker, &ring->items[(head + j) & (HKDS_SHARD_RING_SIZE - 1)], &cpls[j]);
+			}
+
+			/* release the slots to the producer */
+			qsc_atomics_store64(&ring->head, head + cnt);
+			state->callback(state->context, cpls, cnt);
+			qsc_memutils_clear((uint8_t*)cpls, cnt * sizeof(hkds_async_completion));
+			res += cnt;
+		}
+	}
+
+	return res;
+}
+
+static bool hkds_shard_allocate(hkds_shard_worker* worker)
+{
+	hkds_shard_state* state;
+	size_t len;
+	bool res;
+
+	state = (hkds_shard_state*)worker->owner;
+	res = false;
+	len = worker->sets * HKDS_SHARD_WAYS * sizeof(hkds_shard_device);
+	worker->devices = (hkds_shard_device*)qsc_memutils_aligned_alloc(64, len);
+	worker->rings = (hkds_shard_ring*)qsc_memutils_aligned_alloc(64, state->producers * sizeof(hkds_shard_ring));
+	worker->mslots = worker->sets * HKDS_SHARD_WAYS * 2;
+	worker->mcount = 0;
+	worker->marks = (hkds_shard_mark*)qsc_memutils_aligned_alloc(64, worker->mslots * sizeof(hkds_shard_mark));
+
+	if (worker->devices != NULL && worker->rings != NULL && worker->marks != NULL)
+	{
+		/* writing the memory from the pinned thread places its pages on the workers node */
+		qsc_memutils_clear((uint8_t*)worker->devices, len);
+		qsc_memutils_clear((uint8_t*)worker->marks, worker->mslots * sizeof(hkds_shard_mark));
+		qsc_memutils_clear((uint8_t*)worker->rings, state->producers * sizeof(hkds_shard_ring));
+		res = true;
+
+		for (size_t i = 0; i < state->producers; ++i)
+		{
+			worker->rings[i].items = (hkds_async_request*)qsc_memutils_aligned_alloc(64, HKDS_SHARD_RING_SIZE * sizeof(hkds_async_request));
+
+			if (worker->rings[i].items == NULL)
+			{
+				res = false;
+				break;
+			}
+
+			qsc_memutils_clear((uint8_t*)worker->rings[i].items, HKDS_SHARD_RING_SIZE * sizeof(hkds_async_request));
+		}
+	}
+
+	return res;
+}
+
+static void hkds_shard_release(hkds_shard_worker* worker, size_t producers)
+{
+	if (worker->rings != NULL)
+	{
+		for (size_t i = 0; i < producers; ++i)
+		{
+			if (worker->rings[i].items != NULL)
+			{
+				qsc_memutils_clear((uint8_t*)worker->rings[i].items, HKDS_SHARD_RING_SIZE * sizeof(hkds_async_request));
+				qsc_memutils_aligned_free(worker->rings[i].items);
+			}
+		}
+
+		qsc_memutils_aligned_free(worker->rings);
+		worker->rings = NULL;
+	}
+
+	if (worker->devices != NULL)
+	{
+		qsc_memutils_clear((uint8_t*)worker->devices, worker->sets * HKDS_SHARD_WAYS * sizeof(hkds_shard_device));
+		qsc_memutils_aligned_free(worker->devices);
+		worker->devices = NULL;
+	}
+
+	if (worker->marks != NULL)
+	{
+		qsc_memutils_clear((uint8_t*)worker->marks, worker->mslots * sizeof(hkds_shard_mark));
+		qsc_memutils_aligned_free(worker->marks);
+		worker->marks = NULL;
+		worker->mslots = 0;
+		worker->mcount = 0;
+	}
+}
+
+static void hkds_shard_worker_run(void* arg)
+{
+	hkds_shard_worker* worker;
+	hkds_shard_state* state;
+	size_t idle;
+
+	worker = (hkds_shard_worker*)arg;
+	state = (hkds_shard_state*)worker->owner;
+
+	if (state->pinned == true)
+	{
+		qsc_async_thread_affinity(worker->cpu);
+	}
+
+	if (hkds_shard_allocate(worker) == true)
+	{
+		qsc_atomics_store64(&worker->ready, HKDS_SHARD_READY);
+		idle = 0;
+
+		while (qsc_atomics_load64(&state->running) != 0)
+		{
+			if (hkds_shard_poll(worker) != 0)
+			{
+				idle = 0;
+			}
+			else if (idle < HKDS_SHARD_SPIN_COUNT)
+			{
+				qsc_atomics_pause();
+				++idle;
+			}
+			else if (idle < 2 * HKDS_SHARD_SPIN_COUNT)
+			{
+				qsc_async_thread_yield();
+				++idle;
+			}
+			else
+			{
+				qsc_async_thread_sleep(1);
+			}
+		}
+	}
+	else
+	{
+		qsc_atomics_store64(&worker->ready, HKDS_SHARD_FAILED);
+	}
+}
+
+bool hkds_shard_initialize(hkds_shard_state* state, hkds_master_key* mdk, size_t workers, size_t producers, size_t capacity,
+	bool pinned, hkds_async_callback callback, void* context)
+{
+	assert(state != NULL);
+	assert(mdk != NULL);
+	assert(callback != NULL);
+	assert(producers != 0 && producers <= HKDS_SHARD_PRODUCERS_MAX);
+	assert(capacity != 0);
+
+	uint64_t start;
+	size_t cpus;
+	size_t sets;
+	bool res;
+
+	res = false;
+
+	if (state != NULL && mdk != NULL && callback != NULL && producers != 0 && producers <= HKDS_SHARD_PRODUCERS_MAX && capacity != 0)
+	{
+		cpus = qsc_async_processor_count();
+		state->wcount = (workers != 0) ? workers : cpus;
+		state->wcount = (state->wcount < HKDS_SHARD_WORKERS_MAX) ? state->wcount : HKDS_SHARD_WORKERS_MAX;
+		state->workers = (hkds_shard_worker*)qsc_memutils_aligned_alloc(64, state->wcount * sizeof(hkds_shard_worker));
+
+		if (state->workers != NULL)
+		{
+			sets = 1;
+
+			while (sets * HKDS_SHARD_WAYS < capacity)
+			{
+				sets <<= 1;
+			}
+
+			qsc_memutils_clear((uint8_t*)state->workers, state->wcount * sizeof(hkds_shard_worker));
+			state->mdk = mdk;
+			state->callback = callback;
+			state->context = context;
+			state->table = NULL;
+			state->replica = NULL;
+			state->slot = NULL;
+			state->scontext = NULL;
+			state->capacity = sets * HKDS_SHARD_WAYS;
+			state->producers = producers;
+			state->pinned = pinned;
+			state->running = 1;
+
+			for (size_t i = 0; i < state->wcount; ++i)
+			{
+				state->workers[i].owner = state;
+				state->workers[i].cpu = i % cpus;
+				state->workers[i].index = i;
+				state->workers[i].sets = sets;
+				state->workers[i].thread = qsc_async_thread_create(&hkds_shard_worker_run, &state->workers[i]);
+			}
+
+			res = true;
+			start = qsc_timerex_monotonic_microseconds();
+
+			/* wait for each worker to allocate its memory on its own node; a worker that was not created, or does not start in time, fails the initialization */
+			for (size_t i = 0; i < state->wcount; ++i)
+			{
+				if (state->workers[i].thread != 0)
+				{
+					while (qsc_atomics_load64(&state->workers[i].ready) == 0 &&
+						qsc_timerex_monotonic_microseconds() - start < (uint64_t)HKDS_SHARD_START_TIMEOUT * 1000ULL)
+					{
+						qsc_async_thread_sleep(1);
+					}
+				}
+
+				if (qsc_atomics_load64(&state->workers[i].ready) != HKDS_SHARD_READY)
+				{
+					res = false;
+				}
+			}
+
+			if (res == false)
+			{
+				hkds_shard_dispose(state);
+			}
+		}
+	}
+
+	return res;
+}
+
+bool hkds_shard_attach_table(hkds_shard_state* state, hkds_counter_table* table, hkds_replica_log_state* replica,
+	hkds_shard_slot slot, void* context)
+{
+	assert(state != NULL);
+	assert(table != NULL);
+	assert(slot != NULL);
+
+	bool res;
+
+	res = false;
+
+	if (state != NULL && table != NULL && slot != NULL && (replica == NULL || replica->table == table))
+	{
+		/* the workers read these after the next submit publishes a request to them */
+		state->table = table;
+		state->replica = replica;
+		state->slot = slot;
+		state->scontext = context;
+		res = true;
+	}
+
+	return res;
+}
+
+void hkds_shard_dispose(hkds_shard_state* state)
+{
+	assert(state != NULL);
+
+	if (state != NULL && state->workers != NULL)
+	{
+		qsc_atomics_store64(&state->running, 0);
+
+		for (size_t i = 0; i < state->wcount; ++i)
+		{
+			if (state->workers[i].thread != 0)
+			{
+				qsc_async_thread_wait(state->workers[i].thread);
+			}
+
+			hkds_shard_release(&state->workers[i], state->producers);
+		}
+
+		qsc_memutils_aligned_free(state->workers);
+		state->workers = NULL;
+		state->mdk = NULL;
+		state->callback = NULL;
+		state->context = NULL;
+		state->table = NULL;
+		state->replica = NULL;
+		state->slot = NULL;
+		state->scontext = NULL;
+		state->capacity = 0;
+		state->producers = 0;
+		state->wcount = 0;
+	}
+}
+
+size_t hkds_shard_owner(const hkds_shard_state* state, const uint8_t* ksn)
+{
+	assert(state != NULL);
+	assert(ksn != NULL);
+
+	return (size_t)(hkds_shard_hash(ksn) % state->wcount);
+}
+
+bool hkds_shard_submit(hkds_shard_state* state, size_t producer, const hkds_async_request* request)
+{
+	assert(state != NULL);
+	assert(request != NULL);
+	assert(producer < state->producers);
+
+	hkds_shard_ring* ring;
+	uint64_t tail;
+	bool res;
+
+	res = false;
+
+	if (state != NULL && request != NULL && state->workers != NULL && producer < state->producers)
+	{
+		ring = &state->workers[hkds_shard_owner(state, request->ksn)].rings[producer];
+		tail = ring->tail;
+
+		if (tail - qsc_atomics_load64(&ring->head) < HKDS_SHARD_RING_SIZE)
+		{
+			qsc_memutils_copy((uint8_t*)&ring->items[tail & (HKDS_SHARD_RING_SIZE - 1)], (const uint8_t*)request, sizeof(hkds_async_request));
+			/* publish the request to the worker */
+			qsc_atomics_store64(&ring->tail, tail + 1);
+			res = true;
+		}
+	}
+
+	return res;
+}
@@ -0,0 +1,236 @@
+/* 2021 Digital Freedom Defense Incorporated
+ * All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Digital Freedom Defense Incorporated.
+ * The intellectual and technical concepts contained
+ * herein are proprietary to Digital Freedom Defense Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Digital Freedom Defense Incorporated.
+ *
+ * Contact: develop@dfdef.com
+ */
+
+#ifndef HKDS_SHARD_H
+#define HKDS_SHARD_H
+
+#include "common.h"
+#include "hkds_async.h"
+#include "hkds_config.h"
+#include "hkds_counter.h"
+#include "hkds_replica.h"
+#include "hkds_server.h"
+#include "../QSC/async.h"
+
+/* Device sharded server workers.
+* Each worker thread is pinned to a processor and owns the devices whose identity hashes to it.
+* Requests are routed to the owning worker through single-producer single-consumer rings,
+* one ring for each producer thread, so no ring is shared by two writers.
+* A worker keeps a table of its devices, holding the transaction key cache of the devices current epoch
+* and a replay window of its recently used counters. Only the owning worker reads or writes a device entry,
+* so the table needs no lock and its cache lines stay on one core.
+* When a device entry is replaced, the highest counter accepted from the device is kept in a second table owned by the worker,
+* keyed by the device identity and never cleared; a device that returns is restored with that mark, and a counter at or below it is rejected.
+* Only an authenticated message that verified raises the window; an unauthenticated message is checked against the window but
+* does not move it, so unauthenticated devices have no replay guarantee, and a forged counter cannot lock a device out.
+* A shard can share a device counter high-water table with other servers: every raise of a device mark is also applied to
+* the devices table slot, and written to the replication log when one is attached, and a device first seen by a worker starts
+* from the mark in its slot. A standby that tails the log holds the same table, and seeds the shard that takes over from it.
+* The table and rings are allocated by the worker thread after it is pinned, so on a multi-socket
+* server the first-touch policy places them in the memory of the workers node.
+* Requests use the asynchronous request and completion structures; completions are passed to the
+* callback in batches, on the worker thread. */
+
+/*!
+\def HKDS_SHARD_WORKERS_MAX
+* The maximum number of shard workers
+*/
+#define HKDS_SHARD_WORKERS_MAX 256
+
+/*!
+\def HKDS_SHARD_PRODUCERS_MAX
+* The maximum number of producer threads
+*/
+#define HKDS_SHARD_PRODUCERS_MAX 64
+
+/*!
+\def HKDS_SHARD_RING_SIZE
+* The capacity of a producer ring, a power of two
+*/
+#define HKDS_SHARD_RING_SIZE 256
+
+/*!
+\def HKDS_SHARD_WAYS
+* The number of devices in each device table set
+*/
+#define HKDS_SHARD_WAYS 4
+
+/*!
+\def HKDS_SHARD_REPLAY_WINDOW
+* The number of counters tracked by a devices replay window
+*/
+#define HKDS_SHARD_REPLAY_WINDOW 64
+
+/*!
+\def HKDS_SHARD_SPIN_COUNT
+* The number of idle iterations a worker spins, then yields, before it sleeps between polls
+*/
+#define HKDS_SHARD_SPIN_COUNT 1024
+
+/*!
+\def HKDS_SHARD_START_TIMEOUT
+* The time in milliseconds initialization waits for the workers to allocate their memory
+*/
+#define HKDS_SHARD_START_TIMEOUT 10000
+
+/*! \typedef hkds_shard_slot
+* Maps a device identity to its counter table slot; the primary and the standby must use the same mapping,
+* and it is called from the worker threads
+*/
+typedef size_t (*hkds_shard_slot)(void* context, const uint8_t* did);
+
+/*! \struct hkds_shard_ring
+* A single-producer single-consumer request ring
+*/
+HKDS_EXPORT_API typedef struct
+{
+	volatile uint64_t head;					/*!< The consumer position */
+	uint8_t pad1[56];						/*!< Keeps the positions on separate cache lines */
+	volatile uint64_t tail;					/*!< The producer position */
+	uint8_t pad2[56];						/*!< Cache line padding */
+	hkds_async_request* items;				/*!< The request ring */
+} hkds_shard_ring;
+
+/*! \struct hkds_shard_device
+* A device entry owned by a shard worker
+*/
+HKDS_EXPORT_API typedef struct
+{
+	uint8_t did[HKDS_DID_SIZE];								/*!< The device identity */
+	uint8_t skey[HKDS_CACHE_SIZE * HKDS_MESSAGE_SIZE];		/*!< The transaction key cache of the keyed epoch */
+	uint64_t window;										/*!< The replay window bitmap, bit n marks counter (highest - n) */
+	uint64_t stamp;											/*!< The last use, for replacement */
+	uint32_t epoch;											/*!< The epoch of the key cache */
+	uint32_t highest;										/*!< The highest counter accepted */
+	bool keyed;												/*!< The key cache is valid */
+	bool used;												/*!< The entry is tracking a device */
+} hkds_shard_device;
+
+/*! \struct hkds_shard_mark
+* The highest counter accepted from a device, kept after its entry is replaced
+*/
+HKDS_EXPORT_API typedef struct
+{
+	uint8_t did[HKDS_DID_SIZE];								/*!< The device identity */
+	uint32_t highest;										/*!< The highest counter accepted */
+	bool used;												/*!< The mark is holding a device */
+} hkds_shard_mark;
+
+/*! \struct hkds_shard_worker
+* A shard worker state
+*/
+HKDS_EXPORT_API typedef struct
+{
+	hkds_shard_ring* rings;					/*!< The request rings, one per producer */
+	hkds_shard_device* devices;				/*!< The workers device table */
+	hkds_shard_mark* marks;					/*!< The counter marks of replaced devices, an open addressed table */
+	void* owner;							/*!< The shard state */
+	size_t cpu;								/*!< The processor the worker is pinned to */
+	size_t index;							/*!< The worker index */
+	size_t sets;							/*!< The number of device table sets, a power of two */
+	size_t mslots;							/*!< The number of mark table slots, a power of two */
+	size_t mcount;							/*!< The number of marks held */
+	uint64_t clock;							/*!< The device use counter */
+	volatile uint64_t ready;				/*!< The worker has allocated its memory; 2 if the allocation failed */
+	uint64_t hits;							/*!< The number of messages decrypted with a cached key cache */
+	uint64_t misses;						/*!< The number of key caches derived */
+	uint64_t replays;						/*!< The number of messages rejected by the replay window */
+	qsc_thread thread;						/*!< The worker thread */
+} hkds_shard_worker;
+
+/*! \struct hkds_shard_state
+* Contains the sharded server state
+*/
+HKDS_EXPORT_API typedef struct
+{
+	hkds_shard_worker* workers;				/*!< The shard workers */
+	hkds_master_key* mdk;					/*!< A pointer to the master derivation key */
+	hkds_async_callback callback;			/*!< The completion callback */
+	void* context;							/*!< The completion callback context */
+	hkds_counter_table* table;				/*!< The shared device counter table, or NULL */
+	hkds_replica_log_state* replica;		/*!< The replication log of the counter table, or NULL */
+	hkds_shard_slot slot;					/*!< The device to table slot mapping */
+	void* scontext;							/*!< The slot mapping context */
+	size_t capacity;						/*!< The number of devices tracked by each worker */
+	size_t producers;						/*!< The number of producer threads */
+	size_t wcount;							/*!< The number of workers */
+	bool pinned;							/*!< Workers are pinned to processors */
+	volatile uint64_t running;				/*!< The workers are running */
+} hkds_shard_state;
+
+/**
+* \brief Start the shard workers.
+* Returns after every worker has allocated its device table and rings, or fails if a worker
+* thread could not be created or did not start within HKDS_SHARD_START_TIMEOUT.
+*
+* \param state [struct] The shard state
+* \param mdk [struct] The master key set
+* \param workers [size] The number of workers, zero selects the processor count
+* \param producers [size] The number of threads that submit requests
+* \param capacity [size] The number of devices tracked by each worker, rounded up to a power of two sets
+* \param pinned [bool] Pin each worker to a processor
+* \param callback [pointer] The completion callback
+* \param context [pointer] The callback context
+* \return [bool] Returns true if every worker started
+*/
+HKDS_EXPORT_API bool hkds_shard_initialize(hkds_shard_state* state, hkds_master_key* mdk, size_t workers, size_t producers, size_t capacity,
+	bool pinned, hkds_async_callback callback, void* context);
+
+/**
+* \brief Share a device counter high-water table with the workers.
+* Must be called before the first request is submitted. Each raise of a device mark is applied to the table,
+* through the replication log when one is given, and a device new to a worker starts from the mark in its slot;
+* a standby table filled from the log seeds the shard that takes over on failover.
+*
+* \param state [struct] The shard state
+* \param table [struct] The device counter table
+* \param replica [struct] The replication log writing the table, or NULL
+* \param slot [pointer] The device to table slot mapping
+* \param context [pointer] The slot mapping context
+* \return [bool] Returns false if the replication log does not write this table
+*/
+HKDS_EXPORT_API bool hkds_shard_attach_table(hkds_shard_state* state, hkds_counter_table* table, hkds_replica_log_state* replica,
+	hkds_shard_slot slot, void* context);
+
+/**
+* \brief Stop the shard workers and release their memory.
+* Requests still in the rings are discarded.
+*
+* \param state [struct] The shard state
+*/
+HKDS_EXPORT_API void hkds_shard_dispose(hkds_shard_state* state);
+
+/**
+* \brief Get the index of the worker that owns a device
+*
+* \param state [struct][const] The shard state
+* \param ksn [array][const] The clients key serial number
+* \return [size] The owning worker index
+*/
+HKDS_EXPORT_API size_t hkds_shard_owner(const hkds_shard_state* state, const uint8_t* ksn);
+
+/**
+* \brief Route a request to the worker that owns its device.
+* Each producer index must be used by only one thread.
+*
+* \param state [struct] The shard state
+* \param producer [size] The index of the calling producer thread
+* \param request [struct][const] The request
+* \return [bool] Returns false if the owning workers ring is full
+*/
+HKDS_EXPORT_API bool hkds_shard_submit(hkds_shard_state* state, size_t producer, const hkds_async_request* request);
+
+#endif
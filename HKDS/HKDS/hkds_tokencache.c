@@ -0,0 +1,295 @@
+#include "hkds_tokencache.h"
+#include "../QSC/async.h"
+#include "../QSC/atomics.h"
+#include "../QSC/intutils.h"
+#include "../QSC/memutils.h"
+#include "../QSC/timerex.h"
+
+#define HKDS_TOKENCACHE_STATE_EMPTY 0x00
+#define HKDS_TOKENCACHE_STATE_PENDING 0x01
+#define HKDS_TOKENCACHE_STATE_READY 0x02
+#define HKDS_TOKENCACHE_STATE_MASK 0x03ULL
+#define HKDS_TOKENCACHE_SEQUENCE_MASK 0xFFFFFFFCULL
+
+static uint64_t hkds_tokencache_control(uint32_t tag, uint64_t control, uint64_t cstate)
+{
+	/* advance the sequence so a reader can detect that the slot changed while it was copied */
+	return ((uint64_t)tag << 32) | (((control & HKDS_TOKENCACHE_SEQUENCE_MASK) + 4) & HKDS_TOKENCACHE_SEQUENCE_MASK) | cstate;
+}
+
+static uint64_t hkds_tokencache_hash(const uint8_t* ksn)
+{
+	uint64_t h;
+	uint32_t tkc;
+
+	/* fnv-1a over the device id and token epoch */
+	h = 0xCBF29CE484222325ULL;
+
+	for (size_t i = 0; i < HKDS_DID_SIZE; ++i)
+	{
+		h ^= ksn[i];
+		h *= 0x100000001B3ULL;
+	}
+
+	tkc = qsc_intutils_be8to32(ksn + HKDS_DID_SIZE) / HKDS_CACHE_SIZE;
+
+	for (size_t i = 0; i < HKDS_TKC_SIZE; ++i)
+	{
+		h ^= (uint8_t)(tkc >> (i * 8));
+		h *= 0x100000001B3ULL;
+	}
+
+	return h;
+}
+
+static void hkds_tokencache_wait(volatile uint64_t* control, uint64_t expected)
+{
+	size_t ctr;
+
+	ctr = 0;
+
+	while (qsc_atomics_load64(control) == expected)
+	{
+		if (ctr < HKDS_TOKENCACHE_SPIN_COUNT)
+		{
+			qsc_atomics_pause();
+			++ctr;
+		}
+		else
+		{
+			qsc_async_thread_yield();
+		}
+	}
+}
+
+bool hkds_tokencache_initialize(hkds_tokencache_state* cache, size_t capacity, uint64_t ttl)
+{
+	assert(cache != NULL);
+	assert(capacity != 0);
+
+	size_t len;
+	size_t sets;
+	bool res;
+
+	res = false;
+
+	if (cache != NULL && capacity != 0)
+	{
+		sets = 1;
+
+		while (sets * HKDS_TOKENCACHE_WAYS < capacity)
+		{
+			sets <<= 1;
+		}
+
+		len = sets * HKDS_TOKENCACHE_WAYS * sizeof(hkds_tokencache_slot);
+		cache->slots = (hkds_tokencache_slot*)qsc_memutils_aligned_alloc(64, len);
+
+		if (cache->slots != NULL)
+		{
+			qsc_memutils_clear((uint8_t*)cache->slots, len);
+			cache->sets = sets;
+			cache->ttl = (ttl != 0) ? ttl : HKDS_TOKENCACHE_TTL_DEFAULT;
+			cache->hits = 0;
+			cache->misses = 0;
+			cache->coalesced = 0;
+			res = true;
+		}
+	}
+
+	return res;
+}
+
+void hkds_tokencache_dispose(hkds_tokencache_state* cache)
+{
+	assert(cache != NULL);
+
+	if (cache != NULL)
+	{
+		if (cache->slots != NULL)
+		{
+			qsc_memutils_clear((uint8_t*)cache->slots, cache->sets * HKDS_TOKENCACHE_WAYS * sizeof(hkds_tokencache_slot));
+			qsc_memutils_aligned_free(cache->slots);
+			cache->slots = NULL;
+		}
+
+		cache->sets = 0;
+		cache->ttl = 0;
+	}
+}
+
+hkds_tokencache_results hkds_tokencache_encrypt_token(hkds_tokencache_state* cache, hkds_server_state* state, uint8_t* etok)
+{
+	assert(cache != NULL);
+	assert(state != NULL);
+	assert(etok != NULL);
+
+	hkds_tokencache_slot copy;
+	hkds_tokencache_slot* pending;
+	hkds_tokencache_slot* set;
+	hkds_tokencache_slot* victim;
+	uint64_t ctl;
+	uint64_t hash;
+	uint64_t now;
+	uint64_t oldest;
+	uint64_t pctl;
+	uint64_t vctl;
+	hkds_tokencache_results res;
+	uint32_t tag;
+	bool found;
+	bool rescan;
+	bool waited;
+
+	res = hkds_tokencache_computed;
+
+	if (cache == NULL || cache->slots == NULL)
+	{
+		hkds_server_encrypt_token(state, etok);
+	}
+	else
+	{
+		hash = hkds_tokencache_hash(state->ksn);
+		tag = (uint32_t)(hash >> 32);
+		set = cache->slots + ((hash & (cache->sets - 1)) * HKDS_TOKENCACHE_WAYS);
+		waited = false;
+
+		while (true)
+		{
+			now = qsc_timerex_monotonic_microseconds();
+			pending = NULL;
+			victim = NULL;
+			found = false;
+			rescan = false;
+			oldest = UINT64_MAX;
+			pctl = 0;
+			vctl = 0;
+
+			for (size_t i = 0; i < HKDS_TOKENCACHE_WAYS; ++i)
+			{
+				ctl = qsc_atomics_load64(&set[i].control);
+
+				if ((ctl & HKDS_TOKENCACHE_STATE_MASK) == HKDS_TOKENCACHE_STATE_PENDING)
+				{
+					if ((uint32_t)(ctl >> 32) == tag)
+					{
+						/* a concurrent request is computing a token for this key */
+						pending = &set[i];
+						pctl = ctl;
+						break;
+					}
+				}
+				else if ((ctl & HKDS_TOKENCACHE_STATE_MASK) == HKDS_TOKENCACHE_STATE_READY)
+				{
+					/* copy the entry, then confirm it was not replaced during the copy */
+					qsc_memutils_copy((uint8_t*)&copy, (const uint8_t*)&set[i], sizeof(hkds_tokencache_slot));
+					qsc_atomics_fence();
+
+					if (qsc_atomics_load64(&set[i].control) != ctl)
+					{
+						rescan = true;
+						break;
+					}
+
+					if ((uint32_t)(ctl >> 32) == tag && copy.time + cache->ttl >= now &&
+						qsc_intutils_are_equal8(copy.ksn, state->ksn, HKDS_KSN_SIZE) == true &&
+						qsc_intutils_are_equal8(copy.kid, state->mdk->kid, HKDS_KID_SIZE) == true)
+					{
+						qsc_memutils_copy(etok, copy.etok, HKDS_ETOK_SIZE);
+						found = true;
+						break;
+					}
+
+					if (copy.time + cache->ttl < now || (uint32_t)(ctl >> 32) == tag)
+					{
+						/* expired entries, and stale entries for this key, are replaced first */
+						if (oldest != 0)
+						{
+							victim = &set[i];
+							vctl = ctl;
+							oldest = 0;
+						}
+					}
+					else if (copy.time < oldest)
+					{
+						victim = &set[i];
+						vctl = ctl;
+						oldest = copy.time;
+					}
+				}
+				else if (oldest != 0)
+				{
+					/* an empty slot */
+					victim = &set[i];
+					vctl = ctl;
+					oldest = 0;
+				}
+			}
+
+			if (found == true)
+			{
+				qsc_atomics_fetch_add64(&cache->hits, 1);
+				res = (waited == true) ? hkds_tokencache_coalesced : hkds_tokencache_hit;
+				break;
+			}
+
+			if (rescan == true)
+			{
+				continue;
+			}
+
+			if (pending != NULL)
+			{
+				if (waited == false)
+				{
+					qsc_atomics_fetch_add64(&cache->coalesced, 1);
+					waited = true;
+				}
+
+				hkds_tokencache_wait(&pending->control, pctl);
+				continue;
+			}
+
+			if (victim == NULL)
+			{
+				/* every slot in the set is being written; encrypt without caching */
+				hkds_server_encrypt_token(state, etok);
+				qsc_atomics_fetch_add64(&cache->misses, 1);
+				break;
+			}
+
+			/* claim the slot; concurrent requests for this key now wait on it */
+			ctl = hkds_tokencache_control(tag, vctl, HKDS_TOKENCACHE_STATE_PENDING);
+
+			if (qsc_atomics_compare_exchange64(&victim->control, &vctl, ctl) == true)
+			{
+				hkds_server_encrypt_token(state, etok);
+
+				qsc_memutils_copy(victim->kid, state->mdk->kid, HKDS_KID_SIZE);
+				qsc_memutils_copy(victim->ksn, state->ksn, HKDS_KSN_SIZE);
+				qsc_memutils_copy(victim->etok, etok, HKDS_ETOK_SIZE);
+				victim->time = qsc_timerex_monotonic_microseconds();
+
+				/* publish the entry */
+				qsc_atomics_store64(&victim->control, hkds_tokencache_control(tag, ctl, HKDS_TOKENCACHE_STATE_READY));
+				qsc_atomics_fetch_add64(&cache->misses, 1);
+				res = hkds_tokencache_computed;
+				break;
+			}
+		}
+	}
+
+	return res;
+}
+
+void hkds_tokencache_clear(hkds_tokencache_state* cache)
+{
+	assert(cache != NULL);
+
+	if (cache != NULL && cache->slots != NULL)
+	{
+		qsc_memutils_clear((uint8_t*)cache->slots, cache->sets * HKDS_TOKENCACHE_WAYS * sizeof(hkds_tokencache_slot));
+		cache->hits = 0;
+		cache->misses = 0;
+		cache->coalesced = 0;
+	}
+}
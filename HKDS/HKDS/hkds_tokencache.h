@@ -0,0 +1,124 @@
+/* 2021 Digital Freedom Defense Incorporated
+ * All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Digital Freedom Defense Incorporated.
+ * The intellectual and technical concepts contained
+ * herein are proprietary to Digital Freedom Defense Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Digital Freedom Defense Incorporated.
+ *
+ * Contact: develop@dfdef.com
+ */
+
+#ifndef HKDS_TOKENCACHE_H
+#define HKDS_TOKENCACHE_H
+
+#include "common.h"
+#include "hkds_config.h"
+#include "hkds_server.h"
+
+/* Encrypted token issuance cache.
+* A client that does not receive its token response retries the same token request, and at an epoch
+* rollover many clients request tokens at once. The cache stores each encrypted token for a short time,
+* keyed by the device identity and token epoch (DID, tkc), so a retry is answered with a lookup.
+* Concurrent requests for the same key are coalesced; the first thread computes the token while
+* the others wait for it to be published, instead of repeating the derivation.
+* The cache is a fixed set-associative table and is safe to share between server threads without a lock.
+* Because the token MAC binds the full key serial number, an entry is only returned for an exact
+* KSN and master key identity match, so a cached token is identical to a freshly encrypted one. */
+
+/*!
+\def HKDS_TOKENCACHE_WAYS
+* The number of slots in each cache set
+*/
+#define HKDS_TOKENCACHE_WAYS 4
+
+/*!
+\def HKDS_TOKENCACHE_TTL_DEFAULT
+* The default lifetime of a cached token in microseconds (10 seconds)
+*/
+#define HKDS_TOKENCACHE_TTL_DEFAULT 10000000ULL
+
+/*!
+\def HKDS_TOKENCACHE_SPIN_COUNT
+* The number of spin iterations used while waiting on an in-flight token, before yielding the thread
+*/
+#define HKDS_TOKENCACHE_SPIN_COUNT 64
+
+/*! \enum hkds_tokencache_results
+* The token cache request result
+*/
+HKDS_EXPORT_API typedef enum
+{
+	hkds_tokencache_computed = 0x00,	/*!< The token was encrypted by this call and added to the cache */
+	hkds_tokencache_hit = 0x01,			/*!< The token was returned from the cache */
+	hkds_tokencache_coalesced = 0x02,	/*!< The token was computed by a concurrent request for the same key */
+} hkds_tokencache_results;
+
+/*! \struct hkds_tokencache_slot
+* A cache slot; the control word packs the key tag, a sequence number and the slot state
+*/
+HKDS_EXPORT_API typedef struct
+{
+	volatile uint64_t control;					/*!< The key tag (32 bits), sequence (30 bits) and state (2 bits) */
+	uint64_t time;								/*!< The monotonic insertion time in microseconds */
+	uint8_t kid[HKDS_KID_SIZE];					/*!< The master key identity */
+	uint8_t ksn[HKDS_KSN_SIZE];					/*!< The clients key serial number */
+	uint8_t etok[HKDS_ETOK_SIZE];				/*!< The encrypted token */
+} hkds_tokencache_slot;
+
+/*! \struct hkds_tokencache_state
+* Contains the token cache state
+*/
+HKDS_EXPORT_API typedef struct
+{
+	hkds_tokencache_slot* slots;				/*!< The cache slots, sets of HKDS_TOKENCACHE_WAYS */
+	size_t sets;								/*!< The number of sets, a power of two */
+	uint64_t ttl;								/*!< The entry lifetime in microseconds */
+	volatile uint64_t hits;						/*!< The number of requests answered from the cache */
+	volatile uint64_t misses;					/*!< The number of tokens encrypted */
+	volatile uint64_t coalesced;				/*!< The number of requests that waited on an in-flight token */
+} hkds_tokencache_state;
+
+/**
+* \brief Initialize the token cache
+*
+* \param cache [struct] The token cache state
+* \param capacity [size] The minimum number of cached tokens, rounded up to a power of two number of sets
+* \param ttl [uint64] The entry lifetime in microseconds, zero selects HKDS_TOKENCACHE_TTL_DEFAULT
+* \return [bool] Returns true if the cache memory was allocated
+*/
+HKDS_EXPORT_API bool hkds_tokencache_initialize(hkds_tokencache_state* cache, size_t capacity, uint64_t ttl);
+
+/**
+* \brief Clear and release the token cache
+*
+* \param cache [struct] The token cache state
+*/
+HKDS_EXPORT_API void hkds_tokencache_dispose(hkds_tokencache_state* cache);
+
+/**
+* \brief Encrypt a token through the cache.
+* Returns the cached token for the servers KSN if a live entry exists, waits for a concurrent
+* request for the same key to finish, or encrypts the token with hkds_server_encrypt_token and caches it.
+*
+* \param cache [struct] The token cache state
+* \param state [struct] The server state initialized with the clients KSN
+* \param etok [array][output] The encrypted token output array
+* \return [enum] Returns the source of the token
+*/
+HKDS_EXPORT_API hkds_tokencache_results hkds_tokencache_encrypt_token(hkds_tokencache_state* cache, hkds_server_state* state, uint8_t* etok);
+
+/**
+* \brief Remove all entries from the token cache.
+* Must not be called concurrently with hkds_tokencache_encrypt_token.
+*
+* \param cache [struct] The token cache state
+*/
+HKDS_EXPORT_API void hkds_tokencache_clear(hkds_tokencache_state* cache);
+
+#endif
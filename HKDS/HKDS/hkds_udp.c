@@ -0,0 +1,392 @@
+#include "hkds_udp.h"
+#include "hkds_factory.h"
+#include "hkds_network.h"
+#include "hkds_wire.h"
+#include "../QSC/atomics.h"
+#include "../QSC/memutils.h"
+#include <stdlib.h>
+
+static size_t hkds_udp_payload_size(const uint8_t* data, size_t length)
+{
+	size_t len;
+	size_t pos;
+	bool done;
+
+	pos = 0;
+	done = false;
+
+	/* the padding begins where a packet header with a zero packet type is expected */
+	while (done == false && length - pos >= HKDS_HEADER_SIZE)
+	{
+		len = ((const hkds_wire_header*)(data + pos))->length;
+
+		if (data[pos] == 0)
+		{
+			length = pos;
+			done = true;
+		}
+		else if (len < HKDS_HEADER_SIZE || len > length - pos)
+		{
+			/* a malformed or incomplete packet is left to the batch parser */
+			done = true;
+		}
+		else
+		{
+			pos += len;
+		}
+	}
+
+	return length;
+}
+
+static void hkds_udp_run(void* context)
+{
+	hkds_udp_state* state;
+	struct timeval tv;
+	size_t i;
+	size_t m;
+	size_t n;
+
+	state = (hkds_udp_state*)context;
+
+	while (qsc_atomics_load64(&state->running) != 0)
+	{
+		tv.tv_sec = 0;
+		tv.tv_usec = HKDS_UDP_POLL_INTERVAL;
+
+		if (qsc_socket_receive_ready(&state->socket, &tv) == true)
+		{
+			for (i = 0; i < HKDS_UDP_BATCH_MAX; ++i)
+			{
+				state->inbound[i].length = 0;
+			}
+
+			n = qsc_socket_receive_batch(&state->socket, state->inbound, HKDS_UDP_BATCH_MAX, qsc_socket_receive_flag_none);
+
+			if (n != 0)
+			{
+				m = hkds_udp_process(state, state->inbound, n, state->outbound);
+
+				if (m != 0)
+				{
+					qsc_socket_send_batch(&state->socket, state->outbound, m, qsc_socket_send_flag_none);
+				}
+			}
+		}
+	}
+}
+
+size_t hkds_udp_process(hkds_udp_state* state, const qsc_socket_datagram* requests, size_t count, qsc_socket_datagram* responses)
+{
+	assert(state != NULL);
+	assert(requests != NULL);
+	assert(responses != NULL);
+
+	uint8_t emsg[HKDS_ERROR_SIZE] = { 0 };
+	hkds_async_request reqs[HKDS_WIRE_BATCH_MAX];
+	hkds_async_completion cmps[HKDS_WIRE_BATCH_MAX];
+	size_t rejected[HKDS_UDP_BATCH_MAX];
+	uint8_t seqs[HKDS_WIRE_BATCH_MAX];
+	bool refused[HKDS_WIRE_BATCH_MAX];
+	hkds_response_batch rsp;
+	hkds_server_state ss;
+	hkds_wire_batch wb;
+	size_t d;
+	size_t first;
+	size_t i;
+	size_t j;
+	size_t k;
+	size_t n;
+	size_t plen;
+	size_t rcnt;
+	size_t rpos;
+	size_t spent;
+	size_t used;
+	bool full;
+
+	rpos = 0;
+	i = 0;
+
+	if (state != NULL && requests != NULL && responses != NULL)
+	{
+		count = (count > HKDS_UDP_BATCH_MAX) ? HKDS_UDP_BATCH_MAX : count;
+
+		while (i < count)
+		{
+			first = i;
+			n = 0;
+			rcnt = 0;
+			full = false;
+
+			/* combine the requests of consecutive datagrams until the next datagram would overflow the wire batch */
+			while (i < count && full == false)
+			{
+				plen = hkds_udp_payload_size(requests[i].data, requests[i].length);
+				used = hkds_wire_parse_batch(&wb, requests[i].data, plen);
+
+				if (n + wb.count > HKDS_WIRE_BATCH_MAX)
+				{
+					full = true;
+				}
+				else
+				{
+					rejected[i] = wb.rejected + ((used < plen) ? 1 : 0);
+					spent = 0;
+
+					for (j = 0; j < wb.count; ++j)
+					{
+						hkds_network_request(&wb, j, &reqs[n]);
+						reqs[n].token = i;
+						seqs[n] = hkds_wire_batch_sequence(&wb, j);
+						refused[n] = false;
+
+						/* the responses to a datagram are never larger than the datagram; a token request is executed
+							only if its response, and the smallest response to every packet after it, fit in that budget */
+						if (reqs[n].operation == hkds_async_encrypt_token &&
+							spent + HKDS_SERVER_TOKEN_RESPONSE_SIZE + ((wb.count - j - 1) + rejected[i]) * HKDS_ERROR_MESSAGE_SIZE > requests[i].length)
+						{
+							reqs[n].operation = hkds_async_none;
+							refused[n] = true;
+							spent += HKDS_ERROR_MESSAGE_SIZE;
+							++rcnt;
+						}
+						else if (reqs[n].operation == hkds_async_encrypt_token)
+						{
+							spent += HKDS_SERVER_TOKEN_RESPONSE_SIZE;
+						}
+						else
+						{
+							spent += HKDS_SERVER_MESSAGE_RESPONSE_SIZE;
+						}
+
+						if (reqs[n].operation == hkds_async_encrypt_token && state->cache != NULL)
+						{
+							/* a repeated token request is answered from the cache, and is not executed again */
+							hkds_server_initialize_state(&ss, state->mdk, reqs[n].ksn);
+							hkds_tokencache_encrypt_token(state->cache, &ss, cmps[n].output);
+							cmps[n].token = i;
+							cmps[n].operation = hkds_async_encrypt_token;
+							cmps[n].status = true;
+							reqs[n].operation = hkds_async_none;
+						}
+
+						++n;
+					}
+
+					++i;
+				}
+			}
+
+			hkds_network_execute(state->mdk, reqs, n, cmps, NULL);
+			k = 0;
+
+			/* the requests are in datagram order; each datagram is answered with its own responses */
+			for (d = first; d < i; ++d)
+			{
+				/* a response datagram is capped at the size of its request, so the server cannot amplify traffic toward an unverified source */
+				hkds_response_initialize(&rsp, responses[rpos].data, (requests[d].length < responses[rpos].capacity) ? requests[d].length :
+					responses[rpos].capacity, hkds_response_contiguous);
+
+				while (k < n && reqs[k].token == d)
+				{
+					if (refused[k] == true)
+					{
+						/* a token request in a datagram without enough padding for its response */
+						hkds_factory_create_error_echo(emsg, seqs[k], reqs[k].ksn);
+						hkds_response_add_error(&rsp, emsg, error_invalid_format);
+						qsc_memutils_clear(emsg, sizeof(emsg));
+					}
+					else
+					{
+						hkds_response_add_completion(&rsp, &cmps[k], reqs[k].ksn, seqs[k]);
+					}
+
+					++k;
+				}
+
+				for (j = 0; j < rejected[d]; ++j)
+				{
+					hkds_response_add_error(&rsp, emsg, error_invalid_format);
+				}
+
+				if (rsp.count != 0)
+				{
+					responses[rpos].length = rsp.length;
+					responses[rpos].addrlen = requests[d].addrlen;
+					qsc_memutils_copy(responses[rpos].address, requests[d].address, sizeof(responses[rpos].address));
+					++rpos;
+				}
+
+				qsc_atomics_fetch_add64(&state->rejected, rejected[d]);
+			}
+
+			qsc_atomics_fetch_add64(&state->rejected, rcnt);
+			qsc_atomics_fetch_add64(&state->requests, n - rcnt);
+		}
+
+		qsc_atomics_fetch_add64(&state->datagrams, count);
+	}
+
+	return rpos;
+}
+
+bool hkds_udp_start(hkds_udp_state* state, hkds_master_key* mdk, hkds_tokencache_state* cache, const char* address, uint16_t port,
+	qsc_socket_address_families family)
+{
+	assert(state != NULL);
+	assert(mdk != NULL);
+	assert(address != NULL);
+
+	size_t i;
+	bool res;
+
+	res = false;
+
+	if (state != NULL && mdk != NULL && address != NULL)
+	{
+		qsc_memutils_clear(state, sizeof(hkds_udp_state));
+		state->mdk = mdk;
+		state->cache = cache;
+		state->buffers = (uint8_t*)malloc(HKDS_UDP_BATCH_MAX * (HKDS_UDP_DATAGRAM_SIZE + HKDS_RESPONSE_BUFFER_SIZE));
+
+		if (state->buffers != NULL)
+		{
+			for (i = 0; i < HKDS_UDP_BATCH_MAX; ++i)
+			{
+				state->inbound[i].data = state->buffers + (i * HKDS_UDP_DATAGRAM_SIZE);
+				state->inbound[i].capacity = HKDS_UDP_DATAGRAM_SIZE;
+				state->outbound[i].data = state->buffers + (HKDS_UDP_BATCH_MAX * HKDS_UDP_DATAGRAM_SIZE) + (i * HKDS_RESPONSE_BUFFER_SIZE);
+				state->outbound[i].capacity = HKDS_RESPONSE_BUFFER_SIZE;
+			}
+
+			if (qsc_socket_create(&state->socket, family, qsc_socket_transport_datagram, qsc_socket_protocol_udp) == qsc_socket_exception_success)
+			{
+				if (qsc_socket_bind(&state->socket, address, port) == qsc_socket_exception_success &&
+					qsc_socket_set_nonblocking(&state->socket, true) == qsc_socket_exception_success)
+				{
+					qsc_atomics_store64(&state->running, 1);
+					state->thread = qsc_async_thread_create(&hkds_udp_run, state);
+					res = (state->thread != 0);
+				}
+
+				if (res == false)
+				{
+					qsc_atomics_store64(&state->running, 0);
+					qsc_socket_close_socket(&state->socket);
+				}
+			}
+
+			if (res == false)
+			{
+				free(state->buffers);
+				state->buffers = NULL;
+			}
+		}
+	}
+
+	return res;
+}
+
+void hkds_udp_stop(hkds_udp_state* state)
+{
+	assert(state != NULL);
+
+	if (state != NULL && qsc_atomics_exchange64(&state->running, 0) != 0)
+	{
+		/* the server thread sees the stop request within one poll interval */
+		qsc_async_thread_wait(state->thread);
+		qsc_socket_close_socket(&state->socket);
+
+		if (state->buffers != NULL)
+		{
+			free(state->buffers);
+			state->buffers = NULL;
+		}
+	}
+}
+
+bool hkds_udp_client_open(qsc_socket* sock, const char* address, uint16_t port, qsc_socket_address_families family)
+{
+	assert(sock != NULL);
+	assert(address != NULL);
+
+	bool res;
+
+	res = false;
+
+	if (sock != NULL && address != NULL)
+	{
+		qsc_memutils_clear(sock, sizeof(qsc_socket));
+
+		if (qsc_socket_create(sock, family, qsc_socket_transport_datagram, qsc_socket_protocol_udp) == qsc_socket_exception_success)
+		{
+			/* a connected datagram socket only receives from the server */
+			res = (qsc_socket_connect(sock, address, port) == qsc_socket_exception_success);
+
+			if (res == false)
+			{
+				qsc_socket_close_socket(sock);
+			}
+		}
+	}
+
+	return res;
+}
+
+size_t hkds_udp_client_pad(uint8_t* request, size_t reqlen, size_t length)
+{
+	assert(request != NULL);
+
+	size_t res;
+
+	res = reqlen;
+
+	if (request != NULL)
+	{
+		length = (length > HKDS_UDP_DATAGRAM_SIZE) ? HKDS_UDP_DATAGRAM_SIZE : length;
+
+		if (length > reqlen)
+		{
+			qsc_memutils_clear(request + reqlen, length - reqlen);
+			res = length;
+		}
+	}
+
+	return res;
+}
+
+size_t hkds_udp_client_transact(const qsc_socket* sock, const uint8_t* request, size_t reqlen, uint8_t* response, size_t resplen,
+	uint32_t timeout, size_t retries)
+{
+	assert(sock != NULL);
+	assert(request != NULL);
+	assert(response != NULL);
+
+	struct timeval tv;
+	size_t i;
+	size_t res;
+
+	res = 0;
+	i = 0;
+
+	if (sock != NULL && request != NULL && response != NULL)
+	{
+		while (res == 0 && i <= retries)
+		{
+			if (qsc_socket_send(sock, request, reqlen, qsc_socket_send_flag_none) == reqlen)
+			{
+				tv.tv_sec = (long)(timeout / 1000);
+				tv.tv_usec = (long)((timeout % 1000) * 1000);
+
+				if (qsc_socket_receive_ready(sock, &tv) == true)
+				{
+					res = qsc_socket_receive(sock, response, resplen, qsc_socket_receive_flag_none);
+				}
+			}
+
+			++i;
+		}
+	}
+
+	return res;
+}
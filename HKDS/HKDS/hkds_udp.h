@@ -0,0 +1,154 @@
+/* 2021 Digital Freedom Defense Incorporated
+ * All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Digital Freedom Defense Incorporated.
+ * The intellectual and technical concepts contained
+ * herein are proprietary to Digital Freedom Defense Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Digital Freedom Defense Incorporated.
+ *
+ * Contact: develop@dfdef.com
+ */
+
+#ifndef HKDS_UDP_H
+#define HKDS_UDP_H
+
+#include "common.h"
+#include "hkds_async.h"
+#include "hkds_config.h"
+#include "hkds_response.h"
+#include "hkds_server.h"
+#include "hkds_tokencache.h"
+#include "../QSC/async.h"
+#include "../QSC/socketbase.h"
+
+/* Datagram HKDS server and client.
+* HKDS packets are small, fixed in size, and carry the clients KSN, so each request is self-describing
+* and can be carried in a UDP datagram without a connection. A datagram holds one or more whole packets.
+* The server thread moves up to HKDS_UDP_BATCH_MAX datagrams with each batched receive and send system call.
+* The requests of every datagram in a receive are combined into one wire batch, grouped by operation and
+* executed across the SIMD lanes, and each datagram is answered with one response datagram holding
+* the responses to its packets in order.
+* The source address of a datagram is not verified, so the responses to a datagram are never larger than the
+* datagram itself, and a response datagram stays below the path MTU. A token response is larger than its request;
+* a client pads a datagram carrying token requests with zero bytes after its last packet, to at least the size of the
+* responses it expects, and a token request without room for its response is answered with an error_invalid_format message.
+* A lost request or response is recovered by the client sending the request again. Message decryption is
+* a function of the KSN and ciphertext alone, so a repeated message request receives the same response;
+* repeated token requests are answered from the token cache when one is supplied, without a second derivation. */
+
+/*!
+\def HKDS_UDP_BATCH_MAX
+* The maximum number of datagrams received or sent with one system call
+*/
+#define HKDS_UDP_BATCH_MAX QSC_SOCKET_DATAGRAM_BATCH_MAX
+
+/*!
+\def HKDS_UDP_DATAGRAM_SIZE
+* The maximum size of a request datagram; below the path MTU, and holding fewer packets than one wire batch
+*/
+#define HKDS_UDP_DATAGRAM_SIZE 1200
+
+/*!
+\def HKDS_UDP_POLL_INTERVAL
+* The time in microseconds the server thread waits for a datagram before it checks for a stop request
+*/
+#define HKDS_UDP_POLL_INTERVAL 50000
+
+/*! \struct hkds_udp_state
+* Contains the datagram server state
+*/
+HKDS_EXPORT_API typedef struct
+{
+	qsc_socket_datagram inbound[HKDS_UDP_BATCH_MAX];	/*!< The received request datagrams */
+	qsc_socket_datagram outbound[HKDS_UDP_BATCH_MAX];	/*!< The response datagrams */
+	qsc_socket socket;									/*!< The bound datagram socket */
+	qsc_thread thread;									/*!< The server thread */
+	uint8_t* buffers;									/*!< The datagram buffers */
+	hkds_master_key* mdk;								/*!< A pointer to the master derivation key */
+	hkds_tokencache_state* cache;						/*!< The optional token cache, used to answer repeated token requests */
+	volatile uint64_t datagrams;						/*!< The number of request datagrams received */
+	volatile uint64_t requests;							/*!< The number of requests served */
+	volatile uint64_t rejected;							/*!< The number of packets rejected */
+	volatile uint64_t running;							/*!< The server thread is running */
+} hkds_udp_state;
+
+/**
+* \brief Bind the datagram socket and start the server thread
+*
+* \param state [struct] The datagram server state
+* \param mdk [struct] The master key set
+* \param cache [struct] The optional token cache, or NULL
+* \param address [string][const] The servers address
+* \param port [uint16] The servers port number
+* \param family [enum] The socket address family
+* \return [bool] Returns true if the server was started
+*/
+HKDS_EXPORT_API bool hkds_udp_start(hkds_udp_state* state, hkds_master_key* mdk, hkds_tokencache_state* cache, const char* address, uint16_t port,
+	qsc_socket_address_families family);
+
+/**
+* \brief Stop the server thread, and close the datagram socket
+*
+* \param state [struct] The datagram server state
+*/
+HKDS_EXPORT_API void hkds_udp_stop(hkds_udp_state* state);
+
+/**
+* \brief Process a set of request datagrams, and write a response datagram for each datagram that holds a packet.
+* The requests of consecutive datagrams are executed together, up to HKDS_WIRE_BATCH_MAX requests at a time.
+* A response is addressed to the source of its request; a packet that fails validation, or an incomplete packet
+* at the end of a datagram, is answered with an error_invalid_format message.
+* Zero bytes after the last packet of a datagram are padding. The responses to a datagram are limited to the size
+* of the datagram; a token request whose response would exceed that limit is not executed, and is answered with
+* an error_invalid_format message carrying its sequence and KSN.
+*
+* \param state [struct] The datagram server state
+* \param requests [array][const] The request datagrams
+* \param count [size] The number of request datagrams
+* \param responses [array] The response datagrams; the data member of each has a capacity of at least HKDS_RESPONSE_BUFFER_SIZE
+* \return [size] The number of response datagrams written
+*/
+HKDS_EXPORT_API size_t hkds_udp_process(hkds_udp_state* state, const qsc_socket_datagram* requests, size_t count, qsc_socket_datagram* responses);
+
+/**
+* \brief Open a client datagram socket connected to a server
+*
+* \param sock [struct] The client socket
+* \param address [string][const] The servers address
+* \param port [uint16] The servers port number
+* \param family [enum] The socket address family
+* \return [bool] Returns true if the socket was opened
+*/
+HKDS_EXPORT_API bool hkds_udp_client_open(qsc_socket* sock, const char* address, uint16_t port, qsc_socket_address_families family);
+
+/**
+* \brief Pad a request datagram with zero bytes, so the server has room to answer every packet it holds
+*
+* \param request [array] The request datagram; the array has a capacity of at least length bytes
+* \param reqlen [size] The size of the request datagram
+* \param length [size] The size of the expected responses; limited to HKDS_UDP_DATAGRAM_SIZE
+* \return [size] The size of the padded request datagram
+*/
+HKDS_EXPORT_API size_t hkds_udp_client_pad(uint8_t* request, size_t reqlen, size_t length);
+
+/**
+* \brief Send a request datagram and wait for the response, sending the request again if the response does not arrive in time
+*
+* \param sock [struct][const] The connected client socket
+* \param request [array][const] The request datagram
+* \param reqlen [size] The size of the request datagram
+* \param response [array][output] The response buffer
+* \param resplen [size] The size of the response buffer
+* \param timeout [uint32] The time to wait for each response in milliseconds
+* \param retries [size] The number of times the request is sent again
+* \return [size] The size of the response datagram, zero if no response was received
+*/
+HKDS_EXPORT_API size_t hkds_udp_client_transact(const qsc_socket* sock, const uint8_t* request, size_t reqlen, uint8_t* response, size_t resplen,
+	uint32_t timeout, size_t retries);
+
+#endif
@@ -0,0 +1,225 @@
+#include "hkds_wire.h"
+
+size_t hkds_wire_packet_size(hkds_packet_type type)
+{
+	size_t res;
+
+	switch (type)
+	{
+		case packet_token_request:
+		{
+			res = HKDS_CLIENT_TOKEN_REQUEST_SIZE;
+			break;
+		}
+		case packet_token_response:
+		{
+			res = HKDS_SERVER_TOKEN_RESPONSE_SIZE;
+			break;
+		}
+		case packet_message_request:
+		{
+			res = HKDS_CLIENT_MESSAGE_REQUEST_SIZE;
+			break;
+		}
+		case packet_message_response:
+		{
+			res = HKDS_SERVER_MESSAGE_RESPONSE_SIZE;
+			break;
+		}
+		case packet_administrative_message:
+		{
+			res = HKDS_ADMIN_MESSAGE_SIZE;
+			break;
+		}
+		case packet_error_message:
+		{
+			res = HKDS_ERROR_MESSAGE_SIZE;
+			break;
+		}
+		case packet_message_token_response:
+		{
+			res = HKDS_SERVER_MESSAGE_TOKEN_RESPONSE_SIZE;
+			break;
+		}
+		default:
+		{
+			res = 0;
+		}
+	}
+
+	return res;
+}
+
+bool hkds_wire_validate(const uint8_t* input, size_t inlen)
+{
+	assert(input != NULL);
+
+	const hkds_wire_header* hdr;
+	size_t len;
+	bool res;
+
+	res = false;
+
+	if (input != NULL && inlen >= HKDS_HEADER_SIZE)
+	{
+		hdr = (const hkds_wire_header*)input;
+		len = hkds_wire_packet_size((hkds_packet_type)hdr->flag);
+		res = (len != 0 && hdr->protocol == (uint8_t)HKDS_PROTOCOL_TYPE && hdr->length == len && len <= inlen);
+	}
+
+	return res;
+}
+
+const hkds_wire_header* hkds_wire_header_view(const uint8_t* input, size_t inlen)
+{
+	const hkds_wire_header* res;
+
+	res = NULL;
+
+	if (hkds_wire_validate(input, inlen) == true)
+	{
+		res = (const hkds_wire_header*)input;
+	}
+
+	return res;
+}
+
+const hkds_wire_client_message* hkds_wire_client_message_view(const uint8_t* input, size_t inlen)
+{
+	const hkds_wire_client_message* res;
+
+	res = NULL;
+
+	if (hkds_wire_validate(input, inlen) == true && input[0] == (uint8_t)packet_message_request)
+	{
+		res = (const hkds_wire_client_message*)input;
+	}
+
+	return res;
+}
+
+const hkds_wire_client_token* hkds_wire_client_token_view(const uint8_t* input, size_t inlen)
+{
+	const hkds_wire_client_token* res;
+
+	res = NULL;
+
+	if (hkds_wire_validate(input, inlen) == true && input[0] == (uint8_t)packet_token_request)
+	{
+		res = (const hkds_wire_client_token*)input;
+	}
+
+	return res;
+}
+
+size_t hkds_wire_parse_batch(hkds_wire_batch* batch, const uint8_t* input, size_t inlen)
+{
+	assert(batch != NULL);
+	assert(input != NULL);
+
+	const hkds_wire_client_message* msg;
+	const hkds_wire_header* hdr;
+	size_t len;
+	size_t pos;
+
+	pos = 0;
+	batch->count = 0;
+	batch->rejected = 0;
+
+	/* a rejected packet is answered with an error, so it counts against the batch like a request */
+	while (inlen - pos >= HKDS_HEADER_SIZE && batch->count + batch->rejected < HKDS_WIRE_BATCH_MAX)
+	{
+		hdr = (const hkds_wire_header*)(input + pos);
+		/* the length is read once, so the checks and the position use the same value */
+		len = hdr->length;
+
+		if (len < HKDS_HEADER_SIZE)
+		{
+			/* a zero or short length cannot locate the next packet */
+			++batch->rejected;
+			pos = inlen;
+			break;
+		}
+
+		if (len > inlen - pos)
+		{
+			/* an incomplete packet, left for the next receive */
+			break;
+		}
+
+		if (hkds_wire_validate(input + pos, len) == false)
+		{
+			++batch->rejected;
+		}
+		else if (hdr->flag == (uint8_t)packet_message_request)
+		{
+			msg = (const hkds_wire_client_message*)hdr;
+			batch->packet[batch->count] = input + pos;
+			batch->ksn[batch->count] = msg->ksn;
+			batch->message[batch->count] = msg->message;
+			batch->tag[batch->count] = (msg->ksn[HKDS_KID_SIZE] == HKDS_AUTHENTICATION_KMAC) ? msg->tag : NULL;
+			batch->type[batch->count] = packet_message_request;
+			++batch->count;
+		}
+		else if (hdr->flag == (uint8_t)packet_token_request)
+		{
+			batch->packet[batch->count] = input + pos;
+			batch->ksn[batch->count] = ((const hkds_wire_client_token*)hdr)->ksn;
+			batch->message[batch->count] = NULL;
+			batch->tag[batch->count] = NULL;
+			batch->type[batch->count] = packet_token_request;
+			++batch->count;
+		}
+		else
+		{
+			/* valid packets that are not client requests are left to the caller */
+			++batch->rejected;
+		}
+
+		pos += len;
+	}
+
+	return pos;
+}
+
+uint8_t hkds_wire_batch_sequence(const hkds_wire_batch* batch, size_t index)
+{
+	assert(batch != NULL);
+
+	uint8_t res;
+
+	res = HKDS_SEQUENCE_NONE;
+
+	if (batch != NULL && index < batch->count)
+	{
+		res = ((const hkds_wire_header*)batch->packet[index])->sequence;
+	}
+
+	return res;
+}
+
+uint8_t hkds_wire_response_sequence(const uint8_t* input, size_t inlen)
+{
+	assert(input != NULL);
+
+	const hkds_wire_header* hdr;
+	uint8_t res;
+
+	res = HKDS_SEQUENCE_NONE;
+	hdr = hkds_wire_header_view(input, inlen);
+
+	if (hdr != NULL)
+	{
+		if (hdr->flag == (uint8_t)packet_error_message)
+		{
+			res = ((const hkds_wire_error_message*)hdr)->message[0];
+		}
+		else if (hdr->flag == (uint8_t)packet_message_response || hdr->flag == (uint8_t)packet_token_response ||
+			hdr->flag == (uint8_t)packet_message_token_response)
+		{
+			res = hdr->sequence;
+		}
+	}
+
+	return res;
+}
@@ -0,0 +1,215 @@
+/* 2021 Digital Freedom Defense Incorporated
+ * All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Digital Freedom Defense Incorporated.
+ * The intellectual and technical concepts contained
+ * herein are proprietary to Digital Freedom Defense Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Digital Freedom Defense Incorporated.
+ *
+ * Contact: develop@dfdef.com
+ */
+
+#ifndef HKDS_WIRE_H
+#define HKDS_WIRE_H
+
+#include "common.h"
+#include "hkds_config.h"
+
+/* Byte-exact packet wire views.
+* The packet structures in hkds_config.h use enumerations for the header fields, so their in-memory
+* layout does not match the serialized packet. The wire views declare every field as bytes, so a view has
+* no padding, an alignment of one, and the exact size of the serialized packet; a view can be laid over
+* a receive buffer and read in place.
+* The batch parser walks a buffer of consecutive packets, validates each header, and records pointers
+* to the key serial number, ciphertext and tag of each request inside the buffer, without copying them. */
+
+/*!
+\def HKDS_WIRE_BATCH_MAX
+* The maximum number of packets recorded by one call to the batch parser
+*/
+#define HKDS_WIRE_BATCH_MAX HKDS_CACHX64_SIZE
+
+/*! \struct hkds_wire_header
+* The serialized packet header
+*/
+typedef struct
+{
+	uint8_t flag;							/*!< The packet type, a hkds_packet_type value */
+	uint8_t protocol;						/*!< The protocol id, a hkds_protocol_id value */
+	uint8_t sequence;						/*!< The packet sequence, or the error code of an error message */
+	uint8_t length;							/*!< The packet size including header */
+}
+hkds_wire_header;
+
+/*! \struct hkds_wire_client_message
+* The serialized client message request
+*/
+typedef struct
+{
+	hkds_wire_header header;				/*!< The packet header */
+	uint8_t ksn[HKDS_KSN_SIZE];				/*!< The client's KSN */
+	uint8_t message[HKDS_MESSAGE_SIZE];		/*!< The clients encrypted message */
+	uint8_t tag[HKDS_TAG_SIZE];				/*!< The optional authentication tag */
+}
+hkds_wire_client_message;
+
+/*! \struct hkds_wire_client_token
+* The serialized client token request
+*/
+typedef struct
+{
+	hkds_wire_header header;				/*!< The packet header */
+	uint8_t ksn[HKDS_KSN_SIZE];				/*!< The client's KSN */
+}
+hkds_wire_client_token;
+
+/*! \struct hkds_wire_server_message
+* The serialized server message response
+*/
+typedef struct
+{
+	hkds_wire_header header;				/*!< The packet header */
+	uint8_t message[HKDS_MESSAGE_SIZE];		/*!< The servers message response */
+}
+hkds_wire_server_message;
+
+/*! \struct hkds_wire_server_token
+* The serialized server token response
+*/
+typedef struct
+{
+	hkds_wire_header header;				/*!< The packet header */
+	uint8_t etok[HKDS_ETOK_SIZE];			/*!< The severs encrypted token */
+}
+hkds_wire_server_token;
+
+/*! \struct hkds_wire_server_message_token
+* The serialized server message response with the next epochs encrypted token
+*/
+typedef struct
+{
+	hkds_wire_header header;				/*!< The packet header */
+	uint8_t message[HKDS_MESSAGE_SIZE];		/*!< The servers message response */
+	uint8_t etok[HKDS_ETOK_SIZE];			/*!< The encrypted token for the next epoch */
+}
+hkds_wire_server_message_token;
+
+/*! \struct hkds_wire_administrative_message
+* The serialized administrative message
+*/
+typedef struct
+{
+	hkds_wire_header header;				/*!< The packet header */
+	uint8_t message[HKDS_ADMIN_SIZE];		/*!< The administrative message */
+}
+hkds_wire_administrative_message;
+
+/*! \struct hkds_wire_error_message
+* The serialized error message
+*/
+typedef struct
+{
+	hkds_wire_header header;				/*!< The packet header */
+	uint8_t message[HKDS_ERROR_SIZE];		/*!< The error message */
+}
+hkds_wire_error_message;
+
+/*! \struct hkds_wire_batch
+* The client requests found by the batch parser; the pointers refer to the parsed buffer
+*/
+typedef struct
+{
+	const uint8_t* packet[HKDS_WIRE_BATCH_MAX];		/*!< The start of each packet */
+	const uint8_t* ksn[HKDS_WIRE_BATCH_MAX];		/*!< The key serial number of each request */
+	const uint8_t* message[HKDS_WIRE_BATCH_MAX];	/*!< The ciphertext of a message request, NULL for a token request */
+	const uint8_t* tag[HKDS_WIRE_BATCH_MAX];		/*!< The tag of an authenticated message request, otherwise NULL */
+	hkds_packet_type type[HKDS_WIRE_BATCH_MAX];		/*!< The packet type of each request */
+	size_t count;									/*!< The number of requests recorded */
+	size_t rejected;								/*!< The number of packets that failed validation, or are not client requests */
+} hkds_wire_batch;
+
+/**
+* \brief Get the serialized size of a packet type
+*
+* \param type [enum] The packet type
+* \return [size] The packet size including the header, zero for an unknown type
+*/
+HKDS_EXPORT_API size_t hkds_wire_packet_size(hkds_packet_type type);
+
+/**
+* \brief Validate a packet header against the buffer that holds it.
+* The packet type must be known, the protocol must match this implementation, and the length must be the
+* size of the packet type and fit within the buffer.
+*
+* \param input [array][const] The serialized packet
+* \param inlen [size] The number of bytes available in the buffer
+* \return [bool] Returns true if the header is valid
+*/
+HKDS_EXPORT_API bool hkds_wire_validate(const uint8_t* input, size_t inlen);
+
+/**
+* \brief Get a view of a packet header in place
+*
+* \param input [array][const] The serialized packet
+* \param inlen [size] The number of bytes available in the buffer
+* \return [struct] A pointer to the header view, or NULL if the header is invalid
+*/
+HKDS_EXPORT_API const hkds_wire_header* hkds_wire_header_view(const uint8_t* input, size_t inlen);
+
+/**
+* \brief Get a view of a client message request in place
+*
+* \param input [array][const] The serialized packet
+* \param inlen [size] The number of bytes available in the buffer
+* \return [struct] A pointer to the message view, or NULL if the packet is not a valid message request
+*/
+HKDS_EXPORT_API const hkds_wire_client_message* hkds_wire_client_message_view(const uint8_t* input, size_t inlen);
+
+/**
+* \brief Get a view of a client token request in place
+*
+* \param input [array][const] The serialized packet
+* \param inlen [size] The number of bytes available in the buffer
+* \return [struct] A pointer to the token request view, or NULL if the packet is not a valid token request
+*/
+HKDS_EXPORT_API const hkds_wire_client_token* hkds_wire_client_token_view(const uint8_t* input, size_t inlen);
+
+/**
+* \brief Parse a buffer of consecutive packets, recording the client message and token requests.
+* Packets with an invalid header are counted and skipped if their length field can be trusted to
+* reach the next packet, otherwise parsing stops. Parsing also stops after HKDS_WIRE_BATCH_MAX packets, requests and
+* rejected packets together, so every parsed packet can be answered within one response batch.
+*
+* \param batch [struct] The batch receiving the request pointers
+* \param input [array][const] The receive buffer
+* \param inlen [size] The number of bytes in the buffer
+* \return [size] The number of bytes parsed; the remainder of the buffer holds an incomplete packet, or the batch is full
+*/
+HKDS_EXPORT_API size_t hkds_wire_parse_batch(hkds_wire_batch* batch, const uint8_t* input, size_t inlen);
+
+/**
+* \brief Get the sequence of a parsed request, the identifier its response must carry
+*
+* \param batch [struct][const] The parsed batch
+* \param index [size] The index of the request in the batch
+* \return [uint8] The request sequence
+*/
+HKDS_EXPORT_API uint8_t hkds_wire_batch_sequence(const hkds_wire_batch* batch, size_t index);
+
+/**
+* \brief Get the sequence of the request a server packet answers.
+* A message or token response carries the sequence in its header; an error message carries the error code
+* in its header, and the sequence in the first byte of the error message.
+*
+* \param input [array][const] The serialized server packet
+* \param inlen [size] The number of bytes available in the buffer
+* \return [uint8] The request sequence, HKDS_SEQUENCE_NONE if the packet is invalid or answers no parsed request
+*/
+HKDS_EXPORT_API uint8_t hkds_wire_response_sequence(const uint8_t* input, size_t inlen);
+
+#endif
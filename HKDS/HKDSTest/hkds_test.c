@@ -1,9 +1,35 @@
 #include "hkds_test.h"
 #include "testutils.h"
+#include "../HKDS/hkds_admission.h"
+#include "../HKDS/hkds_async.h"
+#include "../HKDS/hkds_batch.h"
 #include "../HKDS/hkds_client.h"
+#include "../HKDS/hkds_counter.h"
+#include "../HKDS/hkds_factory.h"
+#include "../HKDS/hkds_ipc.h"
+#include "../HKDS/hkds_jobs.h"
+#include "../HKDS/hkds_network.h"
+#include "../HKDS/hkds_pipeline.h"
+#include "../HKDS/hkds_precompute.h"
+#include "../HKDS/hkds_priority.h"
+#include "../HKDS/hkds_queue.h"
+#include "../HKDS/hkds_replica.h"
+#include "../HKDS/hkds_response.h"
+#include "../HKDS/hkds_router.h"
 #include "../HKDS/hkds_server.h"
+#include "../HKDS/hkds_shard.h"
+#include "../HKDS/hkds_tokencache.h"
+#include "../HKDS/hkds_udp.h"
+#include "../HKDS/hkds_wire.h"
+#include "../QSC/atomics.h"
+#include "../QSC/bufferpool.h"
 #include "../QSC/csp.h"
+#include "../QSC/fileutils.h"
 #include "../QSC/intutils.h"
+#include "../QSC/memutils.h"
+#include "../QSC/threadpool.h"
+#include "../QSC/timerex.h"
+#include "../QSC/timerwheel.h"
 
 #define HKDSTEST_CYCLES_COUNT 1000
 
@@ -1145,6 +1171,4079 @@ bool hkdstest_parallel_authencrypt_equivalence_test()
 	return res;
 }
 
+bool hkdstest_counter_test()
+{
+	hkds_counter_table table = { 0 };
+	hkds_counter_entry upd[8] = { 0 };
+	bool acc[8] = { 0 };
+	uint8_t ksn[HKDS_KSN_SIZE] = { 0 };
+	uint64_t rec;
+	size_t num;
+	bool res;
+
+	res = hkds_counter_initialize(&table, 16);
+
+	if (res == true)
+	{
+		/* an empty slot accepts the first record, including zero */
+		if (hkds_counter_read(&table, 0, &rec) == true || hkds_counter_update(&table, 0, hkds_counter_pack(0, 0)) == false)
+		{
+			qsctest_print_line("hkdstest_counter_test: empty slot update failure! -HC1");
+			res = false;
+		}
+
+		/* replayed and older records are rejected */
+		if (hkds_counter_update(&table, 1, hkds_counter_pack(1, 20)) == false ||
+			hkds_counter_update(&table, 1, hkds_counter_pack(1, 20)) == true ||
+			hkds_counter_update(&table, 1, hkds_counter_pack(1, 19)) == true ||
+			hkds_counter_update(&table, 1, hkds_counter_pack(1, 21)) == false)
+		{
+			qsctest_print_line("hkdstest_counter_test: replay rejection failure! -HC2");
+			res = false;
+		}
+
+		if (hkds_counter_read(&table, 1, &rec) == false || hkds_counter_epoch(rec) != 1 || hkds_counter_value(rec) != 21)
+		{
+			qsctest_print_line("hkdstest_counter_test: record read failure! -HC3");
+			res = false;
+		}
+
+		/* the ksn counter maps to its token epoch */
+		qsc_intutils_be32to8(ksn + HKDS_DID_SIZE, (uint32_t)(HKDS_CACHE_SIZE * 3) + 1);
+		rec = hkds_counter_from_ksn(ksn);
+
+		if (hkds_counter_epoch(rec) != 3 || hkds_counter_value(rec) != (uint32_t)(HKDS_CACHE_SIZE * 3) + 1)
+		{
+			qsctest_print_line("hkdstest_counter_test: ksn record failure! -HC4");
+			res = false;
+		}
+
+		/* a batch with duplicates, a replay, and multiple updates to one slot */
+		upd[0].index = 5; upd[0].record = 10;
+		upd[1].index = 1; upd[1].record = hkds_counter_pack(1, 21);
+		upd[2].index = 3; upd[2].record = 7;
+		upd[3].index = 5; upd[3].record = 12;
+		upd[4].index = 3; upd[4].record = 7;
+		upd[5].index = 1; upd[5].record = hkds_counter_pack(2, 40);
+		upd[6].index = 5; upd[6].record = 11;
+		upd[7].index = 9; upd[7].record = 1;
+
+		hkds_counter_sort_batch(upd, 8);
+		num = hkds_counter_update_batch(&table, upd, 8, acc);
+
+		/* sorted: (1,21)x (1,40)v (3,7)v (3,7)x (5,10)v (5,11)v (5,12)v (9,1)v */
+		if (num != 6 || acc[0] == true || acc[1] == false || acc[2] == false || acc[3] == true || acc[7] == false)
+		{
+			qsctest_print_line("hkdstest_counter_test: batch update failure! -HC5");
+			res = false;
+		}
+
+		if (hkds_counter_read(&table, 5, &rec) == false || rec != 12 || hkds_counter_read(&table, 1, &rec) == false || hkds_counter_value(rec) != 40)
+		{
+			qsctest_print_line("hkdstest_counter_test: batch record failure! -HC6");
+			res = false;
+		}
+
+		hkds_counter_dispose(&table);
+	}
+	else
+	{
+		qsctest_print_line("hkdstest_counter_test: table allocation failure! -HC0");
+	}
+
+	return res;
+}
+
+bool hkdstest_tokencache_test()
+{
+	/* the PRF mode, 10 for SHAKE-256 */
+	const uint8_t PRFMODE = 0x0A;
+	/* protocol id is always 0x10 for unauthenticated HKDS, 0x11 for KMAC authentication */
+	const uint8_t PID = 0x10;
+	/* master key id */
+	const uint8_t kid[HKDS_KID_SIZE] = { 0x01, 0x02, 0x03, 0x04 };
+	/* device id						|		BKD ID			| PID | Mode |	MID	     |			DID		     | */
+	const uint8_t did[HKDS_DID_SIZE] = { 0x01, 0x00, 0x00, 0x00, PID, PRFMODE, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00 };
+	uint8_t ksn[HKDS_KSN_SIZE] = { 0 };
+	uint8_t etok[HKDS_CACHX64_SIZE][HKDS_ETOK_SIZE] = { 0 };
+	uint8_t exp[HKDS_ETOK_SIZE] = { 0 };
+	uint8_t tok[HKDS_ETOK_SIZE] = { 0 };
+	hkds_tokencache_state cache = { 0 };
+	hkds_master_key mdk;
+	hkds_server_state ss;
+	uint64_t start;
+	bool res;
+
+	res = hkds_tokencache_initialize(&cache, 64, 0);
+
+	if (res == true)
+	{
+		hkds_server_generate_mdk(&qsc_csp_generate, &mdk, kid);
+		qsc_memutils_copy(ksn, did, HKDS_DID_SIZE);
+		qsc_intutils_be32to8(ksn + HKDS_DID_SIZE, HKDS_CACHE_SIZE * 2);
+		hkds_server_initialize_state(&ss, &mdk, ksn);
+		hkds_server_encrypt_token(&ss, exp);
+
+		/* the first request computes the token, a retry is answered from the cache */
+		if (hkds_tokencache_encrypt_token(&cache, &ss, tok) != hkds_tokencache_computed ||
+			qsc_intutils_are_equal8(tok, exp, HKDS_ETOK_SIZE) == false)
+		{
+			qsctest_print_line("hkdstest_tokencache_test: token computation failure! -HTC1");
+			res = false;
+		}
+
+		qsc_memutils_clear(tok, sizeof(tok));
+
+		if (hkds_tokencache_encrypt_token(&cache, &ss, tok) != hkds_tokencache_hit ||
+			qsc_intutils_are_equal8(tok, exp, HKDS_ETOK_SIZE) == false)
+		{
+			qsctest_print_line("hkdstest_tokencache_test: cached token failure! -HTC2");
+			res = false;
+		}
+
+		/* concurrent duplicate requests are coalesced onto the cached token */
+#if defined(_OPENMP)
+#	pragma omp parallel for
+#endif
+		for (int32_t i = 0; i < HKDS_CACHX64_SIZE; ++i)
+		{
+			hkds_server_state ts;
+
+			hkds_server_initialize_state(&ts, &mdk, ksn);
+			hkds_tokencache_encrypt_token(&cache, &ts, etok[i]);
+		}
+
+		for (size_t i = 0; i < HKDS_CACHX64_SIZE; ++i)
+		{
+			if (qsc_intutils_are_equal8(etok[i], exp, HKDS_ETOK_SIZE) == false)
+			{
+				qsctest_print_line("hkdstest_tokencache_test: concurrent token failure! -HTC3");
+				res = false;
+				break;
+			}
+		}
+
+		if (cache.misses != 1)
+		{
+			qsctest_print_line("hkdstest_tokencache_test: duplicate requests were not coalesced! -HTC4");
+			res = false;
+		}
+
+		/* a different counter in the same epoch is bound to a different token mac */
+		qsc_intutils_be32to8(ss.ksn + HKDS_DID_SIZE, (HKDS_CACHE_SIZE * 2) + 1);
+		hkds_server_encrypt_token(&ss, exp);
+
+		if (hkds_tokencache_encrypt_token(&cache, &ss, tok) != hkds_tokencache_computed ||
+			qsc_intutils_are_equal8(tok, exp, HKDS_ETOK_SIZE) == false)
+		{
+			qsctest_print_line("hkdstest_tokencache_test: stale token failure! -HTC5");
+			res = false;
+		}
+
+		hkds_tokencache_dispose(&cache);
+
+		/* expired entries are recomputed */
+		if (hkds_tokencache_initialize(&cache, 8, 1) == true)
+		{
+			hkds_tokencache_encrypt_token(&cache, &ss, tok);
+			start = qsc_timerex_monotonic_microseconds();
+
+			while (qsc_timerex_monotonic_microseconds() - start < 10)
+			{
+			}
+
+			if (hkds_tokencache_encrypt_token(&cache, &ss, tok) != hkds_tokencache_computed)
+			{
+				qsctest_print_line("hkdstest_tokencache_test: token expiry failure! -HTC6");
+				res = false;
+			}
+
+			hkds_tokencache_dispose(&cache);
+		}
+	}
+	else
+	{
+		qsctest_print_line("hkdstest_tokencache_test: cache allocation failure! -HTC0");
+	}
+
+	return res;
+}
+
+bool hkdstest_token_push_test()
+{
+	/* protocol id is always 0x10 for unauthenticated HKDS, 0x11 for KMAC authentication */
+	const uint8_t PID = 0x11;
+	/* master key id */
+	const uint8_t kid[HKDS_KID_SIZE] = { 0x01, 0x02, 0x03, 0x04 };
+	/* device id						|		BKD ID			| PID | Mode |	MID	     |			DID		     | */
+	const uint8_t did[HKDS_DID_SIZE] = { 0x01, 0x00, 0x00, 0x00, PID, HKDSTEST_PRF_MODE, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00 };
+	uint8_t cpt[HKDS_MESSAGE_SIZE + HKDS_TAG_SIZE] = { 0 };
+	uint8_t dec[HKDS_MESSAGE_SIZE] = { 0 };
+	uint8_t edk[HKDS_EDK_SIZE] = { 0 };
+	uint8_t msg[HKDS_MESSAGE_SIZE] = { 0 };
+	uint8_t tokd[HKDS_STK_SIZE] = { 0 };
+	uint8_t toke[HKDS_ETOK_SIZE] = { 0 };
+	hkds_server_message_token_response rsp;
+	hkds_master_key mdk;
+	hkds_client_state cs;
+	hkds_server_state ss;
+	uint32_t ctr;
+	size_t reqs;
+	bool ntr;
+	bool res;
+
+	qsctest_hex_to_bin("000102030405060708090A0B0C0D0E0F", msg, sizeof(msg));
+	res = true;
+	reqs = 0;
+
+	hkds_server_generate_mdk(&qsc_csp_generate, &mdk, kid);
+	hkds_server_generate_edk(mdk.bdk, did, edk);
+	hkds_client_initialize_state(&cs, edk, did);
+
+	for (size_t i = 0; i < HKDSTEST_CYCLES_COUNT; ++i)
+	{
+		if (cs.cache_empty == true)
+		{
+			/* a token request is only needed for the first epoch */
+			hkds_server_initialize_state(&ss, &mdk, cs.ksn);
+			hkds_server_encrypt_token(&ss, toke);
+
+			if (hkds_client_decrypt_token(&cs, toke, tokd) == false)
+			{
+				qsctest_print_line("hkdstest_token_push_test: token authentication failure! -HTP1");
+				res = false;
+				break;
+			}
+
+			hkds_client_generate_cache(&cs, tokd);
+			++reqs;
+		}
+
+		hkds_server_initialize_state(&ss, &mdk, cs.ksn);
+
+		if (hkds_client_encrypt_authenticate_message(&cs, msg, NULL, 0, cpt) == false)
+		{
+			qsctest_print_line("hkdstest_token_push_test: message encryption failure! -HTP2");
+			res = false;
+			break;
+		}
+
+		if (hkds_server_decrypt_verify_message(&ss, cpt, NULL, 0, dec) == false ||
+			qsc_intutils_are_equal8(msg, dec, sizeof(msg)) == false)
+		{
+			qsctest_print_line("hkdstest_token_push_test: message decryption failure! -HTP3");
+			res = false;
+			break;
+		}
+
+		if (hkds_server_push_token_required(&ss) == true)
+		{
+			/* the server attaches the next epochs token to the response */
+			hkds_server_encrypt_next_token(&ss, toke);
+			rsp = hkds_factory_create_server_message_token_response(dec, toke, HKDS_SEQUENCE_DEFAULT);
+
+			if (rsp.header.flag != packet_message_token_response ||
+				hkds_client_accept_next_token(&cs, rsp.etok) == false)
+			{
+				qsctest_print_line("hkdstest_token_push_test: pushed token failure! -HTP4");
+				res = false;
+				break;
+			}
+		}
+	}
+
+	if (res == true && reqs != 1)
+	{
+		qsctest_print_line("hkdstest_token_push_test: the client requested a token after a push! -HTP5");
+		res = false;
+	}
+
+	/* a pushed token that arrives after the client has begun its epoch is ignored, a forged token is rejected */
+	if (res == true)
+	{
+		ctr = qsc_intutils_be8to32(cs.ksn + HKDS_DID_SIZE);
+		hkds_server_initialize_state(&ss, &mdk, cs.ksn);
+		qsc_intutils_be32to8(ss.ksn + HKDS_DID_SIZE, (((ctr - 1) / HKDS_CACHE_SIZE) * HKDS_CACHE_SIZE) - 1);
+		hkds_server_encrypt_next_token(&ss, toke);
+		ntr = cs.ntok_ready;
+
+		if (hkds_client_accept_next_token(&cs, toke) == false || cs.ntok_ready != ntr)
+		{
+			res = false;
+		}
+
+		qsc_csp_generate(toke, sizeof(toke));
+
+		if (hkds_client_accept_next_token(&cs, toke) == true)
+		{
+			res = false;
+		}
+
+		hkds_server_initialize_state(&ss, &mdk, cs.ksn);
+
+		if (hkds_client_encrypt_authenticate_message(&cs, msg, NULL, 0, cpt) == false ||
+			hkds_server_decrypt_verify_message(&ss, cpt, NULL, 0, dec) == false || qsc_intutils_are_equal8(msg, dec, sizeof(msg)) == false)
+		{
+			res = false;
+		}
+
+		if (res == false)
+		{
+			qsctest_print_line("hkdstest_token_push_test: late pushed token failure! -HTP6");
+		}
+	}
+
+	return res;
+}
+
+bool hkdstest_precompute_test()
+{
+	/* protocol id is always 0x10 for unauthenticated HKDS, 0x11 for KMAC authentication */
+	const uint8_t PID = 0x11;
+	/* master key id */
+	const uint8_t kid[HKDS_KID_SIZE] = { 0x01, 0x02, 0x03, 0x04 };
+	/* device id						|		BKD ID			| PID | Mode |	MID	     |			DID		     | */
+	const uint8_t did[HKDS_DID_SIZE] = { 0x01, 0x00, 0x00, 0x00, PID, HKDSTEST_PRF_MODE, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00 };
+	uint8_t cpt[HKDS_MESSAGE_SIZE + HKDS_TAG_SIZE] = { 0 };
+	uint8_t dec[HKDS_MESSAGE_SIZE] = { 0 };
+	uint8_t edk[HKDS_EDK_SIZE] = { 0 };
+	uint8_t exp[HKDS_ETOK_SIZE] = { 0 };
+	uint8_t msg[HKDS_MESSAGE_SIZE] = { 0 };
+	uint8_t tokd[HKDS_STK_SIZE] = { 0 };
+	uint8_t toke[HKDS_ETOK_SIZE] = { 0 };
+	uint8_t hksn[3][HKDS_KSN_SIZE] = { 0 };
+	hkds_precompute_state pcs = { 0 };
+	hkds_master_key mdk;
+	hkds_client_state cs;
+	hkds_server_state ss;
+	bool res;
+
+	qsctest_hex_to_bin("000102030405060708090A0B0C0D0E0F", msg, sizeof(msg));
+	hkds_server_generate_mdk(&qsc_csp_generate, &mdk, kid);
+	hkds_server_generate_edk(mdk.bdk, did, edk);
+	hkds_client_initialize_state(&cs, edk, did);
+
+	res = hkds_precompute_initialize(&pcs, &mdk, 64, 2);
+
+	if (res == true)
+	{
+		/* first epoch, the device becomes active */
+		hkds_server_initialize_state(&ss, &mdk, cs.ksn);
+		hkds_precompute_encrypt_token(&pcs, &ss, toke);
+		hkds_client_decrypt_token(&cs, toke, tokd);
+		hkds_client_generate_cache(&cs, tokd);
+
+		for (size_t i = 0; i < HKDS_CACHE_SIZE / 2; ++i)
+		{
+			hkds_precompute_record(&pcs, cs.ksn);
+			hkds_server_initialize_state(&ss, &mdk, cs.ksn);
+			hkds_client_encrypt_authenticate_message(&cs, msg, NULL, 0, cpt);
+
+			if (hkds_precompute_decrypt_verify_message(&pcs, &ss, cpt, NULL, 0, dec) == false ||
+				qsc_intutils_are_equal8(msg, dec, sizeof(msg)) == false)
+			{
+				qsctest_print_line("hkdstest_precompute_test: fallback decryption failure! -HPC1");
+				res = false;
+				break;
+			}
+		}
+
+		/* the idle stage prepares the next epoch */
+		if (hkds_precompute_run(&pcs, 8, 0) != 1 || pcs.hits != 0)
+		{
+			qsctest_print_line("hkdstest_precompute_test: precompute stage failure! -HPC2");
+			res = false;
+		}
+
+		/* the rollover token request is served from the precomputed token */
+		hkds_server_initialize_state(&ss, &mdk, cs.ksn);
+		hkds_server_encrypt_token(&ss, exp);
+		hkds_precompute_encrypt_token(&pcs, &ss, toke);
+
+		if (pcs.hits != 1 || qsc_intutils_are_equal8(toke, exp, HKDS_ETOK_SIZE) == false ||
+			hkds_client_decrypt_token(&cs, toke, tokd) == false)
+		{
+			qsctest_print_line("hkdstest_precompute_test: precomputed token failure! -HPC3");
+			res = false;
+		}
+
+		hkds_client_generate_cache(&cs, tokd);
+
+		/* the messages of the new epoch are decrypted with the precomputed key cache */
+		for (size_t i = 0; i < HKDS_CACHE_SIZE / 2; ++i)
+		{
+			hkds_server_initialize_state(&ss, &mdk, cs.ksn);
+
+			if (i % 2 == 0)
+			{
+				hkds_client_encrypt_authenticate_message(&cs, msg, NULL, 0, cpt);
+				res &= hkds_precompute_decrypt_verify_message(&pcs, &ss, cpt, NULL, 0, dec);
+			}
+			else
+			{
+				hkds_client_encrypt_message(&cs, msg, cpt);
+				hkds_precompute_decrypt_message(&pcs, &ss, cpt, dec);
+			}
+
+			if (res == false || qsc_intutils_are_equal8(msg, dec, sizeof(msg)) == false)
+			{
+				qsctest_print_line("hkdstest_precompute_test: precomputed decryption failure! -HPC4");
+				res = false;
+				break;
+			}
+		}
+
+		if (res == true && pcs.hits != 1 + (HKDS_CACHE_SIZE / 2))
+		{
+			qsctest_print_line("hkdstest_precompute_test: precomputed material was not used! -HPC5");
+			res = false;
+		}
+
+		/* the most active devices are prepared first */
+		for (size_t i = 0; i < 3; ++i)
+		{
+			qsc_memutils_copy(hksn[i], did, HKDS_DID_SIZE);
+			hksn[i][HKDS_DID_SIZE - 1] = (uint8_t)(0x10 + i);
+
+			for (size_t j = 0; j < HKDS_CACHE_SIZE + (i * 4); ++j)
+			{
+				hkds_precompute_record(&pcs, hksn[i]);
+			}
+		}
+
+		if (res == true && hkds_precompute_run(&pcs, 1, 0) == 1)
+		{
+			for (size_t i = 0; i < pcs.capacity; ++i)
+			{
+				if (pcs.entries[i].used == true && pcs.entries[i].did[HKDS_DID_SIZE - 1] >= 0x10 &&
+					pcs.entries[i].ready[1] != (pcs.entries[i].did[HKDS_DID_SIZE - 1] == 0x12))
+				{
+					res = false;
+				}
+			}
+
+			res = (res == true && hkds_precompute_run(&pcs, 8, 0) == 2);
+		}
+		else
+		{
+			res = false;
+		}
+
+		if (res == false)
+		{
+			qsctest_print_line("hkdstest_precompute_test: precompute selection failure! -HPC6");
+		}
+
+		hkds_precompute_dispose(&pcs);
+	}
+	else
+	{
+		qsctest_print_line("hkdstest_precompute_test: state allocation failure! -HPC0");
+	}
+
+	return res;
+}
+
+static bool hkdstest_batch_round(hkds_batch_state* bts, hkds_client_state cs[HKDS_CACHX8_DEPTH], size_t count, bool force, size_t expected)
+{
+	uint8_t cpt[HKDS_MESSAGE_SIZE] = { 0 };
+	uint8_t exp[HKDS_BATCH_DEPTH][HKDS_MESSAGE_SIZE] = { 0 };
+	uint8_t ksn[HKDS_BATCH_DEPTH][HKDS_KSN_SIZE] = { 0 };
+	uint8_t otp[HKDS_BATCH_DEPTH][HKDS_KSN_SIZE] = { 0 };
+	uint8_t dec[HKDS_BATCH_DEPTH][HKDS_MESSAGE_SIZE] = { 0 };
+	size_t idx;
+	bool res;
+
+	res = true;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		idx = i % HKDS_CACHX8_DEPTH;
+		qsc_csp_generate(exp[i], HKDS_MESSAGE_SIZE);
+		qsc_memutils_copy(ksn[i], cs[idx].ksn, HKDS_KSN_SIZE);
+		hkds_client_encrypt_message(&cs[idx], exp[i], cpt);
+
+		if (hkds_batch_submit(bts, ksn[i], cpt) == false)
+		{
+			res = false;
+			break;
+		}
+	}
+
+	if (res == true && hkds_batch_process(bts, force, otp, dec) != expected)
+	{
+		res = false;
+	}
+
+	for (size_t i = 0; res == true && i < expected; ++i)
+	{
+		if (qsc_intutils_are_equal8(otp[i], ksn[i], HKDS_KSN_SIZE) == false ||
+			qsc_intutils_are_equal8(dec[i], exp[i], HKDS_MESSAGE_SIZE) == false)
+		{
+			res = false;
+		}
+	}
+
+	return res;
+}
+
+bool hkdstest_batch_test()
+{
+	/* protocol id is always 0x10 for unauthenticated HKDS, 0x11 for KMAC authentication */
+	const uint8_t PID = 0x10;
+	/* master key id */
+	const uint8_t kid[HKDS_KID_SIZE] = { 0x01, 0x02, 0x03, 0x04 };
+	uint8_t did[HKDS_DID_SIZE] = { 0x01, 0x00, 0x00, 0x00, PID, HKDSTEST_PRF_MODE, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00 };
+	uint8_t cpt[HKDS_MESSAGE_SIZE] = { 0 };
+	uint8_t edk[HKDS_EDK_SIZE] = { 0 };
+	uint8_t exp[HKDS_KSN_SIZE] = { 0 };
+	uint8_t msg[HKDS_MESSAGE_SIZE] = { 0 };
+	uint8_t tokd[HKDS_STK_SIZE] = { 0 };
+	uint8_t toke[HKDS_ETOK_SIZE] = { 0 };
+	uint8_t dec[HKDS_BATCH_DEPTH][HKDS_MESSAGE_SIZE] = { 0 };
+	uint8_t ksn[HKDS_BATCH_DEPTH][HKDS_KSN_SIZE] = { 0 };
+	hkds_client_state cs[HKDS_CACHX8_DEPTH];
+	hkds_batch_state bts;
+	hkds_master_key mdk;
+	hkds_server_state ss;
+	uint64_t start;
+	size_t cnt;
+	bool res;
+
+	res = true;
+	hkds_server_generate_mdk(&qsc_csp_generate, &mdk, kid);
+
+	for (size_t i = 0; i < HKDS_CACHX8_DEPTH; ++i)
+	{
+		did[HKDS_DID_SIZE - 1] = (uint8_t)i;
+		hkds_server_generate_edk(mdk.bdk, did, edk);
+		hkds_client_initialize_state(&cs[i], edk, did);
+		hkds_server_initialize_state(&ss, &mdk, cs[i].ksn);
+		hkds_server_encrypt_token(&ss, toke);
+		hkds_client_decrypt_token(&cs[i], toke, tokd);
+		hkds_client_generate_cache(&cs[i], tokd);
+	}
+
+	hkds_batch_initialize(&bts, &mdk, 2000, 0);
+
+	/* a full batch is decrypted with the x64 function */
+	if (hkdstest_batch_round(&bts, cs, HKDS_BATCH_DEPTH, false, HKDS_BATCH_DEPTH) == false || hkds_batch_utilization(&bts) != 100)
+	{
+		qsctest_print_line("hkdstest_batch_test: full batch failure! -HBT1");
+		res = false;
+	}
+
+	/* one x8 group and a padded x8 group */
+	if (hkdstest_batch_round(&bts, cs, HKDS_CACHX8_DEPTH + HKDS_BATCH_PAD_MINIMUM + 1, true, HKDS_CACHX8_DEPTH + HKDS_BATCH_PAD_MINIMUM + 1) == false ||
+		bts.lanes != HKDS_BATCH_DEPTH + (2 * HKDS_CACHX8_DEPTH))
+	{
+		qsctest_print_line("hkdstest_batch_test: padded batch failure! -HBT2");
+		res = false;
+	}
+
+	/* a small remainder is decrypted one message at a time */
+	if (hkdstest_batch_round(&bts, cs, 2, true, 2) == false || bts.lanes != HKDS_BATCH_DEPTH + (2 * HKDS_CACHX8_DEPTH) + 2)
+	{
+		qsctest_print_line("hkdstest_batch_test: serial batch failure! -HBT3");
+		res = false;
+	}
+
+	/* a partial batch is held until it is due, then released without a forced flush */
+	qsc_csp_generate(msg, HKDS_MESSAGE_SIZE);
+	qsc_memutils_copy(exp, cs[0].ksn, HKDS_KSN_SIZE);
+	hkds_client_encrypt_message(&cs[0], msg, cpt);
+	hkds_batch_submit(&bts, exp, cpt);
+	start = qsc_timerex_monotonic_microseconds();
+	cnt = 0;
+
+	while (cnt == 0 && qsc_timerex_monotonic_microseconds() - start < 1000000ULL)
+	{
+		cnt = hkds_batch_process(&bts, false, ksn, dec);
+	}
+
+	if (cnt != 1 || hkds_batch_wait_time(&bts) != UINT64_MAX ||
+		qsc_intutils_are_equal8(ksn[0], exp, HKDS_KSN_SIZE) == false ||
+		qsc_intutils_are_equal8(dec[0], msg, HKDS_MESSAGE_SIZE) == false)
+	{
+		qsctest_print_line("hkdstest_batch_test: deadline flush failure! -HBT4");
+		res = false;
+	}
+
+	if (hkds_batch_latency(&bts, 99) == 0)
+	{
+		qsctest_print_line("hkdstest_batch_test: latency histogram failure! -HBT5");
+		res = false;
+	}
+
+	hkds_batch_dispose(&bts);
+
+	return res;
+}
+
+typedef struct
+{
+	const uint8_t (*expected)[HKDS_ASYNC_OUTPUT_SIZE];
+	volatile uint64_t count;
+	volatile uint64_t errors;
+} hkdstest_async_context;
+
+static void hkdstest_async_callback(void* context, const hkds_async_completion* completions, size_t count)
+{
+	hkdstest_async_context* ctx;
+
+	ctx = (hkdstest_async_context*)context;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (completions[i].status == false ||
+			qsc_intutils_are_equal8(completions[i].output, ctx->expected[completions[i].token], HKDS_MESSAGE_SIZE) == false)
+		{
+			qsc_atomics_fetch_add64(&ctx->errors, 1);
+		}
+	}
+
+	qsc_atomics_fetch_add64(&ctx->count, count);
+}
+
+static void hkdstest_async_clients(hkds_master_key* mdk, hkds_client_state cs[HKDS_CACHX8_DEPTH])
+{
+	/* protocol id is always 0x10 for unauthenticated HKDS, 0x11 for KMAC authentication */
+	const uint8_t PID = 0x11;
+	uint8_t did[HKDS_DID_SIZE] = { 0x01, 0x00, 0x00, 0x00, PID, HKDSTEST_PRF_MODE, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00 };
+	uint8_t edk[HKDS_EDK_SIZE] = { 0 };
+	uint8_t tokd[HKDS_STK_SIZE] = { 0 };
+	uint8_t toke[HKDS_ETOK_SIZE] = { 0 };
+	hkds_server_state ss;
+
+	for (size_t i = 0; i < HKDS_CACHX8_DEPTH; ++i)
+	{
+		did[HKDS_DID_SIZE - 1] = (uint8_t)i;
+		hkds_server_generate_edk(mdk->bdk, did, edk);
+		hkds_client_initialize_state(&cs[i], edk, did);
+		hkds_server_initialize_state(&ss, mdk, cs[i].ksn);
+		hkds_server_encrypt_token(&ss, toke);
+		hkds_client_decrypt_token(&cs[i], toke, tokd);
+		hkds_client_generate_cache(&cs[i], tokd);
+	}
+}
+
+bool hkdstest_async_test()
+{
+	const size_t REQCNT = 96;
+	const size_t THDCNT = 72;
+	/* master key id */
+	const uint8_t kid[HKDS_KID_SIZE] = { 0x01, 0x02, 0x03, 0x04 };
+	uint8_t exp[96][HKDS_ASYNC_OUTPUT_SIZE] = { 0 };
+	hkds_async_request reqs[96];
+	hkds_async_completion cpls[96];
+	hkds_client_state cs[HKDS_CACHX8_DEPTH];
+	hkdstest_async_context ctx;
+	hkds_async_state eng;
+	hkds_master_key mdk;
+	hkds_server_state ss;
+	hkds_async_request* preq;
+	clock_t cpu;
+	uint64_t start;
+	size_t cnt;
+	size_t idx;
+	bool res;
+
+	res = true;
+	hkds_server_generate_mdk(&qsc_csp_generate, &mdk, kid);
+	hkdstest_async_clients(&mdk, cs);
+
+	/* a mix of operations, executed on the calling thread */
+	for (size_t i = 0; i < REQCNT; ++i)
+	{
+		idx = i % HKDS_CACHX8_DEPTH;
+		preq = &reqs[i];
+		qsc_memutils_clear((uint8_t*)preq, sizeof(hkds_async_request));
+		preq->token = i;
+		qsc_memutils_copy(preq->ksn, cs[idx].ksn, HKDS_KSN_SIZE);
+		qsc_csp_generate(exp[i], HKDS_MESSAGE_SIZE);
+
+		if (i % 3 == 0)
+		{
+			preq->operation = hkds_async_decrypt;
+			hkds_client_encrypt_message(&cs[idx], exp[i], preq->message);
+		}
+		else if (i % 3 == 1)
+		{
+			/* two additional data lengths, executed as separate groups */
+			preq->operation = hkds_async_decrypt_verify;
+			preq->datalen = (i % 2 == 0) ? 0 : HKDS_MESSAGE_SIZE / 2;
+			qsc_memutils_setvalue(preq->data, (uint8_t)i, preq->datalen);
+			hkds_client_encrypt_authenticate_message(&cs[idx], exp[i], (preq->datalen != 0) ? preq->data : NULL, preq->datalen, preq->message);
+		}
+		else
+		{
+			preq->operation = hkds_async_encrypt_token;
+			hkds_server_initialize_state(&ss, &mdk, preq->ksn);
+			hkds_server_encrypt_token(&ss, exp[i]);
+		}
+	}
+
+	/* a tampered message fails authentication */
+	reqs[1].message[0] ^= 0x01;
+
+	if (hkds_async_initialize(&eng, &mdk, 64, 0, NULL, NULL) == true)
+	{
+		cnt = hkds_async_submit_batch(&eng, reqs, REQCNT);
+
+		if (cnt != 64 || hkds_async_submit(&eng, &reqs[cnt]) == true)
+		{
+			qsctest_print_line("hkdstest_async_test: outstanding limit failure! -HAT1");
+			res = false;
+		}
+
+		while (cnt < REQCNT)
+		{
+			hkds_async_run(&eng, 1);
+			idx = hkds_async_complete(&eng, cpls, REQCNT);
+
+			for (size_t i = 0; i < idx; ++i)
+			{
+				if (cpls[i].token == 1)
+				{
+					res &= (cpls[i].status == false);
+				}
+				else if (cpls[i].status == false || qsc_intutils_are_equal8(cpls[i].output, exp[cpls[i].token],
+					(cpls[i].operation == hkds_async_encrypt_token) ? HKDS_ETOK_SIZE : HKDS_MESSAGE_SIZE) == false)
+				{
+					res = false;
+				}
+			}
+
+			cnt += hkds_async_submit_batch(&eng, reqs + cnt, REQCNT - cnt);
+		}
+
+		hkds_async_run(&eng, 2);
+		cnt = hkds_async_complete(&eng, cpls, REQCNT);
+
+		for (size_t i = 0; i < cnt; ++i)
+		{
+			res &= (cpls[i].status == true && qsc_intutils_are_equal8(cpls[i].output, exp[cpls[i].token],
+				(cpls[i].operation == hkds_async_encrypt_token) ? HKDS_ETOK_SIZE : HKDS_MESSAGE_SIZE) == true);
+		}
+
+		if (res == false || eng.completed != REQCNT || eng.outstanding != 0)
+		{
+			qsctest_print_line("hkdstest_async_test: completion ring failure! -HAT2");
+			res = false;
+		}
+
+		hkds_async_dispose(&eng);
+	}
+	else
+	{
+		qsctest_print_line("hkdstest_async_test: engine initialization failure! -HAT0");
+		res = false;
+	}
+
+	/* decryption on worker threads, completions delivered to a callback */
+	hkdstest_async_clients(&mdk, cs);
+
+	for (size_t i = 0; i < THDCNT; ++i)
+	{
+		idx = i % HKDS_CACHX8_DEPTH;
+		preq = &reqs[i];
+		qsc_memutils_clear((uint8_t*)preq, sizeof(hkds_async_request));
+		preq->token = i;
+		preq->operation = hkds_async_decrypt;
+		qsc_memutils_copy(preq->ksn, cs[idx].ksn, HKDS_KSN_SIZE);
+		qsc_csp_generate(exp[i], HKDS_MESSAGE_SIZE);
+		hkds_client_encrypt_message(&cs[idx], exp[i], preq->message);
+	}
+
+	ctx.expected = (const uint8_t (*)[HKDS_ASYNC_OUTPUT_SIZE])exp;
+	ctx.count = 0;
+	ctx.errors = 0;
+
+	if (hkds_async_initialize(&eng, &mdk, 32, 2, &hkdstest_async_callback, &ctx) == true)
+	{
+		cnt = 0;
+		start = qsc_timerex_monotonic_microseconds();
+
+		while (qsc_atomics_load64(&ctx.count) != THDCNT && qsc_timerex_monotonic_microseconds() - start < 10000000ULL)
+		{
+			cnt += hkds_async_submit_batch(&eng, reqs + cnt, THDCNT - cnt);
+			qsc_async_thread_yield();
+		}
+
+		if (ctx.count != THDCNT || ctx.errors != 0)
+		{
+			qsctest_print_line("hkdstest_async_test: worker completion failure! -HAT3");
+			res = false;
+		}
+
+		/* idle workers block after a short spin instead of holding a processor */
+		cpu = clock();
+		qsc_async_thread_sleep(300);
+		cpu = clock() - cpu;
+
+		if (res == true && (uint64_t)cpu * 1000ULL / CLOCKS_PER_SEC > 100)
+		{
+			qsctest_print_line("hkdstest_async_test: idle worker failure! -HAT4");
+			res = false;
+		}
+
+		/* a submission wakes a blocked worker before its wait interval expires */
+		start = qsc_timerex_monotonic_microseconds();
+		cnt = hkds_async_submit_batch(&eng, reqs, HKDS_CACHX8_DEPTH);
+
+		while (qsc_atomics_load64(&ctx.count) != THDCNT + cnt && qsc_timerex_monotonic_microseconds() - start < 10000000ULL)
+		{
+			qsc_async_thread_yield();
+		}
+
+		if (res == true && (cnt != HKDS_CACHX8_DEPTH || ctx.count != THDCNT + cnt ||
+			qsc_timerex_monotonic_microseconds() - start >= (uint64_t)HKDS_ASYNC_WAIT_INTERVAL * 1000ULL / 2))
+		{
+			qsctest_print_line("hkdstest_async_test: worker wakeup failure! -HAT5");
+			res = false;
+		}
+
+		hkds_async_dispose(&eng);
+	}
+	else
+	{
+		qsctest_print_line("hkdstest_async_test: engine initialization failure! -HAT0");
+		res = false;
+	}
+
+	return res;
+}
+
+typedef struct
+{
+	qsc_threadpool_scheduler* pool;
+	volatile uint64_t sum;
+} hkdstest_scheduler_context;
+
+static void hkdstest_scheduler_inner(void* arg, size_t index)
+{
+	hkdstest_scheduler_context* ctx = (hkdstest_scheduler_context*)arg;
+
+	qsc_atomics_fetch_add64(&ctx->sum, index + 1);
+}
+
+static void hkdstest_scheduler_outer(void* arg, size_t index)
+{
+	hkdstest_scheduler_context* ctx = (hkdstest_scheduler_context*)arg;
+
+	(void)index;
+	/* a task that spawns tasks onto its workers deque */
+	qsc_threadpool_parallel_for(ctx->pool, 100, &hkdstest_scheduler_inner, ctx);
+}
+
+bool hkdstest_scheduler_test()
+{
+	const size_t SETS = 20;
+	/* master key id */
+	const uint8_t kid[HKDS_KID_SIZE] = { 0x01, 0x02, 0x03, 0x04 };
+	uint8_t ct[20][HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE];
+	uint8_t ksn[HKDS_CACHX8_DEPTH][HKDS_KSN_SIZE];
+	uint8_t pt1[20][HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE];
+	uint8_t pt2[20][HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE];
+	uint8_t tok1[20][HKDS_CACHX8_DEPTH][HKDS_ETOK_SIZE];
+	uint8_t tok2[20][HKDS_CACHX8_DEPTH][HKDS_ETOK_SIZE];
+	hkds_server_x8_state state[20];
+	hkdstest_scheduler_context ctx;
+	qsc_threadpool_scheduler pool;
+	hkds_master_key mdk;
+	bool res;
+
+	res = qsc_threadpool_scheduler_initialize(&pool, 3);
+
+	if (res == true)
+	{
+		ctx.pool = &pool;
+		ctx.sum = 0;
+
+		/* the sum of 1 to 10000 */
+		qsc_threadpool_parallel_for(&pool, 10000, &hkdstest_scheduler_inner, &ctx);
+
+		if (ctx.sum != 50005000ULL)
+		{
+			qsctest_print_line("hkdstest_scheduler_test: parallel for failure! -HSC1");
+			res = false;
+		}
+
+		/* nested parallel loops, 50 x (1 + ... + 100) */
+		ctx.sum = 0;
+		qsc_threadpool_parallel_for(&pool, 50, &hkdstest_scheduler_outer, &ctx);
+
+		if (ctx.sum != 252500ULL)
+		{
+			qsctest_print_line("hkdstest_scheduler_test: nested parallel for failure! -HSC2");
+			res = false;
+		}
+
+		/* the scheduled functions match the sequential x8 functions */
+		hkds_server_generate_mdk(&qsc_csp_generate, &mdk, kid);
+
+		for (size_t i = 0; i < SETS; ++i)
+		{
+			qsc_csp_generate((uint8_t*)ksn, sizeof(ksn));
+			qsc_csp_generate((uint8_t*)ct[i], sizeof(ct[i]));
+			hkds_server_initialize_state_x8(&state[i], &mdk, (const uint8_t (*)[HKDS_KSN_SIZE])ksn);
+			hkds_server_decrypt_message_x8(&state[i], (const uint8_t (*)[HKDS_MESSAGE_SIZE])ct[i], pt1[i]);
+			hkds_server_encrypt_token_x8(&state[i], tok1[i]);
+		}
+
+		hkds_server_decrypt_message_xn(&pool, state, SETS, (const uint8_t (*)[HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE])ct, pt2);
+		hkds_server_encrypt_token_xn(&pool, state, SETS, tok2);
+
+		if (qsc_intutils_are_equal8((uint8_t*)pt1, (uint8_t*)pt2, sizeof(pt1)) == false ||
+			qsc_intutils_are_equal8((uint8_t*)tok1, (uint8_t*)tok2, sizeof(tok1)) == false)
+		{
+			qsctest_print_line("hkdstest_scheduler_test: scheduled x8 equivalence failure! -HSC3");
+			res = false;
+		}
+
+		qsc_threadpool_scheduler_dispose(&pool);
+	}
+	else
+	{
+		qsctest_print_line("hkdstest_scheduler_test: scheduler initialization failure! -HSC0");
+	}
+
+	return res;
+}
+
+bool hkdstest_shard_test()
+{
+	const size_t MSGCNT = 48;
+	/* master key id */
+	const uint8_t kid[HKDS_KID_SIZE] = { 0x01, 0x02, 0x03, 0x04 };
+	uint8_t exp[49][HKDS_ASYNC_OUTPUT_SIZE] = { 0 };
+	uint8_t ksn[HKDS_KSN_SIZE] = { 0 };
+	hkds_async_request reqs[48];
+	hkds_client_state cs[HKDS_CACHX8_DEPTH];
+	hkdstest_async_context ctx;
+	hkds_shard_state shs;
+	hkds_server_state ss;
+	hkds_master_key mdk;
+	hkds_async_request forged;
+	hkds_async_request* preq;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t replays;
+	uint64_t start;
+	size_t cnt;
+	size_t idx;
+	bool res;
+
+	res = true;
+	hkds_server_generate_mdk(&qsc_csp_generate, &mdk, kid);
+	hkdstest_async_clients(&mdk, cs);
+
+	/* six messages from each device, plain and authenticated, all within one epoch */
+	for (size_t i = 0; i < MSGCNT; ++i)
+	{
+		idx = i % HKDS_CACHX8_DEPTH;
+		preq = &reqs[i];
+		qsc_memutils_clear((uint8_t*)preq, sizeof(hkds_async_request));
+		preq->token = i;
+		qsc_memutils_copy(preq->ksn, cs[idx].ksn, HKDS_KSN_SIZE);
+		qsc_csp_generate(exp[i], HKDS_MESSAGE_SIZE);
+
+		if ((i / HKDS_CACHX8_DEPTH) % 2 == 0)
+		{
+			preq->operation = hkds_async_decrypt;
+			hkds_client_encrypt_message(&cs[idx], exp[i], preq->message);
+		}
+		else
+		{
+			preq->operation = hkds_async_decrypt_verify;
+			preq->datalen = HKDS_MESSAGE_SIZE / 2;
+			qsc_memutils_setvalue(preq->data, (uint8_t)i, preq->datalen);
+			hkds_client_encrypt_authenticate_message(&cs[idx], exp[i], preq->data, preq->datalen, preq->message);
+		}
+	}
+
+	ctx.expected = (const uint8_t (*)[HKDS_ASYNC_OUTPUT_SIZE])exp;
+	ctx.count = 0;
+	ctx.errors = 0;
+
+	/* pinning is best effort, the test does not depend on the processor count */
+	if (hkds_shard_initialize(&shs, &mdk, 2, 1, 16, true, &hkdstest_async_callback, &ctx) == true)
+	{
+		/* every counter of a device is routed to the same worker */
+		for (size_t i = 0; i < HKDS_CACHX8_DEPTH; ++i)
+		{
+			qsc_memutils_copy(ksn, reqs[i].ksn, HKDS_KSN_SIZE);
+			ksn[HKDS_KSN_SIZE - 1] += 0x40;
+
+			if (hkds_shard_owner(&shs, reqs[i].ksn) != hkds_shard_owner(&shs, ksn) || hkds_shard_owner(&shs, ksn) >= shs.wcount)
+			{
+				qsctest_print_line("hkdstest_shard_test: device routing failure! -HST1");
+				res = false;
+			}
+		}
+
+		cnt = 0;
+		start = qsc_timerex_monotonic_microseconds();
+
+		while (qsc_atomics_load64(&ctx.count) != MSGCNT && qsc_timerex_monotonic_microseconds() - start < 10000000ULL)
+		{
+			if (cnt < MSGCNT && hkds_shard_submit(&shs, 0, &reqs[cnt]) == true)
+			{
+				++cnt;
+			}
+			else
+			{
+				qsc_async_thread_yield();
+			}
+		}
+
+		if (ctx.count != MSGCNT || ctx.errors != 0)
+		{
+			qsctest_print_line("hkdstest_shard_test: worker completion failure! -HST2");
+			res = false;
+		}
+
+		/* replayed authenticated messages are rejected by the owning worker */
+		cnt = 0;
+
+		while (qsc_atomics_load64(&ctx.count) != MSGCNT + HKDS_CACHX8_DEPTH && qsc_timerex_monotonic_microseconds() - start < 10000000ULL)
+		{
+			if (cnt < HKDS_CACHX8_DEPTH && hkds_shard_submit(&shs, 0, &reqs[HKDS_CACHX8_DEPTH + cnt]) == true)
+			{
+				++cnt;
+			}
+			else
+			{
+				qsc_async_thread_yield();
+			}
+		}
+
+		hits = 0;
+		misses = 0;
+		replays = 0;
+
+		/* the counters are final once every completion has been delivered */
+		for (size_t i = 0; i < shs.wcount; ++i)
+		{
+			hits += shs.workers[i].hits;
+			misses += shs.workers[i].misses;
+			replays += shs.workers[i].replays;
+		}
+
+		hkds_shard_dispose(&shs);
+
+		/* one key cache is derived per device, the remaining messages use the cache */
+		if (ctx.errors != HKDS_CACHX8_DEPTH || replays != HKDS_CACHX8_DEPTH)
+		{
+			qsctest_print_line("hkdstest_shard_test: replay window failure! -HST3");
+			res = false;
+		}
+
+		if (misses != HKDS_CACHX8_DEPTH || hits != MSGCNT - HKDS_CACHX8_DEPTH)
+		{
+			qsctest_print_line("hkdstest_shard_test: device key cache failure! -HST4");
+			res = false;
+		}
+	}
+	else
+	{
+		qsctest_print_line("hkdstest_shard_test: shard initialization failure! -HST0");
+		res = false;
+	}
+
+	/* a single worker holding four devices; the first message of each of the eight devices replaces the first four */
+	ctx.count = 0;
+	ctx.errors = 0;
+
+	if (res == true && hkds_shard_initialize(&shs, &mdk, 1, 1, 1, false, &hkdstest_async_callback, &ctx) == true)
+	{
+		cnt = 0;
+		start = qsc_timerex_monotonic_microseconds();
+
+		/* then the replaced first device replays its old authenticated message, and sends its next one */
+		while (qsc_atomics_load64(&ctx.count) != HKDS_CACHX8_DEPTH + 2 && qsc_timerex_monotonic_microseconds() - start < 10000000ULL)
+		{
+			idx = (cnt < HKDS_CACHX8_DEPTH) ? HKDS_CACHX8_DEPTH + cnt : (cnt == HKDS_CACHX8_DEPTH) ? HKDS_CACHX8_DEPTH : 3 * HKDS_CACHX8_DEPTH;
+
+			if (cnt < HKDS_CACHX8_DEPTH + 2 && hkds_shard_submit(&shs, 0, &reqs[idx]) == true)
+			{
+				++cnt;
+			}
+			else
+			{
+				qsc_async_thread_yield();
+			}
+		}
+
+		replays = shs.workers[0].replays;
+		hkds_shard_dispose(&shs);
+
+		if (ctx.count != HKDS_CACHX8_DEPTH + 2 || ctx.errors != 1 || replays != 1)
+		{
+			qsctest_print_line("hkdstest_shard_test: replaced device replay failure! -HST5");
+			res = false;
+		}
+	}
+	else if (res == true)
+	{
+		qsctest_print_line("hkdstest_shard_test: shard initialization failure! -HST0");
+		res = false;
+	}
+
+	/* an unauthenticated message with a forged counter far ahead does not lock the device out */
+	ctx.count = 0;
+	ctx.errors = 0;
+
+	if (res == true && hkds_shard_initialize(&shs, &mdk, 1, 1, 16, false, &hkdstest_async_callback, &ctx) == true)
+	{
+		qsc_memutils_copy((uint8_t*)&forged, (const uint8_t*)&reqs[0], sizeof(hkds_async_request));
+		forged.token = MSGCNT;
+		forged.ksn[HKDS_KSN_SIZE - 1] += 2 * HKDS_SHARD_REPLAY_WINDOW;
+		hkds_server_initialize_state(&ss, &mdk, forged.ksn);
+		hkds_server_decrypt_message(&ss, forged.message, exp[MSGCNT]);
+		cnt = 0;
+		start = qsc_timerex_monotonic_microseconds();
+
+		while (qsc_atomics_load64(&ctx.count) != 2 && qsc_timerex_monotonic_microseconds() - start < 10000000ULL)
+		{
+			if (cnt < 2 && hkds_shard_submit(&shs, 0, (cnt == 0) ? &forged : &reqs[HKDS_CACHX8_DEPTH]) == true)
+			{
+				++cnt;
+			}
+			else
+			{
+				qsc_async_thread_yield();
+			}
+		}
+
+		replays = shs.workers[0].replays;
+		hkds_shard_dispose(&shs);
+
+		if (ctx.count != 2 || ctx.errors != 0 || replays != 0)
+		{
+			qsctest_print_line("hkdstest_shard_test: forged counter lockout failure! -HST6");
+			res = false;
+		}
+	}
+	else if (res == true)
+	{
+		qsctest_print_line("hkdstest_shard_test: shard initialization failure! -HST0");
+		res = false;
+	}
+
+	return res;
+}
+
+bool hkdstest_queue_test()
+{
+	const size_t DEPTH = 200;
+	uint8_t blk8[HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE] = { 0 };
+	uint8_t blk64[HKDS_PARALLEL_DEPTH][HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE] = { 0 };
+	uint8_t msg[HKDS_MESSAGE_SIZE] = { 0 };
+	hkds_queue_message_queue ctx;
+	size_t next;
+	size_t pos;
+	bool res;
+
+	res = qsc_queue_self_test();
+
+	if (res == false)
+	{
+		qsctest_print_line("hkdstest_queue_test: queue self test failure! -HQT1");
+	}
+
+	/* a queue deeper than a single batch, cycled through the end of the ring several times */
+	hkds_queue_initialize(&ctx, DEPTH, HKDS_MESSAGE_SIZE, NULL);
+	next = 0;
+	pos = 0;
+
+	for (size_t i = 0; i < 16 && res == true; ++i)
+	{
+		while (hkds_queue_isfull(&ctx) == false)
+		{
+			qsc_memutils_setvalue(msg, (uint8_t)pos, sizeof(msg));
+			msg[0] = (uint8_t)(pos >> 8);
+			hkds_queue_push(&ctx, msg, sizeof(msg));
+			++pos;
+		}
+
+		if (hkds_queue_count(&ctx) != DEPTH || hkds_queue_extract_block_x64(&ctx, blk64) != HKDS_CACHX64_SIZE ||
+			hkds_queue_extract_block_x8(&ctx, blk8) != HKDS_CACHX8_DEPTH)
+		{
+			qsctest_print_line("hkdstest_queue_test: block extraction failure! -HQT2");
+			res = false;
+			break;
+		}
+
+		for (size_t j = 0; j < HKDS_CACHX64_SIZE + HKDS_CACHX8_DEPTH; ++j)
+		{
+			qsc_memutils_setvalue(msg, (uint8_t)next, sizeof(msg));
+			msg[0] = (uint8_t)(next >> 8);
+
+			if (qsc_intutils_are_equal8(msg, (j < HKDS_CACHX64_SIZE) ? blk64[j / HKDS_CACHX8_DEPTH][j % HKDS_CACHX8_DEPTH] :
+				blk8[j - HKDS_CACHX64_SIZE], sizeof(msg)) == false)
+			{
+				qsctest_print_line("hkdstest_queue_test: queue order failure! -HQT3");
+				res = false;
+				break;
+			}
+
+			++next;
+		}
+	}
+
+	hkds_queue_destroy(&ctx);
+
+	return res;
+}
+
+typedef struct
+{
+	hkds_queue_mpmc* queue;
+	volatile uint64_t* seen;
+	volatile uint64_t* consumed;
+	size_t index;
+	size_t total;
+} hkdstest_mpmc_context;
+
+static void hkdstest_mpmc_producer(void* arg)
+{
+	uint8_t msgs[HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE] = { 0 };
+	hkdstest_mpmc_context* ctx;
+	size_t cnt;
+	size_t id;
+	size_t pos;
+
+	ctx = (hkdstest_mpmc_context*)arg;
+	pos = 0;
+
+	while (pos < ctx->total)
+	{
+		/* batches of eight, and single messages, interleaved */
+		cnt = (pos % 16 == 0) ? 1 : HKDS_CACHX8_DEPTH;
+		cnt = (cnt < ctx->total - pos) ? cnt : ctx->total - pos;
+
+		for (size_t i = 0; i < cnt; ++i)
+		{
+			id = (ctx->index * ctx->total) + pos + i;
+			qsc_memutils_setvalue(msgs[i], (uint8_t)id, HKDS_MESSAGE_SIZE);
+			msgs[i][0] = (uint8_t)(id >> 8);
+		}
+
+		if (cnt == 1)
+		{
+			cnt = (hkds_queue_mpmc_push(ctx->queue, msgs[0], HKDS_MESSAGE_SIZE) == true) ? 1 : 0;
+		}
+		else
+		{
+			cnt = hkds_queue_mpmc_push_batch(ctx->queue, (const uint8_t*)msgs, cnt);
+		}
+
+		if (cnt == 0)
+		{
+			qsc_async_thread_yield();
+		}
+
+		pos += cnt;
+	}
+}
+
+static void hkdstest_mpmc_consumer(void* arg)
+{
+	uint8_t msgs[HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE] = { 0 };
+	hkdstest_mpmc_context* ctx;
+	size_t cnt;
+	size_t id;
+
+	ctx = (hkdstest_mpmc_context*)arg;
+
+	while (qsc_atomics_load64(ctx->consumed) < ctx->total)
+	{
+		cnt = hkds_queue_mpmc_extract_block_x8(ctx->queue, msgs);
+
+		if (cnt == 0)
+		{
+			cnt = hkds_queue_mpmc_pop_batch(ctx->queue, (uint8_t*)msgs, HKDS_CACHX8_DEPTH);
+		}
+
+		for (size_t i = 0; i < cnt; ++i)
+		{
+			id = ((size_t)msgs[i][0] << 8) | msgs[i][1];
+
+			if (id < ctx->total)
+			{
+				qsc_atomics_fetch_add64(&ctx->seen[id], 1);
+			}
+		}
+
+		if (cnt == 0)
+		{
+			qsc_async_thread_yield();
+		}
+		else
+		{
+			qsc_atomics_fetch_add64(ctx->consumed, cnt);
+		}
+	}
+}
+
+bool hkdstest_queue_mpmc_test()
+{
+	const size_t PERTHD = 1024;
+	const size_t THDCNT = 2;
+	uint8_t blk64[HKDS_PARALLEL_DEPTH][HKDS_CACHX8_DEPTH][HKDS_MESSAGE_SIZE] = { 0 };
+	uint8_t msg[HKDS_MESSAGE_SIZE] = { 0 };
+	volatile uint64_t seen[2048] = { 0 };
+	hkdstest_mpmc_context cons[2];
+	hkdstest_mpmc_context prod[2];
+	qsc_thread threads[4];
+	hkds_queue_mpmc queue;
+	volatile uint64_t consumed;
+	bool res;
+
+	res = true;
+
+	if (hkds_queue_mpmc_initialize(&queue, 128, HKDS_MESSAGE_SIZE) == true)
+	{
+		/* a block is taken whole or not at all */
+		for (size_t i = 0; i < HKDS_CACHX64_SIZE - 1; ++i)
+		{
+			qsc_memutils_setvalue(msg, (uint8_t)i, sizeof(msg));
+			hkds_queue_mpmc_push(&queue, msg, sizeof(msg));
+		}
+
+		if (hkds_queue_mpmc_extract_block_x64(&queue, blk64) != 0 || hkds_queue_mpmc_push(&queue, msg, sizeof(msg)) == false ||
+			hkds_queue_mpmc_extract_block_x64(&queue, blk64) != HKDS_CACHX64_SIZE || blk64[7][6][0] != 62 ||
+			hkds_queue_mpmc_count(&queue) != 0 || hkds_queue_mpmc_pop(&queue, msg, sizeof(msg)) == true)
+		{
+			qsctest_print_line("hkdstest_queue_mpmc_test: block extraction failure! -HMQ1");
+			res = false;
+		}
+
+		/* concurrent producers and consumers, every message is delivered exactly once */
+		consumed = 0;
+
+		for (size_t i = 0; i < THDCNT; ++i)
+		{
+			prod[i].queue = &queue;
+			prod[i].seen = seen;
+			prod[i].consumed = &consumed;
+			prod[i].index = i;
+			prod[i].total = PERTHD;
+			cons[i] = prod[i];
+			cons[i].total = PERTHD * THDCNT;
+			threads[i] = qsc_async_thread_create(&hkdstest_mpmc_producer, &prod[i]);
+			threads[THDCNT + i] = qsc_async_thread_create(&hkdstest_mpmc_consumer, &cons[i]);
+		}
+
+		for (size_t i = 0; i < THDCNT * 2; ++i)
+		{
+			qsc_async_thread_wait(threads[i]);
+		}
+
+		for (size_t i = 0; i < PERTHD * THDCNT; ++i)
+		{
+			if (seen[i] != 1)
+			{
+				qsctest_print_line("hkdstest_queue_mpmc_test: concurrent delivery failure! -HMQ2");
+				res = false;
+				break;
+			}
+		}
+
+		hkds_queue_mpmc_destroy(&queue);
+	}
+	else
+	{
+		qsctest_print_line("hkdstest_queue_mpmc_test: queue initialization failure! -HMQ0");
+		res = false;
+	}
+
+	return res;
+}
+
+bool hkdstest_jobs_test()
+{
+	const size_t CLSCNT = 4;
+	const size_t JOBCNT = 67;
+	/* protocol id is always 0x10 for unauthenticated HKDS, 0x11 for KMAC authentication */
+	const uint8_t PID = 0x11;
+	const uint8_t kid[2][HKDS_KID_SIZE] = { { 0x01, 0x02, 0x03, 0x04 }, { 0x05, 0x06, 0x07, 0x08 } };
+	uint8_t did[HKDS_DID_SIZE] = { 0x00, 0x00, 0x00, 0x00, PID, HKDSTEST_PRF_MODE, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00 };
+	uint8_t edk[HKDS_EDK_SIZE] = { 0 };
+	uint8_t tokd[HKDS_STK_SIZE] = { 0 };
+	uint8_t exp[67][HKDS_ASYNC_OUTPUT_SIZE] = { 0 };
+	hkds_async_request reqs[67];
+	hkds_client_state cs[2][HKDS_CACHX8_DEPTH];
+	hkds_master_key mdk[2];
+	hkds_master_key* keys[2];
+	hkdstest_async_context ctx;
+	hkds_jobs_state jbs;
+	hkds_server_state ss;
+	hkds_async_request* preq;
+	hkds_client_state* pcs;
+	size_t cnt;
+	bool res;
+
+	res = true;
+
+	for (size_t k = 0; k < 2; ++k)
+	{
+		hkds_server_generate_mdk(&qsc_csp_generate, &mdk[k], kid[k]);
+		keys[k] = &mdk[k];
+		qsc_memutils_copy(did, kid[k], HKDS_KID_SIZE);
+
+		for (size_t i = 0; i < HKDS_CACHX8_DEPTH; ++i)
+		{
+			did[HKDS_DID_SIZE - 1] = (uint8_t)i;
+			hkds_server_generate_edk(mdk[k].bdk, did, edk);
+			hkds_client_initialize_state(&cs[k][i], edk, did);
+			hkds_server_initialize_state(&ss, &mdk[k], cs[k][i].ksn);
+			hkds_server_encrypt_token(&ss, exp[0]);
+			hkds_client_decrypt_token(&cs[k][i], exp[0], tokd);
+			hkds_client_generate_cache(&cs[k][i], tokd);
+		}
+	}
+
+	/* interleaved traffic from two master keys and four request classes, arriving device by device */
+	cnt = 0;
+
+	for (size_t i = 0; i < HKDS_CACHX8_DEPTH; ++i)
+	{
+		for (size_t k = 0; k < 2; ++k)
+		{
+			for (size_t c = 0; c < CLSCNT; ++c)
+			{
+				pcs = &cs[k][i];
+				preq = &reqs[cnt];
+				qsc_memutils_clear((uint8_t*)preq, sizeof(hkds_async_request));
+				preq->token = cnt;
+				qsc_memutils_copy(preq->ksn, pcs->ksn, HKDS_KSN_SIZE);
+				qsc_csp_generate(exp[cnt], HKDS_MESSAGE_SIZE);
+
+				if (c == 0)
+				{
+					preq->operation = hkds_async_decrypt;
+					hkds_client_encrypt_message(pcs, exp[cnt], preq->message);
+				}
+				else if (c == 3)
+				{
+					preq->operation = hkds_async_encrypt_token;
+					hkds_server_initialize_state(&ss, &mdk[k], preq->ksn);
+					hkds_server_encrypt_token(&ss, exp[cnt]);
+				}
+				else
+				{
+					/* the additional data length separates the two verify classes */
+					preq->operation = hkds_async_decrypt_verify;
+					preq->datalen = (c == 1) ? 0 : HKDS_MESSAGE_SIZE / 2;
+					qsc_memutils_setvalue(preq->data, (uint8_t)cnt, preq->datalen);
+					hkds_client_encrypt_authenticate_message(pcs, exp[cnt], (preq->datalen != 0) ? preq->data : NULL, preq->datalen, preq->message);
+				}
+
+				++cnt;
+			}
+		}
+	}
+
+	/* three stragglers that do not fill a class */
+	for (size_t i = 0; i < 3; ++i)
+	{
+		preq = &reqs[cnt];
+		qsc_memutils_clear((uint8_t*)preq, sizeof(hkds_async_request));
+		preq->token = cnt;
+		preq->operation = hkds_async_decrypt;
+		qsc_memutils_copy(preq->ksn, cs[0][i].ksn, HKDS_KSN_SIZE);
+		qsc_csp_generate(exp[cnt], HKDS_MESSAGE_SIZE);
+		hkds_client_encrypt_message(&cs[0][i], exp[cnt], preq->message);
+		++cnt;
+	}
+
+	ctx.expected = (const uint8_t (*)[HKDS_ASYNC_OUTPUT_SIZE])exp;
+	ctx.count = 0;
+	ctx.errors = 0;
+	hkds_jobs_initialize(&jbs, keys, 2, 10000000ULL, &hkdstest_async_callback, &ctx);
+
+	for (size_t i = 0; i < JOBCNT - 3; ++i)
+	{
+		res &= hkds_jobs_submit(&jbs, &reqs[i]);
+	}
+
+	/* every class filled its lanes and was executed on submission */
+	if (res == false || ctx.count != JOBCNT - 3 || ctx.errors != 0 || hkds_jobs_pending(&jbs) != 0 || hkds_jobs_utilization(&jbs) != 100)
+	{
+		qsctest_print_line("hkdstest_jobs_test: lane packing failure! -HJT1");
+		res = false;
+	}
+
+	for (size_t i = JOBCNT - 3; i < JOBCNT; ++i)
+	{
+		res &= hkds_jobs_submit(&jbs, &reqs[i]);
+	}
+
+	/* stragglers wait for the timeout, or a forced flush */
+	if (hkds_jobs_flush(&jbs, false) != 0 || hkds_jobs_pending(&jbs) != 3 || hkds_jobs_wait_time(&jbs) == 0 ||
+		hkds_jobs_flush(&jbs, true) != 3 || ctx.count != JOBCNT || ctx.errors != 0 || hkds_jobs_wait_time(&jbs) != UINT64_MAX)
+	{
+		qsctest_print_line("hkdstest_jobs_test: straggler flush failure! -HJT2");
+		res = false;
+	}
+
+	/* a request for an unknown master key is rejected */
+	reqs[0].ksn[0] ^= 0xFF;
+
+	if (hkds_jobs_submit(&jbs, &reqs[0]) == true)
+	{
+		qsctest_print_line("hkdstest_jobs_test: key selection failure! -HJT3");
+		res = false;
+	}
+
+	hkds_jobs_dispose(&jbs);
+
+	return res;
+}
+
+bool hkdstest_priority_test()
+{
+	const size_t TOKCNT = 40;
+	const size_t MSGCNT = 16;
+	uint8_t pkt[HKDS_PRIORITY_ITEM_SIZE] = { 0 };
+	uint8_t otp[HKDS_PRIORITY_ITEM_SIZE] = { 0 };
+	hkds_priority_state pts;
+	hkds_priority_class pcls;
+	size_t msgs;
+	size_t pos;
+	size_t toks;
+	bool res;
+
+	res = true;
+	hkds_priority_initialize(&pts, 64, NULL);
+
+	/* a token storm queued ahead of message traffic, the sequence byte carries the arrival order */
+	pkt[0] = (uint8_t)packet_token_request;
+
+	for (size_t i = 0; i < TOKCNT; ++i)
+	{
+		pkt[2] = (uint8_t)i;
+		res &= hkds_priority_submit(&pts, pkt, HKDS_CLIENT_TOKEN_REQUEST_SIZE);
+	}
+
+	pkt[0] = (uint8_t)packet_message_request;
+
+	for (size_t i = 0; i < MSGCNT; ++i)
+	{
+		pkt[2] = (uint8_t)i;
+		res &= hkds_priority_submit(&pts, pkt, HKDS_CLIENT_MESSAGE_REQUEST_SIZE);
+	}
+
+	pkt[0] = (uint8_t)packet_error_message;
+	res &= hkds_priority_submit(&pts, pkt, HKDS_ERROR_MESSAGE_SIZE);
+	/* responses are not server ingress packets */
+	pkt[0] = (uint8_t)packet_message_response;
+	res &= (hkds_priority_submit(&pts, pkt, HKDS_SERVER_MESSAGE_RESPONSE_SIZE) == false);
+
+	if (res == false || hkds_priority_pending(&pts, hkds_priority_token) != TOKCNT)
+	{
+		qsctest_print_line("hkdstest_priority_test: packet classification failure! -HPT1");
+		res = false;
+	}
+
+	msgs = 0;
+	toks = 0;
+	pos = 0;
+
+	while (hkds_priority_next(&pts, otp, &pcls) == true)
+	{
+		/* the control packet is served first, and each class is served in arrival order */
+		if ((pos == 0 && pcls != hkds_priority_control) ||
+			(pcls == hkds_priority_message && otp[2] != msgs) ||
+			(pcls == hkds_priority_token && otp[2] != toks))
+		{
+			res = false;
+		}
+
+		msgs += (pcls == hkds_priority_message) ? 1 : 0;
+		toks += (pcls == hkds_priority_token) ? 1 : 0;
+		++pos;
+
+		/* the messages are not delayed behind the token storm */
+		if (pcls == hkds_priority_message && msgs == MSGCNT && toks > 2)
+		{
+			res = false;
+		}
+	}
+
+	if (res == false || msgs != MSGCNT || toks != TOKCNT)
+	{
+		qsctest_print_line("hkdstest_priority_test: weighted scheduling failure! -HPT2");
+		res = false;
+	}
+
+	if (hkds_priority_latency(&pts, hkds_priority_token, 99) == 0 || pts.classes[hkds_priority_message].dequeued != MSGCNT)
+	{
+		qsctest_print_line("hkdstest_priority_test: class metrics failure! -HPT3");
+		res = false;
+	}
+
+	hkds_priority_dispose(&pts);
+
+	return res;
+}
+
+bool hkdstest_admission_test()
+{
+	uint8_t msg[HKDS_CLIENT_MESSAGE_REQUEST_SIZE] = { 0 };
+	uint8_t tok[HKDS_CLIENT_TOKEN_REQUEST_SIZE] = { 0 };
+	uint8_t adm[HKDS_ADMIN_MESSAGE_SIZE] = { 0 };
+	uint8_t ebuf[HKDS_ERROR_MESSAGE_SIZE] = { 0 };
+	hkds_admission_state ads;
+	hkds_error_message err;
+	uint32_t costs[16];
+	uint32_t cost;
+	size_t cnt;
+	bool res;
+
+	res = true;
+	/* SHAKE-256 packets; an authenticated message for a device whose key cache is not held costs 6 units */
+	msg[0] = (uint8_t)packet_message_request;
+	msg[1] = (uint8_t)protocol_shake_256;
+	msg[HKDS_ADMISSION_PID_OFFSET] = HKDS_AUTHENTICATION_KMAC;
+	tok[0] = (uint8_t)packet_token_request;
+	tok[1] = (uint8_t)protocol_shake_256;
+	adm[0] = (uint8_t)packet_administrative_message;
+	qsc_csp_generate(msg + HKDS_HEADER_SIZE + HKDS_KID_SIZE + 1, HKDS_KSN_SIZE - HKDS_KID_SIZE - 1);
+	qsc_memutils_copy(tok + HKDS_HEADER_SIZE, msg + HKDS_HEADER_SIZE, HKDS_KSN_SIZE);
+
+	if (hkds_admission_cost(msg, false) != 6 || hkds_admission_cost(msg, true) != 2 || hkds_admission_cost(tok, false) != HKDS_ADMISSION_COST_TOKEN ||
+		hkds_admission_cost(adm, false) != 0)
+	{
+		qsctest_print_line("hkdstest_admission_test: cost model failure! -HAC1");
+		res = false;
+	}
+
+	/* a 100 microsecond budget at 2 microseconds per unit admits eight messages */
+	hkds_admission_initialize(&ads, 100, 1, 2000);
+	cnt = 0;
+
+	while (cnt < 16 && hkds_admission_admit(&ads, msg, false, &costs[cnt]) == true)
+	{
+		++cnt;
+	}
+
+	/* tokens are shed at half the budget, control packets are always admitted */
+	if (cnt != 8 || hkds_admission_admit(&ads, tok, false, &cost) == true || hkds_admission_admit(&ads, adm, false, &cost) == false ||
+		ads.rejected[hkds_priority_message] != 1 || ads.rejected[hkds_priority_token] != 1)
+	{
+		qsctest_print_line("hkdstest_admission_test: load shedding failure! -HAC2");
+		res = false;
+	}
+
+	/* completed work drains the backlog, and admission resumes */
+	for (size_t i = 0; i < cnt; ++i)
+	{
+		hkds_admission_complete(&ads, costs[i], costs[i] * 2);
+	}
+
+	if (hkds_admission_delay(&ads) != 0 || ads.unit != 2000 || hkds_admission_admit(&ads, tok, false, &cost) == false)
+	{
+		qsctest_print_line("hkdstest_admission_test: backlog accounting failure! -HAC3");
+		res = false;
+	}
+
+	/* the busy message echoes the request sequence, and is matched to the request like any other response */
+	((hkds_wire_header*)msg)->sequence = 0x2A;
+	err = hkds_admission_create_busy(msg);
+	hkds_factory_serialize_error_message(ebuf, &err);
+
+	if (err.header.flag != packet_error_message || err.header.sequence != (uint8_t)error_server_busy ||
+		qsc_intutils_are_equal8(err.message + 1, msg + HKDS_HEADER_SIZE, HKDS_ERROR_SIZE - 1) == false ||
+		hkds_wire_response_sequence(ebuf, sizeof(ebuf)) != 0x2A)
+	{
+		qsctest_print_line("hkdstest_admission_test: busy message failure! -HAC4");
+		res = false;
+	}
+
+	return res;
+}
+
+bool hkdstest_wire_test()
+{
+	uint8_t buf[256] = { 0 };
+	uint8_t ksn[HKDS_KSN_SIZE] = { 0 };
+	uint8_t msg[HKDS_MESSAGE_SIZE] = { 0 };
+	uint8_t tag[HKDS_TAG_SIZE] = { 0 };
+	uint8_t etok[HKDS_ETOK_SIZE] = { 0 };
+	uint8_t adm[HKDS_ADMIN_SIZE] = { 0 };
+	hkds_client_message_request creq;
+	hkds_client_message_request cext;
+	hkds_server_message_token_response mtok;
+	hkds_server_message_token_response mext;
+	hkds_client_token_request treq;
+	hkds_administrative_message amsg;
+	const hkds_wire_client_message* view;
+	hkds_wire_batch batch;
+	size_t offs[3];
+	size_t pos;
+	bool res;
+
+	res = true;
+
+	/* the views have the exact size of the serialized packets */
+	if (sizeof(hkds_wire_header) != HKDS_HEADER_SIZE || sizeof(hkds_wire_client_message) != HKDS_CLIENT_MESSAGE_REQUEST_SIZE ||
+		sizeof(hkds_wire_client_token) != HKDS_CLIENT_TOKEN_REQUEST_SIZE || sizeof(hkds_wire_server_message) != HKDS_SERVER_MESSAGE_RESPONSE_SIZE ||
+		sizeof(hkds_wire_server_token) != HKDS_SERVER_TOKEN_RESPONSE_SIZE || sizeof(hkds_wire_server_message_token) != HKDS_SERVER_MESSAGE_TOKEN_RESPONSE_SIZE ||
+		sizeof(hkds_wire_administrative_message) != HKDS_ADMIN_MESSAGE_SIZE || sizeof(hkds_wire_error_message) != HKDS_ERROR_MESSAGE_SIZE)
+	{
+		qsctest_print_line("hkdstest_wire_test: wire view size failure! -HWT1");
+		res = false;
+	}
+
+	/* the factory writes the header byte by byte, and the packet reads back in place */
+	qsc_csp_generate(ksn, sizeof(ksn));
+	ksn[HKDS_KID_SIZE] = HKDS_AUTHENTICATION_KMAC;
+	qsc_csp_generate(msg, sizeof(msg));
+	qsc_csp_generate(tag, sizeof(tag));
+	qsc_csp_generate(etok, sizeof(etok));
+	creq = hkds_factory_create_client_message_request(msg, ksn, tag, HKDS_SEQUENCE_DEFAULT);
+	hkds_factory_serialize_client_message(buf, &creq);
+	view = hkds_wire_client_message_view(buf, HKDS_CLIENT_MESSAGE_REQUEST_SIZE);
+	cext = hkds_factory_extract_client_message(buf);
+
+	if (view == NULL || buf[0] != (uint8_t)packet_message_request || buf[1] != (uint8_t)HKDS_PROTOCOL_TYPE || buf[3] != HKDS_CLIENT_MESSAGE_REQUEST_SIZE ||
+		qsc_intutils_are_equal8(view->ksn, ksn, HKDS_KSN_SIZE) == false || qsc_intutils_are_equal8(view->tag, tag, HKDS_TAG_SIZE) == false ||
+		cext.header.flag != packet_message_request || cext.header.length != HKDS_CLIENT_MESSAGE_REQUEST_SIZE ||
+		qsc_intutils_are_equal8(cext.message, msg, HKDS_MESSAGE_SIZE) == false || hkds_factory_extract_packet_type(buf) != packet_message_request)
+	{
+		qsctest_print_line("hkdstest_wire_test: client message serialization failure! -HWT2");
+		res = false;
+	}
+
+	mtok = hkds_factory_create_server_message_token_response(msg, etok, HKDS_SEQUENCE_DEFAULT);
+	hkds_factory_serialize_server_message_token(buf, &mtok);
+	mext = hkds_factory_extract_server_message_token(buf);
+
+	if (hkds_wire_validate(buf, HKDS_SERVER_MESSAGE_TOKEN_RESPONSE_SIZE) == false || mext.header.flag != packet_message_token_response ||
+		hkds_factory_extract_packet_size(buf) != HKDS_SERVER_MESSAGE_TOKEN_RESPONSE_SIZE ||
+		qsc_intutils_are_equal8(mext.etok, etok, HKDS_ETOK_SIZE) == false || qsc_intutils_are_equal8(buf + HKDS_HEADER_SIZE, msg, HKDS_MESSAGE_SIZE) == false)
+	{
+		qsctest_print_line("hkdstest_wire_test: message token serialization failure! -HWT3");
+		res = false;
+	}
+
+	/* a receive buffer holding two messages, a token request, an administrative message,
+	   a packet with the wrong protocol, and the start of an incomplete packet */
+	treq = hkds_factory_create_client_token_request(ksn, HKDS_SEQUENCE_DEFAULT);
+	amsg = hkds_factory_create_administrative_message(adm);
+	pos = 0;
+	offs[0] = pos;
+	hkds_factory_serialize_client_message(buf + pos, &creq);
+	pos += HKDS_CLIENT_MESSAGE_REQUEST_SIZE;
+	offs[1] = pos;
+	hkds_factory_serialize_client_token(buf + pos, &treq);
+	pos += HKDS_CLIENT_TOKEN_REQUEST_SIZE;
+	hkds_factory_serialize_administrative_message(buf + pos, &amsg);
+	pos += HKDS_ADMIN_MESSAGE_SIZE;
+	hkds_factory_serialize_client_message(buf + pos, &creq);
+	buf[pos + 1] ^= 0x07;
+	pos += HKDS_CLIENT_MESSAGE_REQUEST_SIZE;
+	offs[2] = pos;
+	/* an unauthenticated client, the tag is not recorded */
+	creq.ksn[HKDS_KID_SIZE] = 0x10;
+	hkds_factory_serialize_client_message(buf + pos, &creq);
+	pos += HKDS_CLIENT_MESSAGE_REQUEST_SIZE;
+	hkds_factory_serialize_client_token(buf + pos, &treq);
+
+	if (hkds_wire_parse_batch(&batch, buf, pos + (HKDS_CLIENT_TOKEN_REQUEST_SIZE / 2)) != pos || batch.count != 3 || batch.rejected != 2 ||
+		batch.ksn[0] != buf + offs[0] + HKDS_HEADER_SIZE || batch.tag[0] != buf + offs[0] + HKDS_HEADER_SIZE + HKDS_KSN_SIZE + HKDS_MESSAGE_SIZE ||
+		batch.type[1] != packet_token_request || batch.message[1] != NULL || batch.ksn[1] != buf + offs[1] + HKDS_HEADER_SIZE ||
+		batch.packet[2] != buf + offs[2] || batch.tag[2] != NULL || batch.message[2] != buf + offs[2] + HKDS_HEADER_SIZE + HKDS_KSN_SIZE)
+	{
+		qsctest_print_line("hkdstest_wire_test: batch parser failure! -HWT4");
+		res = false;
+	}
+
+	return res;
+}
+
+bool hkdstest_response_test()
+{
+	uint8_t cbuf[HKDS_RESPONSE_BUFFER_SIZE] = { 0 };
+	uint8_t vbuf[HKDS_RESPONSE_BUFFER_SIZE] = { 0 };
+	uint8_t exp[HKDS_RESPONSE_BUFFER_SIZE] = { 0 };
+	uint8_t out[HKDS_RESPONSE_BUFFER_SIZE] = { 0 };
+	uint8_t ksn[HKDS_KSN_SIZE] = { 0 };
+	uint8_t emsg[HKDS_ERROR_SIZE] = { 0 };
+	hkds_async_completion cmp[8] = { 0 };
+	hkds_response_batch cbat;
+	hkds_response_batch vbat;
+	hkds_server_message_response mrsp;
+	hkds_server_token_response trsp;
+	hkds_error_message ersp;
+	size_t clen;
+	size_t i;
+	size_t pos;
+	size_t vlen;
+	bool res;
+
+	res = true;
+	qsc_csp_generate(ksn, sizeof(ksn));
+	/* an error message carries the request sequence, then the leading bytes of the KSN */
+	qsc_memutils_copy(emsg + 1, ksn, HKDS_ERROR_SIZE - 1);
+
+	/* messages, tokens, and two adjacent authentication failures */
+	for (i = 0; i < 8; ++i)
+	{
+		qsc_csp_generate(cmp[i].output, sizeof(cmp[i].output));
+		cmp[i].operation = (i % 3 == 1) ? hkds_async_encrypt_token : hkds_async_decrypt;
+		cmp[i].status = (i != 5 && i != 6);
+	}
+
+	hkds_response_initialize(&cbat, cbuf, sizeof(cbuf), hkds_response_contiguous);
+	hkds_response_initialize(&vbat, vbuf, sizeof(vbuf), hkds_response_vectored);
+	pos = 0;
+
+	for (i = 0; i < 8; ++i)
+	{
+		if (hkds_response_add_completion(&cbat, &cmp[i], ksn, (uint8_t)(i + 1)) == false || hkds_response_add_completion(&vbat, &cmp[i], ksn, (uint8_t)(i + 1)) == false)
+		{
+			qsctest_print_line("hkdstest_response_test: add completion failure! -HRT1");
+			res = false;
+			break;
+		}
+
+		/* the expected stream, built one response at a time with the factory */
+		if (cmp[i].status == false)
+		{
+			emsg[0] = (uint8_t)(i + 1);
+			ersp = hkds_factory_create_error_message(emsg, error_general_failure);
+			hkds_factory_serialize_error_message(exp + pos, &ersp);
+			pos += HKDS_ERROR_MESSAGE_SIZE;
+		}
+		else if (cmp[i].operation == hkds_async_encrypt_token)
+		{
+			trsp = hkds_factory_create_server_token_reponse(cmp[i].output, (uint8_t)(i + 1));
+			hkds_factory_serialize_server_token(exp + pos, &trsp);
+			pos += HKDS_SERVER_TOKEN_RESPONSE_SIZE;
+		}
+		else
+		{
+			mrsp = hkds_factory_create_server_message_response(cmp[i].output, (uint8_t)(i + 1));
+			hkds_factory_serialize_server_message(exp + pos, &mrsp);
+			pos += HKDS_SERVER_MESSAGE_RESPONSE_SIZE;
+		}
+	}
+
+	/* both framings produce the same packet stream as the factory */
+	clen = hkds_response_serialize(&cbat, out, sizeof(out));
+
+	if (res == true && (clen != pos || cbat.size != pos || qsc_intutils_are_equal8(out, exp, pos) == false))
+	{
+		qsctest_print_line("hkdstest_response_test: contiguous batch failure! -HRT2");
+		res = false;
+	}
+
+	qsc_memutils_clear(out, sizeof(out));
+	vlen = hkds_response_serialize(&vbat, out, sizeof(out));
+
+	/* six headers and payloads, the two error packets and the header that follows them share one buffer */
+	if (res == true && (vlen != pos || vbat.vcount != 12 || vbat.length != (6 * HKDS_HEADER_SIZE) + (2 * HKDS_ERROR_MESSAGE_SIZE) ||
+		qsc_intutils_are_equal8(out, exp, pos) == false))
+	{
+		qsctest_print_line("hkdstest_response_test: vectored batch failure! -HRT3");
+		res = false;
+	}
+
+	/* the stream is split by the header length of each packet */
+	pos = 0;
+
+	for (i = 0; i < 8; ++i)
+	{
+		if (hkds_wire_validate(out + pos, vlen - pos) == false)
+		{
+			qsctest_print_line("hkdstest_response_test: packet framing failure! -HRT4");
+			res = false;
+			break;
+		}
+
+		pos += hkds_factory_extract_packet_size(out + pos);
+	}
+
+	if (res == true && pos != vlen)
+	{
+		qsctest_print_line("hkdstest_response_test: packet framing failure! -HRT5");
+		res = false;
+	}
+
+	/* a full batch rejects further responses */
+	hkds_response_reset(&cbat);
+
+	for (i = 0; i < HKDS_RESPONSE_BATCH_MAX; ++i)
+	{
+		if (hkds_response_add_token(&cbat, cmp[1].output, HKDS_SEQUENCE_DEFAULT) == false)
+		{
+			break;
+		}
+	}
+
+	if (i != HKDS_RESPONSE_BATCH_MAX || hkds_response_add_message(&cbat, cmp[0].output, HKDS_SEQUENCE_DEFAULT) == true || cbat.length != HKDS_RESPONSE_BUFFER_SIZE)
+	{
+		qsctest_print_line("hkdstest_response_test: batch limit failure! -HRT6");
+		res = false;
+	}
+
+	return res;
+}
+
+static bool hkdstest_network_overflow()
+{
+	const size_t TOKCNT = HKDS_WIRE_BATCH_MAX - 4;
+	const size_t ADMCNT = 8;
+	const uint8_t kid[HKDS_KID_SIZE] = { 0x01, 0x02, 0x03, 0x04 };
+	uint8_t adm[HKDS_ADMIN_SIZE] = { 0 };
+	uint8_t ksn[HKDS_KSN_SIZE] = { 0 };
+	uint8_t ibuf[(HKDS_WIRE_BATCH_MAX * HKDS_CLIENT_TOKEN_REQUEST_SIZE) + (8 * HKDS_ADMIN_MESSAGE_SIZE)] = { 0 };
+	uint8_t obuf[HKDS_RESPONSE_BUFFER_SIZE] = { 0 };
+	hkds_network_state ns = { 0 };
+	hkds_master_key mdk;
+	hkds_client_token_request treq;
+	hkds_administrative_message amsg;
+	hkds_response_batch rsp;
+	size_t len;
+	size_t pos;
+	size_t used;
+	bool res;
+
+	res = true;
+	hkds_server_generate_mdk(&qsc_csp_generate, &mdk, kid);
+	qsc_csp_generate(ksn, sizeof(ksn));
+	ns.mdk = &mdk;
+	treq = hkds_factory_create_client_token_request(ksn, HKDS_SEQUENCE_DEFAULT);
+	amsg = hkds_factory_create_administrative_message(adm);
+	len = 0;
+
+	/* a full batch of token requests less four, followed by more packets that are rejected than fit in the rest of the batch */
+	for (size_t i = 0; i < TOKCNT; ++i)
+	{
+		hkds_factory_serialize_client_token(ibuf + len, &treq);
+		len += HKDS_CLIENT_TOKEN_REQUEST_SIZE;
+	}
+
+	for (size_t i = 0; i < ADMCNT; ++i)
+	{
+		hkds_factory_serialize_administrative_message(ibuf + len, &amsg);
+		len += HKDS_ADMIN_MESSAGE_SIZE;
+	}
+
+	hkds_factory_serialize_client_token(ibuf + len, &treq);
+	len += HKDS_CLIENT_TOKEN_REQUEST_SIZE;
+
+	/* processing stops where the errors would overflow the batch, and the remainder is answered by the next call */
+	hkds_response_initialize(&rsp, obuf, sizeof(obuf), hkds_response_contiguous);
+	pos = hkds_network_process(&ns, ibuf, len, &rsp);
+
+	if (pos != (TOKCNT * HKDS_CLIENT_TOKEN_REQUEST_SIZE) + (4 * HKDS_ADMIN_MESSAGE_SIZE) || rsp.count != HKDS_WIRE_BATCH_MAX)
+	{
+		qsctest_print_line("hkdstest_network_test: rejected packet overflow failure! -HNT11");
+		res = false;
+	}
+
+	hkds_response_initialize(&rsp, obuf, sizeof(obuf), hkds_response_contiguous);
+	used = hkds_network_process(&ns, ibuf + pos, len - pos, &rsp);
+
+	if (res == true && (pos + used != len || rsp.count != (ADMCNT - 4) + 1 ||
+		qsc_atomics_load64(&ns.requests) != TOKCNT + 1 || qsc_atomics_load64(&ns.rejected) != ADMCNT))
+	{
+		qsctest_print_line("hkdstest_network_test: rejected packet resume failure! -HNT12");
+		res = false;
+	}
+
+	return res;
+}
+
+static bool hkdstest_network_backend(qsc_reactor_backends backend, size_t listeners)
+{
+	const size_t DEVCNT = 8;
+	const size_t MSGCNT = 4;
+	const uint16_t PORT = 38401;
+	const uint8_t kid[HKDS_KID_SIZE] = { 0x01, 0x02, 0x03, 0x04 };
+	uint8_t did[HKDS_DID_SIZE] = { 0x01, 0x02, 0x03, 0x04, 0x10, HKDSTEST_PRF_MODE, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00 };
+	uint8_t edk[HKDS_EDK_SIZE] = { 0 };
+	uint8_t tokd[HKDS_STK_SIZE] = { 0 };
+	uint8_t etok[HKDS_ETOK_SIZE] = { 0 };
+	uint8_t ctxt[HKDS_MESSAGE_SIZE + HKDS_TAG_SIZE] = { 0 };
+	uint8_t ksn[HKDS_KSN_SIZE] = { 0 };
+	uint8_t ptxt[4][HKDS_MESSAGE_SIZE] = { 0 };
+	uint8_t obuf[HKDS_RESPONSE_BUFFER_SIZE] = { 0 };
+	uint8_t ibuf[HKDS_RESPONSE_BUFFER_SIZE] = { 0 };
+	hkds_client_state cs[8];
+	qsc_socket socks[8];
+	hkds_master_key mdk;
+	hkds_network_state ns;
+	hkds_server_state ss;
+	hkds_client_message_request creq;
+	hkds_client_token_request treq;
+	hkds_client_message_request bad;
+	size_t active;
+	size_t exlen;
+	size_t ipos;
+	size_t opos;
+	size_t wait;
+	bool res;
+
+	res = true;
+	hkds_server_generate_mdk(&qsc_csp_generate, &mdk, kid);
+
+	/* two of the devices authenticate their messages */
+	for (size_t i = 0; i < DEVCNT; ++i)
+	{
+		did[HKDS_KID_SIZE] = (i < 2) ? HKDS_AUTHENTICATION_KMAC : 0x10;
+		did[HKDS_DID_SIZE - 1] = (uint8_t)i;
+		hkds_server_generate_edk(mdk.bdk, did, edk);
+		hkds_client_initialize_state(&cs[i], edk, did);
+		hkds_server_initialize_state(&ss, &mdk, cs[i].ksn);
+		hkds_server_encrypt_token(&ss, etok);
+		hkds_client_decrypt_token(&cs[i], etok, tokd);
+		hkds_client_generate_cache(&cs[i], tokd);
+	}
+
+	if (hkds_network_start(&ns, &mdk, "127.0.0.1", PORT, qsc_socket_address_family_ipv4, listeners, (listeners > 1) ? 1 : 2, 64, backend) == false)
+	{
+		qsctest_print_line("hkdstest_network_test: server start failure! -HNT1");
+		return false;
+	}
+
+	for (size_t i = 0; i < DEVCNT; ++i)
+	{
+		qsc_memutils_clear((uint8_t*)&socks[i], sizeof(qsc_socket));
+
+		if (qsc_socket_create(&socks[i], qsc_socket_address_family_ipv4, qsc_socket_transport_stream, qsc_socket_protocol_tcp) != qsc_socket_exception_success ||
+			qsc_socket_connect(&socks[i], "127.0.0.1", PORT) != qsc_socket_exception_success)
+		{
+			qsctest_print_line("hkdstest_network_test: client connect failure! -HNT2");
+			res = false;
+		}
+	}
+
+	/* every terminal writes its requests in one segment, then reads the responses in order */
+	for (size_t i = 0; i < DEVCNT && res == true; ++i)
+	{
+		opos = 0;
+		exlen = (MSGCNT * HKDS_SERVER_MESSAGE_RESPONSE_SIZE) + HKDS_SERVER_TOKEN_RESPONSE_SIZE;
+
+		for (size_t j = 0; j < MSGCNT; ++j)
+		{
+			/* the request carries the counter used to encrypt it */
+			qsc_csp_generate(ptxt[j], HKDS_MESSAGE_SIZE);
+			qsc_memutils_clear(ctxt, sizeof(ctxt));
+			qsc_memutils_copy(ksn, cs[i].ksn, HKDS_KSN_SIZE);
+
+			if (i < 2)
+			{
+				hkds_client_encrypt_authenticate_message(&cs[i], ptxt[j], NULL, 0, ctxt);
+			}
+			else
+			{
+				hkds_client_encrypt_message(&cs[i], ptxt[j], ctxt);
+			}
+
+			creq = hkds_factory_create_client_message_request(ctxt, ksn, ctxt + HKDS_MESSAGE_SIZE, HKDS_SEQUENCE_DEFAULT);
+			hkds_factory_serialize_client_message(obuf + opos, &creq);
+			opos += HKDS_CLIENT_MESSAGE_REQUEST_SIZE;
+		}
+
+		treq = hkds_factory_create_client_token_request(cs[i].ksn, HKDS_SEQUENCE_DEFAULT);
+		hkds_factory_serialize_client_token(obuf + opos, &treq);
+		opos += HKDS_CLIENT_TOKEN_REQUEST_SIZE;
+
+		if (qsc_socket_send_all(&socks[i], obuf, opos, qsc_socket_send_flag_none) != opos ||
+			qsc_socket_receive_all(&socks[i], ibuf, exlen, qsc_socket_receive_flag_none) != exlen)
+		{
+			qsctest_print_line("hkdstest_network_test: client transfer failure! -HNT3");
+			res = false;
+			break;
+		}
+
+		ipos = 0;
+
+		for (size_t j = 0; j < MSGCNT; ++j)
+		{
+			if (hkds_factory_extract_packet_type(ibuf + ipos) != packet_message_response ||
+				qsc_intutils_are_equal8(ibuf + ipos + HKDS_HEADER_SIZE, ptxt[j], HKDS_MESSAGE_SIZE) == false)
+			{
+				qsctest_print_line("hkdstest_network_test: message response failure! -HNT4");
+				res = false;
+			}
+
+			ipos += HKDS_SERVER_MESSAGE_RESPONSE_SIZE;
+		}
+
+		hkds_server_initialize_state(&ss, &mdk, cs[i].ksn);
+		hkds_server_encrypt_token(&ss, etok);
+
+		if (hkds_factory_extract_packet_type(ibuf + ipos) != packet_token_response ||
+			qsc_intutils_are_equal8(ibuf + ipos + HKDS_HEADER_SIZE, etok, HKDS_ETOK_SIZE) == false)
+		{
+			qsctest_print_line("hkdstest_network_test: token response failure! -HNT5");
+			res = false;
+		}
+	}
+
+	if (res == true && hkds_network_connections(&ns) != DEVCNT)
+	{
+		qsctest_print_line("hkdstest_network_test: connection count failure! -HNT6");
+		res = false;
+	}
+
+	/* the connections hold no pooled buffers once their responses have been sent */
+	wait = 0;
+	active = 1;
+
+	while (res == true && active != 0 && wait < 100)
+	{
+		active = 0;
+
+		for (size_t i = 0; i < ns.count; ++i)
+		{
+			active += qsc_bufferpool_capacity(&ns.reactors[i].pool) - qsc_bufferpool_available(&ns.reactors[i].pool);
+		}
+
+		if (active != 0)
+		{
+			qsc_async_thread_sleep(10);
+			++wait;
+		}
+	}
+
+	if (res == true && active != 0)
+	{
+		qsctest_print_line("hkdstest_network_test: buffer release failure! -HNT10");
+		res = false;
+	}
+
+	/* the kernel distributes the connections between the listeners */
+	if (res == true && listeners > 1)
+	{
+		active = 0;
+
+		for (size_t i = 0; i < ns.count; ++i)
+		{
+			active += (qsc_reactor_connections(&ns.reactors[i]) != 0) ? 1 : 0;
+		}
+
+		if (ns.count != listeners || active < 2)
+		{
+			qsctest_print_line("hkdstest_network_test: listener distribution failure! -HNT9");
+			res = false;
+		}
+	}
+
+	/* a packet with the wrong protocol is answered with an error */
+	if (res == true)
+	{
+		bad = hkds_factory_create_client_message_request(ctxt, cs[2].ksn, ctxt + HKDS_MESSAGE_SIZE, HKDS_SEQUENCE_DEFAULT);
+		hkds_factory_serialize_client_message(obuf, &bad);
+		obuf[1] ^= 0x07;
+
+		if (qsc_socket_send_all(&socks[2], obuf, HKDS_CLIENT_MESSAGE_REQUEST_SIZE, qsc_socket_send_flag_none) != HKDS_CLIENT_MESSAGE_REQUEST_SIZE ||
+			qsc_socket_receive_all(&socks[2], ibuf, HKDS_ERROR_MESSAGE_SIZE, qsc_socket_receive_flag_none) != HKDS_ERROR_MESSAGE_SIZE ||
+			hkds_factory_extract_packet_type(ibuf) != packet_error_message || ibuf[2] != (uint8_t)error_invalid_format)
+		{
+			qsctest_print_line("hkdstest_network_test: invalid packet failure! -HNT7");
+			res = false;
+		}
+	}
+
+	for (size_t i = 0; i < DEVCNT; ++i)
+	{
+		qsc_socket_close_socket(&socks[i]);
+	}
+
+	/* the event loops release the closed connections */
+	wait = 0;
+
+	while (hkds_network_connections(&ns) != 0 && wait < 200)
+	{
+		qsc_async_thread_sleep(10);
+		++wait;
+	}
+
+	if (res == true && (hkds_network_connections(&ns) != 0 || qsc_atomics_load64(&ns.requests) != DEVCNT * (MSGCNT + 1)))
+	{
+		qsctest_print_line("hkdstest_network_test: connection release failure! -HNT8");
+		res = false;
+	}
+
+	hkds_network_stop(&ns);
+
+	return res;
+}
+
+bool hkdstest_network_test()
+{
+	bool res;
+
+	/* the automatic selection uses io_uring where the kernel supports it */
+	res = hkdstest_network_backend(qsc_reactor_backend_epoll, 1);
+	res = (res == true) ? hkdstest_network_backend(qsc_reactor_backend_auto, 1) : false;
+	/* four listeners on the same port, each with its own reactor */
+	res = (res == true) ? hkdstest_network_backend(qsc_reactor_backend_auto, 4) : false;
+	/* the rejected packets in a receive are answered across batches, none are dropped */
+	res = (res == true) ? hkdstest_network_overflow() : false;
+
+	return res;
+}
+
+bool hkdstest_udp_test()
+{
+	const size_t DEVCNT = 8;
+	const uint16_t PORT = 38402;
+	const uint8_t kid[HKDS_KID_SIZE] = { 0x01, 0x02, 0x03, 0x04 };
+	uint8_t did[HKDS_DID_SIZE] = { 0x01, 0x02, 0x03, 0x04, 0x10, HKDSTEST_PRF_MODE, 0x01, 0x00, 0x02, 0x00, 0x00, 0x00 };
+	uint8_t edk[HKDS_EDK_SIZE] = { 0 };
+	uint8_t tokd[HKDS_STK_SIZE] = { 0 };
+	uint8_t etok[HKDS_ETOK_SIZE] = { 0 };
+	uint8_t ctxt[HKDS_MESSAGE_SIZE + HKDS_TAG_SIZE] = { 0 };
+	uint8_t ksn[HKDS_KSN_SIZE] = { 0 };
+	uint8_t ptxt[8][HKDS_MESSAGE_SIZE] = { 0 };
+	uint8_t obuf[8][HKDS_UDP_DATAGRAM_SIZE] = { 0 };
+	uint8_t ibuf[8][HKDS_RESPONSE_BUFFER_SIZE] = { 0 };
+	uint8_t rsp1[HKDS_RESPONSE_BUFFER_SIZE] = { 0 };
+	uint8_t rsp2[HKDS_RESPONSE_BUFFER_SIZE] = { 0 };
+	qsc_socket_datagram sgrams[8];
+	qsc_socket_datagram rgrams[8];
+	hkds_client_state cs[8];
+	hkds_master_key mdk;
+	hkds_server_state ss;
+	hkds_tokencache_state tc;
+	hkds_udp_state us;
+	hkds_client_message_request creq;
+	hkds_client_token_request treq;
+	struct timeval tv;
+	qsc_socket sock;
+	size_t len;
+	size_t plen;
+	size_t rcnt;
+	size_t wait;
+	bool res;
+
+	res = true;
+	hkds_server_generate_mdk(&qsc_csp_generate, &mdk, kid);
+
+	for (size_t i = 0; i < DEVCNT; ++i)
+	{
+		did[HKDS_KID_SIZE] = (i < 2) ? HKDS_AUTHENTICATION_KMAC : 0x10;
+		did[HKDS_DID_SIZE - 1] = (uint8_t)i;
+		hkds_server_generate_edk(mdk.bdk, did, edk);
+		hkds_client_initialize_state(&cs[i], edk, did);
+		hkds_server_initialize_state(&ss, &mdk, cs[i].ksn);
+		hkds_server_encrypt_token(&ss, etok);
+		hkds_client_decrypt_token(&cs[i], etok, tokd);
+		hkds_client_generate_cache(&cs[i], tokd);
+	}
+
+	if (hkds_tokencache_initialize(&tc, 64, 0) == false ||
+		hkds_udp_start(&us, &mdk, &tc, "127.0.0.1", PORT, qsc_socket_address_family_ipv4) == false)
+	{
+		qsctest_print_line("hkdstest_udp_test: server start failure! -HUT1");
+		return false;
+	}
+
+	if (hkds_udp_client_open(&sock, "127.0.0.1", PORT, qsc_socket_address_family_ipv4) == false)
+	{
+		qsctest_print_line("hkdstest_udp_test: client open failure! -HUT2");
+		hkds_udp_stop(&us);
+		hkds_tokencache_dispose(&tc);
+		return false;
+	}
+
+	/* one message request from each device, sent in a single batched call */
+	for (size_t i = 0; i < DEVCNT; ++i)
+	{
+		qsc_csp_generate(ptxt[i], HKDS_MESSAGE_SIZE);
+		qsc_memutils_clear(ctxt, sizeof(ctxt));
+		qsc_memutils_copy(ksn, cs[i].ksn, HKDS_KSN_SIZE);
+
+		if (i < 2)
+		{
+			hkds_client_encrypt_authenticate_message(&cs[i], ptxt[i], NULL, 0, ctxt);
+		}
+		else
+		{
+			hkds_client_encrypt_message(&cs[i], ptxt[i], ctxt);
+		}
+
+		creq = hkds_factory_create_client_message_request(ctxt, ksn, ctxt + HKDS_MESSAGE_SIZE, HKDS_SEQUENCE_DEFAULT);
+		hkds_factory_serialize_client_message(obuf[i], &creq);
+		qsc_memutils_clear(&sgrams[i], sizeof(qsc_socket_datagram));
+		sgrams[i].data = obuf[i];
+		sgrams[i].length = HKDS_CLIENT_MESSAGE_REQUEST_SIZE;
+		qsc_memutils_clear(&rgrams[i], sizeof(qsc_socket_datagram));
+		rgrams[i].data = ibuf[i];
+		rgrams[i].capacity = HKDS_RESPONSE_BUFFER_SIZE;
+	}
+
+	if (qsc_socket_send_batch(&sock, sgrams, DEVCNT, qsc_socket_send_flag_none) != DEVCNT)
+	{
+		qsctest_print_line("hkdstest_udp_test: batch send failure! -HUT3");
+		res = false;
+	}
+
+	/* the responses arrive in request order on the loopback interface */
+	rcnt = 0;
+	wait = 0;
+
+	while (res == true && rcnt < DEVCNT && wait < 20)
+	{
+		tv.tv_sec = 0;
+		tv.tv_usec = 100000;
+
+		if (qsc_socket_receive_ready(&sock, &tv) == true)
+		{
+			rcnt += qsc_socket_receive_batch(&sock, rgrams + rcnt, DEVCNT - rcnt, qsc_socket_receive_flag_none);
+		}
+
+		++wait;
+	}
+
+	for (size_t i = 0; i < rcnt; ++i)
+	{
+		if (rgrams[i].length != HKDS_SERVER_MESSAGE_RESPONSE_SIZE || hkds_factory_extract_packet_type(ibuf[i]) != packet_message_response ||
+			qsc_intutils_are_equal8(ibuf[i] + HKDS_HEADER_SIZE, ptxt[i], HKDS_MESSAGE_SIZE) == false)
+		{
+			qsctest_print_line("hkdstest_udp_test: message response failure! -HUT4");
+			res = false;
+			break;
+		}
+	}
+
+	if (rcnt != DEVCNT)
+	{
+		qsctest_print_line("hkdstest_udp_test: batch receive failure! -HUT5");
+		res = false;
+	}
+
+	/* a repeated token request receives the same token, the second from the cache */
+	if (res == true)
+	{
+		treq = hkds_factory_create_client_token_request(cs[3].ksn, HKDS_SEQUENCE_DEFAULT);
+		hkds_factory_serialize_client_token(obuf[0], &treq);
+		/* the token request is padded to the size of its response */
+		plen = hkds_udp_client_pad(obuf[0], HKDS_CLIENT_TOKEN_REQUEST_SIZE, HKDS_SERVER_TOKEN_RESPONSE_SIZE);
+		len = hkds_udp_client_transact(&sock, obuf[0], plen, rsp1, sizeof(rsp1), 500, 3);
+
+		if (len != HKDS_SERVER_TOKEN_RESPONSE_SIZE ||
+			hkds_udp_client_transact(&sock, obuf[0], plen, rsp2, sizeof(rsp2), 500, 3) != len ||
+			qsc_intutils_are_equal8(rsp1, rsp2, len) == false || qsc_atomics_load64(&tc.hits) == 0)
+		{
+			qsctest_print_line("hkdstest_udp_test: repeated token failure! -HUT6");
+			res = false;
+		}
+
+		hkds_server_initialize_state(&ss, &mdk, cs[3].ksn);
+		hkds_server_encrypt_token(&ss, etok);
+
+		if (qsc_intutils_are_equal8(rsp1 + HKDS_HEADER_SIZE, etok, HKDS_ETOK_SIZE) == false)
+		{
+			qsctest_print_line("hkdstest_udp_test: token response failure! -HUT7");
+			res = false;
+		}
+	}
+
+	/* a datagram with a message, a token request and a malformed packet is answered with three responses in order */
+	if (res == true)
+	{
+		qsc_csp_generate(ptxt[0], HKDS_MESSAGE_SIZE);
+		qsc_memutils_copy(ksn, cs[4].ksn, HKDS_KSN_SIZE);
+		hkds_client_encrypt_message(&cs[4], ptxt[0], ctxt);
+		creq = hkds_factory_create_client_message_request(ctxt, ksn, NULL, HKDS_SEQUENCE_DEFAULT);
+		hkds_factory_serialize_client_message(obuf[0], &creq);
+		treq = hkds_factory_create_client_token_request(cs[4].ksn, HKDS_SEQUENCE_DEFAULT);
+		hkds_factory_serialize_client_token(obuf[0] + HKDS_CLIENT_MESSAGE_REQUEST_SIZE, &treq);
+		len = HKDS_CLIENT_MESSAGE_REQUEST_SIZE + HKDS_CLIENT_TOKEN_REQUEST_SIZE;
+		qsc_memutils_copy(obuf[0] + len, obuf[0], HKDS_CLIENT_MESSAGE_REQUEST_SIZE);
+		obuf[0][len + 1] ^= 0x07;
+		len += HKDS_CLIENT_MESSAGE_REQUEST_SIZE;
+
+		if (hkds_udp_client_transact(&sock, obuf[0], len, rsp1, sizeof(rsp1), 500, 3) !=
+			HKDS_SERVER_MESSAGE_RESPONSE_SIZE + HKDS_SERVER_TOKEN_RESPONSE_SIZE + HKDS_ERROR_MESSAGE_SIZE ||
+			qsc_intutils_are_equal8(rsp1 + HKDS_HEADER_SIZE, ptxt[0], HKDS_MESSAGE_SIZE) == false ||
+			hkds_factory_extract_packet_type(rsp1 + HKDS_SERVER_MESSAGE_RESPONSE_SIZE) != packet_token_response ||
+			hkds_factory_extract_packet_type(rsp1 + HKDS_SERVER_MESSAGE_RESPONSE_SIZE + HKDS_SERVER_TOKEN_RESPONSE_SIZE) != packet_error_message)
+		{
+			qsctest_print_line("hkdstest_udp_test: mixed datagram failure! -HUT8");
+			res = false;
+		}
+	}
+
+	/* unpadded token requests are refused, and the response is no larger than the request */
+	if (res == true)
+	{
+		for (size_t i = 0; i < DEVCNT; ++i)
+		{
+			treq = hkds_factory_create_client_token_request(cs[i].ksn, (uint8_t)i);
+			hkds_factory_serialize_client_token(obuf[0] + (i * HKDS_CLIENT_TOKEN_REQUEST_SIZE), &treq);
+		}
+
+		len = DEVCNT * HKDS_CLIENT_TOKEN_REQUEST_SIZE;
+		plen = hkds_udp_client_transact(&sock, obuf[0], len, rsp1, sizeof(rsp1), 500, 3);
+
+		if (plen == 0 || plen > len)
+		{
+			qsctest_print_line("hkdstest_udp_test: amplification failure! -HUT9");
+			res = false;
+		}
+
+		for (size_t i = 0; res == true && i < DEVCNT; ++i)
+		{
+			if (hkds_factory_extract_packet_type(rsp1 + (i * HKDS_ERROR_MESSAGE_SIZE)) != packet_error_message ||
+				rsp1[(i * HKDS_ERROR_MESSAGE_SIZE) + 2] != (uint8_t)error_invalid_format ||
+				rsp1[(i * HKDS_ERROR_MESSAGE_SIZE) + HKDS_HEADER_SIZE] != (uint8_t)i)
+			{
+				qsctest_print_line("hkdstest_udp_test: refused token failure! -HUT10");
+				res = false;
+			}
+		}
+	}
+
+	qsc_socket_close_socket(&sock);
+	hkds_udp_stop(&us);
+
+	if (res == true && (qsc_atomics_load64(&us.requests) != DEVCNT + 4 || qsc_atomics_load64(&us.rejected) != DEVCNT + 1))
+	{
+		qsctest_print_line("hkdstest_udp_test: request count failure! -HUT11");
+		res = false;
+	}
+
+	hkds_tokencache_dispose(&tc);
+
+	return res;
+}
+
+bool hkdstest_pipeline_test()
+{
+	const size_t DEVCNT = 8;
+	const size_t MSGCNT = 4;
+	const uint16_t PORT = 38403;
+	const uint8_t kid[HKDS_KID_SIZE] = { 0x01, 0x02, 0x03, 0x04 };
+	uint8_t did[HKDS_DID_SIZE] = { 0x01, 0x02, 0x03, 0x04, 0x10, HKDSTEST_PRF_MODE, 0x01, 0x00, 0x03, 0x00, 0x00, 0x00 };
+	uint8_t edk[HKDS_EDK_SIZE] = { 0 };
+	uint8_t tokd[HKDS_STK_SIZE] = { 0 };
+	uint8_t etok[HKDS_ETOK_SIZE] = { 0 };
+	uint8_t ctxt[HKDS_MESSAGE_SIZE + HKDS_TAG_SIZE] = { 0 };
+	uint8_t ksn[HKDS_KSN_SIZE] = { 0 };
+	uint8_t ptxt[8][4][HKDS_MESSAGE_SIZE] = { 0 };
+	uint8_t obuf[8 * ((4 * HKDS_CLIENT_MESSAGE_REQUEST_SIZE) + HKDS_CLIENT_TOKEN_REQUEST_SIZE) + HKDS_CLIENT_MESSAGE_REQUEST_SIZE] = { 0 };
+	uint8_t ibuf[HKDS_SERVER_TOKEN_RESPONSE_SIZE] = { 0 };
+	hkds_client_state cs[8];
+	hkds_master_key mdk;
+	hkds_network_state ns;
+	hkds_pipeline_entry ent;
+	hkds_pipeline_state pls;
+	hkds_server_state ss;
+	hkds_client_message_request creq;
+	hkds_client_token_request treq;
+	qsc_socket sock;
+	size_t dev;
+	size_t errs;
+	size_t opos;
+	size_t plen;
+	size_t rcnt;
+	uint64_t last;
+	uint8_t seq;
+	bool ooo;
+	bool res;
+
+	res = true;
+	hkds_server_generate_mdk(&qsc_csp_generate, &mdk, kid);
+	hkds_pipeline_initialize(&pls);
+
+	/* the pipeline assigns every sequence but the reserved one, then refuses a request */
+	for (size_t i = 0; i < HKDS_PIPELINE_DEPTH; ++i)
+	{
+		if (hkds_pipeline_issue(&pls, ksn, packet_token_request, i, &seq) == false || seq == HKDS_SEQUENCE_NONE)
+		{
+			res = false;
+			break;
+		}
+	}
+
+	if (res == false || hkds_pipeline_issue(&pls, ksn, packet_token_request, 0, &seq) == true ||
+		hkds_pipeline_outstanding(&pls) != HKDS_PIPELINE_DEPTH)
+	{
+		qsctest_print_line("hkdstest_pipeline_test: sequence assignment failure! -HPT1");
+		return false;
+	}
+
+	hkds_pipeline_initialize(&pls);
+
+	for (size_t i = 0; i < DEVCNT; ++i)
+	{
+		did[HKDS_KID_SIZE] = (i < 2) ? HKDS_AUTHENTICATION_KMAC : 0x10;
+		did[HKDS_DID_SIZE - 1] = (uint8_t)i;
+		hkds_server_generate_edk(mdk.bdk, did, edk);
+		hkds_client_initialize_state(&cs[i], edk, did);
+		hkds_server_initialize_state(&ss, &mdk, cs[i].ksn);
+		hkds_server_encrypt_token(&ss, etok);
+		hkds_client_decrypt_token(&cs[i], etok, tokd);
+		hkds_client_generate_cache(&cs[i], tokd);
+	}
+
+	if (hkds_network_start(&ns, &mdk, "127.0.0.1", PORT, qsc_socket_address_family_ipv4, 1, 1, 8, qsc_reactor_backend_auto) == false)
+	{
+		qsctest_print_line("hkdstest_pipeline_test: server start failure! -HPT2");
+		return false;
+	}
+
+	qsc_memutils_clear(&sock, sizeof(qsc_socket));
+
+	if (qsc_socket_create(&sock, qsc_socket_address_family_ipv4, qsc_socket_transport_stream, qsc_socket_protocol_tcp) != qsc_socket_exception_success ||
+		qsc_socket_connect(&sock, "127.0.0.1", PORT) != qsc_socket_exception_success)
+	{
+		qsctest_print_line("hkdstest_pipeline_test: client connect failure! -HPT3");
+		hkds_network_stop(&ns);
+		return false;
+	}
+
+	/* a gateway interleaves the requests of every device on one connection, the tag records the device and request */
+	opos = 0;
+
+	for (size_t j = 0; j <= MSGCNT && res == true; ++j)
+	{
+		for (size_t i = 0; i < DEVCNT; ++i)
+		{
+			if (j == 0)
+			{
+				if (hkds_pipeline_issue(&pls, cs[i].ksn, packet_token_request, (i << 8) | j, &seq) == false)
+				{
+					res = false;
+				}
+
+				treq = hkds_factory_create_client_token_request(cs[i].ksn, seq);
+				hkds_factory_serialize_client_token(obuf + opos, &treq);
+				opos += HKDS_CLIENT_TOKEN_REQUEST_SIZE;
+			}
+			else
+			{
+				qsc_csp_generate(ptxt[i][j - 1], HKDS_MESSAGE_SIZE);
+				qsc_memutils_copy(ksn, cs[i].ksn, HKDS_KSN_SIZE);
+
+				if (i < 2)
+				{
+					hkds_client_encrypt_authenticate_message(&cs[i], ptxt[i][j - 1], NULL, 0, ctxt);
+				}
+				else
+				{
+					hkds_client_encrypt_message(&cs[i], ptxt[i][j - 1], ctxt);
+				}
+
+				if (hkds_pipeline_issue(&pls, ksn, packet_message_request, (i << 8) | j, &seq) == false)
+				{
+					res = false;
+				}
+
+				creq = hkds_factory_create_client_message_request(ctxt, ksn, ctxt + HKDS_MESSAGE_SIZE, seq);
+				hkds_factory_serialize_client_message(obuf + opos, &creq);
+				opos += HKDS_CLIENT_MESSAGE_REQUEST_SIZE;
+			}
+		}
+	}
+
+	/* an authenticated message with a damaged tag is answered with an error that carries its sequence */
+	qsc_memutils_copy(ksn, cs[0].ksn, HKDS_KSN_SIZE);
+	hkds_client_encrypt_authenticate_message(&cs[0], ptxt[0][0], NULL, 0, ctxt);
+	ctxt[HKDS_MESSAGE_SIZE] ^= 0x01;
+	res = (hkds_pipeline_issue(&pls, ksn, packet_message_request, 0xFFFF, &seq) == true) ? res : false;
+	creq = hkds_factory_create_client_message_request(ctxt, ksn, ctxt + HKDS_MESSAGE_SIZE, seq);
+	hkds_factory_serialize_client_message(obuf + opos, &creq);
+	opos += HKDS_CLIENT_MESSAGE_REQUEST_SIZE;
+
+	if (res == false || qsc_socket_send_all(&sock, obuf, opos, qsc_socket_send_flag_none) != opos)
+	{
+		qsctest_print_line("hkdstest_pipeline_test: request send failure! -HPT4");
+		res = false;
+	}
+
+	/* read one packet at a time, the header holds its length */
+	rcnt = 0;
+	errs = 0;
+	last = 0;
+	ooo = false;
+
+	while (res == true && hkds_pipeline_outstanding(&pls) != 0)
+	{
+		if (qsc_socket_receive_all(&sock, ibuf, HKDS_HEADER_SIZE, qsc_socket_receive_flag_none) != HKDS_HEADER_SIZE)
+		{
+			res = false;
+			break;
+		}
+
+		plen = ibuf[3];
+
+		if (plen < HKDS_HEADER_SIZE || plen > sizeof(ibuf) ||
+			qsc_socket_receive_all(&sock, ibuf + HKDS_HEADER_SIZE, plen - HKDS_HEADER_SIZE, qsc_socket_receive_flag_none) != plen - HKDS_HEADER_SIZE ||
+			hkds_pipeline_complete(&pls, ibuf, plen, &ent) == false)
+		{
+			qsctest_print_line("hkdstest_pipeline_test: response match failure! -HPT5");
+			res = false;
+			break;
+		}
+
+		/* the tags are issued in increasing order, a smaller tag arrives out of order */
+		ooo = (ent.tag < last) ? true : ooo;
+		last = ent.tag;
+		dev = (size_t)(ent.tag >> 8);
+		++rcnt;
+
+		if (ent.tag == 0xFFFF)
+		{
+			if (hkds_factory_extract_packet_type(ibuf) != packet_error_message || ibuf[2] != (uint8_t)error_general_failure ||
+				qsc_intutils_are_equal8(ibuf + HKDS_HEADER_SIZE + 1, ent.ksn, HKDS_ERROR_SIZE - 1) == false)
+			{
+				res = false;
+			}
+
+			++errs;
+		}
+		else if (ent.type == packet_token_request)
+		{
+			hkds_server_initialize_state(&ss, &mdk, ent.ksn);
+			hkds_server_encrypt_token(&ss, etok);
+
+			if (hkds_factory_extract_packet_type(ibuf) != packet_token_response ||
+				qsc_intutils_are_equal8(ibuf + HKDS_HEADER_SIZE, etok, HKDS_ETOK_SIZE) == false)
+			{
+				res = false;
+			}
+		}
+		else if (hkds_factory_extract_packet_type(ibuf) != packet_message_response ||
+			qsc_intutils_are_equal8(ibuf + HKDS_HEADER_SIZE, ptxt[dev][(ent.tag & 0xFF) - 1], HKDS_MESSAGE_SIZE) == false)
+		{
+			res = false;
+		}
+
+		if (res == false)
+		{
+			qsctest_print_line("hkdstest_pipeline_test: response content failure! -HPT6");
+		}
+	}
+
+	if (res == true && (rcnt != (DEVCNT * (MSGCNT + 1)) + 1 || errs != 1 || ooo == false))
+	{
+		qsctest_print_line("hkdstest_pipeline_test: response completion failure! -HPT7");
+		res = false;
+	}
+
+	qsc_socket_close_socket(&sock);
+	hkds_network_stop(&ns);
+
+	return res;
+}
+
+typedef struct hkdstest_timer_record
+{
+	qsc_timerwheel_state* wheel;
+	qsc_timerwheel_timer* victim;
+	uint64_t deadline;
+	uint64_t period;
+	uint64_t slack;
+	size_t count;
+	bool early;
+} hkdstest_timer_record;
+
+static uint64_t hkdstest_timer_clock;
+
+static void hkdstest_timer_expired(void* context, qsc_timerwheel_timer* timer)
+{
+	hkdstest_timer_record* rec;
+
+	rec = (hkdstest_timer_record*)context;
+	++rec->count;
+
+	/* a timer expires on the first advance past its deadline */
+	if (hkdstest_timer_clock < rec->deadline || hkdstest_timer_clock > rec->deadline + rec->slack)
+	{
+		rec->early = true;
+	}
+
+	if (rec->victim != NULL)
+	{
+		/* cancel a timer that expires on the same tick */
+		qsc_timerwheel_cancel(rec->wheel, rec->victim);
+	}
+
+	if (rec->period != 0 && rec->count < 5)
+	{
+		rec->deadline += rec->period;
+		qsc_timerwheel_start(rec->wheel, timer, rec->deadline);
+	}
+}
+
+static bool hkdstest_timer_idle(qsc_reactor_backends backend)
+{
+	const uint16_t PORT = 38404;
+	uint8_t obuf[HKDS_CLIENT_TOKEN_REQUEST_SIZE] = { 0 };
+	uint8_t ibuf[HKDS_SERVER_TOKEN_RESPONSE_SIZE] = { 0 };
+	const uint8_t kid[HKDS_KID_SIZE] = { 0x01, 0x02, 0x03, 0x04 };
+	uint8_t did[HKDS_DID_SIZE] = { 0x01, 0x02, 0x03, 0x04, 0x10, HKDSTEST_PRF_MODE, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00 };
+	uint8_t edk[HKDS_EDK_SIZE] = { 0 };
+	hkds_client_token_request treq;
+	hkds_client_state cs;
+	hkds_master_key mdk;
+	hkds_network_state ns;
+	qsc_socket socks[2];
+	size_t wait;
+	bool res;
+
+	res = true;
+	hkds_server_generate_mdk(&qsc_csp_generate, &mdk, kid);
+	hkds_server_generate_edk(mdk.bdk, did, edk);
+	hkds_client_initialize_state(&cs, edk, did);
+	treq = hkds_factory_create_client_token_request(cs.ksn, HKDS_SEQUENCE_DEFAULT);
+	hkds_factory_serialize_client_token(obuf, &treq);
+
+	if (hkds_network_start(&ns, &mdk, "127.0.0.1", PORT, qsc_socket_address_family_ipv4, 1, 1, 8, backend) == false)
+	{
+		qsctest_print_line("hkdstest_timer_test: server start failure! -HTT7");
+		return false;
+	}
+
+	hkds_network_idle_timeout(&ns, 100);
+
+	for (size_t i = 0; i < 2; ++i)
+	{
+		qsc_memutils_clear((uint8_t*)&socks[i], sizeof(qsc_socket));
+
+		if (qsc_socket_create(&socks[i], qsc_socket_address_family_ipv4, qsc_socket_transport_stream, qsc_socket_protocol_tcp) != qsc_socket_exception_success ||
+			qsc_socket_connect(&socks[i], "127.0.0.1", PORT) != qsc_socket_exception_success)
+		{
+			qsctest_print_line("hkdstest_timer_test: client connect failure! -HTT8");
+			res = false;
+		}
+	}
+
+	/* the first terminal sends a request every 40 milliseconds, the second stays silent */
+	for (size_t i = 0; i < 8 && res == true; ++i)
+	{
+		qsc_async_thread_sleep(40);
+
+		if (qsc_socket_send_all(&socks[0], obuf, sizeof(obuf), qsc_socket_send_flag_none) != sizeof(obuf) ||
+			qsc_socket_receive_all(&socks[0], ibuf, sizeof(ibuf), qsc_socket_receive_flag_none) != sizeof(ibuf))
+		{
+			qsctest_print_line("hkdstest_timer_test: active connection failure! -HTT9");
+			res = false;
+		}
+	}
+
+	if (res == true && (hkds_network_connections(&ns) != 1 || qsc_socket_receive(&socks[1], ibuf, sizeof(ibuf), qsc_socket_receive_flag_none) != 0))
+	{
+		qsctest_print_line("hkdstest_timer_test: idle connection failure! -HTT10");
+		res = false;
+	}
+
+	for (size_t i = 0; i < 2; ++i)
+	{
+		qsc_socket_close_socket(&socks[i]);
+	}
+
+	wait = 0;
+
+	while (hkds_network_connections(&ns) != 0 && wait < 200)
+	{
+		qsc_async_thread_sleep(10);
+		++wait;
+	}
+
+	hkds_network_stop(&ns);
+
+	return res;
+}
+
+bool hkdstest_timer_test()
+{
+	const uint64_t BASE = 5000000;
+	const uint64_t OFFSETS[7] = { 500, 10000, 100000, 5000000, 1800000000, 2500, 2500 };
+	const uint8_t kid[HKDS_KID_SIZE] = { 0x01, 0x02, 0x03, 0x04 };
+	uint8_t ksn[HKDS_KSN_SIZE] = { 0 };
+	uint8_t cpt[HKDS_MESSAGE_SIZE] = { 0 };
+	uint8_t oksn[HKDS_BATCH_DEPTH][HKDS_KSN_SIZE];
+	uint8_t optx[HKDS_BATCH_DEPTH][HKDS_MESSAGE_SIZE];
+	hkdstest_timer_record rec[7] = { 0 };
+	qsc_timerwheel_timer tmr[7];
+	qsc_timerwheel_timer btmr;
+	qsc_timerwheel_state wheel;
+	hkds_batch_state bts;
+	hkds_master_key mdk;
+	uint64_t next;
+	bool res;
+
+	res = true;
+	hkdstest_timer_clock = BASE;
+	qsc_timerwheel_initialize(&wheel, 1000, BASE);
+
+	/* deadlines on every level of the wheel; timers 5 and 6 share a tick and the first to run cancels the other,
+	   timer 0 restarts itself four times, and timer 1 is cancelled before it expires */
+	for (size_t i = 0; i < 7; ++i)
+	{
+		rec[i].wheel = &wheel;
+		rec[i].deadline = BASE + OFFSETS[i];
+		rec[i].slack = 1700;
+		qsc_timerwheel_timer_initialize(&tmr[i], &hkdstest_timer_expired, &rec[i]);
+		qsc_timerwheel_start(&wheel, &tmr[i], rec[i].deadline);
+	}
+
+	rec[5].victim = &tmr[6];
+	rec[6].victim = &tmr[5];
+	rec[0].period = 3000;
+	rec[4].slack = 1000000;
+	qsc_timerwheel_cancel(&wheel, &tmr[1]);
+	next = qsc_timerwheel_next(&wheel);
+
+	if (qsc_timerwheel_count(&wheel) != 6 || qsc_timerwheel_active(&tmr[1]) == true || next > rec[0].deadline + 1000 || next < rec[0].deadline)
+	{
+		qsctest_print_line("hkdstest_timer_test: timer start failure! -HTT1");
+		res = false;
+	}
+
+	/* advance in uneven steps, each timer must expire on the first advance past its deadline */
+	while (hkdstest_timer_clock < BASE + 6000000 && res == true)
+	{
+		hkdstest_timer_clock += 700;
+		qsc_timerwheel_advance(&wheel, hkdstest_timer_clock);
+	}
+
+	for (size_t i = 0; i < 7; ++i)
+	{
+		if (rec[i].early == true)
+		{
+			qsctest_print_line("hkdstest_timer_test: timer expiry failure! -HTT2");
+			res = false;
+		}
+	}
+
+	if (res == true && (rec[0].count != 5 || rec[1].count != 0 || rec[2].count != 1 || rec[3].count != 1 || rec[4].count != 0 ||
+		rec[5].count + rec[6].count != 1 || qsc_timerwheel_count(&wheel) != 1))
+	{
+		qsctest_print_line("hkdstest_timer_test: timer count failure! -HTT3");
+		res = false;
+	}
+
+	/* the top level timer is moved down the levels as the wheel turns */
+	while (hkdstest_timer_clock < BASE + OFFSETS[4] + 1000000 && res == true)
+	{
+		hkdstest_timer_clock += 1000000;
+		qsc_timerwheel_advance(&wheel, hkdstest_timer_clock);
+	}
+
+	if (res == true && rec[4].early == true)
+	{
+		qsctest_print_line("hkdstest_timer_test: timer cascade failure! -HTT4");
+		res = false;
+	}
+
+	if (res == true && (rec[4].count != 1 || qsc_timerwheel_count(&wheel) != 0 || qsc_timerwheel_next(&wheel) != UINT64_MAX))
+	{
+		qsctest_print_line("hkdstest_timer_test: timer drain failure! -HTT5");
+		res = false;
+	}
+
+	/* a queued message schedules the batch timer at its deadline, and an empty batch cancels it */
+	if (res == true)
+	{
+		hkds_server_generate_mdk(&qsc_csp_generate, &mdk, kid);
+		hkds_batch_initialize(&bts, &mdk, 2000, 0);
+		qsc_timerwheel_initialize(&wheel, 1000, qsc_timerex_monotonic_microseconds());
+		qsc_timerwheel_timer_initialize(&btmr, &hkdstest_timer_expired, &rec[0]);
+		hkds_batch_submit(&bts, ksn, cpt);
+		hkds_batch_schedule(&bts, &wheel, &btmr);
+		next = qsc_timerwheel_next(&wheel);
+
+		if (qsc_timerwheel_active(&btmr) == false || next > qsc_timerex_monotonic_microseconds() + 3000)
+		{
+			qsctest_print_line("hkdstest_timer_test: batch schedule failure! -HTT6");
+			res = false;
+		}
+
+		hkds_batch_process(&bts, true, oksn, optx);
+		hkds_batch_schedule(&bts, &wheel, &btmr);
+
+		if (qsc_timerwheel_active(&btmr) == true)
+		{
+			qsctest_print_line("hkdstest_timer_test: batch schedule failure! -HTT6");
+			res = false;
+		}
+
+		hkds_batch_dispose(&bts);
+	}
+
+	/* the reactor closes the silent connection, and keeps the active one */
+	res = (res == true) ? hkdstest_timer_idle(qsc_reactor_backend_epoll) : false;
+	res = (res == true) ? hkdstest_timer_idle(qsc_reactor_backend_auto) : false;
+
+	return res;
+}
+
+typedef struct hkdstest_bufferpool_worker
+{
+	qsc_bufferpool_buffer** buffers;
+	size_t count;
+	volatile uint64_t* errors;
+} hkdstest_bufferpool_worker;
+
+static void hkdstest_bufferpool_consume(void* arg)
+{
+	hkdstest_bufferpool_worker* worker;
+
+	worker = (hkdstest_bufferpool_worker*)arg;
+
+	/* each worker checks the buffers it was handed, and releases its references */
+	for (size_t i = 0; i < worker->count; ++i)
+	{
+		if (worker->buffers[i]->length != i + 1 || worker->buffers[i]->data[0] != (uint8_t)i || worker->buffers[i]->data[i] != (uint8_t)i)
+		{
+			qsc_atomics_fetch_add64(worker->errors, 1);
+		}
+
+		qsc_bufferpool_release(worker->buffers[i]);
+	}
+}
+
+bool hkdstest_bufferpool_test()
+{
+	const size_t BUFCNT = 64;
+	const size_t WRKCNT = 4;
+	qsc_bufferpool_buffer* bufs[768] = { 0 };
+	hkdstest_bufferpool_worker wrk[4];
+	qsc_thread thds[4];
+	qsc_bufferpool_state pool;
+	volatile uint64_t errors;
+	size_t cnt;
+	bool res;
+
+	res = true;
+	errors = 0;
+
+	/* the maximum is rounded up to three slabs, and one slab is allocated up front */
+	if (qsc_bufferpool_initialize(&pool, 1000, 600) == false || qsc_bufferpool_capacity(&pool) != QSC_BUFFERPOOL_SLAB_BUFFERS ||
+		qsc_bufferpool_available(&pool) != QSC_BUFFERPOOL_SLAB_BUFFERS || pool.stride != 1024)
+	{
+		qsctest_print_line("hkdstest_bufferpool_test: initialization failure! -HBP1");
+		return false;
+	}
+
+	/* slabs are added as the buffers are taken, up to the maximum */
+	cnt = 0;
+	bufs[0] = qsc_bufferpool_acquire(&pool);
+
+	while (bufs[cnt] != NULL && cnt < 767)
+	{
+		++cnt;
+		bufs[cnt] = qsc_bufferpool_acquire(&pool);
+	}
+
+	if (cnt != 767 || bufs[767] == NULL || qsc_bufferpool_acquire(&pool) != NULL || qsc_bufferpool_capacity(&pool) != 768 || qsc_bufferpool_available(&pool) != 0)
+	{
+		qsctest_print_line("hkdstest_bufferpool_test: slab growth failure! -HBP2");
+		res = false;
+	}
+
+	for (size_t i = 0; i < 768 && res == true; ++i)
+	{
+#if defined(QSC_SYSTEM_AVX_INTRINSICS)
+		if (((uintptr_t)bufs[i]->data % QSC_BUFFERPOOL_ALIGNMENT) != 0)
+		{
+			qsctest_print_line("hkdstest_bufferpool_test: buffer alignment failure! -HBP3");
+			res = false;
+		}
+#endif
+		if (bufs[i]->references != 1 || (i % QSC_BUFFERPOOL_SLAB_BUFFERS != 0 && bufs[i]->data != bufs[i - 1]->data + pool.stride))
+		{
+			qsctest_print_line("hkdstest_bufferpool_test: buffer layout failure! -HBP4");
+			res = false;
+		}
+	}
+
+	for (size_t i = 0; i < 768; ++i)
+	{
+		if (bufs[i] != NULL)
+		{
+			qsc_bufferpool_release(bufs[i]);
+		}
+	}
+
+	if (res == true && qsc_bufferpool_available(&pool) != 768)
+	{
+		qsctest_print_line("hkdstest_bufferpool_test: buffer release failure! -HBP5");
+		res = false;
+	}
+
+	/* every buffer is handed to each worker with a reference, and returns when the last worker releases it */
+	for (size_t i = 0; i < BUFCNT && res == true; ++i)
+	{
+		bufs[i] = qsc_bufferpool_acquire(&pool);
+		qsc_memutils_setvalue(bufs[i]->data, (uint8_t)i, i + 1);
+		bufs[i]->length = i + 1;
+
+		for (size_t j = 0; j < WRKCNT; ++j)
+		{
+			qsc_bufferpool_retain(bufs[i]);
+		}
+	}
+
+	if (res == true)
+	{
+		for (size_t j = 0; j < WRKCNT; ++j)
+		{
+			wrk[j].buffers = bufs;
+			wrk[j].count = BUFCNT;
+			wrk[j].errors = &errors;
+			thds[j] = qsc_async_thread_create(&hkdstest_bufferpool_consume, &wrk[j]);
+		}
+
+		for (size_t i = 0; i < BUFCNT; ++i)
+		{
+			qsc_bufferpool_release(bufs[i]);
+		}
+
+		for (size_t j = 0; j < WRKCNT; ++j)
+		{
+			qsc_async_thread_wait(thds[j]);
+		}
+
+		if (qsc_atomics_load64(&errors) != 0 || qsc_bufferpool_available(&pool) != 768)
+		{
+			qsctest_print_line("hkdstest_bufferpool_test: buffer hand-off failure! -HBP6");
+			res = false;
+		}
+	}
+
+	qsc_bufferpool_dispose(&pool);
+
+	return res;
+}
+
+typedef struct hkdstest_ipc_engine
+{
+	hkds_ipc_channel channel;
+	hkds_network_state server;
+	volatile uint64_t served;
+} hkdstest_ipc_engine;
+
+static void hkdstest_ipc_serve(void* arg)
+{
+	hkdstest_ipc_engine* engine;
+
+	engine = (hkdstest_ipc_engine*)arg;
+
+	/* the engine has its own mapping of the channel, as it would in a separate process */
+	while (qsc_atomics_load64(&engine->channel.header->closed) == 0)
+	{
+		qsc_atomics_fetch_add64(&engine->served, hkds_ipc_serve(&engine->channel, &engine->server, 100));
+	}
+}
+
+bool hkdstest_ipc_test()
+{
+	const char* NAME = "/hkdstest-ipc";
+	const size_t DEVCNT = 4;
+	const size_t RECCNT = 24;
+	const size_t SLTCNT = 8;
+	const size_t TOKCNT = 100;
+	const uint8_t kid[HKDS_KID_SIZE] = { 0x01, 0x02, 0x03, 0x04 };
+	uint8_t did[HKDS_DID_SIZE] = { 0x01, 0x02, 0x03, 0x04, 0x10, HKDSTEST_PRF_MODE, 0x01, 0x00, 0x02, 0x00, 0x00, 0x00 };
+	uint8_t edk[HKDS_EDK_SIZE] = { 0 };
+	uint8_t tokd[HKDS_STK_SIZE] = { 0 };
+	uint8_t etok[HKDS_ETOK_SIZE] = { 0 };
+	uint8_t ctxt[HKDS_MESSAGE_SIZE] = { 0 };
+	uint8_t ksn[HKDS_KSN_SIZE] = { 0 };
+	uint8_t ptxt[24][HKDS_MESSAGE_SIZE] = { 0 };
+	bool seen[24] = { 0 };
+	hkds_client_state cs[4];
+	hkds_master_key mdk;
+	hkds_server_state ss;
+	hkds_client_message_request creq;
+	hkds_client_token_request treq;
+	hkdstest_ipc_engine eng;
+	hkds_ipc_channel fch;
+	hkds_ipc_slot* slot;
+	qsc_thread thd;
+	size_t len;
+	size_t ocnt;
+	size_t rcnt;
+	size_t scnt;
+	size_t tcnt;
+	size_t wait;
+	bool res;
+
+	res = true;
+	hkds_server_generate_mdk(&qsc_csp_generate, &mdk, kid);
+
+	for (size_t i = 0; i < DEVCNT; ++i)
+	{
+		did[HKDS_DID_SIZE - 1] = (uint8_t)i;
+		hkds_server_generate_edk(mdk.bdk, did, edk);
+		hkds_client_initialize_state(&cs[i], edk, did);
+		hkds_server_initialize_state(&ss, &mdk, cs[i].ksn);
+		hkds_server_encrypt_token(&ss, etok);
+		hkds_client_decrypt_token(&cs[i], etok, tokd);
+		hkds_client_generate_cache(&cs[i], tokd);
+	}
+
+	/* the front end creates the channel, and the engine maps it by name */
+	if (hkds_ipc_create(&fch, NAME, SLTCNT - 1) == false || fch.header->count != SLTCNT ||
+		hkds_ipc_open(&eng.channel, NAME) == false || eng.channel.slots[hkds_ipc_requests] == fch.slots[hkds_ipc_requests])
+	{
+		qsctest_print_line("hkdstest_ipc_test: channel creation failure! -HIP1");
+		hkds_ipc_close(&fch);
+		return false;
+	}
+
+	/* a ring holds one record for each slot, and is read in order through the other mapping */
+	for (size_t i = 0; i < SLTCNT; ++i)
+	{
+		slot = hkds_ipc_reserve(&fch, hkds_ipc_requests);
+
+		if (slot == NULL)
+		{
+			res = false;
+			break;
+		}
+
+		qsc_memutils_setvalue(slot->data, (uint8_t)i, i + 1);
+		hkds_ipc_publish(&fch, hkds_ipc_requests, slot, i + 1, i);
+	}
+
+	if (res == false || hkds_ipc_reserve(&fch, hkds_ipc_requests) != NULL || hkds_ipc_wait_writable(&fch, hkds_ipc_requests, 0) == true)
+	{
+		qsctest_print_line("hkdstest_ipc_test: ring capacity failure! -HIP2");
+		res = false;
+	}
+
+	for (size_t i = 0; i < SLTCNT && res == true; ++i)
+	{
+		slot = hkds_ipc_acquire(&eng.channel, hkds_ipc_requests);
+
+		if (slot == NULL || slot->tag != i || slot->length != i + 1 || slot->data[i] != (uint8_t)i)
+		{
+			qsctest_print_line("hkdstest_ipc_test: ring order failure! -HIP3");
+			res = false;
+		}
+
+		if (slot != NULL)
+		{
+			hkds_ipc_release(&eng.channel, hkds_ipc_requests, slot);
+		}
+	}
+
+	if (res == true && (hkds_ipc_acquire(&eng.channel, hkds_ipc_requests) != NULL || hkds_ipc_wait_readable(&eng.channel, hkds_ipc_requests, 10) == true ||
+		hkds_ipc_wait_writable(&fch, hkds_ipc_requests, 0) == false))
+	{
+		qsctest_print_line("hkdstest_ipc_test: ring release failure! -HIP4");
+		res = false;
+	}
+
+	/* each record holds a message and a token request, and is answered with one response record carrying its tag;
+	there are more records than slots, so both rings wrap while the front end collects the responses */
+	if (res == true)
+	{
+		qsc_memutils_clear(&eng.server, sizeof(hkds_network_state));
+		eng.server.mdk = &mdk;
+		eng.served = 0;
+		thd = qsc_async_thread_create(&hkdstest_ipc_serve, &eng);
+		scnt = 0;
+		rcnt = 0;
+		wait = 0;
+
+		while (rcnt < RECCNT && wait < 100)
+		{
+			slot = (scnt < RECCNT) ? hkds_ipc_reserve(&fch, hkds_ipc_requests) : NULL;
+
+			if (slot != NULL)
+			{
+				qsc_csp_generate(ptxt[scnt], HKDS_MESSAGE_SIZE);
+				qsc_memutils_copy(ksn, cs[scnt % DEVCNT].ksn, HKDS_KSN_SIZE);
+				hkds_client_encrypt_message(&cs[scnt % DEVCNT], ptxt[scnt], ctxt);
+				creq = hkds_factory_create_client_message_request(ctxt, ksn, NULL, HKDS_SEQUENCE_DEFAULT);
+				hkds_factory_serialize_client_message(slot->data, &creq);
+				treq = hkds_factory_create_client_token_request(cs[scnt % DEVCNT].ksn, HKDS_SEQUENCE_DEFAULT);
+				hkds_factory_serialize_client_token(slot->data + HKDS_CLIENT_MESSAGE_REQUEST_SIZE, &treq);
+				len = HKDS_CLIENT_MESSAGE_REQUEST_SIZE + HKDS_CLIENT_TOKEN_REQUEST_SIZE;
+
+				/* the first record also holds a malformed packet */
+				if (scnt == 0)
+				{
+					qsc_memutils_copy(slot->data + len, slot->data, HKDS_CLIENT_MESSAGE_REQUEST_SIZE);
+					slot->data[len + 1] ^= 0x07;
+					len += HKDS_CLIENT_MESSAGE_REQUEST_SIZE;
+				}
+
+				hkds_ipc_publish(&fch, hkds_ipc_requests, slot, len, scnt);
+				++scnt;
+			}
+
+			slot = hkds_ipc_acquire(&fch, hkds_ipc_responses);
+
+			while (slot != NULL)
+			{
+				len = HKDS_SERVER_MESSAGE_RESPONSE_SIZE + HKDS_SERVER_TOKEN_RESPONSE_SIZE + ((slot->tag == 0) ? HKDS_ERROR_MESSAGE_SIZE : 0);
+
+				if (slot->tag >= RECCNT || seen[slot->tag] == true || slot->length != len ||
+					qsc_intutils_are_equal8(slot->data + HKDS_HEADER_SIZE, ptxt[slot->tag], HKDS_MESSAGE_SIZE) == false ||
+					hkds_factory_extract_packet_type(slot->data + HKDS_SERVER_MESSAGE_RESPONSE_SIZE) != packet_token_response)
+				{
+					qsctest_print_line("hkdstest_ipc_test: response record failure! -HIP5");
+					res = false;
+				}
+				else
+				{
+					seen[slot->tag] = true;
+				}
+
+				hkds_ipc_release(&fch, hkds_ipc_responses, slot);
+				++rcnt;
+				slot = hkds_ipc_acquire(&fch, hkds_ipc_responses);
+			}
+
+			if (scnt == RECCNT && rcnt < RECCNT)
+			{
+				hkds_ipc_wait_readable(&fch, hkds_ipc_responses, 100);
+				++wait;
+			}
+		}
+
+		/* a record holding more token requests than one wire batch is answered with a response record for each batch */
+		slot = hkds_ipc_reserve(&fch, hkds_ipc_requests);
+
+		if (slot != NULL)
+		{
+			for (size_t i = 0; i < TOKCNT; ++i)
+			{
+				treq = hkds_factory_create_client_token_request(cs[i % DEVCNT].ksn, HKDS_SEQUENCE_DEFAULT);
+				hkds_factory_serialize_client_token(slot->data + (i * HKDS_CLIENT_TOKEN_REQUEST_SIZE), &treq);
+			}
+
+			hkds_ipc_publish(&fch, hkds_ipc_requests, slot, TOKCNT * HKDS_CLIENT_TOKEN_REQUEST_SIZE, RECCNT);
+		}
+
+		ocnt = 0;
+		tcnt = 0;
+		wait = 0;
+
+		while (tcnt < TOKCNT && wait < 100)
+		{
+			slot = hkds_ipc_acquire(&fch, hkds_ipc_responses);
+
+			if (slot != NULL)
+			{
+				if (slot->tag != RECCNT || slot->length % HKDS_SERVER_TOKEN_RESPONSE_SIZE != 0 ||
+					slot->length > HKDS_WIRE_BATCH_MAX * HKDS_SERVER_TOKEN_RESPONSE_SIZE)
+				{
+					res = false;
+				}
+
+				tcnt += slot->length / HKDS_SERVER_TOKEN_RESPONSE_SIZE;
+				++ocnt;
+				hkds_ipc_release(&fch, hkds_ipc_responses, slot);
+			}
+			else
+			{
+				hkds_ipc_wait_readable(&fch, hkds_ipc_responses, 100);
+				++wait;
+			}
+		}
+
+		if (res == false || tcnt != TOKCNT || ocnt != 2)
+		{
+			qsctest_print_line("hkdstest_ipc_test: oversized record failure! -HIP8");
+			res = false;
+		}
+
+		/* the engine leaves its serve loop when the channel is closed */
+		hkds_ipc_shutdown(&fch);
+		qsc_async_thread_wait(thd);
+
+		if (rcnt != RECCNT || qsc_atomics_load64(&eng.served) != RECCNT + 1 ||
+			qsc_atomics_load64(&eng.server.requests) != (RECCNT * 2) + TOKCNT || qsc_atomics_load64(&eng.server.rejected) != 1)
+		{
+			qsctest_print_line("hkdstest_ipc_test: engine exchange failure! -HIP6");
+			res = false;
+		}
+	}
+
+	hkds_ipc_close(&eng.channel);
+	hkds_ipc_close(&fch);
+
+	/* the creator removes the shared memory object */
+	if (hkds_ipc_open(&fch, NAME) == true)
+	{
+		qsctest_print_line("hkdstest_ipc_test: channel removal failure! -HIP7");
+		hkds_ipc_close(&fch);
+		res = false;
+	}
+
+	return res;
+}
+
+static size_t hkdstest_router_request(qsc_socket* sock, hkds_client_state* cs, size_t count, const bool* down, uint8_t ptxt[16][HKDS_MESSAGE_SIZE])
+{
+	uint8_t ctxt[HKDS_MESSAGE_SIZE] = { 0 };
+	uint8_t ksn[HKDS_KSN_SIZE] = { 0 };
+	uint8_t obuf[16 * HKDS_CLIENT_MESSAGE_REQUEST_SIZE] = { 0 };
+	hkds_client_message_request creq;
+	size_t exlen;
+
+	exlen = 0;
+
+	/* one request from each device in a single send, each identified by its sequence */
+	for (size_t i = 0; i < count; ++i)
+	{
+		qsc_csp_generate(ptxt[i], HKDS_MESSAGE_SIZE);
+		qsc_memutils_copy(ksn, cs[i].ksn, HKDS_KSN_SIZE);
+		hkds_client_encrypt_message(&cs[i], ptxt[i], ctxt);
+		creq = hkds_factory_create_client_message_request(ctxt, ksn, NULL, (uint8_t)(i + 1));
+		hkds_factory_serialize_client_message(obuf + (i * HKDS_CLIENT_MESSAGE_REQUEST_SIZE), &creq);
+		exlen += (down[i] == true) ? HKDS_ERROR_MESSAGE_SIZE : HKDS_SERVER_MESSAGE_RESPONSE_SIZE;
+	}
+
+	if (qsc_socket_send_all(sock, obuf, count * HKDS_CLIENT_MESSAGE_REQUEST_SIZE, qsc_socket_send_flag_none) != count * HKDS_CLIENT_MESSAGE_REQUEST_SIZE)
+	{
+		exlen = 0;
+	}
+
+	return exlen;
+}
+
+static bool hkdstest_router_response(qsc_socket* sock, size_t count, const bool* down, const uint8_t ptxt[16][HKDS_MESSAGE_SIZE], size_t exlen)
+{
+	uint8_t ibuf[16 * HKDS_ERROR_MESSAGE_SIZE] = { 0 };
+	bool seen[16] = { 0 };
+	size_t idx;
+	size_t pos;
+	bool res;
+
+	res = (exlen != 0 && qsc_socket_receive_all(sock, ibuf, exlen, qsc_socket_receive_flag_none) == exlen);
+
+	/* the backends answer in parallel, so the responses are matched by sequence */
+	pos = 0;
+
+	while (res == true && pos < exlen)
+	{
+		idx = (size_t)hkds_wire_response_sequence(ibuf + pos, exlen - pos) - 1;
+
+		if (idx >= count || seen[idx] == true)
+		{
+			res = false;
+		}
+		else if (down[idx] == true)
+		{
+			res = (hkds_factory_extract_packet_type(ibuf + pos) == packet_error_message);
+		}
+		else
+		{
+			res = (hkds_factory_extract_packet_type(ibuf + pos) == packet_message_response &&
+				qsc_intutils_are_equal8(ibuf + pos + HKDS_HEADER_SIZE, ptxt[idx], HKDS_MESSAGE_SIZE) == true);
+		}
+
+		if (res == true)
+		{
+			seen[idx] = true;
+			pos += hkds_factory_extract_packet_size(ibuf + pos);
+		}
+	}
+
+	return res;
+}
+
+static bool hkdstest_router_round(qsc_socket* sock, hkds_client_state* cs, size_t count, const bool* down)
+{
+	uint8_t ptxt[16][HKDS_MESSAGE_SIZE] = { 0 };
+	size_t exlen;
+
+	exlen = hkdstest_router_request(sock, cs, count, down, ptxt);
+
+	return hkdstest_router_response(sock, count, down, (const uint8_t (*)[HKDS_MESSAGE_SIZE])ptxt, exlen);
+}
+
+bool hkdstest_router_test()
+{
+	const size_t DEVCNT = 16;
+	const size_t BCKCNT = 3;
+	const size_t KSNCNT = 512;
+	const uint16_t PORT = 38405;
+	const char* paths[4] = { "/tmp/hkdstest-router-0.sock", "/tmp/hkdstest-router-1.sock", "/tmp/hkdstest-router-2.sock", "/tmp/hkdstest-router-3.sock" };
+	const uint8_t kid[HKDS_KID_SIZE] = { 0x01, 0x02, 0x03, 0x04 };
+	uint8_t did[HKDS_DID_SIZE] = { 0x01, 0x02, 0x03, 0x04, 0x10, HKDSTEST_PRF_MODE, 0x01, 0x00, 0x03, 0x00, 0x00, 0x00 };
+	uint8_t edk[HKDS_EDK_SIZE] = { 0 };
+	uint8_t tokd[HKDS_STK_SIZE] = { 0 };
+	uint8_t etok[HKDS_ETOK_SIZE] = { 0 };
+	uint8_t ksns[512][HKDS_KSN_SIZE] = { 0 };
+	uint8_t ptxt[16][HKDS_MESSAGE_SIZE] = { 0 };
+	size_t owners[512] = { 0 };
+	size_t counts[4] = { 0 };
+	const bool up[1] = { false };
+	bool down[16] = { 0 };
+	hkds_client_state cs[16];
+	hkds_router_backend_state bs[3];
+	hkds_router_state rs;
+	hkds_master_key mdk;
+	hkds_server_state ss;
+	qsc_socket fast;
+	qsc_socket sock;
+	qsc_socket stall;
+	uint64_t quick;
+	uint64_t first;
+	uint64_t second;
+	uint64_t start;
+	uint64_t total;
+	uint64_t prior;
+	size_t exlen;
+	size_t fdev;
+	size_t idx;
+	size_t moved;
+	bool res;
+
+	res = true;
+	hkds_server_generate_mdk(&qsc_csp_generate, &mdk, kid);
+
+	for (size_t i = 0; i < DEVCNT; ++i)
+	{
+		did[HKDS_DID_SIZE - 1] = (uint8_t)i;
+		hkds_server_generate_edk(mdk.bdk, did, edk);
+		hkds_client_initialize_state(&cs[i], edk, did);
+		hkds_server_initialize_state(&ss, &mdk, cs[i].ksn);
+		hkds_server_encrypt_token(&ss, etok);
+		hkds_client_decrypt_token(&cs[i], etok, tokd);
+		hkds_client_generate_cache(&cs[i], tokd);
+	}
+
+	/* the backends hold the keys, the router holds only the ring */
+	hkds_router_initialize(&rs);
+
+	for (size_t i = 0; i < BCKCNT; ++i)
+	{
+		if (hkds_router_backend_start(&bs[i], &mdk, paths[i], 1, qsc_reactor_backend_epoll) == false || hkds_router_add(&rs, paths[i]) == false)
+		{
+			res = false;
+		}
+	}
+
+	if (res == false || hkds_router_add(&rs, paths[0]) == true ||
+		hkds_router_start(&rs, "127.0.0.1", PORT, qsc_socket_address_family_ipv4, 2, 16, qsc_reactor_backend_auto) == false)
+	{
+		qsctest_print_line("hkdstest_router_test: router start failure! -HRT1");
+
+		for (size_t i = 0; i < BCKCNT; ++i)
+		{
+			hkds_router_backend_stop(&bs[i]);
+		}
+
+		return false;
+	}
+
+	/* every backend receives a share of the devices */
+	for (size_t i = 0; i < KSNCNT; ++i)
+	{
+		qsc_csp_generate(ksns[i], HKDS_KSN_SIZE);
+		owners[i] = hkds_router_route(&rs, ksns[i]);
+		counts[(owners[i] < BCKCNT) ? owners[i] : 3] += 1;
+	}
+
+	if (counts[0] == 0 || counts[1] == 0 || counts[2] == 0 || counts[3] != 0)
+	{
+		qsctest_print_line("hkdstest_router_test: ring distribution failure! -HRT2");
+		res = false;
+	}
+
+	/* an added backend takes devices only from the others, and removing it restores the previous routes */
+	moved = 0;
+
+	if (res == true && hkds_router_add(&rs, paths[3]) == true)
+	{
+		for (size_t i = 0; i < KSNCNT; ++i)
+		{
+			idx = hkds_router_route(&rs, ksns[i]);
+
+			if (idx != owners[i])
+			{
+				res = (idx == BCKCNT) ? res : false;
+				++moved;
+			}
+		}
+
+		hkds_router_remove(&rs, paths[3]);
+
+		for (size_t i = 0; i < KSNCNT; ++i)
+		{
+			res = (hkds_router_route(&rs, ksns[i]) == owners[i]) ? res : false;
+		}
+	}
+
+	if (res == false || moved == 0 || moved == KSNCNT)
+	{
+		qsctest_print_line("hkdstest_router_test: ring rebalance failure! -HRT3");
+		res = false;
+	}
+
+	qsc_memutils_clear((uint8_t*)&sock, sizeof(qsc_socket));
+
+	if (qsc_socket_create(&sock, qsc_socket_address_family_ipv4, qsc_socket_transport_stream, qsc_socket_protocol_tcp) != qsc_socket_exception_success ||
+		qsc_socket_connect(&sock, "127.0.0.1", PORT) != qsc_socket_exception_success)
+	{
+		qsctest_print_line("hkdstest_router_test: client connect failure! -HRT4");
+		res = false;
+	}
+
+	/* each backend decrypts the requests of its own devices */
+	if (res == true)
+	{
+		res = hkdstest_router_round(&sock, cs, DEVCNT, down);
+		total = 0;
+
+		for (size_t i = 0; i < BCKCNT; ++i)
+		{
+			counts[i] = 0;
+		}
+
+		for (size_t i = 0; i < DEVCNT; ++i)
+		{
+			counts[hkds_router_route(&rs, cs[i].ksn)] += 1;
+		}
+
+		for (size_t i = 0; i < BCKCNT; ++i)
+		{
+			total += qsc_atomics_load64(&bs[i].server.requests);
+			res = (qsc_atomics_load64(&bs[i].server.requests) == counts[i]) ? res : false;
+		}
+
+		if (res == false || total != DEVCNT || qsc_atomics_load64(&rs.forwarded) != DEVCNT)
+		{
+			qsctest_print_line("hkdstest_router_test: routed exchange failure! -HRT5");
+			res = false;
+		}
+	}
+
+	/* a backend removed while the router runs receives no more requests, its devices are served by the others */
+	if (res == true)
+	{
+		prior = qsc_atomics_load64(&bs[1].server.requests);
+		hkds_router_remove(&rs, paths[1]);
+
+		if (hkdstest_router_round(&sock, cs, DEVCNT, down) == false || qsc_atomics_load64(&bs[1].server.requests) != prior ||
+			qsc_atomics_load64(&bs[0].server.requests) + qsc_atomics_load64(&bs[2].server.requests) != (2 * DEVCNT) - prior)
+		{
+			qsctest_print_line("hkdstest_router_test: backend removal failure! -HRT6");
+			res = false;
+		}
+	}
+
+	/* the requests for a backend that has stopped are answered with errors, the other devices are still served */
+	if (res == true)
+	{
+		hkds_router_backend_stop(&bs[2]);
+		moved = 0;
+
+		for (size_t i = 0; i < DEVCNT; ++i)
+		{
+			down[i] = (hkds_router_route(&rs, cs[i].ksn) == 2);
+			moved += (down[i] == true) ? 1 : 0;
+		}
+
+		if (moved == 0 || hkdstest_router_round(&sock, cs, DEVCNT, down) == false || qsc_atomics_load64(&rs.failed) != moved)
+		{
+			qsctest_print_line("hkdstest_router_test: backend failure handling failure! -HRT7");
+			res = false;
+		}
+	}
+
+	/* a backend that accepts the link but never answers is timed out once, then its requests are answered with errors at once;
+	   the event loops are not held by the stalled backend, so a terminal whose device is on a running backend is answered meanwhile */
+	if (res == true)
+	{
+		qsc_memutils_clear((uint8_t*)&stall, sizeof(qsc_socket));
+		qsc_memutils_clear((uint8_t*)&fast, sizeof(qsc_socket));
+		remove(paths[3]);
+
+		if (qsc_socket_create(&stall, qsc_socket_address_family_unix, qsc_socket_transport_stream, qsc_socket_protocol_none) == qsc_socket_exception_success &&
+			qsc_socket_bind_unix(&stall, paths[3]) == qsc_socket_exception_success && qsc_socket_listen(&stall, 8) == qsc_socket_exception_success &&
+			qsc_socket_create(&fast, qsc_socket_address_family_ipv4, qsc_socket_transport_stream, qsc_socket_protocol_tcp) == qsc_socket_exception_success &&
+			qsc_socket_connect(&fast, "127.0.0.1", PORT) == qsc_socket_exception_success && hkds_router_add(&rs, paths[3]) == true)
+		{
+			moved = 0;
+			idx = 0;
+			fdev = DEVCNT;
+
+			for (size_t i = 0; i < DEVCNT; ++i)
+			{
+				down[i] = (hkds_router_route(&rs, cs[i].ksn) != 0);
+				moved += (down[i] == true) ? 1 : 0;
+				idx += (hkds_router_route(&rs, cs[i].ksn) == 1) ? 1 : 0;
+				fdev = (down[i] == false && fdev == DEVCNT) ? i : fdev;
+			}
+
+			prior = qsc_atomics_load64(&rs.failed);
+			start = qsc_timerex_monotonic_microseconds();
+			exlen = hkdstest_router_request(&sock, cs, DEVCNT, down, ptxt);
+			quick = qsc_timerex_monotonic_microseconds();
+			res = (exlen != 0 && fdev != DEVCNT && hkdstest_router_round(&fast, &cs[fdev], 1, up) == true);
+			quick = qsc_timerex_monotonic_microseconds() - quick;
+			res = (res == true && hkdstest_router_response(&sock, DEVCNT, down, (const uint8_t (*)[HKDS_MESSAGE_SIZE])ptxt, exlen) == true);
+			first = qsc_timerex_monotonic_microseconds() - start;
+			start = qsc_timerex_monotonic_microseconds();
+			res = (res == true && hkdstest_router_round(&sock, cs, DEVCNT, down) == true);
+			second = qsc_timerex_monotonic_microseconds() - start;
+
+			if (res == false || idx == 0 || qsc_atomics_load64(&rs.failed) - prior != 2 * moved ||
+				quick >= (uint64_t)HKDS_ROUTER_TIMEOUT * 1000ULL || first < (uint64_t)HKDS_ROUTER_TIMEOUT * 1000ULL || second >= (uint64_t)HKDS_ROUTER_TIMEOUT * 1000ULL)
+			{
+				res = false;
+			}
+		}
+		else
+		{
+			res = false;
+		}
+
+		if (res == false)
+		{
+			qsctest_print_line("hkdstest_router_test: stalled backend failure! -HRT8");
+		}
+
+		qsc_socket_close_socket(&fast);
+		qsc_socket_close_socket(&stall);
+		remove(paths[3]);
+	}
+
+	qsc_socket_close_socket(&sock);
+	hkds_router_stop(&rs);
+
+	for (size_t i = 0; i < BCKCNT; ++i)
+	{
+		hkds_router_backend_stop(&bs[i]);
+	}
+
+	return res;
+}
+
+typedef struct hkdstest_replica_worker
+{
+	hkds_replica_log_state* log;
+	size_t base;
+	size_t span;
+	volatile uint64_t* errors;
+} hkdstest_replica_worker;
+
+static void hkdstest_replica_updates(void* arg)
+{
+	hkdstest_replica_worker* worker;
+	uint64_t rec;
+
+	worker = (hkdstest_replica_worker*)arg;
+
+	for (uint32_t i = 1; i <= 4000; ++i)
+	{
+		rec = hkds_counter_pack(1, i);
+
+		if (hkds_replica_update(worker->log, worker->base + (i % worker->span), rec) == false)
+		{
+			qsc_atomics_fetch_add64(worker->errors, 1);
+		}
+
+		/* a replayed message is rejected by the primary, and is not logged */
+		if (hkds_replica_update(worker->log, worker->base + (i % worker->span), rec) == true)
+		{
+			qsc_atomics_fetch_add64(worker->errors, 1);
+		}
+	}
+}
+
+static size_t hkdstest_replica_slot(void* context, const uint8_t* did)
+{
+	(void)context;
+
+	/* the test devices differ only in the last byte of their identity */
+	return (size_t)did[HKDS_DID_SIZE - 1];
+}
+
+static bool hkdstest_replica_submit(hkds_shard_state* state, hkdstest_async_context* ctx, const hkds_async_request* reqs, const size_t* order, size_t count)
+{
+	uint64_t start;
+	size_t cnt;
+
+	cnt = 0;
+	start = qsc_timerex_monotonic_microseconds();
+
+	while (qsc_atomics_load64(&ctx->count) != count && qsc_timerex_monotonic_microseconds() - start < 10000000ULL)
+	{
+		if (cnt < count && hkds_shard_submit(state, 0, &reqs[order[cnt]]) == true)
+		{
+			++cnt;
+		}
+		else
+		{
+			qsc_async_thread_yield();
+		}
+	}
+
+	return (qsc_atomics_load64(&ctx->count) == count);
+}
+
+static bool hkdstest_replica_failover(const char* path)
+{
+	const size_t SLOTS = 16;
+	const size_t MSGCNT = 3 * HKDS_CACHX8_DEPTH;
+	const uint8_t kid[HKDS_KID_SIZE] = { 0x01, 0x02, 0x03, 0x04 };
+	uint8_t exp[3 * HKDS_CACHX8_DEPTH + 1][HKDS_ASYNC_OUTPUT_SIZE] = { 0 };
+	hkds_async_request reqs[3 * HKDS_CACHX8_DEPTH + 1];
+	size_t order[3 * HKDS_CACHX8_DEPTH];
+	hkds_client_state cs[HKDS_CACHX8_DEPTH];
+	hkds_replica_log_state log = { 0 };
+	hkds_replica_standby_state stby = { 0 };
+	hkds_counter_table prim = { 0 };
+	hkds_counter_table sect = { 0 };
+	hkdstest_async_context ctx;
+	hkds_shard_state shs;
+	hkds_master_key mdk;
+	uint64_t rec;
+	uint64_t replays;
+	size_t wait;
+	bool res;
+
+	res = true;
+	hkds_server_generate_mdk(&qsc_csp_generate, &mdk, kid);
+	hkdstest_async_clients(&mdk, cs);
+	hkds_counter_initialize(&prim, SLOTS);
+	hkds_counter_initialize(&sect, SLOTS);
+
+	/* three authenticated messages from each device, and a fourth from the first device sent after the failover */
+	for (size_t i = 0; i <= MSGCNT; ++i)
+	{
+		qsc_memutils_clear((uint8_t*)&reqs[i], sizeof(hkds_async_request));
+		reqs[i].token = i;
+		reqs[i].operation = hkds_async_decrypt_verify;
+		qsc_memutils_copy(reqs[i].ksn, cs[i % HKDS_CACHX8_DEPTH].ksn, HKDS_KSN_SIZE);
+		qsc_csp_generate(exp[i], HKDS_MESSAGE_SIZE);
+		hkds_client_encrypt_authenticate_message(&cs[i % HKDS_CACHX8_DEPTH], exp[i], NULL, 0, reqs[i].message);
+	}
+
+	for (size_t i = 0; i < MSGCNT; ++i)
+	{
+		order[i] = i;
+	}
+
+	ctx.expected = (const uint8_t (*)[HKDS_ASYNC_OUTPUT_SIZE])exp;
+	ctx.count = 0;
+	ctx.errors = 0;
+
+	/* the primary shard logs the mark of every device it accepts */
+	if (hkds_replica_log_open(&log, &prim, path, 64) == false || hkds_replica_standby_open(&stby, &sect, path) == false ||
+		hkds_shard_initialize(&shs, &mdk, 2, 1, SLOTS, false, &hkdstest_async_callback, &ctx) == false)
+	{
+		qsctest_print_line("hkdstest_replica_test: failover start failure! -HRE13");
+		hkds_replica_standby_close(&stby);
+		hkds_replica_log_close(&log);
+		res = false;
+	}
+
+	if (res == true)
+	{
+		hkds_shard_attach_table(&shs, &prim, &log, &hkdstest_replica_slot, NULL);
+		res = hkdstest_replica_submit(&shs, &ctx, reqs, order, MSGCNT);
+		hkds_shard_dispose(&shs);
+		hkds_replica_log_close(&log);
+		wait = 0;
+
+		while (qsc_atomics_load64(&stby.received) != qsc_atomics_load64(&log.records) && wait < 5000)
+		{
+			qsc_async_thread_sleep(1);
+			++wait;
+		}
+
+		hkds_replica_standby_close(&stby);
+
+		if (res == false || ctx.errors != 0 || hkds_counter_read(&sect, 0, &rec) == false || rec != hkds_counter_from_ksn(reqs[MSGCNT - HKDS_CACHX8_DEPTH].ksn))
+		{
+			qsctest_print_line("hkdstest_replica_test: primary shard replication failure! -HRE14");
+			res = false;
+		}
+	}
+
+	/* the shard that takes over is seeded from the standby table; the replayed messages are rejected, and the next message is accepted */
+	if (res == true)
+	{
+		ctx.count = 0;
+		ctx.errors = 0;
+		order[0] = MSGCNT - HKDS_CACHX8_DEPTH;
+		order[1] = HKDS_CACHX8_DEPTH;
+		order[2] = MSGCNT;
+
+		if (hkds_shard_initialize(&shs, &mdk, 2, 1, SLOTS, false, &hkdstest_async_callback, &ctx) == true &&
+			hkds_shard_attach_table(&shs, &sect, NULL, &hkdstest_replica_slot, NULL) == true)
+		{
+			res = hkdstest_replica_submit(&shs, &ctx, reqs, order, 3);
+			replays = 0;
+
+			for (size_t i = 0; i < shs.wcount; ++i)
+			{
+				replays += shs.workers[i].replays;
+			}
+
+			hkds_shard_dispose(&shs);
+
+			if (res == false || ctx.errors != 2 || replays != 2 || hkds_counter_read(&sect, 0, &rec) == false ||
+				rec != hkds_counter_from_ksn(reqs[MSGCNT].ksn))
+			{
+				qsctest_print_line("hkdstest_replica_test: failover replay failure! -HRE15");
+				res = false;
+			}
+		}
+		else
+		{
+			qsctest_print_line("hkdstest_replica_test: failover start failure! -HRE13");
+			res = false;
+		}
+	}
+
+	hkds_counter_dispose(&sect);
+	hkds_counter_dispose(&prim);
+
+	return res;
+}
+
+bool hkdstest_replica_test()
+{
+	const char* path = "/tmp/hkdstest-replica.log";
+	const size_t SLOTS = 1024;
+	const size_t WRKCNT = 4;
+	hkds_replica_log_state log = { 0 };
+	hkds_replica_standby_state stby = { 0 };
+	hkdstest_replica_worker wrk[4] = { 0 };
+	qsc_thread thds[4] = { 0 };
+	hkds_counter_table prim = { 0 };
+	hkds_counter_table sect = { 0 };
+	hkds_counter_table bad = { 0 };
+	volatile uint64_t errors;
+	FILE* fp;
+	errno_t err;
+	uint64_t prec;
+	uint64_t srec;
+	size_t wait;
+	bool pres;
+	bool sres;
+	bool res;
+
+	errors = 0;
+	res = true;
+
+	hkds_counter_initialize(&prim, SLOTS);
+	hkds_counter_initialize(&sect, SLOTS);
+	hkds_counter_initialize(&bad, SLOTS / 2);
+
+	/* records accepted before the log is opened reach the standby through the opening snapshot */
+	for (size_t i = 0; i < SLOTS; i += 3)
+	{
+		hkds_counter_update(&prim, i, hkds_counter_pack(0, (uint32_t)i + 1));
+	}
+
+	/* a small ring, so that the servers overrun the writer and snapshots replace the dropped updates */
+	if (hkds_replica_log_open(&log, &prim, path, 8) == false)
+	{
+		qsctest_print_line("hkdstest_replica_test: log creation failure! -HRE1");
+		res = false;
+	}
+
+	if (res == true && hkds_replica_standby_open(&stby, &bad, path) == true)
+	{
+		hkds_replica_standby_close(&stby);
+		qsctest_print_line("hkdstest_replica_test: table size check failure! -HRE2");
+		res = false;
+	}
+
+	if (res == true)
+	{
+		if (hkds_replica_standby_open(&stby, &sect, path) == false)
+		{
+			qsctest_print_line("hkdstest_replica_test: standby open failure! -HRE3");
+			hkds_replica_log_close(&log);
+			res = false;
+		}
+	}
+
+	if (res == true)
+	{
+		for (size_t j = 0; j < WRKCNT; ++j)
+		{
+			wrk[j].log = &log;
+			wrk[j].base = j * (SLOTS / WRKCNT);
+			wrk[j].span = 97;
+			wrk[j].errors = &errors;
+			thds[j] = qsc_async_thread_create(&hkdstest_replica_updates, &wrk[j]);
+		}
+
+		for (size_t j = 0; j < WRKCNT; ++j)
+		{
+			qsc_async_thread_wait(thds[j]);
+		}
+
+		hkds_replica_log_close(&log);
+
+		if (qsc_atomics_load64(&errors) != 0)
+		{
+			qsctest_print_line("hkdstest_replica_test: primary update failure! -HRE4");
+			res = false;
+		}
+
+		/* the standby tails the log while it is running */
+		wait = 0;
+
+		while (qsc_atomics_load64(&stby.received) != qsc_atomics_load64(&log.records) && wait < 5000)
+		{
+			qsc_async_thread_sleep(1);
+			++wait;
+		}
+
+		if (qsc_atomics_load64(&stby.received) != qsc_atomics_load64(&log.records))
+		{
+			qsctest_print_line("hkdstest_replica_test: log tailing failure! -HRE5");
+			res = false;
+		}
+
+		hkds_replica_standby_close(&stby);
+
+		/* the standby takes over with the replay state of every device */
+		for (size_t i = 0; i < SLOTS && res == true; ++i)
+		{
+			pres = hkds_counter_read(&prim, i, &prec);
+			sres = hkds_counter_read(&sect, i, &srec);
+
+			if (pres != sres || (pres == true && prec != srec))
+			{
+				qsctest_print_line("hkdstest_replica_test: standby record failure! -HRE6");
+				res = false;
+			}
+		}
+
+		if (res == true)
+		{
+			if (hkds_counter_update(&sect, 23, hkds_counter_pack(1, 4000)) == true ||
+				hkds_counter_update(&sect, 23, hkds_counter_pack(1, 4001)) == false)
+			{
+				qsctest_print_line("hkdstest_replica_test: standby replay check failure! -HRE7");
+				res = false;
+			}
+		}
+	}
+
+	/* a log that grows past the compaction bound is replaced by a snapshot, and the standby follows it to the new log */
+	if (res == true)
+	{
+		if (hkds_replica_log_open(&log, &prim, path, 4096) == false)
+		{
+			qsctest_print_line("hkdstest_replica_test: log creation failure! -HRE8");
+			res = false;
+		}
+		else if (hkds_replica_standby_open(&stby, &sect, path) == false)
+		{
+			qsctest_print_line("hkdstest_replica_test: standby open failure! -HRE9");
+			hkds_replica_log_close(&log);
+			res = false;
+		}
+	}
+
+	if (res == true)
+	{
+		for (size_t i = 0; i < HKDS_REPLICA_COMPACT_RATIO * 2 * SLOTS; ++i)
+		{
+			hkds_replica_update(&log, i % SLOTS, hkds_counter_pack(2, (uint32_t)(i / SLOTS) + 1));
+		}
+
+		hkds_replica_log_close(&log);
+		wait = 0;
+
+		while (qsc_atomics_load64(&stby.received) != qsc_atomics_load64(&log.records) && wait < 5000)
+		{
+			qsc_async_thread_sleep(1);
+			++wait;
+		}
+
+		hkds_replica_standby_close(&stby);
+
+		if (qsc_atomics_load64(&log.compactions) == 0 || qsc_atomics_load64(&stby.compactions) != qsc_atomics_load64(&log.compactions) ||
+			qsc_atomics_load64(&stby.received) != qsc_atomics_load64(&log.records) ||
+			qsc_filetools_file_size(path) > HKDS_REPLICA_HEADER_SIZE + ((HKDS_REPLICA_COMPACT_RATIO + 2) * SLOTS * HKDS_REPLICA_RECORD_SIZE))
+		{
+			qsctest_print_line("hkdstest_replica_test: log compaction failure! -HRE10");
+			res = false;
+		}
+
+		for (size_t i = 0; i < SLOTS && res == true; ++i)
+		{
+			pres = hkds_counter_read(&prim, i, &prec);
+			sres = hkds_counter_read(&sect, i, &srec);
+
+			if (pres != sres || (pres == true && prec != srec))
+			{
+				qsctest_print_line("hkdstest_replica_test: compacted standby record failure! -HRE11");
+				res = false;
+			}
+		}
+	}
+
+	/* records that fail to reach the file are not counted as replicated */
+	if (res == true && hkds_replica_log_open(&log, &bad, path, 8) == true)
+	{
+		prec = qsc_atomics_load64(&log.records);
+		fp = log.fp;
+		log.fp = qsc_filetools_open_file("/dev/full", "wb", &err);
+
+		if (log.fp != NULL)
+		{
+			for (size_t i = 0; i < SLOTS / 2; ++i)
+			{
+				hkds_replica_update(&log, i, hkds_counter_pack(1, 1));
+			}
+
+			wait = 0;
+
+			while (qsc_atomics_load64(&log.failures) == 0 && wait < 5000)
+			{
+				qsc_async_thread_sleep(1);
+				++wait;
+			}
+
+			hkds_replica_log_close(&log);
+
+			if (qsc_atomics_load64(&log.failures) == 0 || qsc_atomics_load64(&log.records) != prec)
+			{
+				qsctest_print_line("hkdstest_replica_test: write failure check failure! -HRE12");
+				res = false;
+			}
+		}
+		else
+		{
+			log.fp = fp;
+			fp = NULL;
+			hkds_replica_log_close(&log);
+		}
+
+		if (fp != NULL)
+		{
+			fclose(fp);
+		}
+	}
+
+	/* a second shard server takes over from the replicated table, and rejects the messages the first one accepted */
+	if (res == true)
+	{
+		res = hkdstest_replica_failover(path);
+	}
+
+	hkds_counter_dispose(&bad);
+	hkds_counter_dispose(&sect);
+	hkds_counter_dispose(&prim);
+	remove(path);
+
+	return res;
+}
+
 void hkdstest_test_run()
 {
 	if (hkdstest_kat_test() == true)
@@ -1227,4 +5326,211 @@ void hkdstest_test_run()
 	{
 		qsctest_print_line("Failure! Failed the HKDS parallel authentication and encryption equivalence test.");
 	}
+
+	if (hkdstest_counter_test() == true)
+	{
+		qsctest_print_line("Success! Passed the HKDS counter high-water test.");
+	}
+	else
+	{
+		qsctest_print_line("Failure! Failed the HKDS counter high-water test.");
+	}
+
+	if (hkdstest_tokencache_test() == true)
+	{
+		qsctest_print_line("Success! Passed the HKDS token cache test.");
+	}
+	else
+	{
+		qsctest_print_line("Failure! Failed the HKDS token cache test.");
+	}
+
+	if (hkdstest_token_push_test() == true)
+	{
+		qsctest_print_line("Success! Passed the HKDS token push test.");
+	}
+	else
+	{
+		qsctest_print_line("Failure! Failed the HKDS token push test.");
+	}
+
+	if (hkdstest_precompute_test() == true)
+	{
+		qsctest_print_line("Success! Passed the HKDS precompute test.");
+	}
+	else
+	{
+		qsctest_print_line("Failure! Failed the HKDS precompute test.");
+	}
+
+	if (hkdstest_batch_test() == true)
+	{
+		qsctest_print_line("Success! Passed the HKDS batching stage test.");
+	}
+	else
+	{
+		qsctest_print_line("Failure! Failed the HKDS batching stage test.");
+	}
+
+	if (hkdstest_async_test() == true)
+	{
+		qsctest_print_line("Success! Passed the HKDS asynchronous engine test.");
+	}
+	else
+	{
+		qsctest_print_line("Failure! Failed the HKDS asynchronous engine test.");
+	}
+
+	if (hkdstest_scheduler_test() == true)
+	{
+		qsctest_print_line("Success! Passed the HKDS work-stealing scheduler test.");
+	}
+	else
+	{
+		qsctest_print_line("Failure! Failed the HKDS work-stealing scheduler test.");
+	}
+
+	if (hkdstest_shard_test() == true)
+	{
+		qsctest_print_line("Success! Passed the HKDS shard worker test.");
+	}
+	else
+	{
+		qsctest_print_line("Failure! Failed the HKDS shard worker test.");
+	}
+
+	if (hkdstest_queue_test() == true)
+	{
+		qsctest_print_line("Success! Passed the HKDS message queue test.");
+	}
+	else
+	{
+		qsctest_print_line("Failure! Failed the HKDS message queue test.");
+	}
+
+	if (hkdstest_queue_mpmc_test() == true)
+	{
+		qsctest_print_line("Success! Passed the HKDS lock-free queue test.");
+	}
+	else
+	{
+		qsctest_print_line("Failure! Failed the HKDS lock-free queue test.");
+	}
+
+	if (hkdstest_jobs_test() == true)
+	{
+		qsctest_print_line("Success! Passed the HKDS lane packing job manager test.");
+	}
+	else
+	{
+		qsctest_print_line("Failure! Failed the HKDS lane packing job manager test.");
+	}
+
+	if (hkdstest_priority_test() == true)
+	{
+		qsctest_print_line("Success! Passed the HKDS priority scheduler test.");
+	}
+	else
+	{
+		qsctest_print_line("Failure! Failed the HKDS priority scheduler test.");
+	}
+
+	if (hkdstest_admission_test() == true)
+	{
+		qsctest_print_line("Success! Passed the HKDS admission control test.");
+	}
+	else
+	{
+		qsctest_print_line("Failure! Failed the HKDS admission control test.");
+	}
+
+	if (hkdstest_wire_test() == true)
+	{
+		qsctest_print_line("Success! Passed the HKDS wire format test.");
+	}
+	else
+	{
+		qsctest_print_line("Failure! Failed the HKDS wire format test.");
+	}
+
+	if (hkdstest_response_test() == true)
+	{
+		qsctest_print_line("Success! Passed the HKDS batched response builder test.");
+	}
+	else
+	{
+		qsctest_print_line("Failure! Failed the HKDS batched response builder test.");
+	}
+
+	if (hkdstest_network_test() == true)
+	{
+		qsctest_print_line("Success! Passed the HKDS reactor network server test.");
+	}
+	else
+	{
+		qsctest_print_line("Failure! Failed the HKDS reactor network server test.");
+	}
+
+	if (hkdstest_udp_test() == true)
+	{
+		qsctest_print_line("Success! Passed the HKDS datagram server test.");
+	}
+	else
+	{
+		qsctest_print_line("Failure! Failed the HKDS datagram server test.");
+	}
+
+	if (hkdstest_pipeline_test() == true)
+	{
+		qsctest_print_line("Success! Passed the HKDS request pipelining test.");
+	}
+	else
+	{
+		qsctest_print_line("Failure! Failed the HKDS request pipelining test.");
+	}
+
+	if (hkdstest_timer_test() == true)
+	{
+		qsctest_print_line("Success! Passed the HKDS timer wheel test.");
+	}
+	else
+	{
+		qsctest_print_line("Failure! Failed the HKDS timer wheel test.");
+	}
+
+	if (hkdstest_bufferpool_test() == true)
+	{
+		qsctest_print_line("Success! Passed the HKDS buffer pool test.");
+	}
+	else
+	{
+		qsctest_print_line("Failure! Failed the HKDS buffer pool test.");
+	}
+
+	if (hkdstest_ipc_test() == true)
+	{
+		qsctest_print_line("Success! Passed the HKDS shared memory channel test.");
+	}
+	else
+	{
+		qsctest_print_line("Failure! Failed the HKDS shared memory channel test.");
+	}
+
+	if (hkdstest_router_test() == true)
+	{
+		qsctest_print_line("Success! Passed the HKDS router test.");
+	}
+	else
+	{
+		qsctest_print_line("Failure! Failed the HKDS router test.");
+	}
+
+	if (hkdstest_replica_test() == true)
+	{
+		qsctest_print_line("Success! Passed the HKDS replication test.");
+	}
+	else
+	{
+		qsctest_print_line("Failure! Failed the HKDS replication test.");
+	}
 }
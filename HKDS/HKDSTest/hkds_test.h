@@ -66,6 +66,167 @@ bool hkdstest_simd_authencrypt_equivalence_test(void);
 */
 bool hkdstest_parallel_authencrypt_equivalence_test(void);
 
+/**
+* \brief Tests the device counter high-water table for replay rejection and batch update correctness
+*
+* \return Returns true for test success
+*/
+bool hkdstest_counter_test(void);
+
+/**
+* \brief Tests the token cache for hit, coalescing, and expiry correctness
+*
+* \return Returns true for test success
+*/
+bool hkdstest_tokencache_test(void);
+
+/**
+* \brief Tests the server pushed next epoch token for operational correctness
+*
+* \return Returns true for test success
+*/
+bool hkdstest_token_push_test(void);
+
+/**
+* \brief Tests the next epoch precomputation for operational correctness
+*
+* \return Returns true for test success
+*/
+bool hkdstest_precompute_test(void);
+
+/**
+* \brief Test the latency-bounded batching stage
+*
+* \return Returns true for test success
+*/
+bool hkdstest_batch_test(void);
+
+/**
+* \brief Test the asynchronous submission and completion engine
+*
+* \return Returns true for test success
+*/
+bool hkdstest_async_test(void);
+
+/**
+* \brief Test the work-stealing scheduler and the scheduled x8 functions
+*
+* \return Returns true for test success
+*/
+bool hkdstest_scheduler_test(void);
+
+/**
+* \brief Test the core-pinned device sharded workers against client messages, the replay window and the device key cache
+*
+* \return Returns true for test success
+*/
+bool hkdstest_shard_test(void);
+
+/**
+* \brief Test the ring buffer message queue with block extraction across the end of the ring
+*
+* \return Returns true for test success
+*/
+bool hkdstest_queue_test(void);
+
+/**
+* \brief Test the lock-free multi-producer multi-consumer queue with concurrent producers and consumers
+*
+* \return Returns true for test success
+*/
+bool hkdstest_queue_mpmc_test(void);
+
+/**
+* \brief Test the lane packing job manager with mixed traffic from several master keys and request classes
+*
+* \return Returns true for test success
+*/
+bool hkdstest_jobs_test(void);
+
+/**
+* \brief Test the weighted priority scheduler with a token request storm queued ahead of message traffic
+*
+* \return Returns true for test success
+*/
+bool hkdstest_priority_test(void);
+
+/**
+* \brief Test the cost model admission controller under overload
+*
+* \return Returns true for test success
+*/
+bool hkdstest_admission_test(void);
+
+/**
+* \brief Test the byte-exact wire views, the factory serialization and the batch packet parser
+*
+* \return Returns true for test success
+*/
+bool hkdstest_wire_test(void);
+
+/**
+* \brief Test the batched response builder in contiguous and vectored framing
+*
+* \return Returns true for test success
+*/
+bool hkdstest_response_test(void);
+
+/**
+* \brief Test the reactor driven network server with persistent terminal connections, on one listener and on several reuse port listeners
+*
+* \return Returns true for test success
+*/
+bool hkdstest_network_test(void);
+
+/**
+* \brief Test the datagram server with batched receives and sends, repeated requests, and mixed datagrams
+*
+* \return Returns true for test success
+*/
+bool hkdstest_udp_test(void);
+
+/**
+* \brief Test pipelined requests on one connection, answered out of order and matched by sequence
+*
+* \return Returns true for test success
+*/
+bool hkdstest_pipeline_test(void);
+
+/**
+* \brief Test the timer wheel, the batch deadline timer, and the reactor idle timeout
+*
+* \return Returns true for test success
+*/
+bool hkdstest_timer_test(void);
+
+/**
+* \brief Test the buffer pool slab growth, and the reference counted hand-off of buffers between threads
+*
+* \return Returns true for test success
+*/
+bool hkdstest_bufferpool_test(void);
+
+/**
+* \brief Test the shared memory channel between a front end and an engine
+*
+* \return Returns true for test success
+*/
+bool hkdstest_ipc_test(void);
+
+/**
+* \brief Test the device sharding router and its backend servers
+*
+* \return Returns true for test success
+*/
+bool hkdstest_router_test(void);
+
+/**
+* \brief Test the replication of the counter table to a standby through the log
+*
+* \return Returns true for test success
+*/
+bool hkdstest_replica_test(void);
+
 /**
 * \brief Run all tests
 */
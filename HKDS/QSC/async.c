@@ -1,5 +1,12 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#	define _GNU_SOURCE
+#endif
 #include "cpuidex.h"
 #include "async.h"
+#if defined(QSC_SYSTEM_OS_POSIX)
+#	include <sched.h>
+#	include <time.h>
+#endif
 
 void qsc_async_launch_thread(void (*func)(void*), void* state)
 {
@@ -120,6 +127,33 @@ size_t qsc_async_processor_count()
 	return cpus;
 }
 
+bool qsc_async_thread_affinity(size_t cpu)
+{
+	bool res;
+
+	res = false;
+
+#if defined(QSC_SYSTEM_OS_WINDOWS)
+	if (cpu < sizeof(DWORD_PTR) * 8)
+	{
+		res = (SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0);
+	}
+#elif defined(QSC_SYSTEM_OS_LINUX)
+	cpu_set_t set;
+
+	if (cpu < CPU_SETSIZE)
+	{
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		res = (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set) == 0);
+	}
+#else
+	(void)cpu;
+#endif
+
+	return res;
+}
+
 qsc_thread qsc_async_thread_create(void (*func)(void*), void* state)
 {
 	assert(func != NULL);
@@ -204,7 +238,11 @@ void qsc_async_thread_sleep(uint32_t msec)
 		hthd = GetCurrentThread();
 		WaitForSingleObject(hthd, msec);
 #elif defined(QSC_SYSTEM_OS_POSIX)
-		sleep(msec * 1000);
+		struct timespec ts;
+
+		ts.tv_sec = (time_t)(msec / 1000);
+		ts.tv_nsec = (long)(msec % 1000) * 1000000L;
+		nanosleep(&ts, NULL);
 #endif
 	}
 }
@@ -284,3 +322,12 @@ void qsc_async_thread_wait_all(qsc_thread* handles, size_t count)
 #endif
 	}
 }
+
+void qsc_async_thread_yield()
+{
+#if defined(QSC_SYSTEM_OS_WINDOWS)
+	SwitchToThread();
+#elif defined(QSC_SYSTEM_OS_POSIX)
+	sched_yield();
+#endif
+}
@@ -122,6 +122,14 @@ QSC_EXPORT_API void qsc_async_mutex_unlock_ex(qsc_mutex mtx);
 */
 QSC_EXPORT_API size_t qsc_async_processor_count(void);
 
+/**
+* \brief Pin the calling thread to a processor
+*
+* \param cpu: The processor index
+* \return Returns true if the thread affinity was set
+*/
+QSC_EXPORT_API bool qsc_async_thread_affinity(size_t cpu);
+
 /**
 * \brief Create a thread with one parameter
 *
@@ -183,4 +191,9 @@ QSC_EXPORT_API void qsc_async_thread_wait(qsc_thread handle);
 */
 QSC_EXPORT_API void qsc_async_thread_wait_all(qsc_thread* handles, size_t count);
 
+/**
+* \brief Yield the remainder of the calling threads time slice to another ready thread
+*/
+QSC_EXPORT_API void qsc_async_thread_yield(void);
+
 #endif
@@ -0,0 +1,200 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#	define _GNU_SOURCE
+#endif
+#include "atomics.h"
+
+#if defined(QSC_SYSTEM_OS_WINDOWS)
+#	include <Windows.h>
+#	if defined(QSC_SYSTEM_COMPILER_MSC)
+#		pragma comment(lib, "Synchronization.lib")
+#	endif
+#elif defined(QSC_SYSTEM_OS_LINUX)
+#	include <linux/futex.h>
+#	include <sys/syscall.h>
+#	include <time.h>
+#	include <unistd.h>
+#else
+#	include <time.h>
+#endif
+#if defined(QSC_SYSTEM_COMPILER_MSC)
+#	include <intrin.h>
+#	if defined(QSC_SYSTEM_ARCH_X86_X64)
+#		pragma intrinsic(_InterlockedCompareExchange64, _InterlockedExchange64, _InterlockedExchangeAdd64, _mm_pause)
+#	endif
+#endif
+
+uint64_t qsc_atomics_load64(const volatile uint64_t* target)
+{
+	assert(target != NULL);
+
+	uint64_t res;
+
+#if defined(QSC_SYSTEM_COMPILER_MSC)
+#	if defined(QSC_SYSTEM_IS_X64)
+	/* aligned 64-bit loads are atomic on x64, msvc volatile reads have acquire semantics */
+	res = *target;
+	_ReadWriteBarrier();
+#	else
+	res = (uint64_t)_InterlockedCompareExchange64((volatile __int64*)target, 0, 0);
+#	endif
+#else
+	res = __atomic_load_n(target, __ATOMIC_ACQUIRE);
+#endif
+
+	return res;
+}
+
+void qsc_atomics_store64(volatile uint64_t* target, uint64_t value)
+{
+	assert(target != NULL);
+
+#if defined(QSC_SYSTEM_COMPILER_MSC)
+#	if defined(QSC_SYSTEM_IS_X64)
+	_ReadWriteBarrier();
+	*target = value;
+#	else
+	_InterlockedExchange64((volatile __int64*)target, (__int64)value);
+#	endif
+#else
+	__atomic_store_n(target, value, __ATOMIC_RELEASE);
+#endif
+}
+
+bool qsc_atomics_compare_exchange64(volatile uint64_t* target, uint64_t* expected, uint64_t desired)
+{
+	assert(target != NULL);
+	assert(expected != NULL);
+
+	bool res;
+
+#if defined(QSC_SYSTEM_COMPILER_MSC)
+	uint64_t prev;
+
+	prev = (uint64_t)_InterlockedCompareExchange64((volatile __int64*)target, (__int64)desired, (__int64)*expected);
+	res = (prev == *expected);
+
+	if (res == false)
+	{
+		*expected = prev;
+	}
+#else
+	res = __atomic_compare_exchange_n(target, expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+
+	return res;
+}
+
+uint64_t qsc_atomics_exchange64(volatile uint64_t* target, uint64_t value)
+{
+	assert(target != NULL);
+
+	uint64_t res;
+
+#if defined(QSC_SYSTEM_COMPILER_MSC)
+	res = (uint64_t)_InterlockedExchange64((volatile __int64*)target, (__int64)value);
+#else
+	res = __atomic_exchange_n(target, value, __ATOMIC_SEQ_CST);
+#endif
+
+	return res;
+}
+
+uint64_t qsc_atomics_fetch_add64(volatile uint64_t* target, uint64_t value)
+{
+	assert(target != NULL);
+
+	uint64_t res;
+
+#if defined(QSC_SYSTEM_COMPILER_MSC)
+	res = (uint64_t)_InterlockedExchangeAdd64((volatile __int64*)target, (__int64)value);
+#else
+	res = __atomic_fetch_add(target, value, __ATOMIC_SEQ_CST);
+#endif
+
+	return res;
+}
+
+uint64_t qsc_atomics_fetch_max64(volatile uint64_t* target, uint64_t value)
+{
+	assert(target != NULL);
+
+	uint64_t cur;
+
+	cur = qsc_atomics_load64(target);
+
+	/* on failure cur is refreshed with the competing value; stop as soon as it is no longer smaller */
+	while (cur < value)
+	{
+		if (qsc_atomics_compare_exchange64(target, &cur, value) == true)
+		{
+			break;
+		}
+	}
+
+	return cur;
+}
+
+void qsc_atomics_wait64(const volatile uint64_t* target, uint64_t value, uint32_t milliseconds)
+{
+	assert(target != NULL);
+
+#if defined(QSC_SYSTEM_OS_WINDOWS)
+	WaitOnAddress((volatile VOID*)target, &value, sizeof(uint64_t), (DWORD)milliseconds);
+#elif defined(QSC_SYSTEM_OS_LINUX)
+	struct timespec ts;
+	const volatile uint32_t* word;
+
+	/* the futex is the low order half of the integer */
+	word = (const volatile uint32_t*)target + ((QSC_SYSTEM_IS_LITTLE_ENDIAN) ? 0 : 1);
+	ts.tv_sec = (time_t)(milliseconds / 1000);
+	ts.tv_nsec = (long)(milliseconds % 1000) * 1000000L;
+	syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, (uint32_t)value, &ts, NULL, 0);
+#else
+	struct timespec ts;
+
+	if (qsc_atomics_load64(target) == value && milliseconds != 0)
+	{
+		ts.tv_sec = 0;
+		ts.tv_nsec = 1000000L;
+		nanosleep(&ts, NULL);
+	}
+#endif
+}
+
+void qsc_atomics_wake64(volatile uint64_t* target)
+{
+	assert(target != NULL);
+
+#if defined(QSC_SYSTEM_OS_WINDOWS)
+	WakeByAddressAll((PVOID)target);
+#elif defined(QSC_SYSTEM_OS_LINUX)
+	volatile uint32_t* word;
+
+	word = (volatile uint32_t*)target + ((QSC_SYSTEM_IS_LITTLE_ENDIAN) ? 0 : 1);
+	syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, INT32_MAX, NULL, NULL, 0);
+#else
+	(void)target;
+#endif
+}
+
+void qsc_atomics_fence(void)
+{
+#if defined(QSC_SYSTEM_COMPILER_MSC)
+	MemoryBarrier();
+#else
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+#endif
+}
+
+void qsc_atomics_pause(void)
+{
+#if defined(QSC_SYSTEM_COMPILER_MSC) && defined(QSC_SYSTEM_ARCH_X86_X64)
+	_mm_pause();
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	__builtin_ia32_pause();
+#elif defined(__GNUC__) && defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#else
+	qsc_atomics_fence();
+#endif
+}
@@ -0,0 +1,116 @@
+/* The AGPL version 3 License (AGPLv3)
+*
+* Copyright (c) 2021 Digital Freedom Defence Inc.
+* This file is part of the QSC Cryptographic library
+*
+* This program is free software : you can redistribute it and / or modify
+* it under the terms of the GNU Affero General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU Affero General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef QSC_ATOMICS_H
+#define QSC_ATOMICS_H
+
+#include "common.h"
+
+/**
+* \file atomics.h
+* \brief Portable 64-bit atomic memory operations.
+* The load operations have acquire semantics, the store operations have release semantics,
+* and the read-modify-write operations are sequentially consistent.
+* All targets must be naturally (8 byte) aligned.
+*/
+
+/**
+* \brief Atomically load a 64-bit integer
+*
+* \param target: [const] A pointer to the integer
+* \return The current value
+*/
+QSC_EXPORT_API uint64_t qsc_atomics_load64(const volatile uint64_t* target);
+
+/**
+* \brief Atomically store a 64-bit integer
+*
+* \param target: A pointer to the integer
+* \param value: The value to store
+*/
+QSC_EXPORT_API void qsc_atomics_store64(volatile uint64_t* target, uint64_t value);
+
+/**
+* \brief Atomically compare a 64-bit integer with an expected value, and if equal replace it with the desired value.
+* On failure the expected value is updated with the current value of the target.
+*
+* \param target: A pointer to the integer
+* \param expected: A pointer to the expected value
+* \param desired: The replacement value
+* \return Returns true if the target was replaced
+*/
+QSC_EXPORT_API bool qsc_atomics_compare_exchange64(volatile uint64_t* target, uint64_t* expected, uint64_t desired);
+
+/**
+* \brief Atomically replace a 64-bit integer, and return the previous value
+*
+* \param target: A pointer to the integer
+* \param value: The value to store
+* \return The previous value
+*/
+QSC_EXPORT_API uint64_t qsc_atomics_exchange64(volatile uint64_t* target, uint64_t value);
+
+/**
+* \brief Atomically add to a 64-bit integer, and return the previous value
+*
+* \param target: A pointer to the integer
+* \param value: The value to add
+* \return The previous value
+*/
+QSC_EXPORT_API uint64_t qsc_atomics_fetch_add64(volatile uint64_t* target, uint64_t value);
+
+/**
+* \brief Atomically raise a 64-bit integer to a value if the value is larger (monotonic maximum).
+*
+* \param target: A pointer to the integer
+* \param value: The candidate maximum
+* \return The value held by the target before the operation
+*/
+QSC_EXPORT_API uint64_t qsc_atomics_fetch_max64(volatile uint64_t* target, uint64_t value);
+
+/**
+* \brief Block the calling thread while a 64-bit integer holds a value, or until the timeout expires.
+* The wait can also end without a change, so the caller reads the integer again after it returns.
+* Used with an integer that is advanced by one on each event; on Linux the wait compares the low order 32 bits,
+* on systems without an address wait it is a sleep of at most one millisecond.
+*
+* \param target: [const] A pointer to the integer
+* \param value: The value the thread waits to change
+* \param milliseconds: The maximum wait time in milliseconds
+*/
+QSC_EXPORT_API void qsc_atomics_wait64(const volatile uint64_t* target, uint64_t value, uint32_t milliseconds);
+
+/**
+* \brief Wake every thread waiting on a 64-bit integer with qsc_atomics_wait64
+*
+* \param target: A pointer to the integer
+*/
+QSC_EXPORT_API void qsc_atomics_wake64(volatile uint64_t* target);
+
+/**
+* \brief A full memory barrier
+*/
+QSC_EXPORT_API void qsc_atomics_fence(void);
+
+/**
+* \brief A processor spin-wait hint, used inside busy-wait loops
+*/
+QSC_EXPORT_API void qsc_atomics_pause(void);
+
+#endif
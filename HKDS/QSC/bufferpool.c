@@ -0,0 +1,279 @@
+#include "bufferpool.h"
+#include "atomics.h"
+#include "memutils.h"
+
+static qsc_bufferpool_buffer* qsc_bufferpool_lookup(const qsc_bufferpool_state* state, uint32_t index)
+{
+	return &state->slabs[index / QSC_BUFFERPOOL_SLAB_BUFFERS][index % QSC_BUFFERPOOL_SLAB_BUFFERS];
+}
+
+static void qsc_bufferpool_push(qsc_bufferpool_state* state, qsc_bufferpool_buffer* buffer)
+{
+	uint64_t head;
+	uint64_t next;
+	bool res;
+
+	res = false;
+
+	/* the change counter in the high half of the head prevents a stale pop from succeeding */
+	while (res == false)
+	{
+		head = qsc_atomics_load64(&state->head);
+		buffer->next = (uint32_t)head;
+		next = (((head >> 32) + 1) << 32) | ((uint64_t)buffer->index + 1);
+		res = qsc_atomics_compare_exchange64(&state->head, &head, next);
+	}
+
+	qsc_atomics_fetch_add64(&state->available, 1);
+}
+
+static qsc_bufferpool_buffer* qsc_bufferpool_pop(qsc_bufferpool_state* state)
+{
+	qsc_bufferpool_buffer* buf;
+	uint64_t head;
+	uint64_t next;
+	bool res;
+
+	buf = NULL;
+	res = false;
+
+	while (res == false)
+	{
+		head = qsc_atomics_load64(&state->head);
+
+		if ((uint32_t)head == 0)
+		{
+			buf = NULL;
+			res = true;
+		}
+		else
+		{
+			/* the slabs are never released while the pool is in use, so a stale next value is only discarded */
+			buf = qsc_bufferpool_lookup(state, (uint32_t)head - 1);
+			next = (((head >> 32) + 1) << 32) | buf->next;
+			res = qsc_atomics_compare_exchange64(&state->head, &head, next);
+		}
+	}
+
+	if (buf != NULL)
+	{
+		qsc_atomics_fetch_add64(&state->available, (uint64_t)-1);
+	}
+
+	return buf;
+}
+
+static bool qsc_bufferpool_grow(qsc_bufferpool_state* state)
+{
+	qsc_bufferpool_buffer* desc;
+	uint8_t* block;
+	size_t count;
+	size_t i;
+	bool res;
+
+	res = false;
+	count = (size_t)qsc_atomics_load64(&state->count);
+
+	if (count < state->maximum)
+	{
+		desc = (qsc_bufferpool_buffer*)qsc_memutils_malloc(QSC_BUFFERPOOL_SLAB_BUFFERS * sizeof(qsc_bufferpool_buffer));
+		block = (uint8_t*)qsc_memutils_aligned_alloc(QSC_BUFFERPOOL_ALIGNMENT, QSC_BUFFERPOOL_SLAB_BUFFERS * state->stride);
+
+		if (desc != NULL && block != NULL)
+		{
+			qsc_memutils_clear(desc, QSC_BUFFERPOOL_SLAB_BUFFERS * sizeof(qsc_bufferpool_buffer));
+
+			for (i = 0; i < QSC_BUFFERPOOL_SLAB_BUFFERS; ++i)
+			{
+				desc[i].data = block + (i * state->stride);
+				desc[i].pool = state;
+				desc[i].index = (uint32_t)(count + i);
+			}
+
+			state->slabs[count / QSC_BUFFERPOOL_SLAB_BUFFERS] = desc;
+			qsc_atomics_store64(&state->count, count + QSC_BUFFERPOOL_SLAB_BUFFERS);
+
+			/* pushed in reverse, so the buffers are taken in address order */
+			for (i = QSC_BUFFERPOOL_SLAB_BUFFERS; i > 0; --i)
+			{
+				qsc_bufferpool_push(state, &desc[i - 1]);
+			}
+
+			res = true;
+		}
+		else
+		{
+			if (desc != NULL)
+			{
+				qsc_memutils_alloc_free(desc);
+			}
+
+			if (block != NULL)
+			{
+				qsc_memutils_aligned_free(block);
+			}
+		}
+	}
+
+	return res;
+}
+
+bool qsc_bufferpool_initialize(qsc_bufferpool_state* state, size_t size, size_t maximum)
+{
+	assert(state != NULL);
+	assert(size != 0);
+
+	size_t slabs;
+	bool res;
+
+	res = false;
+
+	if (state != NULL && size != 0)
+	{
+		qsc_memutils_clear(state, sizeof(qsc_bufferpool_state));
+		/* the buffer indices are 32 bits, with zero marking the end of the free stack */
+		maximum = (maximum > (size_t)UINT32_MAX - QSC_BUFFERPOOL_SLAB_BUFFERS) ? (size_t)UINT32_MAX - QSC_BUFFERPOOL_SLAB_BUFFERS : maximum;
+		slabs = (maximum + QSC_BUFFERPOOL_SLAB_BUFFERS - 1) / QSC_BUFFERPOOL_SLAB_BUFFERS;
+		slabs = (slabs == 0) ? 1 : slabs;
+		state->maximum = slabs * QSC_BUFFERPOOL_SLAB_BUFFERS;
+		state->size = size;
+		state->stride = (size + QSC_BUFFERPOOL_ALIGNMENT - 1) & ~((size_t)QSC_BUFFERPOOL_ALIGNMENT - 1);
+		state->slabs = (qsc_bufferpool_buffer**)qsc_memutils_malloc(slabs * sizeof(qsc_bufferpool_buffer*));
+
+		if (state->slabs != NULL)
+		{
+			qsc_memutils_clear(state->slabs, slabs * sizeof(qsc_bufferpool_buffer*));
+			res = qsc_bufferpool_grow(state);
+
+			if (res == false)
+			{
+				qsc_memutils_alloc_free(state->slabs);
+				state->slabs = NULL;
+			}
+		}
+	}
+
+	return res;
+}
+
+void qsc_bufferpool_dispose(qsc_bufferpool_state* state)
+{
+	assert(state != NULL);
+	assert(state == NULL || state->slabs == NULL || state->available == state->count);
+
+	size_t i;
+
+	if (state != NULL && state->slabs != NULL)
+	{
+		for (i = 0; i < (size_t)state->count / QSC_BUFFERPOOL_SLAB_BUFFERS; ++i)
+		{
+			/* the first buffer of a slab is the start of its aligned block */
+			qsc_memutils_aligned_free(state->slabs[i][0].data);
+			qsc_memutils_alloc_free(state->slabs[i]);
+		}
+
+		qsc_memutils_alloc_free(state->slabs);
+		qsc_memutils_clear(state, sizeof(qsc_bufferpool_state));
+	}
+}
+
+qsc_bufferpool_buffer* qsc_bufferpool_acquire(qsc_bufferpool_state* state)
+{
+	assert(state != NULL);
+
+	qsc_bufferpool_buffer* buf;
+	bool more;
+
+	buf = NULL;
+
+	if (state != NULL && state->slabs != NULL)
+	{
+		more = true;
+		buf = qsc_bufferpool_pop(state);
+
+		/* one thread adds a slab when the pool is empty, the others wait for its buffers */
+		while (buf == NULL && more == true)
+		{
+			if (qsc_atomics_exchange64(&state->growing, 1) == 0)
+			{
+				buf = qsc_bufferpool_pop(state);
+
+				if (buf == NULL)
+				{
+					more = qsc_bufferpool_grow(state);
+				}
+
+				qsc_atomics_store64(&state->growing, 0);
+			}
+			else
+			{
+				qsc_atomics_pause();
+			}
+
+			if (buf == NULL)
+			{
+				buf = qsc_bufferpool_pop(state);
+			}
+		}
+
+		if (buf != NULL)
+		{
+			qsc_atomics_store64(&buf->references, 1);
+			buf->length = 0;
+		}
+	}
+
+	return buf;
+}
+
+void qsc_bufferpool_retain(qsc_bufferpool_buffer* buffer)
+{
+	assert(buffer != NULL);
+
+	if (buffer != NULL)
+	{
+		qsc_atomics_fetch_add64(&buffer->references, 1);
+	}
+}
+
+void qsc_bufferpool_release(qsc_bufferpool_buffer* buffer)
+{
+	assert(buffer != NULL);
+
+	if (buffer != NULL && qsc_atomics_fetch_add64(&buffer->references, (uint64_t)-1) == 1)
+	{
+		qsc_bufferpool_push((qsc_bufferpool_state*)buffer->pool, buffer);
+	}
+}
+
+size_t qsc_bufferpool_available(const qsc_bufferpool_state* state)
+{
+	assert(state != NULL);
+
+	size_t res;
+
+	res = 0;
+
+	if (state != NULL)
+	{
+		res = (size_t)qsc_atomics_load64(&state->available);
+	}
+
+	return res;
+}
+
+size_t qsc_bufferpool_capacity(const qsc_bufferpool_state* state)
+{
+	assert(state != NULL);
+
+	size_t res;
+
+	res = 0;
+
+	if (state != NULL)
+	{
+		res = (size_t)qsc_atomics_load64(&state->count);
+	}
+
+	return res;
+}
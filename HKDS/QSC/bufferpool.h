@@ -0,0 +1,145 @@
+/* The AGPL version 3 License (AGPLv3)
+*
+* Copyright (c) 2021 Digital Freedom Defence Inc.
+* This file is part of the QSC Cryptographic library
+*
+* This program is free software : you can redistribute it and / or modify
+* it under the terms of the GNU Affero General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU Affero General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef QSC_BUFFERPOOL_H
+#define QSC_BUFFERPOOL_H
+
+#include "common.h"
+
+/**
+* \file bufferpool.h
+* \brief A pool of fixed size, cache aligned buffers.
+* The buffers are carved from slabs of QSC_BUFFERPOOL_SLAB_BUFFERS buffers, each slab one aligned allocation,
+* so acquiring and releasing a buffer makes no allocation; a slab is only added when the free buffers
+* are exhausted, up to the pool maximum.
+* The free buffers are held on a lock-free stack, so connections on any event loop, and the worker threads they
+* hand buffers to, can share one pool. A buffer carries a reference count: a buffer is acquired with one reference,
+* each thread that receives it takes another, and the buffer returns to the pool when the last reference is released,
+* for example once the response it holds has been sent.
+* The slabs are released when the pool is disposed; all buffers must have been returned to the pool.
+*/
+
+/*!
+* \def QSC_BUFFERPOOL_ALIGNMENT
+* \brief The alignment of each buffer, the size of a cache line
+*/
+#define QSC_BUFFERPOOL_ALIGNMENT 64
+
+/*!
+* \def QSC_BUFFERPOOL_SLAB_BUFFERS
+* \brief The number of buffers in a slab
+*/
+#define QSC_BUFFERPOOL_SLAB_BUFFERS 256
+
+/*** Structures ***/
+
+/*! \struct qsc_bufferpool_buffer
+* \brief A pooled buffer
+*/
+typedef struct qsc_bufferpool_buffer
+{
+	uint8_t* data;									/*!< The cache aligned buffer */
+	void* pool;										/*!< The owning pool */
+	volatile uint64_t references;					/*!< The number of references held on the buffer */
+	size_t length;									/*!< The number of bytes in use, set by the caller */
+	volatile uint32_t next;							/*!< The next free buffer index plus one, while the buffer is free */
+	uint32_t index;									/*!< The index of the buffer in the pool */
+} qsc_bufferpool_buffer;
+
+/*! \struct qsc_bufferpool_state
+* \brief The buffer pool state
+*/
+typedef struct qsc_bufferpool_state
+{
+	qsc_bufferpool_buffer** slabs;					/*!< The buffer descriptors of each slab */
+	volatile uint64_t head;							/*!< The free stack; a change counter in the high half, the top buffer index plus one in the low half */
+	volatile uint64_t available;					/*!< The number of free buffers */
+	volatile uint64_t count;						/*!< The number of buffers allocated */
+	volatile uint64_t growing;						/*!< A slab is being added */
+	size_t maximum;									/*!< The maximum number of buffers */
+	size_t size;									/*!< The usable size of each buffer */
+	size_t stride;									/*!< The distance between buffers, the size rounded up to the alignment */
+} qsc_bufferpool_state;
+
+/*** Function Prototypes ***/
+
+/**
+* \brief Initialize the pool, and allocate the first slab
+*
+* \param state: The pool state
+* \param size: The size of each buffer in bytes
+* \param maximum: The maximum number of buffers, rounded up to a whole slab
+*
+* \return Returns true if the pool was initialized
+*/
+QSC_EXPORT_API bool qsc_bufferpool_initialize(qsc_bufferpool_state* state, size_t size, size_t maximum);
+
+/**
+* \brief Release the slabs; every buffer must have been returned to the pool
+*
+* \param state: The pool state
+*/
+QSC_EXPORT_API void qsc_bufferpool_dispose(qsc_bufferpool_state* state);
+
+/**
+* \brief Take a buffer from the pool, holding one reference.
+* Thread safe.
+*
+* \param state: The pool state
+*
+* \return Returns the buffer, or NULL if the pool is at its maximum and no buffer is free
+*/
+QSC_EXPORT_API qsc_bufferpool_buffer* qsc_bufferpool_acquire(qsc_bufferpool_state* state);
+
+/**
+* \brief Add a reference to a buffer, before handing it to another thread.
+* Thread safe.
+*
+* \param buffer: The buffer
+*/
+QSC_EXPORT_API void qsc_bufferpool_retain(qsc_bufferpool_buffer* buffer);
+
+/**
+* \brief Release a reference to a buffer; the last reference returns the buffer to the pool.
+* Thread safe.
+*
+* \param buffer: The buffer
+*/
+QSC_EXPORT_API void qsc_bufferpool_release(qsc_bufferpool_buffer* buffer);
+
+/**
+* \brief Get the number of free buffers
+*
+* \param state: [const] The pool state
+*
+* \return Returns the number of buffers in the pool
+*/
+QSC_EXPORT_API size_t qsc_bufferpool_available(const qsc_bufferpool_state* state);
+
+/**
+* \brief Get the number of buffers allocated, free or in use
+*
+* \param state: [const] The pool state
+*
+* \return Returns the number of buffers
+*/
+QSC_EXPORT_API size_t qsc_bufferpool_capacity(const qsc_bufferpool_state* state);
+
+#endif
@@ -1,24 +1,84 @@
 #include "queue.h"
 
+static size_t qsc_queue_copy(const qsc_queue_state* ctx, uint8_t* output, uint64_t* tags, size_t count)
+{
+	size_t first;
+
+	count = (count < ctx->count) ? count : ctx->count;
+
+	if (count != 0)
+	{
+		/* the items are contiguous up to the end of the slab, then wrap to the first slot */
+		first = ctx->mask + 1 - ctx->head;
+		first = (first < count) ? first : count;
+
+		if (output != NULL)
+		{
+			qsc_memutils_copy(output, ctx->queue + (ctx->head * ctx->width), first * ctx->width);
+
+			if (count > first)
+			{
+				qsc_memutils_copy(output + (first * ctx->width), ctx->queue, (count - first) * ctx->width);
+			}
+		}
+
+		if (tags != NULL)
+		{
+			qsc_memutils_copy((uint8_t*)tags, (const uint8_t*)(ctx->tags + ctx->head), first * sizeof(uint64_t));
+
+			if (count > first)
+			{
+				qsc_memutils_copy((uint8_t*)(tags + first), (const uint8_t*)ctx->tags, (count - first) * sizeof(uint64_t));
+			}
+		}
+	}
+
+	return count;
+}
+
+static void qsc_queue_erase(qsc_queue_state* ctx, size_t count)
+{
+	size_t first;
+
+	first = ctx->mask + 1 - ctx->head;
+	first = (first < count) ? first : count;
+	qsc_memutils_clear(ctx->queue + (ctx->head * ctx->width), first * ctx->width);
+	qsc_memutils_clear((uint8_t*)(ctx->tags + ctx->head), first * sizeof(uint64_t));
+
+	if (count > first)
+	{
+		qsc_memutils_clear(ctx->queue, (count - first) * ctx->width);
+		qsc_memutils_clear((uint8_t*)ctx->tags, (count - first) * sizeof(uint64_t));
+	}
+
+	ctx->head = (ctx->head + count) & ctx->mask;
+	ctx->count -= count;
+}
+
 void qsc_queue_destroy(qsc_queue_state* ctx)
 {
 	assert(ctx != NULL);
 
 	if (ctx != NULL)
 	{
-		for (size_t i = 0; i < ctx->depth; ++i)
+		if (ctx->queue != NULL)
 		{
-			if (ctx->queue[i] != NULL)
-			{
-				qsc_memutils_clear(ctx->queue[i], ctx->width);
-				qsc_memutils_aligned_free(ctx->queue[i]);
-			}
+			qsc_memutils_clear(ctx->queue, (ctx->mask + 1) * ctx->width);
+			qsc_memutils_aligned_free(ctx->queue);
+			ctx->queue = NULL;
+		}
+
+		if (ctx->tags != NULL)
+		{
+			qsc_memutils_clear((uint8_t*)ctx->tags, (ctx->mask + 1) * sizeof(uint64_t));
+			qsc_memutils_aligned_free(ctx->tags);
+			ctx->tags = NULL;
 		}
 
-		qsc_memutils_aligned_free(ctx->queue);
-		qsc_memutils_clear((uint8_t*)ctx->tags, sizeof(ctx->tags));
 		ctx->count = 0;
 		ctx->depth = 0;
+		ctx->head = 0;
+		ctx->mask = 0;
 		ctx->position = 0;
 		ctx->width = 0;
 	}
@@ -31,18 +91,10 @@ void qsc_queue_flush(qsc_queue_state* ctx, uint8_t* output)
 
 	if (ctx->queue != NULL)
 	{
-		for (size_t i = 0; i < ctx->position; ++i)
-		{
-			if (ctx->queue[i] != NULL)
-			{
-				qsc_memutils_copy((output + (i * ctx->width)), ctx->queue[i], ctx->width);
-				qsc_memutils_clear(ctx->queue[i], ctx->width);
-			}
-		}
-
-		ctx->count = 0;
+		qsc_queue_copy(ctx, output, NULL, ctx->count);
+		qsc_queue_erase(ctx, ctx->count);
+		ctx->head = 0;
 		ctx->position = 0;
-		qsc_memutils_clear((uint8_t*)ctx->tags, sizeof(ctx->tags));
 	}
 }
 
@@ -51,26 +103,47 @@ void qsc_queue_initialize(qsc_queue_state* ctx, size_t depth, size_t width)
 	assert(ctx != NULL);
 	assert(depth != 0 && width != 0);
 
-	ctx->queue = (uint8_t**)qsc_memutils_aligned_alloc(QSC_QUEUE_ALIGNMENT, depth * sizeof(uint8_t*));
+	size_t slots;
 
-	if (ctx->queue != NULL)
+	slots = 1;
+
+	while (slots < depth)
 	{
-		for (size_t i = 0; i < depth; ++i)
-		{
-			ctx->queue[i] = qsc_memutils_aligned_alloc(QSC_QUEUE_ALIGNMENT, width);
+		slots <<= 1;
+	}
 
-			if (ctx->queue[i] != NULL)
-			{
-				qsc_memutils_clear(ctx->queue[i], width);
-			}
-		}
+	ctx->queue = (uint8_t*)qsc_memutils_aligned_alloc(QSC_QUEUE_ALIGNMENT, slots * width);
+	ctx->tags = (uint64_t*)qsc_memutils_aligned_alloc(QSC_QUEUE_ALIGNMENT, slots * sizeof(uint64_t));
+	ctx->count = 0;
+	ctx->head = 0;
+	ctx->position = 0;
 
-		ctx->count = 0;
+	if (ctx->queue != NULL && ctx->tags != NULL)
+	{
+		qsc_memutils_clear(ctx->queue, slots * width);
+		qsc_memutils_clear((uint8_t*)ctx->tags, slots * sizeof(uint64_t));
 		ctx->depth = depth;
-		ctx->position = 0;
-		qsc_memutils_clear((uint8_t*)ctx->tags, QSC_QUEUE_MAX_DEPTH);
+		ctx->mask = slots - 1;
 		ctx->width = width;
 	}
+	else
+	{
+		if (ctx->queue != NULL)
+		{
+			qsc_memutils_aligned_free(ctx->queue);
+			ctx->queue = NULL;
+		}
+
+		if (ctx->tags != NULL)
+		{
+			qsc_memutils_aligned_free(ctx->tags);
+			ctx->tags = NULL;
+		}
+
+		ctx->depth = 0;
+		ctx->mask = 0;
+		ctx->width = 0;
+	}
 }
 
 size_t qsc_queue_items(const qsc_queue_state* ctx)
@@ -94,6 +167,22 @@ bool qsc_queue_isempty(const qsc_queue_state* ctx)
 	return (bool)(ctx->count == 0);
 }
 
+size_t qsc_queue_peek(const qsc_queue_state* ctx, uint8_t* output, uint64_t* tags, size_t count)
+{
+	assert(ctx != NULL);
+
+	size_t res;
+
+	res = 0;
+
+	if (ctx != NULL && ctx->queue != NULL)
+	{
+		res = qsc_queue_copy(ctx, output, tags, count);
+	}
+
+	return res;
+}
+
 uint64_t qsc_queue_pop(qsc_queue_state* ctx, uint8_t* output, size_t outlen)
 {
 	assert(ctx != NULL);
@@ -106,26 +195,30 @@ uint64_t qsc_queue_pop(qsc_queue_state* ctx, uint8_t* output, size_t outlen)
 
 	if (!qsc_queue_isempty(ctx) && outlen <= ctx->width)
 	{
-		qsc_memutils_copy(output, ctx->queue[0], outlen);
-		qsc_memutils_clear(ctx->queue[0], ctx->width);
-		tag = ctx->tags[ctx->position - 1];
+		qsc_memutils_copy(output, ctx->queue + (ctx->head * ctx->width), outlen);
+		tag = ctx->tags[ctx->head];
+		qsc_queue_erase(ctx, 1);
+	}
 
-		if (ctx->count > 1)
-		{
-			for (size_t i = 1; i < ctx->count; ++i)
-			{
-				qsc_memutils_copy(ctx->queue[i - 1], ctx->queue[i], ctx->width);
-				ctx->tags[i - 1] = ctx->tags[i];
-			}
-		}
+	return tag;
+}
+
+size_t qsc_queue_pop_bulk(qsc_queue_state* ctx, uint8_t* output, uint64_t* tags, size_t count)
+{
+	assert(ctx != NULL);
+	assert(output != NULL);
+
+	size_t res;
+
+	res = 0;
 
-		qsc_memutils_clear(ctx->queue[ctx->position - 1], ctx->width);
-		ctx->tags[ctx->position - 1] = 0;
-		--ctx->count;
-		--ctx->position;
+	if (ctx != NULL && output != NULL && ctx->queue != NULL)
+	{
+		res = qsc_queue_copy(ctx, output, tags, count);
+		qsc_queue_erase(ctx, res);
 	}
 
-	return tag;
+	return res;
 }
 
 void qsc_queue_push(qsc_queue_state* ctx, const uint8_t* input, size_t inlen, uint64_t tag)
@@ -136,9 +229,10 @@ void qsc_queue_push(qsc_queue_state* ctx, const uint8_t* input, size_t inlen, ui
 
 	if (!qsc_queue_isfull(ctx) && inlen <= ctx->width)
 	{
-		qsc_memutils_copy(ctx->queue[ctx->position], input, inlen);
+		/* consumed slots are cleared, so a short item is zero padded */
+		qsc_memutils_copy(ctx->queue + (ctx->position * ctx->width), input, inlen);
 		ctx->tags[ctx->position] = tag;
-		++ctx->position;
+		ctx->position = (ctx->position + 1) & ctx->mask;
 		++ctx->count;
 	}
 }
@@ -148,6 +242,7 @@ bool qsc_queue_self_test()
 	uint8_t exp[64][16] = { 0 };
 	uint8_t otp1[64 * 16] = { 0 };
 	uint8_t otp2[64][16] = { 0 };
+	uint64_t tags[64] = { 0 };
 	qsc_queue_state ctx;
 	size_t i;
 	bool ret;
@@ -219,6 +314,43 @@ bool qsc_queue_self_test()
 		}
 	}
 
+	/* bulk operations across the end of the ring */
+	for (i = 0; i < 48; ++i)
+	{
+		qsc_queue_push(&ctx, exp[i], 16, i);
+	}
+
+	qsc_queue_pop_bulk(&ctx, (uint8_t*)otp2, tags, 40);
+
+	for (i = 48; i < 64; ++i)
+	{
+		qsc_queue_push(&ctx, exp[i], 16, i);
+	}
+
+	for (i = 0; i < 40; ++i)
+	{
+		qsc_queue_push(&ctx, exp[i], 16, i);
+	}
+
+	if (qsc_queue_items(&ctx) != 64 || qsc_queue_peek(&ctx, NULL, tags, 1) != 1 || tags[0] != 40)
+	{
+		ret = false;
+	}
+
+	if (qsc_queue_pop_bulk(&ctx, (uint8_t*)otp2, tags, 64) != 64 || qsc_queue_isempty(&ctx) == false)
+	{
+		ret = false;
+	}
+
+	for (i = 0; i < 64; ++i)
+	{
+		if (qsc_intutils_are_equal8(exp[(i + 40) % 64], otp2[i], 16) == false || tags[i] != (i + 40) % 64)
+		{
+			ret = false;
+			break;
+		}
+	}
+
 	qsc_queue_destroy(&ctx);
 
 	return ret;
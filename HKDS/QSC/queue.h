@@ -35,21 +35,19 @@
 */
 #define QSC_QUEUE_ALIGNMENT 64
 
-/*!
-\def QSC_QUEUE_MAX_DEPTH
-* The maximum queue depth
-*/
-#define QSC_QUEUE_MAX_DEPTH 64
-
 /*! \struct qsc_queue_state
-* Contains the queue context state
+* Contains the queue context state.
+* The items are stored in a ring over one contiguous slab, with a power of two number of slots,
+* so push and pop are constant time operations regardless of the queue depth.
 */
 typedef struct qsc_queue_state
 {
-	uint8_t** queue;					/*!< The pointer to a 2 dimensional queue array */
-	uint64_t tags[QSC_QUEUE_MAX_DEPTH];	/*!< The 64-bit tag associated with each queue item  */
+	uint8_t* queue;						/*!< The item slab, one slot of width bytes per ring position */
+	uint64_t* tags;						/*!< The 64-bit tag associated with each queue item  */
 	size_t count;						/*!< The number of queue items */
 	size_t depth;						/*!< The maximum number of items in the queue */
+	size_t head;						/*!< The slot of the first item in the queue */
+	size_t mask;						/*!< The number of slots minus one */
 	size_t position;					/*!< The next empty slot in the queue */
 	size_t width;						/*!< The maximum byte length of a queue item */
 } qsc_queue_state;
@@ -73,7 +71,7 @@ QSC_EXPORT_API void qsc_queue_flush(qsc_queue_state* ctx, uint8_t* output);
 * \brief Initialize the queue state.
 *
 * \param ctx [struct] The function state
-* \param depth [size] The number of queue items to initialize, maximum is QSC_QUEUE_MAX_DEPTH
+* \param depth [size] The maximum number of queue items; the ring is rounded up to a power of two slots
 * \param width [size] The maximum size of each queue item in bytes
 */
 QSC_EXPORT_API void qsc_queue_initialize(qsc_queue_state* ctx, size_t depth, size_t width);
@@ -112,6 +110,29 @@ QSC_EXPORT_API bool qsc_queue_isempty(const qsc_queue_state* ctx);
 */
 QSC_EXPORT_API uint64_t qsc_queue_pop(qsc_queue_state* ctx, uint8_t* output, size_t outlen);
 
+/**
+* \brief Remove up to count items from the front of the queue, in one call.
+* The items are copied to the output array at a stride of the queue width.
+*
+* \param ctx [struct] The function state
+* \param output [array] The array receiving the queue items, count * width bytes
+* \param tags [array] The optional array receiving the item tags, can be NULL
+* \param count [size] The maximum number of items to remove
+* \return The number of items removed
+*/
+QSC_EXPORT_API size_t qsc_queue_pop_bulk(qsc_queue_state* ctx, uint8_t* output, uint64_t* tags, size_t count);
+
+/**
+* \brief Copy up to count items from the front of the queue, without removing them.
+*
+* \param ctx [struct][const] The function state
+* \param output [array] The optional array receiving the queue items, count * width bytes, can be NULL
+* \param tags [array] The optional array receiving the item tags, can be NULL
+* \param count [size] The maximum number of items to copy
+* \return The number of items copied
+*/
+QSC_EXPORT_API size_t qsc_queue_peek(const qsc_queue_state* ctx, uint8_t* output, uint64_t* tags, size_t count);
+
 /**
 * \brief Add an item to the queue.
 *
@@ -1,3 +1,6 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#	define _GNU_SOURCE
+#endif
 #include "socketbase.h"
 #include "intutils.h"
 #include "memutils.h"
@@ -6,11 +9,85 @@
 #if defined(QSC_SYSTEM_OS_POSIX)
 #   include <sys/ioctl.h>
 #   include <sys/select.h>
+#   include <sys/un.h>
 #	if !defined(PSTR)
 #   	define PSTR char*
 #	endif
 #endif
 
+#if !defined(QSC_SYSTEM_OS_WINDOWS)
+static void qsc_socket_option_native(qsc_socket_protocols level, qsc_socket_options option, int32_t* nlevel, int32_t* noption)
+{
+	/* the option enumerations use the Winsock values; the socket level options differ on posix systems */
+	*nlevel = (int32_t)level;
+	*noption = (int32_t)option;
+
+	if (level == qsc_socket_protocol_socket)
+	{
+		*nlevel = SOL_SOCKET;
+
+		switch (option)
+		{
+		case qsc_socket_option_broadcast:
+		{
+			*noption = SO_BROADCAST;
+			break;
+		}
+		case qsc_socket_option_keepalive:
+		{
+			*noption = SO_KEEPALIVE;
+			break;
+		}
+		case qsc_socket_option_linger:
+		{
+			*noption = SO_LINGER;
+			break;
+		}
+		case qsc_socket_option_no_route:
+		{
+			*noption = SO_DONTROUTE;
+			break;
+		}
+		case qsc_socket_option_out_of_band:
+		{
+			*noption = SO_OOBINLINE;
+			break;
+		}
+		case qsc_socket_option_reuse_address:
+		{
+			*noption = SO_REUSEADDR;
+			break;
+		}
+#if defined(SO_REUSEPORT)
+		case qsc_socket_option_reuse_port:
+		{
+			*noption = SO_REUSEPORT;
+			break;
+		}
+#endif
+		case qsc_socket_option_receive_time_out:
+		{
+			*noption = SO_RCVTIMEO;
+			break;
+		}
+		case qsc_socket_option_send_time_out:
+		{
+			*noption = SO_SNDTIMEO;
+			break;
+		}
+		default:
+		{
+			*noption = (int32_t)option;
+		}
+		}
+	}
+	else if (level == qsc_socket_protocol_ipv6 && option == qsc_socket_option_ipv6_only)
+	{
+		*noption = IPV6_V6ONLY;
+	}
+}
+#endif
+
 static qsc_socket_exceptions qsc_socket_acceptv4(const qsc_socket* source, qsc_socket* target)
 {
 	assert(source != NULL);
@@ -93,6 +170,49 @@ static qsc_socket_exceptions qsc_socket_acceptv6(const qsc_socket* source, qsc_s
 	return res;
 }
 
+#if defined(QSC_SYSTEM_OS_POSIX)
+static qsc_socket_exceptions qsc_socket_acceptux(const qsc_socket* source, qsc_socket* target)
+{
+	assert(source != NULL);
+	assert(target != NULL);
+
+	socklen_t salen;
+	struct sockaddr_un sa;
+	qsc_socket_exceptions res;
+
+	res = qsc_socket_invalid_input;
+
+	if (source != NULL && target != NULL)
+	{
+		salen = sizeof(sa);
+		qsc_memutils_clear((uint8_t*)&sa, salen);
+		target->connection = 0;
+		target->connection_status = qsc_socket_state_none;
+		qsc_memutils_clear((uint8_t*)target->address, sizeof(target->address));
+		target->address_family = source->address_family;
+		target->socket_protocol = source->socket_protocol;
+		target->socket_transport = source->socket_transport;
+		target->connection = accept(source->connection, (struct sockaddr*)&sa, &salen);
+
+		if (target->connection != QSC_UNINITIALIZED_SOCKET && target->connection != QSC_SOCKET_RET_ERROR)
+		{
+			/* the connecting peer is usually unbound, the listeners path identifies the connection */
+			target->connection_status = qsc_socket_state_connected;
+			qsc_memutils_copy(target->address, source->address, sizeof(target->address));
+			target->port = 0;
+			res = qsc_socket_exception_success;
+		}
+		else
+		{
+			res = qsc_socket_get_last_error();
+			qsc_socket_close_socket(target);
+		}
+	}
+
+	return res;
+}
+#endif
+
 //~~~Accessors~~~//
 
 bool qsc_socket_ipv4_valid_address(const char* address)
@@ -185,6 +305,12 @@ qsc_socket_exceptions qsc_socket_accept(const qsc_socket* source, qsc_socket* ta
 		{
 			res = qsc_socket_acceptv4(source, target);
 		}
+#if defined(QSC_SYSTEM_OS_POSIX)
+		else if (source->address_family == qsc_socket_address_family_unix)
+		{
+			res = qsc_socket_acceptux(source, target);
+		}
+#endif
 		else
 		{
 			res = qsc_socket_acceptv6(source, target);
@@ -225,6 +351,10 @@ qsc_socket_exceptions qsc_socket_bind(qsc_socket* sock, const char* address, uin
 			qsc_ipinfo_ipv4_address addt = qsc_ipinfo_ipv4_address_from_string(address);
 			res = qsc_socket_bind_ipv4(sock, &addt, port);
 		}
+		else if (sock->address_family == qsc_socket_address_family_unix)
+		{
+			res = qsc_socket_bind_unix(sock, address);
+		}
 		else
 		{
 			qsc_ipinfo_ipv6_address addt = qsc_ipinfo_ipv6_address_from_string(address);
@@ -247,13 +377,11 @@ qsc_socket_exceptions qsc_socket_bind_ipv4(qsc_socket* sock, const qsc_ipinfo_ip
 
 	if (sock != NULL && address != NULL)
 	{
-		uint32_t ip4u;
-
 		qsc_memutils_clear((uint8_t*)&sa, sizeof(sa));
 		sa.sin_family = AF_INET;
 		sa.sin_port = htons(port);
-		ip4u = qsc_intutils_be8to32(address->ipv4);
-		sa.sin_addr.s_addr = ip4u;
+		/* the address bytes are already in network order */
+		qsc_memutils_copy(&sa.sin_addr.s_addr, address->ipv4, sizeof(sa.sin_addr.s_addr));
 #if defined(QSC_SYSTEM_OS_APPLE)
 		sa.sin_len = sizeof(sockaddr_in);
 #endif
@@ -318,6 +446,52 @@ qsc_socket_exceptions qsc_socket_bind_ipv6(qsc_socket* sock, const qsc_ipinfo_ip
 	return res;
 }
 
+qsc_socket_exceptions qsc_socket_bind_unix(qsc_socket* sock, const char* path)
+{
+	assert(sock != NULL);
+	assert(path != NULL);
+
+	qsc_socket_exceptions res;
+
+	res = qsc_socket_invalid_input;
+
+#if defined(QSC_SYSTEM_OS_POSIX)
+	struct sockaddr_un sa;
+	size_t plen;
+
+	if (sock != NULL && path != NULL)
+	{
+		qsc_memutils_clear((uint8_t*)&sa, sizeof(sa));
+		plen = strlen(path);
+
+		if (plen != 0 && plen < sizeof(sa.sun_path))
+		{
+			sa.sun_family = AF_UNIX;
+			qsc_memutils_copy(sa.sun_path, path, plen);
+			res = (qsc_socket_exceptions)bind(sock->connection, (const struct sockaddr*)&sa, sizeof(sa));
+
+			if (res != qsc_socket_exception_error)
+			{
+				qsc_memutils_clear((uint8_t*)sock->address, sizeof(sock->address));
+				qsc_memutils_copy(sock->address, path, (plen < sizeof(sock->address)) ? plen : sizeof(sock->address) - 1);
+				sock->address_family = qsc_socket_address_family_unix;
+				sock->port = 0;
+			}
+		}
+	}
+
+	if (res == qsc_socket_exception_error)
+	{
+		res = qsc_socket_get_last_error();
+	}
+#else
+	(void)sock;
+	(void)path;
+#endif
+
+	return res;
+}
+
 qsc_socket_exceptions qsc_socket_close_socket(const qsc_socket* sock)
 {
 	assert(sock != NULL);
@@ -365,6 +539,10 @@ qsc_socket_exceptions qsc_socket_connect(qsc_socket* sock, const char* address,
 			addt = qsc_ipinfo_ipv4_address_from_string(address);
 			res = qsc_socket_connect_ipv4(sock, &addt, port);
 		}
+		else if (sock->address_family == qsc_socket_address_family_unix)
+		{
+			res = qsc_socket_connect_unix(sock, address);
+		}
 		else
 		{
 			qsc_ipinfo_ipv6_address addt;
@@ -452,6 +630,52 @@ qsc_socket_exceptions qsc_socket_connect_ipv6(qsc_socket* sock, const qsc_ipinfo
 	return res;
 }
 
+qsc_socket_exceptions qsc_socket_connect_unix(qsc_socket* sock, const char* path)
+{
+	assert(sock != NULL);
+	assert(path != NULL);
+
+	qsc_socket_exceptions res;
+
+	res = qsc_socket_invalid_input;
+
+#if defined(QSC_SYSTEM_OS_POSIX)
+	struct sockaddr_un sa;
+	size_t plen;
+
+	if (sock != NULL && path != NULL)
+	{
+		qsc_memutils_clear((uint8_t*)&sa, sizeof(sa));
+		plen = strlen(path);
+
+		if (plen != 0 && plen < sizeof(sa.sun_path))
+		{
+			sa.sun_family = AF_UNIX;
+			qsc_memutils_copy(sa.sun_path, path, plen);
+			res = (qsc_socket_exceptions)connect(sock->connection, (const struct sockaddr*)&sa, sizeof(sa));
+
+			if (res != qsc_socket_exception_error)
+			{
+				qsc_memutils_clear((uint8_t*)sock->address, sizeof(sock->address));
+				qsc_memutils_copy(sock->address, path, (plen < sizeof(sock->address)) ? plen : sizeof(sock->address) - 1);
+				sock->connection_status = qsc_socket_state_connected;
+				sock->port = 0;
+			}
+		}
+	}
+
+	if (res == qsc_socket_exception_error)
+	{
+		res = qsc_socket_get_last_error();
+	}
+#else
+	(void)sock;
+	(void)path;
+#endif
+
+	return res;
+}
+
 qsc_socket_exceptions qsc_socket_create(qsc_socket* sock, qsc_socket_address_families family, qsc_socket_transports transport, qsc_socket_protocols protocol)
 {
 	assert(sock != NULL);
@@ -611,7 +835,7 @@ size_t qsc_socket_receive_all(const qsc_socket* sock, uint8_t* output, size_t ou
 	{
 		while (outlen > 0)
 		{
-			res = recv(sock->connection, (char*)output, (int32_t)outlen, (int32_t)flag);
+			res = recv(sock->connection, (char*)output + pos, (int32_t)outlen, (int32_t)flag);
 
 			if (res < 1)
 			{
@@ -649,14 +873,15 @@ size_t qsc_socket_receive_from(qsc_socket* sock, char* destination, uint16_t por
 
 			d.sin_family = AF_INET;
 			d.sin_port = htons(port);
-			d.sin_addr.s_addr = inet_pton(AF_INET, destination, &d.sin_addr);
+			inet_pton(AF_INET, destination, &d.sin_addr);
+			len = (int32_t)sizeof(d);
 
 			res = recvfrom(sock->connection, (char*)output, (int32_t)outlen, (int32_t)flag, (struct sockaddr*)&d, (uint32_t*)&len);
 
 			if (res != qsc_socket_exception_error)
 			{
 				inet_ntop(AF_INET, &d.sin_addr, astr, INET_ADDRSTRLEN);
-				qsc_memutils_copy((uint8_t*)destination, (uint8_t*)astr, len);
+				qsc_memutils_copy((uint8_t*)destination, (uint8_t*)astr, strlen(astr) + 1);
 				sock->connection_status = qsc_socket_state_connectionless;
 				sock->port = port;
 			}
@@ -669,13 +894,14 @@ size_t qsc_socket_receive_from(qsc_socket* sock, char* destination, uint16_t por
 			d.sin6_family = AF_INET6;
 			d.sin6_port = htons(port);
 			inet_pton(AF_INET6, destination, &d.sin6_addr);
+			len = (int32_t)sizeof(d);
 
 			res = recvfrom(sock->connection, (char*)output, (int32_t)outlen, (int32_t)flag, (struct sockaddr*)&d, (uint32_t*)&len);
 
 			if (res != qsc_socket_exception_error)
 			{
 				inet_ntop(AF_INET6, &d.sin6_addr, astr, INET6_ADDRSTRLEN);
-				qsc_memutils_copy((uint8_t*)destination, (uint8_t*)astr, len);
+				qsc_memutils_copy((uint8_t*)destination, (uint8_t*)astr, strlen(astr) + 1);
 				sock->address_family = qsc_socket_address_family_ipv6;
 				sock->connection_status = qsc_socket_state_connectionless;
 				sock->port = port;
@@ -690,6 +916,66 @@ size_t qsc_socket_receive_from(qsc_socket* sock, char* destination, uint16_t por
 	return (size_t)res;
 }
 
+size_t qsc_socket_receive_batch(const qsc_socket* sock, qsc_socket_datagram* datagrams, size_t count, qsc_socket_receive_flags flag)
+{
+	assert(sock != NULL);
+	assert(datagrams != NULL);
+
+#if defined(QSC_SYSTEM_OS_LINUX)
+	struct mmsghdr msgs[QSC_SOCKET_DATAGRAM_BATCH_MAX];
+	struct iovec vec[QSC_SOCKET_DATAGRAM_BATCH_MAX];
+	size_t i;
+#elif defined(QSC_SYSTEM_OS_WINDOWS)
+	int32_t len;
+#else
+	socklen_t len;
+#endif
+	int32_t res;
+
+	res = 0;
+
+	if (sock != NULL && datagrams != NULL && count != 0)
+	{
+#if defined(QSC_SYSTEM_OS_LINUX)
+		count = (count > QSC_SOCKET_DATAGRAM_BATCH_MAX) ? QSC_SOCKET_DATAGRAM_BATCH_MAX : count;
+		qsc_memutils_clear(msgs, count * sizeof(struct mmsghdr));
+
+		for (i = 0; i < count; ++i)
+		{
+			vec[i].iov_base = datagrams[i].data;
+			vec[i].iov_len = datagrams[i].capacity;
+			msgs[i].msg_hdr.msg_name = datagrams[i].address;
+			msgs[i].msg_hdr.msg_namelen = QSC_SOCKET_ADDRESS_STORAGE_SIZE;
+			msgs[i].msg_hdr.msg_iov = &vec[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		/* one call returns every datagram already queued, up to the batch size */
+		res = recvmmsg(sock->connection, msgs, (uint32_t)count, (int32_t)flag, NULL);
+
+		for (i = 0; res > 0 && i < (size_t)res; ++i)
+		{
+			datagrams[i].length = msgs[i].msg_len;
+			datagrams[i].addrlen = msgs[i].msg_hdr.msg_namelen;
+		}
+#else
+		len = QSC_SOCKET_ADDRESS_STORAGE_SIZE;
+		res = recvfrom(sock->connection, (char*)datagrams[0].data, (int32_t)datagrams[0].capacity, (int32_t)flag, (struct sockaddr*)datagrams[0].address, &len);
+
+		if (res != qsc_socket_exception_error)
+		{
+			datagrams[0].length = (size_t)res;
+			datagrams[0].addrlen = (uint32_t)len;
+			res = 1;
+		}
+#endif
+	}
+
+	res = (res == qsc_socket_exception_error) ? 0 : res;
+
+	return (size_t)res;
+}
+
 size_t qsc_socket_send(const qsc_socket* sock, const uint8_t* input, size_t inlen, qsc_socket_send_flags flag)
 {
 	assert(sock != NULL);
@@ -701,7 +987,11 @@ size_t qsc_socket_send(const qsc_socket* sock, const uint8_t* input, size_t inle
 
 	if (sock != NULL && input != NULL)
 	{
-		res = send(sock->connection, (const char*)input, (int32_t)inlen + 1, (int32_t)flag);
+#if defined(QSC_SYSTEM_OS_WINDOWS)
+		/* winsock sends do not raise signals */
+		flag = (qsc_socket_send_flags)(flag & ~qsc_socket_send_flag_no_signal);
+#endif
+		res = send(sock->connection, (const char*)input, (int32_t)inlen, (int32_t)flag);
 		res = (res == qsc_socket_exception_error) ? 0 : res;
 	}
 
@@ -741,6 +1031,64 @@ size_t qsc_socket_send_to(const qsc_socket* sock, const char* destination, size_
 	return (size_t)res;
 }
 
+size_t qsc_socket_send_batch(const qsc_socket* sock, const qsc_socket_datagram* datagrams, size_t count, qsc_socket_send_flags flag)
+{
+	assert(sock != NULL);
+	assert(datagrams != NULL);
+
+#if defined(QSC_SYSTEM_OS_LINUX)
+	struct mmsghdr msgs[QSC_SOCKET_DATAGRAM_BATCH_MAX];
+	struct iovec vec[QSC_SOCKET_DATAGRAM_BATCH_MAX];
+	size_t i;
+	size_t n;
+#endif
+	size_t pos;
+	int32_t res;
+
+	pos = 0;
+	res = 1;
+
+	if (sock != NULL && datagrams != NULL)
+	{
+		while (pos < count && res > 0)
+		{
+#if defined(QSC_SYSTEM_OS_LINUX)
+			n = (count - pos > QSC_SOCKET_DATAGRAM_BATCH_MAX) ? QSC_SOCKET_DATAGRAM_BATCH_MAX : count - pos;
+			qsc_memutils_clear(msgs, n * sizeof(struct mmsghdr));
+
+			for (i = 0; i < n; ++i)
+			{
+				vec[i].iov_base = datagrams[pos + i].data;
+				vec[i].iov_len = datagrams[pos + i].length;
+				msgs[i].msg_hdr.msg_name = (datagrams[pos + i].addrlen != 0) ? (void*)datagrams[pos + i].address : NULL;
+				msgs[i].msg_hdr.msg_namelen = datagrams[pos + i].addrlen;
+				msgs[i].msg_hdr.msg_iov = &vec[i];
+				msgs[i].msg_hdr.msg_iovlen = 1;
+			}
+
+			/* the system may send fewer datagrams than requested; the remainder is passed again */
+			res = sendmmsg(sock->connection, msgs, (uint32_t)n, (int32_t)flag);
+			pos += (res > 0) ? (size_t)res : 0;
+#else
+			if (datagrams[pos].addrlen != 0)
+			{
+				res = sendto(sock->connection, (const char*)datagrams[pos].data, (int32_t)datagrams[pos].length, (int32_t)flag,
+					(const struct sockaddr*)datagrams[pos].address, (int32_t)datagrams[pos].addrlen);
+			}
+			else
+			{
+				res = send(sock->connection, (const char*)datagrams[pos].data, (int32_t)datagrams[pos].length, (int32_t)flag);
+			}
+
+			pos += (res != qsc_socket_exception_error) ? 1 : 0;
+			res = (res != qsc_socket_exception_error) ? 1 : 0;
+#endif
+		}
+	}
+
+	return pos;
+}
+
 size_t qsc_socket_send_all(const qsc_socket* sock, const uint8_t* input, size_t inlen, qsc_socket_send_flags flag)
 {
 	assert(sock != NULL);
@@ -755,7 +1103,7 @@ size_t qsc_socket_send_all(const qsc_socket* sock, const uint8_t* input, size_t
 	{
 		while (inlen > 0)
 		{
-			res = send(sock->connection, (const char*)input, (int32_t)inlen, (int32_t)flag);
+			res = send(sock->connection, (const char*)input + pos, (int32_t)inlen, (int32_t)flag);
 
 			if (res < 1)
 			{
@@ -771,6 +1119,102 @@ size_t qsc_socket_send_all(const qsc_socket* sock, const uint8_t* input, size_t
 	return (size_t)pos;
 }
 
+size_t qsc_socket_send_vector(const qsc_socket* sock, const qsc_socket_vector* vectors, size_t count, qsc_socket_send_flags flag)
+{
+	assert(sock != NULL);
+	assert(vectors != NULL);
+
+#if defined(QSC_SYSTEM_OS_WINDOWS)
+	WSABUF vec[QSC_SOCKET_VECTOR_MAX];
+	DWORD sent;
+#else
+	struct iovec vec[QSC_SOCKET_VECTOR_MAX];
+	struct msghdr msg;
+	ssize_t sent;
+#endif
+	size_t first;
+	size_t i;
+	size_t n;
+	size_t off;
+	size_t pos;
+	size_t rem;
+	size_t total;
+	bool err;
+
+	err = false;
+	i = 0;
+	off = 0;
+	pos = 0;
+
+	if (sock != NULL && vectors != NULL)
+	{
+		while (i < count && err == false)
+		{
+			/* load the unsent remainder of the current buffer and the buffers that follow it */
+			n = 0;
+			total = 0;
+
+			while (i + n < count && n < QSC_SOCKET_VECTOR_MAX)
+			{
+				first = (n == 0) ? off : 0;
+#if defined(QSC_SYSTEM_OS_WINDOWS)
+				vec[n].buf = (CHAR*)(vectors[i + n].data + first);
+				vec[n].len = (ULONG)(vectors[i + n].length - first);
+#else
+				vec[n].iov_base = (void*)(vectors[i + n].data + first);
+				vec[n].iov_len = vectors[i + n].length - first;
+#endif
+				total += vectors[i + n].length - first;
+				++n;
+			}
+
+			if (total == 0)
+			{
+				i += n;
+				off = 0;
+			}
+			else
+			{
+#if defined(QSC_SYSTEM_OS_WINDOWS)
+				sent = 0;
+
+				if (WSASend(sock->connection, vec, (DWORD)n, &sent, (DWORD)flag, NULL, NULL) != 0 || sent == 0)
+				{
+					err = true;
+				}
+#else
+				qsc_memutils_clear(&msg, sizeof(msg));
+				msg.msg_iov = vec;
+				msg.msg_iovlen = n;
+				sent = sendmsg(sock->connection, &msg, (int32_t)flag);
+
+				if (sent < 1)
+				{
+					err = true;
+				}
+#endif
+				if (err == false)
+				{
+					pos += (size_t)sent;
+					rem = (size_t)sent;
+
+					/* skip the buffers that were sent completely, a partial send resumes inside a buffer */
+					while (i < count && rem >= vectors[i].length - off)
+					{
+						rem -= vectors[i].length - off;
+						off = 0;
+						++i;
+					}
+
+					off += rem;
+				}
+			}
+		}
+	}
+
+	return (err == true) ? 0 : pos;
+}
+
 qsc_socket_exceptions qsc_socket_shut_down(qsc_socket* sock, qsc_socket_shut_down_flags parameters)
 {
 	assert(sock != NULL);
@@ -1072,61 +1516,63 @@ qsc_socket_exceptions qsc_socket_ioctl(const qsc_socket* sock, int32_t command,
 bool qsc_socket_receive_ready(const qsc_socket* sock, const struct timeval* timeout)
 {
 	assert(sock != NULL);
-	assert(timeout != NULL);
 
-	qsc_socket_exceptions res;
+	int32_t res;
 
-	res = qsc_socket_invalid_input;
+	res = 0;
 
 	if (sock != NULL)
 	{
 		fd_set fds;
+		struct timeval tcopy;
+
 		FD_ZERO(&fds);
 		FD_SET(sock->connection, &fds);
 
 		if (timeout == NULL)
 		{
-			res = (qsc_socket_exceptions)select((int32_t)sock->connection + 1, &fds, NULL, NULL, NULL);
+			res = select((int32_t)sock->connection + 1, &fds, NULL, NULL, NULL);
 		}
 		else
 		{
-			const struct timeval* tcopy = timeout;
-			res = (qsc_socket_exceptions)select((int32_t)sock->connection + 1, &fds, NULL, NULL, tcopy);
+			/* select may modify the timeout */
+			tcopy = *timeout;
+			res = select((int32_t)sock->connection + 1, &fds, NULL, NULL, &tcopy);
 		}
 	}
 
-	return (res == qsc_socket_exception_success);
+	/* select returns the number of ready descriptors, zero on timeout */
+	return (res > 0);
 }
 
 bool qsc_socket_send_ready(const qsc_socket* sock, const struct timeval* timeout)
 {
 	assert(sock != NULL);
-	assert(timeout != NULL);
 
-	qsc_socket_exceptions res;
+	int32_t res;
 
-	res = qsc_socket_invalid_input;
+	res = 0;
 
 	if (sock != NULL)
 	{
 		fd_set fds;
-		const struct timeval* tcopy;
+		struct timeval tcopy;
 
 		FD_ZERO(&fds);
 		FD_SET(sock->connection, &fds);
 
 		if (timeout == NULL)
 		{
-			res = (qsc_socket_exceptions)select((int32_t)sock->connection + 1, NULL, &fds, NULL, NULL);
+			res = select((int32_t)sock->connection + 1, NULL, &fds, NULL, NULL);
 		}
 		else
 		{
-			tcopy = timeout;
-			res = (qsc_socket_exceptions)select((int32_t)sock->connection + 1, NULL, &fds, NULL, tcopy);
+			tcopy = *timeout;
+			res = select((int32_t)sock->connection + 1, NULL, &fds, NULL, &tcopy);
 		}
 	}
 
-	return (res == qsc_socket_exception_success);
+	return (res > 0);
 }
 
 void qsc_socket_set_last_error(qsc_socket_exceptions error)
@@ -1151,6 +1597,46 @@ qsc_socket_exceptions qsc_socket_shut_down_sockets()
 	return res;
 }
 
+qsc_socket_exceptions qsc_socket_set_nonblocking(const qsc_socket* sock, bool enabled)
+{
+	assert(sock != NULL);
+
+	qsc_socket_exceptions res;
+
+	res = qsc_socket_invalid_input;
+
+	if (sock != NULL)
+	{
+#if defined(QSC_SYSTEM_OS_WINDOWS)
+		u_long mode;
+
+		mode = (enabled == true) ? 1 : 0;
+		res = (qsc_socket_exceptions)ioctlsocket(sock->connection, FIONBIO, &mode);
+#else
+		int32_t flags;
+
+		flags = fcntl(sock->connection, F_GETFL, 0);
+
+		if (flags != -1)
+		{
+			flags = (enabled == true) ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+			res = (qsc_socket_exceptions)fcntl(sock->connection, F_SETFL, flags);
+		}
+		else
+		{
+			res = qsc_socket_exception_error;
+		}
+#endif
+	}
+
+	if (res == qsc_socket_exception_error)
+	{
+		res = qsc_socket_get_last_error();
+	}
+
+	return res;
+}
+
 qsc_socket_exceptions qsc_socket_set_option(const qsc_socket* sock, qsc_socket_protocols level, qsc_socket_options option, int32_t optval)
 {
 	assert(sock != NULL);
@@ -1161,7 +1647,27 @@ qsc_socket_exceptions qsc_socket_set_option(const qsc_socket* sock, qsc_socket_p
 
 	if (sock != NULL)
 	{
+#if defined(QSC_SYSTEM_OS_WINDOWS)
 		res = (qsc_socket_exceptions)setsockopt(sock->connection, (int32_t)level, (int32_t)option, (void*)&optval, sizeof(optval));
+#else
+		struct timeval tv;
+		int32_t nlvl;
+		int32_t nopt;
+
+		qsc_socket_option_native(level, option, &nlvl, &nopt);
+
+		if (level == qsc_socket_protocol_socket && (option == qsc_socket_option_receive_time_out || option == qsc_socket_option_send_time_out))
+		{
+			/* the timeouts are given in milliseconds, posix systems take them as a timeval */
+			tv.tv_sec = (time_t)(optval / 1000);
+			tv.tv_usec = (suseconds_t)((optval % 1000) * 1000);
+			res = (qsc_socket_exceptions)setsockopt(sock->connection, nlvl, nopt, (void*)&tv, sizeof(tv));
+		}
+		else
+		{
+			res = (qsc_socket_exceptions)setsockopt(sock->connection, nlvl, nopt, (void*)&optval, sizeof(optval));
+		}
+#endif
 	}
 
 	if (res == qsc_socket_exception_error)
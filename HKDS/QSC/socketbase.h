@@ -48,6 +48,7 @@ QSC_SYSTEM_CONDITION_IGNORE(5105)
 #else //elif defined(QSC_SYSTEM_OS_POSIX)
 
 #	include <errno.h>
+#	include <fcntl.h>
 #	include <netdb.h>
 #	include <ifaddrs.h>
 #	include <netinet/in.h>
@@ -56,6 +57,7 @@ QSC_SYSTEM_CONDITION_IGNORE(5105)
 #	include <sys/socket.h>
 #	include <string.h>
 #	include <sys/types.h>
+#	include <sys/uio.h>
 #	include <unistd.h>
 #	if defined(QSC_SYSTEM_OS_APPLE)
 #
@@ -82,6 +84,24 @@ QSC_SYSTEM_CONDITION_IGNORE(5105)
 */
 #define QSC_SOCKET_RECEIVE_BUFFER_SIZE 1600
 
+/*!
+\def QSC_SOCKET_VECTOR_MAX
+* \brief The maximum number of buffers passed to the system in one vectored send
+*/
+#define QSC_SOCKET_VECTOR_MAX 128
+
+/*!
+\def QSC_SOCKET_DATAGRAM_BATCH_MAX
+* \brief The maximum number of datagrams passed to the system in one batched receive or send
+*/
+#define QSC_SOCKET_DATAGRAM_BATCH_MAX 64
+
+/*!
+\def QSC_SOCKET_ADDRESS_STORAGE_SIZE
+* \brief The size of a stored native socket address, large enough for an IPv6 address
+*/
+#define QSC_SOCKET_ADDRESS_STORAGE_SIZE 128
+
 /*! \enum qsc_socket_exceptions
 * \brief Socket code enumeration names
 */
@@ -263,6 +283,27 @@ typedef struct qsc_socket_receive_poll_state
 	uint32_t count;																		/*!< The number of active sockets */
 } qsc_socket_receive_poll_state;
 
+/*! \struct qsc_socket_vector
+* \brief A buffer in a vectored send
+*/
+typedef struct qsc_socket_vector
+{
+	const uint8_t* data;																/*!< A pointer to the buffer */
+	size_t length;																		/*!< The number of bytes in the buffer */
+} qsc_socket_vector;
+
+/*! \struct qsc_socket_datagram
+* \brief A datagram in a batched receive or send
+*/
+typedef struct qsc_socket_datagram
+{
+	uint8_t address[QSC_SOCKET_ADDRESS_STORAGE_SIZE];									/*!< The native address of the datagram source on receive, or the destination on send */
+	uint8_t* data;																		/*!< A pointer to the datagram buffer */
+	size_t capacity;																	/*!< The size of the datagram buffer */
+	size_t length;																		/*!< The number of bytes in the datagram */
+	uint32_t addrlen;																	/*!< The length of the native address; zero sends to the connected peer */
+} qsc_socket_datagram;
+
 /*** Function Prototypes ***/
 
 /**
@@ -377,6 +418,17 @@ QSC_EXPORT_API qsc_socket_exceptions qsc_socket_bind_ipv4(qsc_socket* sock, cons
 */
 QSC_EXPORT_API qsc_socket_exceptions qsc_socket_bind_ipv6(qsc_socket* sock, const qsc_ipinfo_ipv6_address* address, uint16_t port);
 
+/**
+* \brief The Bind Unix function associates a file system path with a Unix domain socket.
+* The path must not exist; a listener removes a stale socket file before it binds.
+*
+* \param sock: The socket instance
+* \param path: [const] The socket path
+*
+* \return Returns an exception code on failure, or success(0)
+*/
+QSC_EXPORT_API qsc_socket_exceptions qsc_socket_bind_unix(qsc_socket* sock, const char* path);
+
 /**
 * \brief The Close socket function closes and disposes of the socket
 *
@@ -419,6 +471,16 @@ QSC_EXPORT_API qsc_socket_exceptions qsc_socket_connect_ipv4(qsc_socket* sock, c
 */
 QSC_EXPORT_API qsc_socket_exceptions qsc_socket_connect_ipv6(qsc_socket* sock, const qsc_ipinfo_ipv6_address* address, uint16_t port);
 
+/**
+* \brief The Connect Unix function establishes a connection to a Unix domain socket on the local host
+*
+* \param sock: The socket instance
+* \param path: [const] The listening sockets path
+*
+* \return Returns an exception code on failure, or success(0)
+*/
+QSC_EXPORT_API qsc_socket_exceptions qsc_socket_connect_unix(qsc_socket* sock, const char* path);
+
 /**
 * \brief The Create function creates a socket that is bound to a specific transport provider
 *
@@ -486,6 +548,20 @@ QSC_EXPORT_API size_t qsc_socket_receive_all(const qsc_socket* sock, uint8_t* ou
 */
 QSC_EXPORT_API size_t qsc_socket_receive_from(qsc_socket* sock, char* destination, uint16_t port, uint8_t* output, size_t outlen, qsc_socket_receive_flags flag);
 
+/**
+* \brief Receive a set of datagrams on a bound connection-less socket, with one system call for up to QSC_SOCKET_DATAGRAM_BATCH_MAX datagrams.
+* Waits for the first datagram unless the socket is non-blocking, and returns the datagrams that are already queued with it.
+* Each datagram receives its length and source address; systems without a batched receive return one datagram per call.
+*
+* \param sock: [const] The socket instance
+* \param datagrams: The array of datagrams; the data and capacity members of each are set by the caller
+* \param count: The number of datagrams in the array
+* \param flag: Flags that influence the behavior of the receive function
+*
+* \return Returns the number of datagrams received
+*/
+QSC_EXPORT_API size_t qsc_socket_receive_batch(const qsc_socket* sock, qsc_socket_datagram* datagrams, size_t count, qsc_socket_receive_flags flag);
+
 /**
 * \brief Polls an array of sockets.
 * Fires a callback if a socket is ready to receive data, or an error if socket is disconnected.
@@ -508,6 +584,19 @@ QSC_EXPORT_API uint32_t qsc_socket_receive_poll(const qsc_socket_receive_poll_st
 */
 QSC_EXPORT_API size_t qsc_socket_send(const qsc_socket* sock, const uint8_t* input, size_t inlen, qsc_socket_send_flags flag);
 
+/**
+* \brief Sends a set of buffers on a TCP connected socket with one system call per QSC_SOCKET_VECTOR_MAX buffers.
+* The buffers are sent in order, as one contiguous stream; a partial send is resumed until every buffer is sent.
+*
+* \param sock: [const] The socket instance
+* \param vectors: [const] The array of buffers to be transmitted
+* \param count: The number of buffers
+* \param flag: Flags that influence the behavior of the send function
+*
+* \return Returns the number of bytes sent to the remote host, or zero on failure
+*/
+QSC_EXPORT_API size_t qsc_socket_send_vector(const qsc_socket* sock, const qsc_socket_vector* vectors, size_t count, qsc_socket_send_flags flag);
+
 /**
 * \brief Sends data on a UDP socket
 *
@@ -523,6 +612,19 @@ QSC_EXPORT_API size_t qsc_socket_send(const qsc_socket* sock, const uint8_t* inp
 */
 QSC_EXPORT_API size_t qsc_socket_send_to(const qsc_socket* sock, const char* destination, size_t destlen, uint16_t port, const uint8_t* input, size_t inlen, qsc_socket_send_flags flag);
 
+/**
+* \brief Sends a set of datagrams on a UDP socket, with one system call for up to QSC_SOCKET_DATAGRAM_BATCH_MAX datagrams.
+* Each datagram is sent to its own address, or to the connected peer when the address length is zero.
+*
+* \param sock: [const] The socket instance
+* \param datagrams: [const] The array of datagrams to be transmitted
+* \param count: The number of datagrams
+* \param flag: Flags that influence the behavior of the send function
+*
+* \return Returns the number of datagrams sent, in order
+*/
+QSC_EXPORT_API size_t qsc_socket_send_batch(const qsc_socket* sock, const qsc_socket_datagram* datagrams, size_t count, qsc_socket_send_flags flag);
+
 /**
 * \brief Sends a block of data larger than a single packet size, on a TCP socket and returns when sent
 *
@@ -607,9 +709,20 @@ QSC_EXPORT_API void qsc_socket_set_last_error(qsc_socket_exceptions error);
 */
 QSC_EXPORT_API qsc_socket_exceptions qsc_socket_shut_down_sockets(void);
 
+/**
+* \brief Set the socket to non-blocking or blocking mode.
+* A non-blocking socket returns qsc_socket_exception_would_block from calls that would wait.
+*
+* \param sock: [const] The socket instance
+* \param enabled: Non-blocking mode is enabled
+*
+* \return Returns an exception code on failure, or success(0)
+*/
+QSC_EXPORT_API qsc_socket_exceptions qsc_socket_set_nonblocking(const qsc_socket* sock, bool enabled);
+
 /**
 * \brief Send an option command to the socket.
-* Options that use a boolean are format: 0=false, 1=true.
+* Options that use a boolean are format: 0=false, 1=true. The receive and send timeouts are in milliseconds.
 *
 * \param sock: [const] The socket instance
 * \param level: The level at which the option is assigned
@@ -74,6 +74,7 @@ typedef enum qsc_socket_options
 	qsc_socket_option_no_route = 0x00000010L,			/*!< Sets whether outgoing data should be sent on interface the socket is bound to and not a routed on some other interface SO_DONTROUTE */
 	qsc_socket_option_out_of_band = 0x00000100L,		/*!< Indicates that out-of-bound data should be returned in-line with regular data SO_OOBINLINE */
 	qsc_socket_option_reuse_address = 0x00000004L,		/*!< Enables or disables the reuse of a bound address */
+	qsc_socket_option_reuse_port = 0x0000000FL,			/*!< Allows several sockets to bind the same address and port, the kernel spreads the connections SO_REUSEPORT */
 	qsc_socket_option_receive_time_out = 0x00001006L,	/*!< The timeout, in milliseconds, for blocking received calls SO_RCVTIMEO */
 	qsc_socket_option_send_time_out = 0x00001005L,		/*!< The timeout, in milliseconds, for blocking send calls SO_SNDTIMEO */
 	qsc_socket_option_tcp_no_delay = 0x00000001L		/*!< Enables or disables the Nagle algorithm for TCP sockets. This option is disabled (set to FALSE) by default TCP_NODELAY */
@@ -118,6 +119,7 @@ typedef enum qsc_socket_send_flags
 	qsc_socket_send_flag_send_oob = 0x00000001L,		/*!< Sends OOB data on a stream type socket MSG_OOB */
 	qsc_socket_send_flag_peek_message = 0x00000002L,	/*!< Sends a partial message */
 	qsc_socket_send_flag_no_routing = 0x00000004L,		/*!< The data packets should not be routed MSG_DONTROUTE */
+	qsc_socket_send_flag_no_signal = 0x00004000L,		/*!< A send to a closed peer returns an error instead of raising SIGPIPE MSG_NOSIGNAL */
 } qsc_socket_send_flags;
 
 /*! \enum qsc_socket_shut_down_flags
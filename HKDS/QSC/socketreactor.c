@@ -0,0 +1,1619 @@
+#include "socketreactor.h"
+#include "atomics.h"
+#include "memutils.h"
+#include "timerex.h"
+
+#if defined(QSC_SYSTEM_OS_LINUX)
+#	include <stdlib.h>
+#	include <sys/epoll.h>
+#	include <sys/eventfd.h>
+#	include <sys/mman.h>
+#	include <sys/syscall.h>
+#	if defined(__has_include)
+#		if __has_include(<linux/io_uring.h>)
+#			include <linux/io_uring.h>
+#			if defined(IORING_RECV_MULTISHOT) && defined(IORING_ACCEPT_MULTISHOT) && defined(IORING_ENTER_EXT_ARG) && defined(__NR_io_uring_setup)
+#				define QSC_REACTOR_URING
+#			endif
+#		endif
+#	endif
+
+#if defined(QSC_REACTOR_URING)
+/* the operation of an io_uring completion is held in the low bits of its user data */
+#	define QSC_REACTOR_OP_ACCEPT 0x00
+#	define QSC_REACTOR_OP_RECEIVE 0x01
+#	define QSC_REACTOR_OP_SEND 0x02
+#	define QSC_REACTOR_OP_WAKEUP 0x03
+#	define QSC_REACTOR_OP_CANCEL 0x04
+#	define QSC_REACTOR_OP_MASK 0x07
+#endif
+
+static void qsc_reactor_expire(qsc_reactor_loop* loop, qsc_reactor_connection* connection)
+{
+	/* the connection is settled by the backend once the wheel has advanced */
+	if (connection->expired == false)
+	{
+		connection->expired = true;
+		connection->enext = loop->expired;
+		loop->expired = connection;
+	}
+}
+
+static qsc_reactor_connection* qsc_reactor_expired_next(qsc_reactor_loop* loop)
+{
+	qsc_reactor_connection* conn;
+
+	conn = loop->expired;
+
+	if (conn != NULL)
+	{
+		loop->expired = conn->enext;
+		conn->enext = NULL;
+		conn->expired = false;
+	}
+
+	return conn;
+}
+
+static void qsc_reactor_idle_expired(void* context, qsc_timerwheel_timer* timer)
+{
+	qsc_reactor_connection* conn;
+	qsc_reactor_loop* loop;
+	qsc_reactor_state* state;
+	uint64_t idle;
+
+	conn = (qsc_reactor_connection*)context;
+	loop = (qsc_reactor_loop*)conn->loop;
+	state = (qsc_reactor_state*)loop->owner;
+	idle = qsc_atomics_load64(&state->idle);
+
+	if (idle != 0)
+	{
+		/* receives only record their time; an active connection moves the timer to its new deadline */
+		if (loop->now - conn->activity >= idle)
+		{
+			conn->closing = true;
+			qsc_reactor_expire(loop, conn);
+		}
+		else
+		{
+			qsc_timerwheel_start(&loop->timers, timer, conn->activity + idle);
+		}
+	}
+}
+
+static void qsc_reactor_expired_remove(qsc_reactor_loop* loop, qsc_reactor_connection* connection)
+{
+	qsc_reactor_connection** prev;
+
+	/* a connection released before it is settled is unlinked, the list holds only the connections of one iteration */
+	if (connection->expired == true)
+	{
+		prev = &loop->expired;
+
+		while (*prev != NULL && *prev != connection)
+		{
+			prev = &(*prev)->enext;
+		}
+
+		if (*prev != NULL)
+		{
+			*prev = connection->enext;
+		}
+
+		connection->enext = NULL;
+		connection->expired = false;
+	}
+}
+
+static void qsc_reactor_timer_dispatch(void* context, qsc_timerwheel_timer* timer)
+{
+	qsc_reactor_timer* rtmr;
+	qsc_reactor_loop* loop;
+	qsc_reactor_state* state;
+
+	(void)timer;
+	rtmr = (qsc_reactor_timer*)context;
+	loop = (qsc_reactor_loop*)rtmr->connection->loop;
+	state = (qsc_reactor_state*)loop->owner;
+
+	if (rtmr->connection->closing == false)
+	{
+		rtmr->callback(state->context, rtmr->connection, rtmr);
+		qsc_reactor_expire(loop, rtmr->connection);
+	}
+}
+
+static int32_t qsc_reactor_wait_time(const qsc_reactor_loop* loop)
+{
+	uint64_t next;
+	uint64_t now;
+	int32_t res;
+
+	res = -1;
+	next = qsc_timerwheel_next(&loop->timers);
+
+	if (next != UINT64_MAX)
+	{
+		now = qsc_timerex_monotonic_microseconds();
+		next = (next > now) ? ((next - now) + 999) / 1000 : 0;
+		res = (next > INT32_MAX) ? INT32_MAX : (int32_t)next;
+	}
+
+	return res;
+}
+
+static bool qsc_reactor_buffer_reserve(qsc_reactor_connection* connection, qsc_bufferpool_buffer** buffer)
+{
+	qsc_reactor_state* state;
+
+	/* a buffer is held only while the connection has pending bytes */
+	if (*buffer == NULL)
+	{
+		state = (qsc_reactor_state*)((qsc_reactor_loop*)connection->loop)->owner;
+		*buffer = qsc_bufferpool_acquire(&state->pool);
+
+		if (*buffer == NULL)
+		{
+			/* the pool is at its maximum */
+			connection->closing = true;
+		}
+	}
+
+	return (*buffer != NULL);
+}
+
+static void qsc_reactor_buffer_return(qsc_bufferpool_buffer** buffer)
+{
+	if (*buffer != NULL)
+	{
+		qsc_bufferpool_release(*buffer);
+		*buffer = NULL;
+	}
+}
+
+static qsc_reactor_connection* qsc_reactor_connection_create(qsc_reactor_loop* loop, const qsc_socket* target)
+{
+	qsc_reactor_connection* conn;
+	qsc_reactor_state* state;
+
+	state = (qsc_reactor_state*)loop->owner;
+	conn = NULL;
+
+	if (qsc_atomics_fetch_add64(&state->connections, 1) < state->maximum)
+	{
+		conn = (qsc_reactor_connection*)malloc(sizeof(qsc_reactor_connection));
+
+		if (conn != NULL)
+		{
+			qsc_memutils_clear(conn, sizeof(qsc_reactor_connection));
+			qsc_memutils_copy(&conn->target, target, sizeof(qsc_socket));
+			conn->loop = loop;
+			qsc_timerwheel_timer_initialize(&conn->idle, &qsc_reactor_idle_expired, conn);
+			qsc_socket_set_nonblocking(&conn->target, true);
+			qsc_socket_set_option(&conn->target, qsc_socket_protocol_tcp, qsc_socket_option_tcp_no_delay, 1);
+
+			if (state->accept != NULL && state->accept(state->context, conn) == false)
+			{
+				free(conn);
+				conn = NULL;
+			}
+		}
+	}
+
+	if (conn == NULL)
+	{
+		/* over the limit, refused, or out of memory */
+		qsc_socket_close_socket(target);
+		qsc_atomics_fetch_add64(&state->connections, (uint64_t)-1);
+	}
+
+	return conn;
+}
+
+static void qsc_reactor_connection_link(qsc_reactor_loop* loop, qsc_reactor_connection* connection)
+{
+	qsc_reactor_state* state;
+	uint64_t idle;
+
+	state = (qsc_reactor_state*)loop->owner;
+	idle = qsc_atomics_load64(&state->idle);
+	connection->activity = loop->now;
+
+	if (idle != 0)
+	{
+		qsc_timerwheel_start(&loop->timers, &connection->idle, loop->now + idle);
+	}
+
+	connection->next = loop->head;
+
+	if (loop->head != NULL)
+	{
+		loop->head->previous = connection;
+	}
+
+	loop->head = connection;
+	++loop->connections;
+}
+
+static void qsc_reactor_release(qsc_reactor_loop* loop, qsc_reactor_connection* connection)
+{
+	qsc_reactor_state* state;
+
+	state = (qsc_reactor_state*)loop->owner;
+
+	if (state->closed != NULL)
+	{
+		state->closed(state->context, connection);
+	}
+
+	if (state->backend == qsc_reactor_backend_epoll)
+	{
+		epoll_ctl(loop->efd, EPOLL_CTL_DEL, connection->target.connection, NULL);
+	}
+
+	qsc_reactor_expired_remove(loop, connection);
+	qsc_timerwheel_cancel(&loop->timers, &connection->idle);
+	qsc_socket_close_socket(&connection->target);
+	qsc_reactor_buffer_return(&connection->rbuffer);
+	qsc_reactor_buffer_return(&connection->wbuffer);
+
+	if (connection->overflow != NULL)
+	{
+		free(connection->overflow);
+	}
+
+	if (connection->previous != NULL)
+	{
+		connection->previous->next = connection->next;
+	}
+	else
+	{
+		loop->head = connection->next;
+	}
+
+	if (connection->next != NULL)
+	{
+		connection->next->previous = connection->previous;
+	}
+
+	--loop->connections;
+	qsc_atomics_fetch_add64(&state->connections, (uint64_t)-1);
+	qsc_memutils_clear(connection, sizeof(qsc_reactor_connection));
+	free(connection);
+}
+
+static void qsc_reactor_compact(qsc_reactor_connection* connection, size_t used)
+{
+	used = (used > connection->rlength) ? connection->rlength : used;
+
+	if (used != 0 && used < connection->rlength)
+	{
+		qsc_memutils_move(connection->rbuffer->data, connection->rbuffer->data + used, connection->rlength - used);
+	}
+
+	connection->rlength -= used;
+
+	if (connection->rlength == QSC_REACTOR_BUFFER_SIZE)
+	{
+		/* a full buffer that holds no complete message can not be framed */
+		connection->closing = true;
+	}
+	else if (connection->rlength == 0)
+	{
+		qsc_reactor_buffer_return(&connection->rbuffer);
+	}
+}
+
+static void qsc_reactor_deliver(qsc_reactor_loop* loop, qsc_reactor_connection* connection, const uint8_t* input, size_t inlen)
+{
+	qsc_reactor_state* state;
+	size_t used;
+
+	state = (qsc_reactor_state*)loop->owner;
+	connection->activity = loop->now;
+
+	if (connection->rlength == 0)
+	{
+		/* nothing is pending, the callback reads the received data in place, and only the remainder is kept */
+		used = state->receive(state->context, connection, input, inlen);
+		used = (used > inlen) ? inlen : used;
+
+		if (used < inlen && connection->closing == false && qsc_reactor_buffer_reserve(connection, &connection->rbuffer) == true)
+		{
+			qsc_memutils_copy(connection->rbuffer->data, input + used, inlen - used);
+			connection->rlength = inlen - used;
+			connection->closing = (connection->rlength == QSC_REACTOR_BUFFER_SIZE) ? true : connection->closing;
+		}
+	}
+	else if (inlen <= QSC_REACTOR_BUFFER_SIZE - connection->rlength)
+	{
+		qsc_memutils_copy(connection->rbuffer->data + connection->rlength, input, inlen);
+		connection->rlength += inlen;
+		qsc_reactor_compact(connection, state->receive(state->context, connection, connection->rbuffer->data, connection->rlength));
+	}
+	else
+	{
+		connection->closing = true;
+	}
+}
+
+static bool qsc_reactor_send_direct(qsc_reactor_connection* connection, const uint8_t* input, size_t inlen, size_t* sent)
+{
+	ssize_t res;
+
+	*sent = 0;
+	res = send(connection->target.connection, input, inlen, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+	if (res > 0)
+	{
+		*sent = (size_t)res;
+	}
+	else if (res < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+	{
+		connection->closing = true;
+	}
+
+	return (connection->closing == false);
+}
+
+static bool qsc_reactor_overflow_add(qsc_reactor_connection* connection, const uint8_t* input, size_t inlen)
+{
+	uint8_t* tmp;
+	size_t ncap;
+
+	if (connection->olength + inlen > QSC_REACTOR_OVERFLOW_MAX)
+	{
+		/* the peer is not reading its responses */
+		connection->closing = true;
+	}
+	else if (connection->olength + inlen > connection->ocapacity)
+	{
+		ncap = (connection->ocapacity == 0) ? QSC_REACTOR_BUFFER_SIZE * 4 : connection->ocapacity * 2;
+		ncap = (ncap < connection->olength + inlen) ? connection->olength + inlen : ncap;
+		ncap = (ncap > QSC_REACTOR_OVERFLOW_MAX) ? QSC_REACTOR_OVERFLOW_MAX : ncap;
+		tmp = (uint8_t*)realloc(connection->overflow, ncap);
+
+		if (tmp != NULL)
+		{
+			connection->overflow = tmp;
+			connection->ocapacity = ncap;
+		}
+		else
+		{
+			connection->closing = true;
+		}
+	}
+
+	if (connection->closing == false)
+	{
+		qsc_memutils_copy(connection->overflow + connection->olength, input, inlen);
+		connection->olength += inlen;
+	}
+
+	return (connection->closing == false);
+}
+
+static void qsc_reactor_overflow_drain(qsc_reactor_connection* connection)
+{
+	size_t mlen;
+
+	/* move the oldest overflow bytes into the free space of the write buffer */
+	mlen = QSC_REACTOR_BUFFER_SIZE - connection->wlength;
+	mlen = (mlen > connection->olength) ? connection->olength : mlen;
+
+	if (mlen != 0 && qsc_reactor_buffer_reserve(connection, &connection->wbuffer) == true)
+	{
+		qsc_memutils_copy(connection->wbuffer->data + connection->wlength, connection->overflow, mlen);
+		connection->wlength += mlen;
+		connection->olength -= mlen;
+
+		if (connection->olength != 0)
+		{
+			qsc_memutils_move(connection->overflow, connection->overflow + mlen, connection->olength);
+		}
+	}
+}
+
+/* epoll backend */
+
+static void qsc_reactor_epoll_accept(qsc_reactor_loop* loop)
+{
+	struct epoll_event evt;
+	qsc_reactor_connection* conn;
+	qsc_reactor_state* state;
+	qsc_socket target;
+	bool more;
+
+	state = (qsc_reactor_state*)loop->owner;
+	more = true;
+
+	/* the listener is shared by the loops, accept until another loop has taken the remaining connections */
+	while (more == true)
+	{
+		qsc_memutils_clear(&target, sizeof(qsc_socket));
+
+		if (qsc_socket_accept(state->source, &target) != qsc_socket_exception_success)
+		{
+			more = false;
+		}
+		else
+		{
+			conn = qsc_reactor_connection_create(loop, &target);
+
+			if (conn != NULL)
+			{
+				evt.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+				evt.data.ptr = conn;
+
+				if (epoll_ctl(loop->efd, EPOLL_CTL_ADD, conn->target.connection, &evt) == 0)
+				{
+					qsc_reactor_connection_link(loop, conn);
+				}
+				else
+				{
+					qsc_socket_close_socket(&conn->target);
+					free(conn);
+					qsc_atomics_fetch_add64(&state->connections, (uint64_t)-1);
+				}
+			}
+		}
+	}
+}
+
+static void qsc_reactor_epoll_flush(qsc_reactor_connection* connection)
+{
+	size_t pos;
+	size_t sent;
+	bool more;
+
+	more = true;
+
+	/* write the buffered output, refilling the write buffer from the overflow until the socket is full */
+	while (more == true && connection->closing == false)
+	{
+		qsc_reactor_overflow_drain(connection);
+		pos = 0;
+		sent = 1;
+
+		while (pos < connection->wlength && sent != 0 && connection->closing == false)
+		{
+			qsc_reactor_send_direct(connection, connection->wbuffer->data + pos, connection->wlength - pos, &sent);
+			pos += sent;
+		}
+
+		if (pos != 0 && pos < connection->wlength)
+		{
+			qsc_memutils_move(connection->wbuffer->data, connection->wbuffer->data + pos, connection->wlength - pos);
+		}
+
+		connection->wlength = (pos < connection->wlength) ? connection->wlength - pos : 0;
+		more = (connection->wlength == 0 && connection->olength != 0);
+	}
+
+	if (connection->wlength == 0)
+	{
+		qsc_reactor_buffer_return(&connection->wbuffer);
+	}
+}
+
+static void qsc_reactor_epoll_read(qsc_reactor_loop* loop, qsc_reactor_connection* connection)
+{
+	ssize_t res;
+	bool more;
+
+	more = true;
+
+	/* edge-triggered; read until the socket would block, or the readiness is lost */
+	while (more == true && connection->closing == false)
+	{
+		/* the receive is limited to the space left behind a pending partial packet */
+		res = recv(connection->target.connection, loop->scratch, QSC_REACTOR_BUFFER_SIZE - connection->rlength, 0);
+
+		if (res > 0)
+		{
+			qsc_reactor_deliver(loop, connection, loop->scratch, (size_t)res);
+		}
+		else if (res == 0)
+		{
+			connection->closing = true;
+		}
+		else if (errno == EAGAIN || errno == EWOULDBLOCK)
+		{
+			more = false;
+		}
+		else if (errno != EINTR)
+		{
+			connection->closing = true;
+		}
+	}
+}
+
+static void qsc_reactor_epoll_run(qsc_reactor_loop* loop)
+{
+	struct epoll_event evts[QSC_REACTOR_EVENTS_MAX];
+	qsc_reactor_connection* conn;
+	qsc_reactor_state* state;
+	uint64_t val;
+	int32_t i;
+	int32_t n;
+
+	state = (qsc_reactor_state*)loop->owner;
+
+	while (qsc_atomics_load64(&state->running) != 0)
+	{
+		/* wait until an event arrives or the next timer is due */
+		n = epoll_wait(loop->efd, evts, QSC_REACTOR_EVENTS_MAX, qsc_reactor_wait_time(loop));
+		loop->now = qsc_timerex_monotonic_microseconds();
+
+		for (i = 0; i < n; ++i)
+		{
+			if (evts[i].data.ptr == loop)
+			{
+				/* the wakeup descriptor, the reactor is stopping */
+				if (read(loop->wakeup, &val, sizeof(val)) < 0)
+				{
+					val = 0;
+				}
+			}
+			else if (evts[i].data.ptr == state->source)
+			{
+				qsc_reactor_epoll_accept(loop);
+			}
+			else
+			{
+				conn = (qsc_reactor_connection*)evts[i].data.ptr;
+
+				if ((evts[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0)
+				{
+					qsc_reactor_epoll_read(loop, conn);
+				}
+
+				if ((evts[i].events & EPOLLOUT) != 0 && (conn->wlength != 0 || conn->olength != 0))
+				{
+					qsc_reactor_epoll_flush(conn);
+				}
+
+				if (conn->closing == true)
+				{
+					qsc_reactor_release(loop, conn);
+				}
+			}
+		}
+
+		qsc_timerwheel_advance(&loop->timers, loop->now);
+		conn = qsc_reactor_expired_next(loop);
+
+		while (conn != NULL)
+		{
+			/* a timer callback writes directly to the socket, only a closed connection needs settling */
+			if (conn->closing == true)
+			{
+				qsc_reactor_release(loop, conn);
+			}
+
+			conn = qsc_reactor_expired_next(loop);
+		}
+	}
+}
+
+static bool qsc_reactor_epoll_initialize(qsc_reactor_state* state, qsc_reactor_loop* loop)
+{
+	struct epoll_event evt;
+	bool res;
+
+	res = false;
+	loop->efd = epoll_create1(EPOLL_CLOEXEC);
+
+	if (loop->efd >= 0)
+	{
+		evt.events = EPOLLIN;
+		evt.data.ptr = loop;
+
+		if (epoll_ctl(loop->efd, EPOLL_CTL_ADD, loop->wakeup, &evt) == 0)
+		{
+			/* each loop waits on the listener, exclusive so one loop is woken for each new connection */
+			evt.events = EPOLLIN | EPOLLEXCLUSIVE;
+			evt.data.ptr = state->source;
+			res = (epoll_ctl(loop->efd, EPOLL_CTL_ADD, state->source->connection, &evt) == 0);
+		}
+	}
+
+	return res;
+}
+
+#if defined(QSC_REACTOR_URING)
+
+/* io_uring backend */
+
+static struct io_uring_sqe* qsc_reactor_uring_sqe(qsc_reactor_uring* ring)
+{
+	struct io_uring_sqe* sqe;
+	uint32_t head;
+	uint32_t tail;
+
+	tail = *ring->sqtail;
+	head = __atomic_load_n(ring->sqhead, __ATOMIC_ACQUIRE);
+
+	if (tail - head >= ring->sqentries)
+	{
+		/* the submission ring is full, pass the queued entries to the kernel */
+		if (syscall(__NR_io_uring_enter, ring->fd, ring->queued, 0, 0, NULL, 0) > 0)
+		{
+			ring->queued = 0;
+		}
+	}
+
+	sqe = &((struct io_uring_sqe*)ring->sqes)[tail & ring->sqmask];
+	qsc_memutils_clear(sqe, sizeof(struct io_uring_sqe));
+	ring->sqarray[tail & ring->sqmask] = tail & ring->sqmask;
+	__atomic_store_n(ring->sqtail, tail + 1, __ATOMIC_RELEASE);
+	++ring->queued;
+
+	return sqe;
+}
+
+static void qsc_reactor_uring_buffer_add(qsc_reactor_uring* ring, uint16_t bid)
+{
+	struct io_uring_buf_ring* br;
+	struct io_uring_buf* buf;
+
+	br = (struct io_uring_buf_ring*)ring->bring;
+	buf = &br->bufs[ring->btail & (QSC_REACTOR_URING_BUFFERS - 1)];
+	buf->addr = (uint64_t)(uintptr_t)(ring->bslab + ((size_t)bid * QSC_REACTOR_BUFFER_SIZE));
+	buf->len = QSC_REACTOR_BUFFER_SIZE;
+	buf->bid = bid;
+	++ring->btail;
+	__atomic_store_n(&br->tail, ring->btail, __ATOMIC_RELEASE);
+}
+
+static void qsc_reactor_uring_arm_accept(qsc_reactor_loop* loop)
+{
+	struct io_uring_sqe* sqe;
+	qsc_reactor_state* state;
+
+	state = (qsc_reactor_state*)loop->owner;
+	sqe = qsc_reactor_uring_sqe(&loop->uring);
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = state->source->connection;
+	sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+	sqe->user_data = (uint64_t)(uintptr_t)loop | QSC_REACTOR_OP_ACCEPT;
+	loop->uring.accepting = true;
+}
+
+static void qsc_reactor_uring_arm_receive(qsc_reactor_loop* loop, qsc_reactor_connection* connection)
+{
+	struct io_uring_sqe* sqe;
+
+	sqe = qsc_reactor_uring_sqe(&loop->uring);
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = connection->target.connection;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = 0;
+	sqe->user_data = (uint64_t)(uintptr_t)connection | QSC_REACTOR_OP_RECEIVE;
+	++connection->inflight;
+}
+
+static void qsc_reactor_uring_arm_send(qsc_reactor_loop* loop, qsc_reactor_connection* connection)
+{
+	struct io_uring_sqe* sqe;
+
+	sqe = qsc_reactor_uring_sqe(&loop->uring);
+	sqe->opcode = IORING_OP_SEND;
+	sqe->fd = connection->target.connection;
+	sqe->addr = (uint64_t)(uintptr_t)connection->wbuffer->data;
+	sqe->len = (uint32_t)connection->wlength;
+	sqe->msg_flags = MSG_NOSIGNAL;
+	sqe->user_data = (uint64_t)(uintptr_t)connection | QSC_REACTOR_OP_SEND;
+	/* the kernel holds a reference to the buffer until the send completes */
+	qsc_bufferpool_retain(connection->wbuffer);
+	connection->sending = true;
+	++connection->inflight;
+}
+
+static void qsc_reactor_uring_arm_wakeup(qsc_reactor_loop* loop)
+{
+	struct io_uring_sqe* sqe;
+
+	sqe = qsc_reactor_uring_sqe(&loop->uring);
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = loop->wakeup;
+	sqe->addr = (uint64_t)(uintptr_t)&loop->uring.wakeval;
+	sqe->len = sizeof(loop->uring.wakeval);
+	sqe->user_data = (uint64_t)(uintptr_t)loop | QSC_REACTOR_OP_WAKEUP;
+}
+
+static void qsc_reactor_uring_settle(qsc_reactor_loop* loop, qsc_reactor_connection* connection)
+{
+	/* start a send of the buffered output, or shut a closing connection down and release it once idle */
+	if (connection->closing == false)
+	{
+		if (connection->sending == false)
+		{
+			/* the kernel does not hold the write buffer, so it can be refilled from the overflow */
+			qsc_reactor_overflow_drain(connection);
+
+			if (connection->wlength != 0)
+			{
+				qsc_reactor_uring_arm_send(loop, connection);
+			}
+			else
+			{
+				qsc_reactor_buffer_return(&connection->wbuffer);
+			}
+		}
+	}
+	else
+	{
+		if (connection->shut == false)
+		{
+			shutdown(connection->target.connection, SHUT_RDWR);
+			connection->shut = true;
+		}
+
+		if (connection->inflight == 0)
+		{
+			qsc_reactor_release(loop, connection);
+		}
+	}
+}
+
+static void qsc_reactor_uring_complete(qsc_reactor_loop* loop, const struct io_uring_cqe* cqe)
+{
+	qsc_reactor_connection* conn;
+	qsc_reactor_state* state;
+	qsc_socket target;
+	uint64_t op;
+	uint16_t bid;
+	bool more;
+	bool running;
+
+	state = (qsc_reactor_state*)loop->owner;
+	op = cqe->user_data & QSC_REACTOR_OP_MASK;
+	more = ((cqe->flags & IORING_CQE_F_MORE) != 0);
+	running = (qsc_atomics_load64(&state->running) != 0);
+
+	if (op == QSC_REACTOR_OP_ACCEPT)
+	{
+		if (cqe->res >= 0)
+		{
+			qsc_memutils_clear(&target, sizeof(qsc_socket));
+			target.connection = cqe->res;
+			target.address_family = state->source->address_family;
+			target.socket_protocol = state->source->socket_protocol;
+			target.socket_transport = state->source->socket_transport;
+			target.connection_status = qsc_socket_state_connected;
+			conn = (running == true) ? qsc_reactor_connection_create(loop, &target) : NULL;
+
+			if (conn != NULL)
+			{
+				qsc_reactor_connection_link(loop, conn);
+				qsc_reactor_uring_arm_receive(loop, conn);
+			}
+			else if (running == false)
+			{
+				qsc_socket_close_socket(&target);
+			}
+		}
+
+		loop->uring.accepting = more;
+
+		if (more == false && running == true)
+		{
+			qsc_reactor_uring_arm_accept(loop);
+		}
+	}
+	else if (op == QSC_REACTOR_OP_RECEIVE)
+	{
+		conn = (qsc_reactor_connection*)(uintptr_t)(cqe->user_data & ~(uint64_t)QSC_REACTOR_OP_MASK);
+
+		if (cqe->res > 0 && (cqe->flags & IORING_CQE_F_BUFFER) != 0)
+		{
+			bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+
+			if (conn->closing == false)
+			{
+				qsc_reactor_deliver(loop, conn, loop->uring.bslab + ((size_t)bid * QSC_REACTOR_BUFFER_SIZE), (size_t)cqe->res);
+			}
+
+			qsc_reactor_uring_buffer_add(&loop->uring, bid);
+		}
+		else if (cqe->res != -ENOBUFS)
+		{
+			/* the peer closed, or the receive failed; out of buffers only ends the multishot receive */
+			conn->closing = true;
+		}
+
+		if (more == false)
+		{
+			--conn->inflight;
+
+			if (conn->closing == false && running == true)
+			{
+				qsc_reactor_uring_arm_receive(loop, conn);
+			}
+		}
+
+		qsc_reactor_uring_settle(loop, conn);
+	}
+	else if (op == QSC_REACTOR_OP_SEND)
+	{
+		conn = (qsc_reactor_connection*)(uintptr_t)(cqe->user_data & ~(uint64_t)QSC_REACTOR_OP_MASK);
+		--conn->inflight;
+		conn->sending = false;
+		qsc_bufferpool_release(conn->wbuffer);
+
+		if (cqe->res > 0)
+		{
+			if ((size_t)cqe->res < conn->wlength)
+			{
+				qsc_memutils_move(conn->wbuffer->data, conn->wbuffer->data + cqe->res, conn->wlength - (size_t)cqe->res);
+			}
+
+			conn->wlength -= ((size_t)cqe->res < conn->wlength) ? (size_t)cqe->res : conn->wlength;
+		}
+		else
+		{
+			conn->closing = true;
+		}
+
+		qsc_reactor_uring_settle(loop, conn);
+	}
+	else if (op == QSC_REACTOR_OP_WAKEUP)
+	{
+		if (running == true)
+		{
+			qsc_reactor_uring_arm_wakeup(loop);
+		}
+	}
+}
+
+static size_t qsc_reactor_uring_reap(qsc_reactor_loop* loop)
+{
+	const struct io_uring_cqe* cqe;
+	uint32_t head;
+	uint32_t tail;
+	size_t cnt;
+
+	cnt = 0;
+	head = *loop->uring.cqhead;
+	tail = __atomic_load_n(loop->uring.cqtail, __ATOMIC_ACQUIRE);
+
+	while (head != tail)
+	{
+		cqe = &((const struct io_uring_cqe*)loop->uring.cqes)[head & loop->uring.cqmask];
+		qsc_reactor_uring_complete(loop, cqe);
+		++head;
+		++cnt;
+		__atomic_store_n(loop->uring.cqhead, head, __ATOMIC_RELEASE);
+		tail = __atomic_load_n(loop->uring.cqtail, __ATOMIC_ACQUIRE);
+	}
+
+	return cnt;
+}
+
+static void qsc_reactor_uring_enter(qsc_reactor_loop* loop, int32_t timeout)
+{
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+	long res;
+
+	/* submit the queued operations and wait for at least one completion, or until the timeout, in one call */
+	if (timeout < 0)
+	{
+		res = syscall(__NR_io_uring_enter, loop->uring.fd, loop->uring.queued, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+	}
+	else
+	{
+		qsc_memutils_clear(&arg, sizeof(arg));
+		ts.tv_sec = timeout / 1000;
+		ts.tv_nsec = (long long)(timeout % 1000) * 1000000LL;
+		arg.ts = (uint64_t)(uintptr_t)&ts;
+		res = syscall(__NR_io_uring_enter, loop->uring.fd, loop->uring.queued, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+	}
+
+	if (res >= 0)
+	{
+		loop->uring.queued -= ((uint32_t)res < loop->uring.queued) ? (uint32_t)res : loop->uring.queued;
+	}
+}
+
+static void qsc_reactor_uring_run(qsc_reactor_loop* loop)
+{
+	qsc_reactor_connection* conn;
+	qsc_reactor_connection* next;
+	qsc_reactor_state* state;
+	struct io_uring_sqe* sqe;
+
+	state = (qsc_reactor_state*)loop->owner;
+	qsc_reactor_uring_arm_wakeup(loop);
+	qsc_reactor_uring_arm_accept(loop);
+
+	while (qsc_atomics_load64(&state->running) != 0)
+	{
+		qsc_reactor_uring_enter(loop, qsc_reactor_wait_time(loop));
+		loop->now = qsc_timerex_monotonic_microseconds();
+		qsc_reactor_uring_reap(loop);
+		qsc_timerwheel_advance(&loop->timers, loop->now);
+		conn = qsc_reactor_expired_next(loop);
+
+		while (conn != NULL)
+		{
+			/* queue the sends of the timer callbacks, or shut down the connections they closed */
+			qsc_reactor_uring_settle(loop, conn);
+			conn = qsc_reactor_expired_next(loop);
+		}
+	}
+
+	/* stopping; cancel the accept and shut every connection down, then drain the operations still in progress */
+	if (loop->uring.accepting == true)
+	{
+		sqe = qsc_reactor_uring_sqe(&loop->uring);
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->addr = (uint64_t)(uintptr_t)loop | QSC_REACTOR_OP_ACCEPT;
+		sqe->user_data = (uint64_t)(uintptr_t)loop | QSC_REACTOR_OP_CANCEL;
+	}
+
+	conn = loop->head;
+
+	while (conn != NULL)
+	{
+		next = conn->next;
+		conn->closing = true;
+		qsc_reactor_uring_settle(loop, conn);
+		conn = next;
+	}
+
+	while (loop->head != NULL || loop->uring.accepting == true)
+	{
+		qsc_reactor_uring_enter(loop, -1);
+		qsc_reactor_uring_reap(loop);
+	}
+}
+
+static void qsc_reactor_uring_dispose(qsc_reactor_loop* loop)
+{
+	qsc_reactor_uring* ring;
+
+	ring = &loop->uring;
+
+	if (ring->fd >= 0)
+	{
+		close(ring->fd);
+	}
+
+	if (ring->sqes != NULL)
+	{
+		munmap(ring->sqes, ring->sqelen);
+	}
+
+	if (ring->cqmap != NULL && ring->cqmap != ring->sqmap)
+	{
+		munmap(ring->cqmap, ring->cqmlen);
+	}
+
+	if (ring->sqmap != NULL)
+	{
+		munmap(ring->sqmap, ring->sqmlen);
+	}
+
+	if (ring->bring != NULL)
+	{
+		munmap(ring->bring, ring->brlen);
+	}
+
+	if (ring->bslab != NULL)
+	{
+		free(ring->bslab);
+	}
+
+	qsc_memutils_clear(ring, sizeof(qsc_reactor_uring));
+	ring->fd = -1;
+}
+
+static bool qsc_reactor_uring_initialize(qsc_reactor_loop* loop)
+{
+	struct io_uring_buf_reg reg;
+	struct io_uring_params prm;
+	qsc_reactor_uring* ring;
+	size_t i;
+	bool res;
+
+	ring = &loop->uring;
+	qsc_memutils_clear(ring, sizeof(qsc_reactor_uring));
+	qsc_memutils_clear(&prm, sizeof(prm));
+	res = false;
+	prm.flags = IORING_SETUP_CQSIZE;
+	prm.cq_entries = QSC_REACTOR_URING_ENTRIES * 4;
+	ring->fd = (int32_t)syscall(__NR_io_uring_setup, QSC_REACTOR_URING_ENTRIES, &prm);
+
+	/* the timed wait passes its timeout as an extended argument */
+	if (ring->fd >= 0 && (prm.features & IORING_FEAT_SINGLE_MMAP) != 0 && (prm.features & IORING_FEAT_EXT_ARG) != 0)
+	{
+		ring->sqmlen = prm.sq_off.array + (prm.sq_entries * sizeof(uint32_t));
+		ring->cqmlen = prm.cq_off.cqes + (prm.cq_entries * sizeof(struct io_uring_cqe));
+		ring->sqmlen = (ring->cqmlen > ring->sqmlen) ? ring->cqmlen : ring->sqmlen;
+		ring->sqelen = prm.sq_entries * sizeof(struct io_uring_sqe);
+		ring->sqmap = (uint8_t*)mmap(NULL, ring->sqmlen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+		ring->sqes = mmap(NULL, ring->sqelen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+		ring->brlen = QSC_REACTOR_URING_BUFFERS * sizeof(struct io_uring_buf);
+		ring->bring = mmap(NULL, ring->brlen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		ring->bslab = (uint8_t*)malloc((size_t)QSC_REACTOR_URING_BUFFERS * QSC_REACTOR_BUFFER_SIZE);
+		ring->sqmap = (ring->sqmap == MAP_FAILED) ? NULL : ring->sqmap;
+		ring->sqes = (ring->sqes == MAP_FAILED) ? NULL : ring->sqes;
+		ring->bring = (ring->bring == MAP_FAILED) ? NULL : ring->bring;
+
+		if (ring->sqmap != NULL && ring->sqes != NULL && ring->bring != NULL && ring->bslab != NULL)
+		{
+			ring->cqmap = ring->sqmap;
+			ring->sqhead = (volatile uint32_t*)(ring->sqmap + prm.sq_off.head);
+			ring->sqtail = (volatile uint32_t*)(ring->sqmap + prm.sq_off.tail);
+			ring->sqarray = (uint32_t*)(ring->sqmap + prm.sq_off.array);
+			ring->sqmask = *(uint32_t*)(ring->sqmap + prm.sq_off.ring_mask);
+			ring->sqentries = prm.sq_entries;
+			ring->cqhead = (volatile uint32_t*)(ring->cqmap + prm.cq_off.head);
+			ring->cqtail = (volatile uint32_t*)(ring->cqmap + prm.cq_off.tail);
+			ring->cqmask = *(uint32_t*)(ring->cqmap + prm.cq_off.ring_mask);
+			ring->cqes = ring->cqmap + prm.cq_off.cqes;
+
+			/* the receive buffers are provided to the kernel through a registered buffer ring */
+			qsc_memutils_clear(&reg, sizeof(reg));
+			reg.ring_addr = (uint64_t)(uintptr_t)ring->bring;
+			reg.ring_entries = QSC_REACTOR_URING_BUFFERS;
+			reg.bgid = 0;
+
+			if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) == 0)
+			{
+				for (i = 0; i < QSC_REACTOR_URING_BUFFERS; ++i)
+				{
+					qsc_reactor_uring_buffer_add(ring, (uint16_t)i);
+				}
+
+				res = true;
+			}
+		}
+	}
+
+	if (res == false)
+	{
+		qsc_reactor_uring_dispose(loop);
+	}
+
+	return res;
+}
+
+static bool qsc_reactor_uring_probe(void)
+{
+	qsc_reactor_loop loop;
+	const struct io_uring_cqe* cqe;
+	qsc_reactor_connection conn;
+	uint8_t b;
+	int32_t sv[2];
+	bool res;
+
+	/* multishot receive is newer than the buffer ring; receive one byte on a socket pair to test for it */
+	res = false;
+	qsc_memutils_clear(&loop, sizeof(loop));
+	qsc_memutils_clear(&conn, sizeof(conn));
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0)
+	{
+		if (qsc_reactor_uring_initialize(&loop) == true)
+		{
+			b = 0x01;
+			conn.target.connection = sv[0];
+			qsc_reactor_uring_arm_receive(&loop, &conn);
+
+			if (send(sv[1], &b, 1, MSG_NOSIGNAL) == 1)
+			{
+				qsc_reactor_uring_enter(&loop, -1);
+
+				if (*loop.uring.cqhead != __atomic_load_n(loop.uring.cqtail, __ATOMIC_ACQUIRE))
+				{
+					cqe = &((const struct io_uring_cqe*)loop.uring.cqes)[*loop.uring.cqhead & loop.uring.cqmask];
+					res = (cqe->res == 1 && (cqe->flags & IORING_CQE_F_MORE) != 0);
+				}
+			}
+
+			qsc_reactor_uring_dispose(&loop);
+		}
+
+		close(sv[0]);
+		close(sv[1]);
+	}
+
+	return res;
+}
+
+#endif
+
+static void qsc_reactor_run(void* context)
+{
+	qsc_reactor_loop* loop;
+	qsc_reactor_state* state;
+
+	loop = (qsc_reactor_loop*)context;
+	state = (qsc_reactor_state*)loop->owner;
+
+#if defined(QSC_REACTOR_URING)
+	if (state->backend == qsc_reactor_backend_uring)
+	{
+		qsc_reactor_uring_run(loop);
+	}
+	else
+#endif
+	{
+		qsc_reactor_epoll_run(loop);
+	}
+}
+
+static bool qsc_reactor_loop_initialize(qsc_reactor_state* state, qsc_reactor_loop* loop)
+{
+	bool res;
+
+	res = false;
+	loop->owner = state;
+	loop->head = NULL;
+	loop->expired = NULL;
+	loop->connections = 0;
+	loop->now = qsc_timerex_monotonic_microseconds();
+	qsc_timerwheel_initialize(&loop->timers, QSC_REACTOR_TIMER_RESOLUTION, loop->now);
+	loop->wakeup = eventfd(0, EFD_CLOEXEC);
+
+	if (loop->wakeup >= 0)
+	{
+#if defined(QSC_REACTOR_URING)
+		if (state->backend == qsc_reactor_backend_uring)
+		{
+			res = qsc_reactor_uring_initialize(loop);
+		}
+		else
+#endif
+		{
+			res = qsc_reactor_epoll_initialize(state, loop);
+		}
+	}
+
+	return res;
+}
+
+static void qsc_reactor_loop_dispose(qsc_reactor_loop* loop)
+{
+	while (loop->head != NULL)
+	{
+		qsc_reactor_release(loop, loop->head);
+	}
+
+#if defined(QSC_REACTOR_URING)
+	if (loop->uring.fd >= 0)
+	{
+		qsc_reactor_uring_dispose(loop);
+	}
+#endif
+
+	if (loop->efd >= 0)
+	{
+		close(loop->efd);
+	}
+
+	if (loop->wakeup >= 0)
+	{
+		close(loop->wakeup);
+	}
+
+	loop->efd = -1;
+	loop->wakeup = -1;
+}
+
+bool qsc_reactor_initialize(qsc_reactor_state* state, qsc_socket* source, size_t threads, size_t maximum,
+	bool (*accept)(void* context, qsc_reactor_connection* connection),
+	size_t (*receive)(void* context, qsc_reactor_connection* connection, const uint8_t* input, size_t inlen),
+	void (*closed)(void* context, qsc_reactor_connection* connection), void* context, qsc_reactor_backends backend)
+{
+	assert(state != NULL);
+	assert(source != NULL);
+	assert(receive != NULL);
+
+	uint64_t val;
+	size_t i;
+	size_t n;
+	bool res;
+
+	res = false;
+
+	if (state != NULL && source != NULL && receive != NULL)
+	{
+		qsc_memutils_clear(state, sizeof(qsc_reactor_state));
+		threads = (threads == 0) ? qsc_async_processor_count() : threads;
+		threads = (threads == 0) ? 1 : threads;
+		state->lcount = (threads > QSC_REACTOR_THREADS_MAX) ? QSC_REACTOR_THREADS_MAX : threads;
+		state->maximum = maximum;
+		state->source = source;
+		state->accept = accept;
+		state->receive = receive;
+		state->closed = closed;
+		state->context = context;
+
+#if defined(QSC_REACTOR_URING)
+		if (backend == qsc_reactor_backend_auto)
+		{
+			backend = (qsc_reactor_uring_probe() == true) ? qsc_reactor_backend_uring : qsc_reactor_backend_epoll;
+		}
+#else
+		backend = (backend == qsc_reactor_backend_auto) ? qsc_reactor_backend_epoll : backend;
+#endif
+		state->backend = backend;
+		res = (qsc_socket_set_nonblocking(source, true) == qsc_socket_exception_success);
+		/* a read and a write buffer for each connection at most; the slabs are added as the connections need them */
+		res = (res == true) ? qsc_bufferpool_initialize(&state->pool, QSC_REACTOR_BUFFER_SIZE, (maximum > SIZE_MAX / 2) ? SIZE_MAX : maximum * 2) : false;
+#if !defined(QSC_REACTOR_URING)
+		res = (backend == qsc_reactor_backend_uring) ? false : res;
+#endif
+
+		for (i = 0; i < state->lcount; ++i)
+		{
+			state->loops[i].efd = -1;
+			state->loops[i].wakeup = -1;
+			state->loops[i].uring.fd = -1;
+
+			if (res == true)
+			{
+				res = qsc_reactor_loop_initialize(state, &state->loops[i]);
+			}
+		}
+
+		n = 0;
+
+		if (res == true)
+		{
+			qsc_atomics_store64(&state->running, 1);
+
+			while (n < state->lcount && res == true)
+			{
+				state->loops[n].thread = qsc_async_thread_create(&qsc_reactor_run, &state->loops[n]);
+				res = (state->loops[n].thread != 0);
+				n += (res == true) ? 1 : 0;
+			}
+
+			if (res == false)
+			{
+				/* the loops already started are stopped before the state is released */
+				qsc_atomics_store64(&state->running, 0);
+				val = 1;
+
+				for (i = 0; i < n; ++i)
+				{
+					if (write(state->loops[i].wakeup, &val, sizeof(val)) < 0)
+					{
+						val = 1;
+					}
+
+					qsc_async_thread_wait(state->loops[i].thread);
+				}
+			}
+		}
+
+		if (res == false)
+		{
+			for (i = 0; i < state->lcount; ++i)
+			{
+				qsc_reactor_loop_dispose(&state->loops[i]);
+			}
+
+			qsc_bufferpool_dispose(&state->pool);
+			state->lcount = 0;
+		}
+	}
+
+	return res;
+}
+
+void qsc_reactor_dispose(qsc_reactor_state* state)
+{
+	assert(state != NULL);
+
+	uint64_t val;
+	size_t i;
+
+	if (state != NULL && qsc_atomics_exchange64(&state->running, 0) != 0)
+	{
+		val = 1;
+
+		for (i = 0; i < state->lcount; ++i)
+		{
+			if (write(state->loops[i].wakeup, &val, sizeof(val)) < 0)
+			{
+				val = 1;
+			}
+		}
+
+		for (i = 0; i < state->lcount; ++i)
+		{
+			qsc_async_thread_wait(state->loops[i].thread);
+			qsc_reactor_loop_dispose(&state->loops[i]);
+		}
+
+		qsc_bufferpool_dispose(&state->pool);
+		state->lcount = 0;
+	}
+}
+
+qsc_reactor_connection* qsc_reactor_attach(qsc_reactor_connection* connection, const qsc_socket* target, void* tag)
+{
+	assert(connection != NULL);
+	assert(target != NULL);
+
+	struct epoll_event evt;
+	qsc_reactor_connection* conn;
+	qsc_reactor_loop* loop;
+	qsc_reactor_state* state;
+
+	conn = NULL;
+
+	if (connection != NULL && target != NULL)
+	{
+		loop = (qsc_reactor_loop*)connection->loop;
+		state = (qsc_reactor_state*)loop->owner;
+		conn = (qsc_reactor_connection*)malloc(sizeof(qsc_reactor_connection));
+
+		if (conn != NULL)
+		{
+			/* an attached connection is not counted against the maximum, but is released like an accepted one */
+			qsc_memutils_clear(conn, sizeof(qsc_reactor_connection));
+			qsc_memutils_copy(&conn->target, target, sizeof(qsc_socket));
+			conn->loop = loop;
+			conn->tag = tag;
+			qsc_timerwheel_timer_initialize(&conn->idle, &qsc_reactor_idle_expired, conn);
+			qsc_socket_set_nonblocking(&conn->target, true);
+			qsc_atomics_fetch_add64(&state->connections, 1);
+
+			if (state->backend == qsc_reactor_backend_epoll)
+			{
+				evt.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+				evt.data.ptr = conn;
+
+				if (epoll_ctl(loop->efd, EPOLL_CTL_ADD, conn->target.connection, &evt) != 0)
+				{
+					free(conn);
+					conn = NULL;
+					qsc_atomics_fetch_add64(&state->connections, (uint64_t)-1);
+				}
+			}
+
+			if (conn != NULL)
+			{
+				qsc_reactor_connection_link(loop, conn);
+#if defined(QSC_REACTOR_URING)
+				if (state->backend == qsc_reactor_backend_uring)
+				{
+					qsc_reactor_uring_arm_receive(loop, conn);
+				}
+#endif
+			}
+		}
+
+		if (conn == NULL)
+		{
+			qsc_socket_close_socket(target);
+		}
+	}
+
+	return conn;
+}
+
+void qsc_reactor_close(qsc_reactor_connection* connection)
+{
+	assert(connection != NULL);
+
+	if (connection != NULL)
+	{
+		connection->closing = true;
+		/* the connection may belong to another callback of the loop, and is released after the current events */
+		qsc_reactor_expire((qsc_reactor_loop*)connection->loop, connection);
+	}
+}
+
+size_t qsc_reactor_connections(const qsc_reactor_state* state)
+{
+	assert(state != NULL);
+
+	size_t res;
+
+	res = 0;
+
+	if (state != NULL)
+	{
+		res = (size_t)qsc_atomics_load64(&state->connections);
+	}
+
+	return res;
+}
+
+bool qsc_reactor_send(qsc_reactor_connection* connection, const uint8_t* input, size_t inlen)
+{
+	assert(connection != NULL);
+	assert(input != NULL);
+
+	qsc_reactor_state* state;
+	size_t pos;
+	bool res;
+
+	res = false;
+	pos = 0;
+
+	if (connection != NULL && input != NULL && connection->closing == false)
+	{
+		state = (qsc_reactor_state*)((qsc_reactor_loop*)connection->loop)->owner;
+
+		/* epoll writes straight to an idle socket; io_uring queues the output for a batched send,
+		   and only writes directly when the output does not fit the buffer and nothing is queued ahead of it */
+		if (connection->wlength == 0 && connection->olength == 0 && connection->sending == false &&
+			(state->backend == qsc_reactor_backend_epoll || inlen > QSC_REACTOR_BUFFER_SIZE))
+		{
+			qsc_reactor_send_direct(connection, input, inlen, &pos);
+		}
+
+		if (connection->closing == false)
+		{
+			if (pos == inlen)
+			{
+				res = true;
+			}
+			else if (connection->olength == 0 && inlen - pos <= QSC_REACTOR_BUFFER_SIZE - connection->wlength)
+			{
+				if (qsc_reactor_buffer_reserve(connection, &connection->wbuffer) == true)
+				{
+					qsc_memutils_copy(connection->wbuffer->data + connection->wlength, input + pos, inlen - pos);
+					connection->wlength += inlen - pos;
+					res = true;
+				}
+			}
+			else
+			{
+				res = qsc_reactor_overflow_add(connection, input + pos, inlen - pos);
+			}
+		}
+
+		/* the output of a connection sent to from another connection's callback is settled after the current events */
+		qsc_reactor_expire((qsc_reactor_loop*)connection->loop, connection);
+	}
+
+	return res;
+}
+
+void qsc_reactor_idle_timeout(qsc_reactor_state* state, uint32_t milliseconds)
+{
+	assert(state != NULL);
+
+	if (state != NULL)
+	{
+		qsc_atomics_store64(&state->idle, (uint64_t)milliseconds * 1000);
+	}
+}
+
+void qsc_reactor_timer_initialize(qsc_reactor_timer* timer, void (*callback)(void* context, qsc_reactor_connection* connection, qsc_reactor_timer* timer))
+{
+	assert(timer != NULL);
+	assert(callback != NULL);
+
+	if (timer != NULL && callback != NULL)
+	{
+		qsc_timerwheel_timer_initialize(&timer->node, &qsc_reactor_timer_dispatch, timer);
+		timer->connection = NULL;
+		timer->callback = callback;
+	}
+}
+
+void qsc_reactor_timer_start(qsc_reactor_connection* connection, qsc_reactor_timer* timer, uint32_t milliseconds)
+{
+	assert(connection != NULL);
+	assert(timer != NULL);
+
+	qsc_reactor_loop* loop;
+
+	if (connection != NULL && timer != NULL)
+	{
+		loop = (qsc_reactor_loop*)connection->loop;
+		timer->connection = connection;
+		qsc_timerwheel_start(&loop->timers, &timer->node, loop->now + ((uint64_t)milliseconds * 1000));
+	}
+}
+
+void qsc_reactor_timer_cancel(qsc_reactor_connection* connection, qsc_reactor_timer* timer)
+{
+	assert(connection != NULL);
+	assert(timer != NULL);
+
+	if (connection != NULL && timer != NULL)
+	{
+		qsc_timerwheel_cancel(&((qsc_reactor_loop*)connection->loop)->timers, &timer->node);
+	}
+}
+
+#else
+
+bool qsc_reactor_initialize(qsc_reactor_state* state, qsc_socket* source, size_t threads, size_t maximum,
+	bool (*accept)(void* context, qsc_reactor_connection* connection),
+	size_t (*receive)(void* context, qsc_reactor_connection* connection, const uint8_t* input, size_t inlen),
+	void (*closed)(void* context, qsc_reactor_connection* connection), void* context, qsc_reactor_backends backend)
+{
+	(void)state;
+	(void)source;
+	(void)threads;
+	(void)maximum;
+	(void)accept;
+	(void)receive;
+	(void)closed;
+	(void)context;
+	(void)backend;
+
+	return false;
+}
+
+void qsc_reactor_dispose(qsc_reactor_state* state)
+{
+	(void)state;
+}
+
+qsc_reactor_connection* qsc_reactor_attach(qsc_reactor_connection* connection, const qsc_socket* target, void* tag)
+{
+	(void)connection;
+	(void)target;
+	(void)tag;
+
+	return NULL;
+}
+
+void qsc_reactor_close(qsc_reactor_connection* connection)
+{
+	if (connection != NULL)
+	{
+		connection->closing = true;
+	}
+}
+
+size_t qsc_reactor_connections(const qsc_reactor_state* state)
+{
+	(void)state;
+
+	return 0;
+}
+
+bool qsc_reactor_send(qsc_reactor_connection* connection, const uint8_t* input, size_t inlen)
+{
+	(void)connection;
+	(void)input;
+	(void)inlen;
+
+	return false;
+}
+
+
+void qsc_reactor_idle_timeout(qsc_reactor_state* state, uint32_t milliseconds)
+{
+	(void)state;
+	(void)milliseconds;
+}
+
+void qsc_reactor_timer_initialize(qsc_reactor_timer* timer, void (*callback)(void* context, qsc_reactor_connection* connection, qsc_reactor_timer* timer))
+{
+	(void)timer;
+	(void)callback;
+}
+
+void qsc_reactor_timer_start(qsc_reactor_connection* connection, qsc_reactor_timer* timer, uint32_t milliseconds)
+{
+	(void)connection;
+	(void)timer;
+	(void)milliseconds;
+}
+
+void qsc_reactor_timer_cancel(qsc_reactor_connection* connection, qsc_reactor_timer* timer)
+{
+	(void)connection;
+	(void)timer;
+}
+
+#endif
@@ -0,0 +1,344 @@
+/* The AGPL version 3 License (AGPLv3)
+*
+* Copyright (c) 2021 Digital Freedom Defence Inc.
+* This file is part of the QSC Cryptographic library
+*
+* This program is free software : you can redistribute it and / or modify
+* it under the terms of the GNU Affero General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU Affero General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef QSC_SOCKETREACTOR_H
+#define QSC_SOCKETREACTOR_H
+
+#include "common.h"
+#include "async.h"
+#include "bufferpool.h"
+#include "socketbase.h"
+#include "timerwheel.h"
+
+/**
+* \file socketreactor.h
+* \brief An edge-triggered event reactor for socket servers.
+* The reactor serves many persistent connections from a small fixed set of event loop threads.
+* Each loop thread waits on its own epoll instance, and the listening socket is added to every loop,
+* so a loop accepts its own connections and no connection is handed between threads.
+* Sockets are non-blocking and registered edge-triggered; a loop reads each ready connection until the
+* socket would block, and passes the buffered bytes to the receive callback, which returns the number of
+* bytes it consumed. The unconsumed remainder, an incomplete packet, is kept for the next read.
+* Output is written directly to the socket, and only the part the socket can not take is held in the
+* connections write buffer until the socket is writable again.
+* The read and write buffers are taken from a pool of cache aligned buffers shared by all loops of the reactor,
+* only while a connection holds an incomplete packet or unsent output, and returned to the pool when they empty,
+* so an idle connection holds no buffer memory and the buffers are not allocated on the receive path. Output that does not fit the write buffer
+* is held in an overflow buffer allocated for the connection, up to QSC_REACTOR_OVERFLOW_MAX bytes;
+* a peer that lets more output than that accumulate is disconnected.
+* A connection is only accessed by its own loop thread, so the callbacks and the send and close functions
+* need no locks, but they must only be called from within a callback of that connection's loop.
+* A callback may send on or close any connection of its loop; a connection other than the one being served is
+* settled after the current events, so a loop can forward data between its connections.
+* A connected socket, such as a link to another server, can be attached to the loop of a connection, and is then served
+* by the same callbacks as the accepted connections.
+* On Linux kernels that support it, the reactor can use io_uring in place of epoll. Each loop then owns a ring
+* with a multishot accept on the listener and a multishot receive on each connection. Received data is placed
+* in a ring of provided buffers registered with the kernel, and sends are queued as submissions.
+* A loop submits its queued operations and reaps completions with one system call per iteration, so one
+* call can carry the receives and responses of thousands of packets.
+* The automatic backend selection probes io_uring when the reactor starts, and falls back to epoll
+* when the ring, the buffer ring, or the multishot receive is not available.
+* Each loop owns a timer wheel, so connection timers are started and cancelled in constant time however many
+* connections the loop serves. The loop waits until the next timer is due, advances the wheel after each batch
+* of events, and settles the connections whose timers expired before it waits again. The optional idle timeout
+* closes connections that receive nothing for the timeout period; a receive only records its time, and the idle
+* timer is moved forward when it expires on a connection that has been active, so busy connections cost no timer work.
+* Request timeouts are started on a connection with the reactor timer functions, and run on its loop thread.
+* The reactor is implemented on Linux; on other platforms the initialize function returns false.
+*/
+
+/*!
+* \def QSC_REACTOR_BUFFER_SIZE
+* \brief The size of the pooled read and write buffers
+*/
+#define QSC_REACTOR_BUFFER_SIZE 1024
+
+/*!
+* \def QSC_REACTOR_EVENTS_MAX
+* \brief The maximum number of events returned by one wait
+*/
+#define QSC_REACTOR_EVENTS_MAX 256
+
+/*!
+* \def QSC_REACTOR_OVERFLOW_MAX
+* \brief The maximum number of output bytes a connection holds beyond its write buffer
+*/
+#define QSC_REACTOR_OVERFLOW_MAX 65536
+
+/*!
+* \def QSC_REACTOR_URING_BUFFERS
+* \brief The number of provided receive buffers of each io_uring loop, a power of two
+*/
+#define QSC_REACTOR_URING_BUFFERS 512
+
+/*!
+* \def QSC_REACTOR_URING_ENTRIES
+* \brief The submission queue size of each io_uring loop, a power of two
+*/
+#define QSC_REACTOR_URING_ENTRIES 1024
+
+/*!
+* \def QSC_REACTOR_TIMER_RESOLUTION
+* \brief The tick length of the event loop timer wheels in microseconds
+*/
+#define QSC_REACTOR_TIMER_RESOLUTION 1000
+
+/*!
+* \def QSC_REACTOR_THREADS_MAX
+* \brief The maximum number of event loop threads
+*/
+#define QSC_REACTOR_THREADS_MAX 64
+
+/*** Structures ***/
+
+/*! \enum qsc_reactor_backends
+* \brief The reactor event backend
+*/
+typedef enum qsc_reactor_backends
+{
+	qsc_reactor_backend_auto = 0x00,						/*!< Use io_uring if it is available, otherwise epoll */
+	qsc_reactor_backend_epoll = 0x01,						/*!< Edge-triggered epoll */
+	qsc_reactor_backend_uring = 0x02,						/*!< io_uring with multishot accept and receive */
+} qsc_reactor_backends;
+
+/*! \struct qsc_reactor_connection
+* \brief A connection served by the reactor
+*/
+typedef struct qsc_reactor_connection
+{
+	qsc_socket target;										/*!< The connected socket */
+	qsc_bufferpool_buffer* rbuffer;							/*!< The received bytes not yet consumed, or NULL if none are pending */
+	qsc_bufferpool_buffer* wbuffer;							/*!< The output bytes not yet sent, or NULL if none are pending */
+	struct qsc_reactor_connection* next;					/*!< The next connection of the loop */
+	struct qsc_reactor_connection* previous;				/*!< The previous connection of the loop */
+	void* loop;												/*!< The owning event loop */
+	void* tag;												/*!< A caller defined connection context */
+	struct qsc_reactor_connection* enext;					/*!< The next connection settled after the timer wheel advances */
+	qsc_timerwheel_timer idle;								/*!< The idle timeout timer */
+	uint64_t activity;										/*!< The time of the last receive in microseconds */
+	uint8_t* overflow;										/*!< The output that follows the write buffer, allocated when needed */
+	size_t ocapacity;										/*!< The size of the overflow buffer */
+	size_t olength;											/*!< The number of bytes in the overflow buffer */
+	size_t rlength;											/*!< The number of bytes in the read buffer */
+	size_t wlength;											/*!< The number of bytes in the write buffer */
+	uint32_t inflight;										/*!< The number of io_uring operations in progress */
+	bool closing;											/*!< The connection is closed when the current event is processed */
+	bool expired;											/*!< A timer of the connection has expired, and the connection is waiting to be settled */
+	bool sending;											/*!< An io_uring send of the write buffer is in progress */
+	bool shut;												/*!< The io_uring connection has been shut down, and is released when its operations complete */
+} qsc_reactor_connection;
+
+/*! \struct qsc_reactor_uring
+* \brief The io_uring state of an event loop
+*/
+typedef struct qsc_reactor_uring
+{
+	uint8_t* bslab;											/*!< The provided receive buffers */
+	void* bring;											/*!< The provided buffer ring */
+	void* sqes;												/*!< The submission queue entries */
+	void* cqes;												/*!< The completion queue entries */
+	uint8_t* sqmap;											/*!< The submission ring mapping */
+	uint8_t* cqmap;											/*!< The completion ring mapping, or the submission mapping when shared */
+	uint32_t* sqarray;										/*!< The submission index array */
+	volatile uint32_t* sqhead;								/*!< The submission ring head, advanced by the kernel */
+	volatile uint32_t* sqtail;								/*!< The submission ring tail */
+	volatile uint32_t* cqhead;								/*!< The completion ring head */
+	volatile uint32_t* cqtail;								/*!< The completion ring tail, advanced by the kernel */
+	size_t brlen;											/*!< The size of the buffer ring mapping */
+	size_t cqmlen;											/*!< The size of the completion ring mapping */
+	size_t sqelen;											/*!< The size of the submission entries mapping */
+	size_t sqmlen;											/*!< The size of the submission ring mapping */
+	uint64_t wakeval;										/*!< The value read from the wakeup descriptor */
+	uint32_t cqmask;										/*!< The completion ring mask */
+	uint32_t queued;										/*!< The number of submissions not yet passed to the kernel */
+	uint32_t sqentries;										/*!< The submission ring size */
+	uint32_t sqmask;										/*!< The submission ring mask */
+	uint16_t btail;											/*!< The provided buffer ring tail */
+	int32_t fd;												/*!< The ring descriptor */
+	bool accepting;											/*!< The multishot accept is armed */
+} qsc_reactor_uring;
+
+/*! \struct qsc_reactor_loop
+* \brief An event loop thread state
+*/
+typedef struct qsc_reactor_loop
+{
+	qsc_timerwheel_state timers;							/*!< The connection timers */
+	qsc_reactor_connection* head;							/*!< The connections served by the loop */
+	qsc_reactor_connection* expired;						/*!< The connections with expired timers, settled after the wheel advances */
+	void* owner;											/*!< The reactor state */
+	qsc_reactor_uring uring;								/*!< The io_uring state */
+	qsc_thread thread;										/*!< The loop thread */
+	size_t connections;										/*!< The number of connections served by the loop */
+	uint8_t scratch[QSC_REACTOR_BUFFER_SIZE];				/*!< The epoll receive buffer, read by the callback in place */
+	uint64_t now;											/*!< The time the last wait returned in microseconds */
+	int32_t efd;											/*!< The event descriptor */
+	int32_t wakeup;											/*!< The descriptor used to wake the loop when the reactor is stopped */
+} qsc_reactor_loop;
+
+/*! \struct qsc_reactor_state
+* \brief The reactor state
+*/
+typedef struct qsc_reactor_state
+{
+	qsc_reactor_loop loops[QSC_REACTOR_THREADS_MAX];															/*!< The event loops */
+	qsc_bufferpool_state pool;																					/*!< The read and write buffers shared by the loops */
+	qsc_socket* source;																							/*!< The listening socket */
+	bool (*accept)(void* context, qsc_reactor_connection* connection);											/*!< The optional accept callback, returns false to refuse the connection */
+	size_t (*receive)(void* context, qsc_reactor_connection* connection, const uint8_t* input, size_t inlen);	/*!< The receive callback, returns the number of bytes consumed */
+	void (*closed)(void* context, qsc_reactor_connection* connection);											/*!< The optional callback invoked before a connection is released */
+	void* context;																								/*!< The callback context */
+	size_t lcount;																								/*!< The number of event loops */
+	qsc_reactor_backends backend;																				/*!< The backend in use */
+	size_t maximum;																								/*!< The maximum number of connections */
+	volatile uint64_t connections;																				/*!< The number of open connections */
+	volatile uint64_t idle;																						/*!< The idle timeout in microseconds, zero if disabled */
+	volatile uint64_t running;																					/*!< The event loops are running */
+} qsc_reactor_state;
+
+/*! \struct qsc_reactor_timer
+* \brief A timer started on a connection
+*/
+typedef struct qsc_reactor_timer
+{
+	qsc_timerwheel_timer node;																					/*!< The timer wheel entry */
+	qsc_reactor_connection* connection;																			/*!< The connection the timer was started on */
+	void (*callback)(void* context, qsc_reactor_connection* connection, struct qsc_reactor_timer* timer);		/*!< The expiry callback, invoked with the reactor callback context */
+} qsc_reactor_timer;
+
+/*** Function Prototypes ***/
+
+/**
+* \brief Start the reactor on a listening socket.
+* The listening socket is made non-blocking and is served by every event loop.
+*
+* \param state: The reactor state
+* \param source: The bound and listening socket; must remain valid until the reactor is disposed
+* \param threads: The number of event loop threads, zero selects the processor count
+* \param maximum: The maximum number of open connections; further connections are closed when accepted.
+* The buffer pool holds up to two buffers for each connection.
+* \param accept: The optional accept callback
+* \param receive: The receive callback
+* \param closed: The optional close callback
+* \param context: The callback context
+* \param backend: The event backend; auto selects io_uring when the kernel supports it, otherwise epoll
+*
+* \return Returns true if the event loops were started; false if the requested backend is not available or a loop thread could not be created
+*/
+QSC_EXPORT_API bool qsc_reactor_initialize(qsc_reactor_state* state, qsc_socket* source, size_t threads, size_t maximum,
+	bool (*accept)(void* context, qsc_reactor_connection* connection),
+	size_t (*receive)(void* context, qsc_reactor_connection* connection, const uint8_t* input, size_t inlen),
+	void (*closed)(void* context, qsc_reactor_connection* connection), void* context, qsc_reactor_backends backend);
+
+/**
+* \brief Stop the event loops and close every connection.
+* The close callback is invoked for each open connection. The listening socket is not closed.
+*
+* \param state: The reactor state
+*/
+QSC_EXPORT_API void qsc_reactor_dispose(qsc_reactor_state* state);
+
+/**
+* \brief Add a connected socket to the event loop of a connection.
+* The socket is made non-blocking and is served by the loop and the callbacks of the reactor like an accepted connection;
+* it is not counted against the maximum, and the accept callback is not invoked.
+* Must be called from a callback of a connection on the loop.
+*
+* \param connection: A connection of the event loop
+* \param target: [const] The connected socket, owned by the reactor from this call; it is closed if it can not be added
+* \param tag: The caller defined context of the new connection
+*
+* \return Returns the attached connection, or NULL if the socket could not be added
+*/
+QSC_EXPORT_API qsc_reactor_connection* qsc_reactor_attach(qsc_reactor_connection* connection, const qsc_socket* target, void* tag);
+
+/**
+* \brief Close a connection after the current event has been processed.
+* Must be called from a callback of the connection.
+*
+* \param connection: The connection
+*/
+QSC_EXPORT_API void qsc_reactor_close(qsc_reactor_connection* connection);
+
+/**
+* \brief Get the number of open connections
+*
+* \param state: [const] The reactor state
+*
+* \return Returns the number of open connections
+*/
+QSC_EXPORT_API size_t qsc_reactor_connections(const qsc_reactor_state* state);
+
+/**
+* \brief Send data on a connection.
+* With epoll the data is written to the socket, and the part the socket does not accept is held in the write buffer.
+* With io_uring the data is added to the write buffer, and sent by a submission when the callback returns.
+* Output that does not fit the write buffer is held in the overflow buffer; if that would exceed QSC_REACTOR_OVERFLOW_MAX,
+* the peer is not reading and the connection is closed.
+* Must be called from a callback of the connection.
+*
+* \param connection: The connection
+* \param input: [const] The data to send
+* \param inlen: The number of bytes to send
+*
+* \return Returns true if the data was sent or buffered
+*/
+QSC_EXPORT_API bool qsc_reactor_send(qsc_reactor_connection* connection, const uint8_t* input, size_t inlen);
+
+/**
+* \brief Set the idle timeout; a connection that receives nothing for the timeout period is closed.
+* The timeout applies to the connections accepted after it is set.
+*
+* \param state: The reactor state
+* \param milliseconds: The idle timeout in milliseconds, zero disables the timeout
+*/
+QSC_EXPORT_API void qsc_reactor_idle_timeout(qsc_reactor_state* state, uint32_t milliseconds);
+
+/**
+* \brief Initialize a connection timer with its expiry callback.
+* The callback runs on the loop thread of the connection, and may send on and close the connection.
+*
+* \param timer: The timer
+* \param callback: The expiry callback
+*/
+QSC_EXPORT_API void qsc_reactor_timer_initialize(qsc_reactor_timer* timer, void (*callback)(void* context, qsc_reactor_connection* connection, qsc_reactor_timer* timer));
+
+/**
+* \brief Start a timer on a connection, or restart a running timer.
+* The timers of a connection must be cancelled in the close callback, before the connection is released.
+* Must be called from a callback of the connection.
+*
+* \param connection: The connection
+* \param timer: The initialized timer
+* \param milliseconds: The time until the timer expires in milliseconds
+*/
+QSC_EXPORT_API void qsc_reactor_timer_start(qsc_reactor_connection* connection, qsc_reactor_timer* timer, uint32_t milliseconds);
+
+/**
+* \brief Cancel a timer started on a connection.
+* Must be called from a callback of the connection.
+*
+* \param connection: The connection
+* \param timer: The timer
+*/
+QSC_EXPORT_API void qsc_reactor_timer_cancel(qsc_reactor_connection* connection, qsc_reactor_timer* timer);
+
+#endif
@@ -75,6 +75,54 @@ void qsc_socket_server_initialize(qsc_socket* sock)
 	sock->socket_transport = qsc_socket_transport_none;
 }
 
+qsc_socket_exceptions qsc_socket_server_open(qsc_socket* source, const char* address, uint16_t port, qsc_socket_address_families family, bool shared)
+{
+	assert(source != NULL);
+	assert(address != NULL);
+
+	qsc_socket_exceptions res;
+
+	res = qsc_socket_invalid_input;
+
+	if (source != NULL && address != NULL)
+	{
+		res = qsc_socket_create(source, family, qsc_socket_transport_stream, qsc_socket_protocol_tcp);
+
+		if (res == qsc_socket_exception_success)
+		{
+			qsc_socket_set_option(source, qsc_socket_protocol_socket, qsc_socket_option_reuse_address, 1);
+
+			if (shared == true)
+			{
+				/* the option must be set on every listener before it is bound */
+				res = qsc_socket_set_option(source, qsc_socket_protocol_socket, qsc_socket_option_reuse_port, 1);
+			}
+
+			if (res == qsc_socket_exception_success)
+			{
+				res = qsc_socket_bind(source, address, port);
+			}
+
+			if (res == qsc_socket_exception_success)
+			{
+				res = qsc_socket_listen(source, QSC_SOCKET_SERVER_LISTEN_BACKLOG);
+
+				if (res == qsc_socket_exception_success)
+				{
+					source->connection_status = qsc_socket_state_listening;
+				}
+			}
+
+			if (res != qsc_socket_exception_success)
+			{
+				qsc_socket_close_socket(source);
+			}
+		}
+	}
+
+	return res;
+}
+
 qsc_socket_exceptions qsc_socket_server_listen(qsc_socket* source, qsc_socket* target, const char* address, uint16_t port, qsc_socket_address_families family)
 {
 	assert(source != NULL);
@@ -124,6 +124,21 @@ QSC_EXPORT_API void qsc_socket_server_close_socket(qsc_socket* sock);
 */
 QSC_EXPORT_API void qsc_socket_server_initialize(qsc_socket* sock);
 
+/**
+* \brief Creates, binds, and places the source socket in a listening state, without waiting for a connection.
+* Used with the socket reactor, which accepts the connections on its event loops.
+*
+* \param source: The listening socket
+* \param address: [const] The servers address, or the socket path with the unix address family
+* \param port: The servers port number, unused with the unix address family
+* \param family: The socket address family
+* \param shared: Set the reuse port option, so that several listening sockets, each served by its own event loops,
+* can bind the same address and port; the kernel distributes the incoming connections between them
+*
+* \return Returns an exception code on failure, or success(0)
+*/
+QSC_EXPORT_API qsc_socket_exceptions qsc_socket_server_open(qsc_socket* source, const char* address, uint16_t port, qsc_socket_address_families family, bool shared);
+
 /**
 * \brief Places the source socket in a blocking listening state, and waits for a connection.
 * Returns a single socket, and must be called to listen for each new connection.
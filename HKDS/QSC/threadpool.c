@@ -1,6 +1,13 @@
 #include "threadpool.h"
+#include "atomics.h"
 #include "memutils.h"
 
+#if defined(QSC_SYSTEM_COMPILER_MSC)
+#	define QSC_THREADPOOL_TLS __declspec(thread)
+#else
+#	define QSC_THREADPOOL_TLS __thread
+#endif
+
 #if defined(QSC_SYSTEM_OS_WINDOWS)
 bool qsc_threadpool_add_task(qsc_threadpool_state* ctx, void (*func)(void*), void* state)
 {
@@ -135,3 +142,429 @@ void qsc_threadpool_remove_task(qsc_threadpool_state* ctx, size_t index)
 	}
 }
 #endif
+
+/* work-stealing scheduler */
+
+static QSC_THREADPOOL_TLS qsc_threadpool_scheduler* qsc_threadpool_current = NULL;
+static QSC_THREADPOOL_TLS size_t qsc_threadpool_index = 0;
+
+static void qsc_threadpool_run_task(const qsc_threadpool_task* task)
+{
+	task->func(task->state, task->index);
+
+	if (task->pending != NULL)
+	{
+		qsc_atomics_fetch_add64(task->pending, (uint64_t)0 - 1);
+	}
+}
+
+static bool qsc_threadpool_deque_push(qsc_threadpool_deque* deq, const qsc_threadpool_task* task)
+{
+	uint64_t b;
+	uint64_t t;
+	bool res;
+
+	res = false;
+	b = deq->bottom;
+	t = qsc_atomics_load64(&deq->top);
+
+	if (b - t < QSC_THREADPOOL_DEQUE_SIZE)
+	{
+		deq->tasks[b & (QSC_THREADPOOL_DEQUE_SIZE - 1)] = *task;
+		/* publish the task before the new bottom */
+		qsc_atomics_store64(&deq->bottom, b + 1);
+		res = true;
+	}
+
+	return res;
+}
+
+static bool qsc_threadpool_deque_pop(qsc_threadpool_deque* deq, qsc_threadpool_task* task)
+{
+	uint64_t b;
+	uint64_t t;
+	bool res;
+
+	res = false;
+	b = deq->bottom - 1;
+	qsc_atomics_store64(&deq->bottom, b);
+	/* the bottom store must be visible before the top is read */
+	qsc_atomics_fence();
+	t = qsc_atomics_load64(&deq->top);
+
+	if ((int64_t)(b - t) >= 0)
+	{
+		*task = deq->tasks[b & (QSC_THREADPOOL_DEQUE_SIZE - 1)];
+		res = true;
+
+		if (b == t)
+		{
+			/* the last task, race a concurrent thief for it */
+			res = qsc_atomics_compare_exchange64(&deq->top, &t, t + 1);
+			qsc_atomics_store64(&deq->bottom, b + 1);
+		}
+	}
+	else
+	{
+		qsc_atomics_store64(&deq->bottom, b + 1);
+	}
+
+	return res;
+}
+
+static bool qsc_threadpool_deque_steal(qsc_threadpool_deque* deq, qsc_threadpool_task* task)
+{
+	uint64_t b;
+	uint64_t t;
+	bool res;
+
+	res = false;
+	t = qsc_atomics_load64(&deq->top);
+	qsc_atomics_fence();
+	b = qsc_atomics_load64(&deq->bottom);
+
+	if ((int64_t)(b - t) > 0)
+	{
+		*task = deq->tasks[t & (QSC_THREADPOOL_DEQUE_SIZE - 1)];
+		res = qsc_atomics_compare_exchange64(&deq->top, &t, t + 1);
+	}
+
+	return res;
+}
+
+static void qsc_threadpool_inject_lock(qsc_threadpool_scheduler* ctx)
+{
+	uint64_t exp;
+
+	exp = 0;
+
+	while (qsc_atomics_compare_exchange64(&ctx->ilock, &exp, 1) == false)
+	{
+		exp = 0;
+		qsc_atomics_pause();
+	}
+}
+
+static void qsc_threadpool_inject_unlock(qsc_threadpool_scheduler* ctx)
+{
+	qsc_atomics_store64(&ctx->ilock, 0);
+}
+
+static bool qsc_threadpool_inject_take(qsc_threadpool_scheduler* ctx, size_t idx, qsc_threadpool_task* task)
+{
+	size_t cnt;
+	size_t share;
+	bool res;
+
+	res = false;
+
+	if (ctx->ihead != ctx->itail)
+	{
+		qsc_threadpool_inject_lock(ctx);
+		cnt = (size_t)(ctx->itail - ctx->ihead);
+
+		if (cnt != 0)
+		{
+			*task = ctx->inject[ctx->ihead & (QSC_THREADPOOL_INJECT_SIZE - 1)];
+			++ctx->ihead;
+			--cnt;
+			res = true;
+
+			if (idx < ctx->tcount)
+			{
+				/* a worker moves a share of the queue to its deque, where the other workers can steal it */
+				share = cnt / ctx->tcount;
+				share = (share < QSC_THREADPOOL_DEQUE_SIZE / 2) ? share : QSC_THREADPOOL_DEQUE_SIZE / 2;
+
+				for (size_t i = 0; i < share; ++i)
+				{
+					if (qsc_threadpool_deque_push(&ctx->deques[idx], &ctx->inject[ctx->ihead & (QSC_THREADPOOL_INJECT_SIZE - 1)]) == false)
+					{
+						break;
+					}
+
+					++ctx->ihead;
+				}
+			}
+		}
+
+		qsc_threadpool_inject_unlock(ctx);
+	}
+
+	return res;
+}
+
+static bool qsc_threadpool_find_task(qsc_threadpool_scheduler* ctx, size_t idx, qsc_threadpool_task* task)
+{
+	size_t vct;
+	bool res;
+
+	res = false;
+
+	if (idx < ctx->tcount)
+	{
+		res = qsc_threadpool_deque_pop(&ctx->deques[idx], task);
+	}
+
+	if (res == false)
+	{
+		res = qsc_threadpool_inject_take(ctx, idx, task);
+	}
+
+	for (size_t i = 1; res == false && i <= ctx->tcount; ++i)
+	{
+		vct = (idx + i) % ctx->tcount;
+
+		if (vct != idx)
+		{
+			res = qsc_threadpool_deque_steal(&ctx->deques[vct], task);
+		}
+	}
+
+	return res;
+}
+
+static void qsc_threadpool_worker(void* arg)
+{
+	qsc_threadpool_scheduler* ctx;
+	qsc_threadpool_task task;
+	size_t idle;
+
+	ctx = (qsc_threadpool_scheduler*)arg;
+	qsc_threadpool_current = ctx;
+	qsc_threadpool_index = (size_t)qsc_atomics_fetch_add64(&ctx->started, 1);
+	idle = 0;
+
+	while (qsc_atomics_load64(&ctx->running) != 0)
+	{
+		if (qsc_threadpool_find_task(ctx, qsc_threadpool_index, &task) == true)
+		{
+			qsc_threadpool_run_task(&task);
+			idle = 0;
+		}
+		else if (idle < QSC_THREADPOOL_SPIN_COUNT)
+		{
+			qsc_atomics_pause();
+			++idle;
+		}
+		else if (idle < 2 * QSC_THREADPOOL_SPIN_COUNT)
+		{
+			qsc_async_thread_yield();
+			++idle;
+		}
+		else
+		{
+			qsc_async_thread_sleep(1);
+		}
+	}
+
+	qsc_threadpool_current = NULL;
+}
+
+bool qsc_threadpool_scheduler_initialize(qsc_threadpool_scheduler* ctx, size_t threads)
+{
+	assert(ctx != NULL);
+
+	size_t cnt;
+	bool res;
+
+	res = false;
+
+	if (ctx != NULL)
+	{
+		cnt = (threads != 0) ? threads : qsc_async_processor_count();
+		cnt = (cnt < QSC_THREADPOOL_WORKERS_MAX) ? cnt : QSC_THREADPOOL_WORKERS_MAX;
+
+		qsc_memutils_clear(ctx->threads, sizeof(ctx->threads));
+		ctx->deques = (qsc_threadpool_deque*)qsc_memutils_aligned_alloc(64, cnt * sizeof(qsc_threadpool_deque));
+		ctx->inject = (qsc_threadpool_task*)qsc_memutils_aligned_alloc(64, QSC_THREADPOOL_INJECT_SIZE * sizeof(qsc_threadpool_task));
+		ctx->ihead = 0;
+		ctx->itail = 0;
+		ctx->ilock = 0;
+		ctx->running = 1;
+		ctx->started = 0;
+		ctx->tcount = 0;
+
+		if (ctx->deques != NULL && ctx->inject != NULL)
+		{
+			qsc_memutils_clear(ctx->deques, cnt * sizeof(qsc_threadpool_deque));
+			res = true;
+
+			for (size_t i = 0; i < cnt; ++i)
+			{
+				ctx->deques[i].tasks = (qsc_threadpool_task*)qsc_memutils_aligned_alloc(64, QSC_THREADPOOL_DEQUE_SIZE * sizeof(qsc_threadpool_task));
+
+				if (ctx->deques[i].tasks == NULL)
+				{
+					res = false;
+				}
+			}
+
+			if (res == true)
+			{
+				/* the worker count is fixed before any worker runs */
+				ctx->tcount = cnt;
+
+				for (size_t i = 0; i < cnt; ++i)
+				{
+					ctx->threads[i] = qsc_async_thread_create(&qsc_threadpool_worker, ctx);
+
+					if (ctx->threads[i] == 0)
+					{
+						res = false;
+					}
+				}
+
+				if (res == false)
+				{
+					/* the workers that did start are stopped, and the scheduler is released */
+					qsc_threadpool_scheduler_dispose(ctx);
+				}
+			}
+			else
+			{
+				ctx->tcount = cnt;
+				qsc_threadpool_scheduler_dispose(ctx);
+			}
+		}
+		else
+		{
+			qsc_threadpool_scheduler_dispose(ctx);
+		}
+	}
+
+	return res;
+}
+
+void qsc_threadpool_scheduler_dispose(qsc_threadpool_scheduler* ctx)
+{
+	assert(ctx != NULL);
+
+	if (ctx != NULL)
+	{
+		qsc_atomics_store64(&ctx->running, 0);
+
+		for (size_t i = 0; i < ctx->tcount; ++i)
+		{
+			if (ctx->threads[i] != 0)
+			{
+				qsc_async_thread_wait(ctx->threads[i]);
+				ctx->threads[i] = 0;
+			}
+		}
+
+		if (ctx->deques != NULL)
+		{
+			for (size_t i = 0; i < ctx->tcount; ++i)
+			{
+				if (ctx->deques[i].tasks != NULL)
+				{
+					qsc_memutils_aligned_free(ctx->deques[i].tasks);
+				}
+			}
+
+			qsc_memutils_aligned_free(ctx->deques);
+			ctx->deques = NULL;
+		}
+
+		if (ctx->inject != NULL)
+		{
+			qsc_memutils_aligned_free(ctx->inject);
+			ctx->inject = NULL;
+		}
+
+		ctx->ihead = 0;
+		ctx->itail = 0;
+		ctx->started = 0;
+		ctx->tcount = 0;
+	}
+}
+
+void qsc_threadpool_scheduler_submit(qsc_threadpool_scheduler* ctx, void (*func)(void*, size_t), void* state, size_t index, volatile uint64_t* pending)
+{
+	assert(ctx != NULL);
+	assert(func != NULL);
+
+	qsc_threadpool_task task;
+	bool res;
+
+	if (ctx != NULL && func != NULL)
+	{
+		task.func = func;
+		task.state = state;
+		task.index = index;
+		task.pending = pending;
+		res = false;
+
+		if (qsc_threadpool_current == ctx)
+		{
+			res = qsc_threadpool_deque_push(&ctx->deques[qsc_threadpool_index], &task);
+		}
+		else if (ctx->inject != NULL)
+		{
+			qsc_threadpool_inject_lock(ctx);
+
+			if (ctx->itail - ctx->ihead < QSC_THREADPOOL_INJECT_SIZE)
+			{
+				ctx->inject[ctx->itail & (QSC_THREADPOOL_INJECT_SIZE - 1)] = task;
+				++ctx->itail;
+				res = true;
+			}
+
+			qsc_threadpool_inject_unlock(ctx);
+		}
+
+		if (res == false)
+		{
+			/* the queue is full, run the task on this thread */
+			qsc_threadpool_run_task(&task);
+		}
+	}
+}
+
+void qsc_threadpool_scheduler_wait(qsc_threadpool_scheduler* ctx, volatile uint64_t* pending)
+{
+	assert(ctx != NULL);
+	assert(pending != NULL);
+
+	qsc_threadpool_task task;
+	size_t idx;
+
+	if (ctx != NULL && pending != NULL)
+	{
+		/* a non-worker thread has no deque, it only takes and steals tasks */
+		idx = (qsc_threadpool_current == ctx) ? qsc_threadpool_index : ctx->tcount;
+
+		while (qsc_atomics_load64(pending) != 0)
+		{
+			if (qsc_threadpool_find_task(ctx, idx, &task) == true)
+			{
+				qsc_threadpool_run_task(&task);
+			}
+			else
+			{
+				qsc_atomics_pause();
+			}
+		}
+	}
+}
+
+void qsc_threadpool_parallel_for(qsc_threadpool_scheduler* ctx, size_t count, void (*func)(void*, size_t), void* state)
+{
+	assert(ctx != NULL);
+	assert(func != NULL);
+
+	volatile uint64_t pending;
+
+	if (ctx != NULL && func != NULL && count != 0)
+	{
+		pending = count;
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			qsc_threadpool_scheduler_submit(ctx, func, state, i, &pending);
+		}
+
+		qsc_threadpool_scheduler_wait(ctx, &pending);
+	}
+}
@@ -96,4 +96,128 @@ QSC_EXPORT_API bool qsc_threadpool_thread_active(const qsc_threadpool_state* ctx
 QSC_EXPORT_API void qsc_threadpool_remove_task(qsc_threadpool_state* ctx, size_t index);
 
 #endif
+
+/* Work-stealing scheduler.
+* A persistent set of worker threads, each owning a Chase-Lev task deque.
+* A worker runs tasks from the bottom of its own deque; when it is empty, it takes a share of the tasks
+* submitted by non-worker threads from the shared injection queue, and then steals from the top of the
+* other workers deques. Tasks submitted by a worker are added to its own deque.
+* Threads are started once by the initialize function, no threads are created per task or per batch.
+* The scheduler is portable, using the qsc_async threads and the qsc_atomics functions. */
+
+/*!
+* \def QSC_THREADPOOL_WORKERS_MAX
+* \brief The maximum number of scheduler worker threads
+*/
+#define QSC_THREADPOOL_WORKERS_MAX 256
+
+/*!
+* \def QSC_THREADPOOL_DEQUE_SIZE
+* \brief The capacity of a worker task deque, a power of two
+*/
+#define QSC_THREADPOOL_DEQUE_SIZE 1024
+
+/*!
+* \def QSC_THREADPOOL_INJECT_SIZE
+* \brief The capacity of the injection queue, a power of two
+*/
+#define QSC_THREADPOOL_INJECT_SIZE 4096
+
+/*!
+* \def QSC_THREADPOOL_SPIN_COUNT
+* \brief The number of idle iterations a worker spins, then yields, before it sleeps between searches
+*/
+#define QSC_THREADPOOL_SPIN_COUNT 1024
+
+/*!
+* \struct qsc_threadpool_task
+* \brief A scheduled task; the function receives the task state and index
+*/
+typedef struct qsc_threadpool_task
+{
+	void (*func)(void*, size_t);	/*!< The task function */
+	void* state;					/*!< The task state */
+	size_t index;					/*!< The task index */
+	volatile uint64_t* pending;		/*!< An optional counter, decremented when the task completes */
+} qsc_threadpool_task;
+
+/*!
+* \struct qsc_threadpool_deque
+* \brief A Chase-Lev work-stealing deque; the owner adds and removes at the bottom, thieves remove from the top
+*/
+typedef struct qsc_threadpool_deque
+{
+	volatile uint64_t top;			/*!< The position of the next task stolen */
+	uint8_t pad1[56];				/*!< Keeps the top and bottom positions on separate cache lines */
+	volatile uint64_t bottom;		/*!< The position of the next task added by the owner */
+	uint8_t pad2[56];				/*!< Cache line padding */
+	qsc_threadpool_task* tasks;		/*!< The task ring */
+} qsc_threadpool_deque;
+
+/*!
+* \struct qsc_threadpool_scheduler
+* \brief The work-stealing scheduler state
+*/
+typedef struct qsc_threadpool_scheduler
+{
+	qsc_thread threads[QSC_THREADPOOL_WORKERS_MAX];		/*!< The worker threads */
+	qsc_threadpool_deque* deques;						/*!< The worker deques */
+	qsc_threadpool_task* inject;						/*!< The injection queue ring */
+	volatile uint64_t ihead;							/*!< The injection queue read position */
+	volatile uint64_t itail;							/*!< The injection queue write position */
+	volatile uint64_t ilock;							/*!< The injection queue spin lock */
+	volatile uint64_t running;							/*!< The workers are running */
+	volatile uint64_t started;							/*!< The number of workers that have started */
+	size_t tcount;										/*!< The number of worker threads */
+} qsc_threadpool_scheduler;
+
+/**
+* \brief Start the work-stealing scheduler
+*
+* \param ctx: The scheduler state
+* \param threads: The number of worker threads, zero selects the processor count
+* \return Returns true if the scheduler was started; false if its memory or a worker thread could not be created
+*/
+QSC_EXPORT_API bool qsc_threadpool_scheduler_initialize(qsc_threadpool_scheduler* ctx, size_t threads);
+
+/**
+* \brief Stop the worker threads and release the scheduler.
+* Tasks that have not started are discarded.
+*
+* \param ctx: The scheduler state
+*/
+QSC_EXPORT_API void qsc_threadpool_scheduler_dispose(qsc_threadpool_scheduler* ctx);
+
+/**
+* \brief Submit a task to the scheduler.
+* A task submitted from a worker is added to that workers deque, other threads add it to the injection queue.
+* If the queue is full, the task is run on the calling thread.
+*
+* \param ctx: The scheduler state
+* \param func: The task function
+* \param state: The task state
+* \param index: The task index
+* \param pending: An optional counter, decremented when the task completes; can be NULL
+*/
+QSC_EXPORT_API void qsc_threadpool_scheduler_submit(qsc_threadpool_scheduler* ctx, void (*func)(void*, size_t), void* state, size_t index, volatile uint64_t* pending);
+
+/**
+* \brief Run tasks on the calling thread until the pending counter reaches zero
+*
+* \param ctx: The scheduler state
+* \param pending: The completion counter
+*/
+QSC_EXPORT_API void qsc_threadpool_scheduler_wait(qsc_threadpool_scheduler* ctx, volatile uint64_t* pending);
+
+/**
+* \brief Run a function over a range of indices on the scheduler, and wait for completion.
+* The calling thread participates in the work; the function can be called from a task.
+*
+* \param ctx: The scheduler state
+* \param count: The number of indices
+* \param func: The function, called once with each index from zero to count - 1
+* \param state: The function state
+*/
+QSC_EXPORT_API void qsc_threadpool_parallel_for(qsc_threadpool_scheduler* ctx, size_t count, void (*func)(void*, size_t), void* state);
+
 #endif
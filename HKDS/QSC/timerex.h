@@ -71,6 +71,14 @@ QSC_EXPORT_API clock_t qsc_timerex_stopwatch_start();
 */
 QSC_EXPORT_API uint64_t qsc_timerex_stopwatch_elapsed(clock_t start);
 
+/**
+* \brief Returns a monotonic clock reading in microseconds.
+* The origin is arbitrary, use only to measure intervals; the clock is not affected by system time changes.
+*
+* \return The monotonic time in microseconds
+*/
+QSC_EXPORT_API uint64_t qsc_timerex_monotonic_microseconds(void);
+
 #if defined(QSC_DEBUG_MODE)
 /**
 * \brief Print timer function values
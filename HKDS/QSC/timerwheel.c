@@ -0,0 +1,248 @@
+#include "timerwheel.h"
+#include "memutils.h"
+
+static void qsc_timerwheel_link(qsc_timerwheel_state* state, qsc_timerwheel_timer* timer)
+{
+	qsc_timerwheel_timer** slot;
+	uint64_t delta;
+	size_t level;
+
+	delta = (timer->expiry > state->current) ? timer->expiry - state->current : 0;
+	level = 0;
+
+	/* the level is the smallest whose span covers the distance to the deadline */
+	while (level < QSC_TIMERWHEEL_LEVELS - 1 && delta >= (1ULL << (QSC_TIMERWHEEL_SLOT_BITS * (level + 1))))
+	{
+		++level;
+	}
+
+	slot = &state->slots[level][(timer->expiry >> (QSC_TIMERWHEEL_SLOT_BITS * level)) & (QSC_TIMERWHEEL_SLOTS - 1)];
+	timer->slot = slot;
+	timer->previous = NULL;
+	timer->next = *slot;
+
+	if (*slot != NULL)
+	{
+		(*slot)->previous = timer;
+	}
+
+	*slot = timer;
+}
+
+static void qsc_timerwheel_unlink(qsc_timerwheel_timer* timer)
+{
+	if (timer->previous != NULL)
+	{
+		timer->previous->next = timer->next;
+	}
+	else
+	{
+		*timer->slot = timer->next;
+	}
+
+	if (timer->next != NULL)
+	{
+		timer->next->previous = timer->previous;
+	}
+
+	timer->next = NULL;
+	timer->previous = NULL;
+	timer->slot = NULL;
+}
+
+static void qsc_timerwheel_cascade(qsc_timerwheel_state* state)
+{
+	qsc_timerwheel_timer* next;
+	qsc_timerwheel_timer* timer;
+	uint64_t mask;
+	size_t level;
+
+	/* move the timers of each level whose lower levels completed a turn, highest first,
+	   so that timers moved from the top are moved again if their new slot is also due */
+	for (level = QSC_TIMERWHEEL_LEVELS - 1; level > 0; --level)
+	{
+		mask = (1ULL << (QSC_TIMERWHEEL_SLOT_BITS * level)) - 1;
+
+		if ((state->current & mask) == 0)
+		{
+			timer = state->slots[level][(state->current >> (QSC_TIMERWHEEL_SLOT_BITS * level)) & (QSC_TIMERWHEEL_SLOTS - 1)];
+			state->slots[level][(state->current >> (QSC_TIMERWHEEL_SLOT_BITS * level)) & (QSC_TIMERWHEEL_SLOTS - 1)] = NULL;
+
+			while (timer != NULL)
+			{
+				next = timer->next;
+				qsc_timerwheel_link(state, timer);
+				timer = next;
+			}
+		}
+	}
+}
+
+void qsc_timerwheel_initialize(qsc_timerwheel_state* state, uint64_t resolution, uint64_t now)
+{
+	assert(state != NULL);
+	assert(resolution != 0);
+
+	if (state != NULL)
+	{
+		qsc_memutils_clear(state, sizeof(qsc_timerwheel_state));
+		state->resolution = (resolution != 0) ? resolution : 1;
+		state->current = now / state->resolution;
+	}
+}
+
+void qsc_timerwheel_timer_initialize(qsc_timerwheel_timer* timer, void (*callback)(void* context, qsc_timerwheel_timer* timer), void* context)
+{
+	assert(timer != NULL);
+	assert(callback != NULL);
+
+	if (timer != NULL)
+	{
+		qsc_memutils_clear(timer, sizeof(qsc_timerwheel_timer));
+		timer->callback = callback;
+		timer->context = context;
+	}
+}
+
+void qsc_timerwheel_start(qsc_timerwheel_state* state, qsc_timerwheel_timer* timer, uint64_t deadline)
+{
+	assert(state != NULL);
+	assert(timer != NULL);
+
+	uint64_t tick;
+
+	if (state != NULL && timer != NULL)
+	{
+		if (timer->slot != NULL)
+		{
+			qsc_timerwheel_unlink(timer);
+			--state->count;
+		}
+
+		/* rounded up, a timer never expires before its deadline */
+		tick = (deadline / state->resolution) + ((deadline % state->resolution != 0) ? 1 : 0);
+		tick = (tick <= state->current) ? state->current + 1 : tick;
+		tick = (tick - state->current >= QSC_TIMERWHEEL_SPAN) ? state->current + QSC_TIMERWHEEL_SPAN - 1 : tick;
+		timer->expiry = tick;
+		qsc_timerwheel_link(state, timer);
+		++state->count;
+	}
+}
+
+void qsc_timerwheel_cancel(qsc_timerwheel_state* state, qsc_timerwheel_timer* timer)
+{
+	assert(state != NULL);
+	assert(timer != NULL);
+
+	if (state != NULL && timer != NULL && timer->slot != NULL)
+	{
+		qsc_timerwheel_unlink(timer);
+		--state->count;
+	}
+}
+
+bool qsc_timerwheel_active(const qsc_timerwheel_timer* timer)
+{
+	assert(timer != NULL);
+
+	return (timer != NULL && timer->slot != NULL);
+}
+
+size_t qsc_timerwheel_advance(qsc_timerwheel_state* state, uint64_t now)
+{
+	assert(state != NULL);
+
+	qsc_timerwheel_timer* timer;
+	uint64_t target;
+	size_t cnt;
+
+	cnt = 0;
+
+	if (state != NULL)
+	{
+		target = now / state->resolution;
+
+		while (state->current < target)
+		{
+			if (state->count == 0)
+			{
+				/* nothing is running, skip the idle ticks */
+				state->current = target;
+			}
+			else
+			{
+				++state->current;
+				qsc_timerwheel_cascade(state);
+
+				/* the slot of the tick is detached and expired as a batch; the timers stay linked to the expired list,
+				   so a callback can cancel a timer of the same tick that has not run yet */
+				state->expired = state->slots[0][state->current & (QSC_TIMERWHEEL_SLOTS - 1)];
+				state->slots[0][state->current & (QSC_TIMERWHEEL_SLOTS - 1)] = NULL;
+				timer = state->expired;
+
+				while (timer != NULL)
+				{
+					timer->slot = &state->expired;
+					timer = timer->next;
+				}
+
+				while (state->expired != NULL)
+				{
+					timer = state->expired;
+					qsc_timerwheel_unlink(timer);
+					--state->count;
+					++cnt;
+					timer->callback(timer->context, timer);
+				}
+			}
+		}
+	}
+
+	return cnt;
+}
+
+uint64_t qsc_timerwheel_next(const qsc_timerwheel_state* state)
+{
+	assert(state != NULL);
+
+	uint64_t res;
+	uint64_t tick;
+	size_t i;
+
+	res = UINT64_MAX;
+
+	if (state != NULL && state->count != 0)
+	{
+		/* the next turn of the first level, when higher level timers may move down */
+		tick = ((state->current >> QSC_TIMERWHEEL_SLOT_BITS) + 1) << QSC_TIMERWHEEL_SLOT_BITS;
+
+		/* the first occupied slot of the first level before the turn; the turn is at most one level span away */
+		for (i = 1; state->current + i < tick; ++i)
+		{
+			if (state->slots[0][(state->current + i) & (QSC_TIMERWHEEL_SLOTS - 1)] != NULL)
+			{
+				tick = state->current + i;
+			}
+		}
+
+		res = tick * state->resolution;
+	}
+
+	return res;
+}
+
+size_t qsc_timerwheel_count(const qsc_timerwheel_state* state)
+{
+	assert(state != NULL);
+
+	size_t res;
+
+	res = 0;
+
+	if (state != NULL)
+	{
+		res = state->count;
+	}
+
+	return res;
+}
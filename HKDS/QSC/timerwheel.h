@@ -0,0 +1,169 @@
+/* The AGPL version 3 License (AGPLv3)
+*
+* Copyright (c) 2021 Digital Freedom Defence Inc.
+* This file is part of the QSC Cryptographic library
+*
+* This program is free software : you can redistribute it and / or modify
+* it under the terms of the GNU Affero General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU Affero General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef QSC_TIMERWHEEL_H
+#define QSC_TIMERWHEEL_H
+
+#include "common.h"
+
+/**
+* \file timerwheel.h
+* \brief A hierarchical timer wheel.
+* Timers are held in four levels of 64 slots; the first level has one slot for each tick, and each higher level
+* has one slot for each full turn of the level below it. A timer is placed by the distance to its deadline,
+* and the timers of a higher level slot are moved down a level when the level below completes a turn,
+* so starting and cancelling a timer are constant time operations regardless of the number of timers.
+* Timers are intrusive list nodes owned by the caller, so the wheel makes no allocations.
+* Advancing the wheel detaches the slot of each elapsed tick and runs its timers as one batch; a callback
+* may start or cancel any timer, including the one that is running.
+* Deadlines are absolute times in microseconds, on the clock used to advance the wheel; a deadline further away
+* than the wheel span is held in the last slot of the top level and expires at the end of the span.
+* The wheel is not thread safe, and is intended to be owned by a single event loop.
+*/
+
+/*!
+* \def QSC_TIMERWHEEL_LEVELS
+* \brief The number of wheel levels
+*/
+#define QSC_TIMERWHEEL_LEVELS 4
+
+/*!
+* \def QSC_TIMERWHEEL_SLOT_BITS
+* \brief The number of tick bits resolved by each level
+*/
+#define QSC_TIMERWHEEL_SLOT_BITS 6
+
+/*!
+* \def QSC_TIMERWHEEL_SLOTS
+* \brief The number of slots in each level
+*/
+#define QSC_TIMERWHEEL_SLOTS (1ULL << QSC_TIMERWHEEL_SLOT_BITS)
+
+/*!
+* \def QSC_TIMERWHEEL_SPAN
+* \brief The number of ticks covered by the wheel
+*/
+#define QSC_TIMERWHEEL_SPAN (1ULL << (QSC_TIMERWHEEL_SLOT_BITS * QSC_TIMERWHEEL_LEVELS))
+
+/*** Structures ***/
+
+/*! \struct qsc_timerwheel_timer
+* \brief A timer, held by the caller and linked into the wheel while it is running
+*/
+typedef struct qsc_timerwheel_timer
+{
+	struct qsc_timerwheel_timer* next;										/*!< The next timer in the slot */
+	struct qsc_timerwheel_timer* previous;									/*!< The previous timer in the slot */
+	struct qsc_timerwheel_timer** slot;										/*!< The slot holding the timer, or NULL if the timer is not running */
+	void (*callback)(void* context, struct qsc_timerwheel_timer* timer);	/*!< The expiry callback */
+	void* context;															/*!< The callback context */
+	uint64_t expiry;														/*!< The tick the timer expires on */
+} qsc_timerwheel_timer;
+
+/*! \struct qsc_timerwheel_state
+* \brief The timer wheel state
+*/
+typedef struct qsc_timerwheel_state
+{
+	qsc_timerwheel_timer* slots[QSC_TIMERWHEEL_LEVELS][QSC_TIMERWHEEL_SLOTS];	/*!< The timer lists of each level */
+	qsc_timerwheel_timer* expired;												/*!< The timers of the tick being processed */
+	uint64_t current;															/*!< The last processed tick */
+	uint64_t resolution;														/*!< The tick length in microseconds */
+	size_t count;																/*!< The number of running timers */
+} qsc_timerwheel_state;
+
+/*** Function Prototypes ***/
+
+/**
+* \brief Initialize the timer wheel
+*
+* \param state: The timer wheel state
+* \param resolution: The tick length in microseconds; deadlines are rounded up to a tick
+* \param now: The current time in microseconds
+*/
+QSC_EXPORT_API void qsc_timerwheel_initialize(qsc_timerwheel_state* state, uint64_t resolution, uint64_t now);
+
+/**
+* \brief Initialize a timer with its expiry callback
+*
+* \param timer: The timer
+* \param callback: The function invoked when the timer expires
+* \param context: The callback context
+*/
+QSC_EXPORT_API void qsc_timerwheel_timer_initialize(qsc_timerwheel_timer* timer, void (*callback)(void* context, qsc_timerwheel_timer* timer), void* context);
+
+/**
+* \brief Start a timer, or move a running timer to a new deadline.
+* A deadline that has already passed expires on the next tick.
+*
+* \param state: The timer wheel state
+* \param timer: The initialized timer
+* \param deadline: The expiry time in microseconds
+*/
+QSC_EXPORT_API void qsc_timerwheel_start(qsc_timerwheel_state* state, qsc_timerwheel_timer* timer, uint64_t deadline);
+
+/**
+* \brief Stop a running timer; a timer that is not running is unchanged
+*
+* \param state: The timer wheel state
+* \param timer: The timer
+*/
+QSC_EXPORT_API void qsc_timerwheel_cancel(qsc_timerwheel_state* state, qsc_timerwheel_timer* timer);
+
+/**
+* \brief Get the running state of a timer
+*
+* \param timer: [const] The timer
+*
+* \return Returns true if the timer is running
+*/
+QSC_EXPORT_API bool qsc_timerwheel_active(const qsc_timerwheel_timer* timer);
+
+/**
+* \brief Advance the wheel to the current time, and run the callbacks of the expired timers
+*
+* \param state: The timer wheel state
+* \param now: The current time in microseconds
+*
+* \return Returns the number of timers that expired
+*/
+QSC_EXPORT_API size_t qsc_timerwheel_advance(qsc_timerwheel_state* state, uint64_t now);
+
+/**
+* \brief Get the time the wheel should next be advanced, for use as a wait timeout.
+* The result is the deadline of the nearest timer in the first level, or the next turn of the first level,
+* when timers of the higher levels must be moved down; the search is bounded by the number of slots.
+*
+* \param state: [const] The timer wheel state
+*
+* \return Returns the time in microseconds, or UINT64_MAX if no timer is running
+*/
+QSC_EXPORT_API uint64_t qsc_timerwheel_next(const qsc_timerwheel_state* state);
+
+/**
+* \brief Get the number of running timers
+*
+* \param state: [const] The timer wheel state
+*
+* \return Returns the number of timers
+*/
+QSC_EXPORT_API size_t qsc_timerwheel_count(const qsc_timerwheel_state* state);
+
+#endif